@@ -78,6 +78,9 @@ bool opt_start_replaybuffer = false;
 bool opt_minimize_tray = false;
 bool opt_allow_opengl = false;
 bool opt_always_on_top = false;
+bool opt_profiler_trace = false;
+bool opt_lazy_modules = false;
+string opt_metrics_socket;
 string opt_starting_collection;
 string opt_starting_profile;
 string opt_starting_scene;
@@ -1257,6 +1260,9 @@ bool OBSApp::OBSInit()
 	blog(LOG_INFO, "Portable mode: %s",
 			portable_mode ? "true" : "false");
 
+	if (!opt_metrics_socket.empty())
+		obs_metrics_start_server(opt_metrics_socket.c_str());
+
 	setQuitOnLastWindowClosed(false);
 
 	mainWindow = new OBSBasic();
@@ -1634,6 +1640,28 @@ static void SaveProfilerData(const ProfilerSnapshot &snap)
 				static_cast<const char*>(path));
 }
 
+static void SaveProfilerTrace()
+{
+	if (currentLogFile.empty())
+		return;
+
+	auto pos = currentLogFile.rfind('.');
+	if (pos == currentLogFile.npos)
+		return;
+
+#define LITERAL_SIZE(x) x, (sizeof(x) - 1)
+	ostringstream dst;
+	dst.write(LITERAL_SIZE("obs-studio/profiler_data/"));
+	dst.write(currentLogFile.c_str(), pos);
+	dst.write(LITERAL_SIZE(".trace.json"));
+#undef LITERAL_SIZE
+
+	BPtr<char> path = GetConfigPathPtr(dst.str().c_str());
+	if (!profiler_trace_dump_json(path, 0))
+		blog(LOG_WARNING, "Could not save profiler trace to '%s'",
+				static_cast<const char*>(path));
+}
+
 static auto ProfilerFree = [](void *)
 {
 	profiler_stop();
@@ -1645,6 +1673,11 @@ static auto ProfilerFree = [](void *)
 
 	SaveProfilerData(snap);
 
+	if (opt_profiler_trace) {
+		profiler_trace_stop();
+		SaveProfilerTrace();
+	}
+
 	profiler_free();
 };
 
@@ -1660,6 +1693,8 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 				ProfilerFree);
 
 	profiler_start();
+	if (opt_profiler_trace)
+		profiler_trace_start();
 	profile_register_root(run_program_init, 0);
 
 	ScopeProfiler prof{run_program_init};
@@ -2210,6 +2245,14 @@ static void upgrade_settings(void)
 
 int main(int argc, char *argv[])
 {
+	/* the allocator has to be replaced before anything is allocated, so
+	 * this option is looked for ahead of the others */
+	for (int i = 1; i < argc; i++) {
+		if (arg_is(argv[i], "--arena-allocator", nullptr)) {
+			base_use_arena_allocator();
+			break;
+		}
+	}
 
 
 	QFile inputFile;
@@ -2296,6 +2339,18 @@ int main(int argc, char *argv[])
 		} else if (arg_is(argv[i], "--allow-opengl", nullptr)) {
 			opt_allow_opengl = true;
 
+		} else if (arg_is(argv[i], "--profiler-trace", nullptr)) {
+			opt_profiler_trace = true;
+
+		} else if (arg_is(argv[i], "--metrics-socket", nullptr)) {
+			if (++i < argc) opt_metrics_socket = argv[i];
+
+		} else if (arg_is(argv[i], "--arena-allocator", nullptr)) {
+			/* handled at the start of main */
+
+		} else if (arg_is(argv[i], "--lazy-modules", nullptr)) {
+			opt_lazy_modules = true;
+
 		} else if (arg_is(argv[i], "--help", "-h")) {
 			std::cout <<
 			"--help, -h: Get list of available commands.\n\n" << 
@@ -2314,6 +2369,14 @@ int main(int argc, char *argv[])
 			"--always-on-top: Start in 'always on top' mode.\n\n" <<
 			"--unfiltered_log: Make log unfiltered.\n\n" <<
 			"--allow-opengl: Allow OpenGL on Windows.\n\n" <<
+			"--profiler-trace: Save a timeline of profiled events "
+				"on exit.\n" <<
+			"--metrics-socket <path>: Serve live metrics on a Unix "
+				"socket.\n" <<
+			"--arena-allocator: Use the size-class memory "
+				"allocator.\n" <<
+			"--lazy-modules: Load plugins when they are first "
+				"used.\n\n" <<
 			"--version, -V: Get current version.\n";
 
 			exit(0);
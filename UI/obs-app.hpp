@@ -220,4 +220,5 @@ extern bool opt_minimize_tray;
 extern bool opt_studio_mode;
 extern bool opt_allow_opengl;
 extern bool opt_always_on_top;
+extern bool opt_lazy_modules;
 extern std::string opt_starting_scene;
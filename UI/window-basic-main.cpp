@@ -1562,6 +1562,7 @@ void OBSBasic::OBSInit()
 
 	AddExtraModulePaths();
 	blog(LOG_INFO, "---------------------------------");
+	obs_set_lazy_module_loading(opt_lazy_modules);
 	obs_load_all_modules();
 	blog(LOG_INFO, "---------------------------------");
 	obs_log_loaded_modules();
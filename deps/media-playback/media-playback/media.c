@@ -676,6 +676,20 @@ static inline bool mp_media_init_internal(mp_media_t *m,
 	return true;
 }
 
+/* sources that allow parallel creation can get here from several threads
+ * at once */
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+static void mp_media_init_once(void)
+{
+	av_register_all();
+	avdevice_register_all();
+	avcodec_register_all();
+	avformat_network_init();
+
+	base_sys_ts = (int64_t)os_gettime_ns();
+}
+
 bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 {
 	memset(media, 0, sizeof(*media));
@@ -693,17 +707,7 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	if (!info->is_local_file || media->speed < 1 || media->speed > 200)
 		media->speed = 100;
 
-	static bool initialized = false;
-	if (!initialized) {
-		av_register_all();
-		avdevice_register_all();
-		avcodec_register_all();
-		avformat_network_init();
-		initialized = true;
-	}
-
-	if (!base_sys_ts)
-		base_sys_ts = (int64_t)os_gettime_ns();
+	pthread_once(&init_once, mp_media_init_once);
 
 	if (!mp_media_init_internal(media, info)) {
 		mp_media_free(media);
@@ -2033,24 +2033,25 @@ static inline void gs_vertexbuffer_flush_internal(gs_vertbuffer_t *vertbuffer,
 
 	if (data->points)
 		vertbuffer->FlushBuffer(vertbuffer->vertexBuffer,
-				data->points, sizeof(vec3));
+				data->points, sizeof(vec3), data->num);
 
 	if (vertbuffer->normalBuffer && data->normals)
 		vertbuffer->FlushBuffer(vertbuffer->normalBuffer,
-				data->normals, sizeof(vec3));
+				data->normals, sizeof(vec3), data->num);
 
 	if (vertbuffer->tangentBuffer && data->tangents)
 		vertbuffer->FlushBuffer(vertbuffer->tangentBuffer,
-				data->tangents, sizeof(vec3));
+				data->tangents, sizeof(vec3), data->num);
 
 	if (vertbuffer->colorBuffer && data->colors)
 		vertbuffer->FlushBuffer(vertbuffer->colorBuffer,
-				data->colors, sizeof(uint32_t));
+				data->colors, sizeof(uint32_t),
+				data->num);
 
 	for (size_t i = 0; i < num_tex; i++) {
 		gs_tvertarray &tv = data->tvarray[i];
 		vertbuffer->FlushBuffer(vertbuffer->uvBuffers[i],
-				tv.array, tv.width*sizeof(float));
+				tv.array, tv.width*sizeof(float), data->num);
 	}
 }
 
@@ -33,7 +33,7 @@ static inline void PushBuffer(vector<ID3D11Buffer*> &buffers,
 }
 
 void gs_vertex_buffer::FlushBuffer(ID3D11Buffer *buffer, void *array,
-		size_t elementSize)
+		size_t elementSize, size_t num)
 {
 	D3D11_MAPPED_SUBRESOURCE msr;
 	HRESULT hr;
@@ -42,7 +42,10 @@ void gs_vertex_buffer::FlushBuffer(ID3D11Buffer *buffer, void *array,
 					D3D11_MAP_WRITE_DISCARD, 0, &msr)))
 		throw HRError("Failed to map buffer", hr);
 
-	memcpy(msr.pData, array, elementSize * vbd.data->num);
+	if (num > vbd.data->num)
+		num = vbd.data->num;
+
+	memcpy(msr.pData, array, elementSize * num);
 	device->context->Unmap(buffer, 0);
 }
 
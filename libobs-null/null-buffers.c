@@ -0,0 +1,133 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include <util/bmem.h>
+#include "null-subsystem.h"
+
+/* vertex and index data is only ever read by the caller, so the buffers
+ * just keep ownership of it and flushing has nothing to upload */
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+		struct gs_vb_data *data, uint32_t flags)
+{
+	struct gs_vertex_buffer *vb;
+
+	if (!data || !data->num) {
+		blog(LOG_ERROR, "device_vertexbuffer_create (null): No data");
+		return NULL;
+	}
+
+	vb = bzalloc(sizeof(struct gs_vertex_buffer));
+	vb->device  = device;
+	vb->data    = data;
+	vb->dynamic = (flags & GS_DYNAMIC) != 0;
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vb)
+{
+	if (!vb)
+		return;
+
+	if (vb->device->cur_vertex_buffer == vb)
+		vb->device->cur_vertex_buffer = NULL;
+
+	gs_vbdata_destroy(vb->data);
+	bfree(vb);
+}
+
+static inline void vertexbuffer_check_dynamic(const gs_vertbuffer_t *vb,
+		const char *func)
+{
+	if (!vb->dynamic)
+		blog(LOG_ERROR, "%s (null): vertex buffer is not dynamic",
+				func);
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vb)
+{
+	vertexbuffer_check_dynamic(vb, "gs_vertexbuffer_flush");
+}
+
+void gs_vertexbuffer_flush_direct(gs_vertbuffer_t *vb,
+		const struct gs_vb_data *data)
+{
+	vertexbuffer_check_dynamic(vb, "gs_vertexbuffer_flush_direct");
+	UNUSED_PARAMETER(data);
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
+{
+	return vb->data;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+		enum gs_index_type type, void *indices, size_t num,
+		uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+
+	ib->device  = device;
+	ib->type    = type;
+	ib->data    = indices;
+	ib->num     = num;
+	ib->dynamic = (flags & GS_DYNAMIC) != 0;
+	return ib;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *ib)
+{
+	if (!ib)
+		return;
+
+	if (ib->device->cur_index_buffer == ib)
+		ib->device->cur_index_buffer = NULL;
+
+	bfree(ib->data);
+	bfree(ib);
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *ib)
+{
+	if (!ib->dynamic)
+		blog(LOG_ERROR, "gs_indexbuffer_flush (null): index buffer "
+				"is not dynamic");
+}
+
+void gs_indexbuffer_flush_direct(gs_indexbuffer_t *ib, const void *data)
+{
+	gs_indexbuffer_flush(ib);
+	UNUSED_PARAMETER(data);
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *ib)
+{
+	return ib->data;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *ib)
+{
+	return ib->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *ib)
+{
+	return ib->type;
+}
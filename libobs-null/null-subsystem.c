@@ -0,0 +1,481 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include <util/bmem.h>
+#include "null-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Null";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_NULL;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_NULL";
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing null renderer (adapter %u ignored), "
+			"nothing will be drawn", adapter);
+
+	device->cur_cull_mode = GS_BACK;
+	matrix4_identity(&device->cur_proj);
+
+	*p_device = device;
+	return GS_SUCCESS;
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (!device)
+		return;
+
+	blog(LOG_INFO, "Null renderer: %llu draws discarded, "
+			"%llu bytes copied",
+			(unsigned long long)device->draws,
+			(unsigned long long)device->copied_bytes);
+
+	da_free(device->proj_stack);
+	bfree(device);
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+		const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info   = *info;
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		swapchain->device->cur_swap = NULL;
+
+	bfree(swapchain);
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	if (device->cur_swap) {
+		device->cur_swap->info.cx = cx;
+		device->cur_swap->info.cy = cy;
+	}
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	*cx = device->cur_swap ? device->cur_swap->info.cx : 0;
+	*cy = device->cur_swap ? device->cur_swap->info.cy : 0;
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cx : 0;
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cy : 0;
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vb)
+{
+	device->cur_vertex_buffer = vb;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *ib)
+{
+	device->cur_index_buffer = ib;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device,
+		gs_samplerstate_t *ss, int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_samplers[unit] = ss;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d,
+		int unit)
+{
+	UNUSED_PARAMETER(b_3d);
+	device_load_samplerstate(device, NULL, unit);
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	device->cur_pixel_shader = pixelshader;
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+		gs_zstencil_t *zstencil)
+{
+	device->cur_render_target   = tex;
+	device->cur_zstencil_buffer = zstencil;
+	device->cur_render_side     = 0;
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+		int side, gs_zstencil_t *zstencil)
+{
+	device->cur_render_target   = cubetex;
+	device->cur_zstencil_buffer = zstencil;
+	device->cur_render_side     = side;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_begin_scene(gs_device_t *device)
+{
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	UNUSED_PARAMETER(draw_mode);
+	UNUSED_PARAMETER(start_vert);
+	UNUSED_PARAMETER(num_verts);
+
+	if (!device->cur_vertex_shader || !device->cur_pixel_shader) {
+		blog(LOG_ERROR, "device_draw (null): No shader loaded");
+		return;
+	}
+
+	device->draws++;
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+static inline uint8_t float_to_u8(float val)
+{
+	if (val <= 0.0f) return 0;
+	if (val >= 1.0f) return 255;
+	return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+/* only 8-bit four channel targets are filled; a clear is the one render
+ * operation whose result is well defined without rasterizing anything */
+static void clear_render_target(struct gs_texture *tex, const struct vec4 *color)
+{
+	uint8_t r = float_to_u8(color->x);
+	uint8_t g = float_to_u8(color->y);
+	uint8_t b = float_to_u8(color->z);
+	uint8_t a = float_to_u8(color->w);
+	uint8_t pixel[4];
+	uint8_t *line;
+
+	if (tex->format == GS_RGBA) {
+		pixel[0] = r; pixel[1] = g; pixel[2] = b; pixel[3] = a;
+	} else if (tex->format == GS_BGRA || tex->format == GS_BGRX) {
+		pixel[0] = b; pixel[1] = g; pixel[2] = r; pixel[3] = a;
+	} else {
+		return;
+	}
+
+	line = tex->data;
+	for (uint32_t x = 0; x < tex->width; x++)
+		memcpy(line + x * 4, pixel, 4);
+	for (uint32_t y = 1; y < tex->height; y++)
+		memcpy(line + y * tex->linesize, line, tex->width * 4);
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		const struct vec4 *color, float depth, uint8_t stencil)
+{
+	struct gs_texture *tex = device->cur_render_target;
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+
+	if ((clear_flags & GS_CLEAR_COLOR) != 0 && tex &&
+	    tex->type == GS_TEXTURE_2D)
+		clear_render_target(tex, color);
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green,
+		bool blue, bool alpha)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(red);
+	UNUSED_PARAMETER(green);
+	UNUSED_PARAMETER(blue);
+	UNUSED_PARAMETER(alpha);
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+		enum gs_blend_type dest)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src);
+	UNUSED_PARAMETER(dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src_c);
+	UNUSED_PARAMETER(dest_c);
+	UNUSED_PARAMETER(src_a);
+	UNUSED_PARAMETER(dest_a);
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_stencil_op_type fail, enum gs_stencil_op_type zfail,
+		enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+		int height)
+{
+	device->cur_viewport.x  = x;
+	device->cur_viewport.y  = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(rect);
+}
+
+void device_ortho(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+	float rml = right-left;
+	float bmt = bottom-top;
+	float fmn = far-near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =         2.0f /  rml;
+	dst->t.x = (left+right) / -rml;
+
+	dst->y.y =         2.0f / -bmt;
+	dst->t.y = (bottom+top) /  bmt;
+
+	dst->z.z =        -2.0f /  fmn;
+	dst->t.z =   (far+near) / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+	float rml    = right-left;
+	float tmb    = top-bottom;
+	float nmf    = near-far;
+	float nearx2 = 2.0f*near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =           nearx2 /  rml;
+	dst->z.x =      (left+right) / rml;
+
+	dst->y.y =           nearx2 /  tmb;
+	dst->z.y =      (bottom+top) / tmb;
+
+	dst->z.z =        (far+near) / nmf;
+	dst->t.z = 2.0f * (near*far) / nmf;
+
+	dst->z.w = -1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+/* nothing reaches an API here, so the draws are what gets counted */
+uint64_t device_get_api_calls(const gs_device_t *device)
+{
+	return device->draws;
+}
+
+#ifdef _WIN32
+bool device_gdi_texture_available(void)
+{
+	return false;
+}
+
+bool device_shared_texture_available(void)
+{
+	return false;
+}
+#endif
@@ -0,0 +1,133 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include <util/darray.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+
+/*
+ * Null renderer
+ *
+ *   Implements the device API without a GPU: textures and staging surfaces
+ * are plain system memory, draws are discarded, and shaders are only parsed
+ * so that effects can bind their parameters.  Copies, clears, mapping and
+ * staging still move real data, which keeps the raw video path (and anything
+ * timed against it) working in headless environments such as CI containers.
+ */
+
+struct gs_sampler_state {
+	struct gs_sampler_info info;
+};
+
+struct gs_shader_param {
+	char                       *name;
+	enum gs_shader_param_type  type;
+	int                        array_count;
+
+	gs_texture_t               *texture;
+	gs_samplerstate_t          *next_sampler;
+
+	DARRAY(uint8_t)            cur_value;
+	DARRAY(uint8_t)            def_value;
+};
+
+struct gs_shader {
+	gs_device_t                *device;
+	enum gs_shader_type        type;
+	DARRAY(struct gs_shader_param) params;
+
+	struct gs_shader_param     *viewproj;
+	struct gs_shader_param     *world;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t                *device;
+	struct gs_vb_data          *data;
+	bool                       dynamic;
+};
+
+struct gs_index_buffer {
+	gs_device_t                *device;
+	enum gs_index_type         type;
+	void                       *data;
+	size_t                     num;
+	bool                       dynamic;
+};
+
+struct gs_texture {
+	gs_device_t                *device;
+	enum gs_texture_type       type;
+	enum gs_color_format       format;
+	uint32_t                   width;
+	uint32_t                   height;
+	uint32_t                   depth;
+	uint32_t                   linesize;
+	bool                       is_render_target;
+	uint8_t                    *data;
+};
+
+struct gs_stage_surface {
+	gs_device_t                *device;
+	enum gs_color_format       format;
+	uint32_t                   width;
+	uint32_t                   height;
+	uint32_t                   linesize;
+	uint8_t                    *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t                *device;
+	enum gs_zstencil_format    format;
+	uint32_t                   width;
+	uint32_t                   height;
+};
+
+struct gs_swap_chain {
+	gs_device_t                *device;
+	struct gs_init_data        info;
+};
+
+struct gs_device {
+	gs_swapchain_t             *cur_swap;
+	gs_texture_t               *cur_render_target;
+	gs_zstencil_t              *cur_zstencil_buffer;
+	int                        cur_render_side;
+	gs_texture_t               *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t          *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t            *cur_vertex_buffer;
+	gs_indexbuffer_t           *cur_index_buffer;
+	gs_shader_t                *cur_vertex_shader;
+	gs_shader_t                *cur_pixel_shader;
+
+	enum gs_cull_mode          cur_cull_mode;
+	struct gs_rect             cur_viewport;
+
+	struct matrix4             cur_proj;
+	DARRAY(struct matrix4)     proj_stack;
+
+	uint64_t                   draws;
+	uint64_t                   copied_bytes;
+};
+
+static inline uint32_t null_texture_plane_size(const struct gs_texture *tex)
+{
+	return tex->linesize * tex->height;
+}
@@ -0,0 +1,378 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include <util/bmem.h>
+#include "null-subsystem.h"
+
+static struct gs_texture *texture_create(gs_device_t *device,
+		enum gs_texture_type type, uint32_t width, uint32_t height,
+		uint32_t depth, enum gs_color_format format, uint32_t flags)
+{
+	struct gs_texture *tex;
+	uint32_t bpp = gs_get_format_bpp(format);
+
+	if (!width || !height || !depth || !bpp) {
+		blog(LOG_ERROR, "device_texture_create (null): Invalid size "
+				"or format");
+		return NULL;
+	}
+
+	tex = bzalloc(sizeof(struct gs_texture));
+	tex->device           = device;
+	tex->type             = type;
+	tex->format           = format;
+	tex->width            = width;
+	tex->height           = height;
+	tex->depth            = depth;
+	tex->linesize         = (width * bpp + 7) / 8;
+	tex->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+	tex->data = bzalloc((size_t)null_texture_plane_size(tex) * depth);
+	return tex;
+}
+
+/* only the top level is kept: nothing samples the lower mip levels */
+static void texture_upload(struct gs_texture *tex, uint32_t planes,
+		const uint8_t **data, uint32_t levels)
+{
+	uint32_t size = null_texture_plane_size(tex);
+
+	if (!data)
+		return;
+
+	for (uint32_t i = 0; i < planes; i++) {
+		if (data[i * levels])
+			memcpy(tex->data + (size_t)size * i, data[i * levels],
+					size);
+	}
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format,
+		uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture *tex = texture_create(device, GS_TEXTURE_2D,
+			width, height, 1, color_format, flags);
+
+	if (tex)
+		texture_upload(tex, 1, data, levels ? levels : 1);
+	return tex;
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture *tex = texture_create(device, GS_TEXTURE_CUBE,
+			size, size, 6, color_format, flags);
+
+	if (tex)
+		texture_upload(tex, 6, data, levels ? levels : 1);
+	return tex;
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, uint32_t depth,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture *tex = texture_create(device, GS_TEXTURE_3D,
+			width, height, depth, color_format, flags);
+
+	if (tex && data && data[0])
+		memcpy(tex->data, data[0],
+				(size_t)null_texture_plane_size(tex) * depth);
+
+	UNUSED_PARAMETER(levels);
+	return tex;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	if (!tex)
+		return;
+
+	if (tex->device->cur_render_target == tex)
+		tex->device->cur_render_target = NULL;
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (tex->device->cur_textures[i] == tex)
+			tex->device->cur_textures[i] = NULL;
+	}
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	if (tex->type != GS_TEXTURE_2D)
+		return false;
+
+	*ptr      = tex->data;
+	*linesize = tex->linesize;
+	return true;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return tex->data;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	gs_texture_destroy(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	return cubetex->width;
+}
+
+enum gs_color_format gs_cubetexture_get_color_format(
+		const gs_texture_t *cubetex)
+{
+	return cubetex->format;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	gs_texture_destroy(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	return voltex->width;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	return voltex->height;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	return voltex->depth;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(
+		const gs_texture_t *voltex)
+{
+	return voltex->format;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void copy_region(gs_device_t *device,
+		uint8_t *dst, uint32_t dst_linesize,
+		const uint8_t *src, uint32_t src_linesize,
+		uint32_t row_bytes, uint32_t rows)
+{
+	for (uint32_t y = 0; y < rows; y++)
+		memcpy(dst + (size_t)y * dst_linesize,
+				src + (size_t)y * src_linesize, row_bytes);
+
+	device->copied_bytes += (uint64_t)row_bytes * rows;
+}
+
+void device_copy_texture_region(gs_device_t *device,
+		gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	uint32_t bpp;
+
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"Source or destination texture is NULL");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D || dst->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"Source and destination must be 2D textures");
+		return;
+	}
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"Source and destination formats do not match");
+		return;
+	}
+
+	if (!src_w) src_w = src->width  - src_x;
+	if (!src_h) src_h = src->height - src_y;
+
+	if (src_x + src_w > src->width  || src_y + src_h > src->height ||
+	    dst_x + src_w > dst->width  || dst_y + src_h > dst->height) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"Region is out of bounds");
+		return;
+	}
+
+	bpp = gs_get_format_bpp(src->format);
+	copy_region(device,
+			dst->data + dst_y * dst->linesize + dst_x * bpp / 8,
+			dst->linesize,
+			src->data + src_y * src->linesize + src_x * bpp / 8,
+			src->linesize,
+			src_w * bpp / 8, src_h);
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+		gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device,
+		uint32_t width, uint32_t height,
+		enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf;
+	uint32_t bpp = gs_get_format_bpp(color_format);
+
+	if (!width || !height || !bpp) {
+		blog(LOG_ERROR, "device_stagesurface_create (null): Invalid "
+				"size or format");
+		return NULL;
+	}
+
+	surf = bzalloc(sizeof(struct gs_stage_surface));
+	surf->device   = device;
+	surf->format   = color_format;
+	surf->width    = width;
+	surf->height   = height;
+	surf->linesize = (width * bpp + 7) / 8;
+	surf->data     = bzalloc((size_t)surf->linesize * height);
+	return surf;
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+		gs_texture_t *src)
+{
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_stage_texture (null): Source or "
+				"destination is NULL");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D || src->format != dst->format ||
+	    src->width != dst->width || src->height != dst->height) {
+		blog(LOG_ERROR, "device_stage_texture (null): Source and "
+				"destination do not match");
+		return;
+	}
+
+	copy_region(device, dst->data, dst->linesize, src->data, src->linesize,
+			dst->linesize, dst->height);
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (!stagesurf)
+		return;
+
+	bfree(stagesurf->data);
+	bfree(stagesurf);
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format gs_stagesurface_get_color_format(
+		const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+		uint32_t *linesize)
+{
+	*data     = stagesurf->data;
+	*linesize = stagesurf->linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs = bzalloc(sizeof(*zs));
+
+	zs->device = device;
+	zs->format = format;
+	zs->width  = width;
+	zs->height = height;
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zs)
+{
+	bfree(zs);
+}
+
+gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
+		const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *ss = bzalloc(sizeof(*ss));
+
+	UNUSED_PARAMETER(device);
+	ss->info = *info;
+	return ss;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	bfree(samplerstate);
+}
@@ -17,6 +17,8 @@
 
 #include "gl-subsystem.h"
 
+uint64_t gl_call_count = 0;
+
 bool gl_init_face(GLenum target, GLenum type, uint32_t num_levels,
 		GLenum format, GLint internal_format, bool compressed,
 		uint32_t width, uint32_t height, uint32_t size,
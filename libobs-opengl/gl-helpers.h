@@ -23,9 +23,17 @@
  * make a bunch of helper functions to make it a bit easier to handle errors
  */
 
+/* every GL call is checked with gl_success, so this doubles as a count of
+ * the GL calls issued.  only ever touched with the context current */
+extern uint64_t gl_call_count;
+
 static inline bool gl_success(const char *funcname)
 {
-	GLenum errorcode = glGetError();
+	GLenum errorcode;
+
+	gl_call_count++;
+
+	errorcode = glGetError();
 	if (errorcode != GL_NO_ERROR) {
 		blog(LOG_ERROR, "%s failed, glGetError returned 0x%X",
 				funcname, errorcode);
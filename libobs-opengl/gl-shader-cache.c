@@ -0,0 +1,282 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <obs-config.h>
+#include "gl-subsystem.h"
+
+/*
+ * On-disk cache of linked program binaries.
+ *
+ * Each vertex/pixel shader pair is stored in its own file, named after the
+ * hashes of the generated GLSL of both shaders.  The file header records the
+ * driver that produced the binary, so a driver update, a GPU change or a
+ * libobs API bump simply makes the old entries miss, after which they are
+ * overwritten by a freshly linked program.
+ */
+
+#define PROGRAM_CACHE_MAGIC   0x42504c47 /* "GLPB" */
+#define PROGRAM_CACHE_VERSION 1
+#define PROGRAM_CACHE_MAX     (16 * 1024 * 1024)
+
+struct program_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t driver_hash;
+	uint64_t vertex_hash;
+	uint64_t pixel_hash;
+	uint32_t format;
+	uint32_t size;
+};
+
+uint64_t gl_hash_string(uint64_t hash, const char *str)
+{
+	if (!hash)
+		hash = 0xcbf29ce484222325ULL;
+
+	while (str && *str) {
+		hash ^= (uint8_t)*(str++);
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static inline void hash_gl_string(uint64_t *hash, GLenum name)
+{
+	*hash = gl_hash_string(*hash, (const char*)glGetString(name));
+}
+
+void gl_program_cache_init(struct gs_device *device)
+{
+	struct gl_program_cache *cache = &device->program_cache;
+	GLint formats = 0;
+	char api_ver[16];
+
+	if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+		return;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (!gl_success("glGetIntegerv") || formats <= 0)
+		return;
+
+	hash_gl_string(&cache->driver_hash, GL_VENDOR);
+	hash_gl_string(&cache->driver_hash, GL_RENDERER);
+	hash_gl_string(&cache->driver_hash, GL_VERSION);
+	hash_gl_string(&cache->driver_hash, GL_SHADING_LANGUAGE_VERSION);
+
+	snprintf(api_ver, sizeof(api_ver), "%u", (unsigned)LIBOBS_API_VER);
+	cache->driver_hash = gl_hash_string(cache->driver_hash, api_ver);
+	cache->supported = true;
+}
+
+void gl_program_cache_free(struct gs_device *device)
+{
+	struct gl_program_cache *cache = &device->program_cache;
+
+	if (cache->loaded || cache->linked)
+		blog(LOG_INFO, "OpenGL program cache: %ld loaded in %.2f ms, "
+				"%ld linked in %.2f ms",
+				cache->loaded,
+				(double)cache->load_time_ns / 1000000.0,
+				cache->linked,
+				(double)cache->link_time_ns / 1000000.0);
+
+	dstr_free(&cache->path);
+}
+
+void device_set_shader_cache_path(gs_device_t *device, const char *path)
+{
+	struct gl_program_cache *cache = &device->program_cache;
+
+	dstr_free(&cache->path);
+
+	if (!cache->supported || !path || !*path)
+		return;
+
+	if (os_mkdirs(path) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "OpenGL program cache: failed to create "
+				"'%s'", path);
+		return;
+	}
+
+	dstr_copy(&cache->path, path);
+	if (dstr_end(&cache->path) != '/')
+		dstr_cat_ch(&cache->path, '/');
+
+	blog(LOG_INFO, "OpenGL program cache: %s", cache->path.array);
+}
+
+static inline bool program_cache_enabled(const struct gs_device *device)
+{
+	return device->program_cache.supported &&
+		!dstr_is_empty(&device->program_cache.path);
+}
+
+static void get_program_file(struct dstr *file, struct gs_program *program,
+		const char *ext)
+{
+	dstr_copy_dstr(file, &program->device->program_cache.path);
+	dstr_catf(file, "%016llx-%016llx%s",
+			(unsigned long long)program->vertex_shader->hash,
+			(unsigned long long)program->pixel_shader->hash,
+			ext);
+}
+
+static inline bool header_valid(const struct program_cache_header *header,
+		struct gs_program *program)
+{
+	return header->magic       == PROGRAM_CACHE_MAGIC &&
+	       header->version     == PROGRAM_CACHE_VERSION &&
+	       header->driver_hash == program->device->program_cache.driver_hash &&
+	       header->vertex_hash == program->vertex_shader->hash &&
+	       header->pixel_hash  == program->pixel_shader->hash &&
+	       header->size > 0 && header->size <= PROGRAM_CACHE_MAX;
+}
+
+static bool load_program_binary(struct gs_program *program, FILE *f)
+{
+	struct program_cache_header header;
+	GLint linked = GL_FALSE;
+	void *data;
+
+	if (fread(&header, 1, sizeof(header), f) != sizeof(header))
+		return false;
+	if (!header_valid(&header, program))
+		return false;
+
+	data = bmalloc(header.size);
+	if (fread(data, 1, header.size, f) != header.size) {
+		bfree(data);
+		return false;
+	}
+
+	glProgramBinary(program->obj, header.format, data, header.size);
+	bfree(data);
+
+	/* the driver is allowed to reject any binary, even one it produced
+	 * itself, so this is not treated as an error */
+	while (glGetError() != GL_NO_ERROR);
+
+	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+	return gl_success("glGetProgramiv") && linked == GL_TRUE;
+}
+
+bool gl_program_cache_load(struct gs_program *program)
+{
+	struct gs_device *device = program->device;
+	struct dstr file = {0};
+	uint64_t start;
+	bool success = false;
+	FILE *f;
+
+	if (!program_cache_enabled(device))
+		return false;
+
+	start = os_gettime_ns();
+
+	get_program_file(&file, program, ".bin");
+	f = os_fopen(file.array, "rb");
+	if (f) {
+		success = load_program_binary(program, f);
+		fclose(f);
+
+		if (!success)
+			os_unlink(file.array);
+	}
+
+	dstr_free(&file);
+
+	if (success) {
+		device->program_cache.loaded++;
+		device->program_cache.load_time_ns += os_gettime_ns() - start;
+	}
+
+	return success;
+}
+
+static bool write_program_binary(struct gs_program *program, FILE *f)
+{
+	struct program_cache_header header = {0};
+	GLint size = 0;
+	GLenum format = 0;
+	GLsizei written = 0;
+	bool success = false;
+	void *data;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (!gl_success("glGetProgramiv") || size <= 0 ||
+	    size > PROGRAM_CACHE_MAX)
+		return false;
+
+	data = bmalloc(size);
+	glGetProgramBinary(program->obj, size, &written, &format, data);
+	if (!gl_success("glGetProgramBinary") || written <= 0)
+		goto fail;
+
+	header.magic       = PROGRAM_CACHE_MAGIC;
+	header.version     = PROGRAM_CACHE_VERSION;
+	header.driver_hash = program->device->program_cache.driver_hash;
+	header.vertex_hash = program->vertex_shader->hash;
+	header.pixel_hash  = program->pixel_shader->hash;
+	header.format      = format;
+	header.size        = (uint32_t)written;
+
+	success = fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+	          fwrite(data, 1, written, f) == (size_t)written;
+
+fail:
+	bfree(data);
+	return success;
+}
+
+void gl_program_cache_store(struct gs_program *program)
+{
+	struct dstr file = {0};
+	struct dstr temp = {0};
+	bool success = false;
+	FILE *f;
+
+	if (!program_cache_enabled(program->device))
+		return;
+
+	/* write to a temporary file first so that a crash or another
+	 * instance can never observe a partially written binary */
+	get_program_file(&file, program, ".bin");
+	get_program_file(&temp, program, ".tmp");
+
+	f = os_fopen(temp.array, "wb");
+	if (f) {
+		success = write_program_binary(program, f);
+		success = (fclose(f) == 0) && success;
+	}
+
+	if (success) {
+		os_unlink(file.array);
+		success = os_rename(temp.array, file.array) == 0;
+	}
+	if (!success) {
+		blog(LOG_DEBUG, "OpenGL program cache: failed to write '%s'",
+				file.array);
+		os_unlink(temp.array);
+	}
+
+	dstr_free(&temp);
+	dstr_free(&file);
+}
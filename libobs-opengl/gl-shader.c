@@ -17,6 +17,7 @@
 
 #include <assert.h>
 
+#include <util/platform.h>
 #include <graphics/vec2.h>
 #include <graphics/vec3.h>
 #include <graphics/vec4.h>
@@ -75,11 +76,11 @@ static bool gl_add_param(struct gs_shader *shader, struct shader_var *var,
 	param.shader      = shader;
 	param.type        = get_shader_param_type(var->type);
 
+	param.serial      = 1;
+
 	if (param.type == GS_SHADER_PARAM_TEXTURE) {
 		param.sampler_id  = var->gl_sampler_id;
 		param.texture_id  = (*texture_id)++;
-	} else {
-		param.changed = true;
 	}
 
 	da_move(param.def_value, var->default_val);
@@ -199,6 +200,8 @@ static bool gl_shader_init(struct gs_shader *shader,
 	if (!gl_success("glCreateShader") || !shader->obj)
 		return false;
 
+	shader->hash = gl_hash_string(0, glsp->gl_string.array);
+
 	glShaderSource(shader->obj, 1, (const GLchar**)&glsp->gl_string.array,
 			0);
 	if (!gl_success("glShaderSource"))
@@ -379,20 +382,34 @@ void gs_shader_get_param_info(const gs_sparam_t *param,
 	info->name = param->name;
 }
 
+/* uniform values live in each program object, so instead of a single dirty
+ * flag every change bumps the serial of the parameter, and each program
+ * uploads the value again only once its own copy of the serial is stale */
+static void set_param_value(struct gs_shader_param *param, const void *val,
+		size_t size)
+{
+	if (param->cur_value.num == size &&
+	    memcmp(param->cur_value.array, val, size) == 0)
+		return;
+
+	da_copy_array(param->cur_value, val, size);
+	param->serial++;
+}
+
 void gs_shader_set_bool(gs_sparam_t *param, bool val)
 {
 	int int_val = val;
-	da_copy_array(param->cur_value, &int_val, sizeof(int_val));
+	set_param_value(param, &int_val, sizeof(int_val));
 }
 
 void gs_shader_set_float(gs_sparam_t *param, float val)
 {
-	da_copy_array(param->cur_value, &val, sizeof(val));
+	set_param_value(param, &val, sizeof(val));
 }
 
 void gs_shader_set_int(gs_sparam_t *param, int val)
 {
-	da_copy_array(param->cur_value, &val, sizeof(val));
+	set_param_value(param, &val, sizeof(val));
 }
 
 void gs_shader_set_matrix3(gs_sparam_t *param, const struct matrix3 *val)
@@ -400,27 +417,27 @@ void gs_shader_set_matrix3(gs_sparam_t *param, const struct matrix3 *val)
 	struct matrix4 mat;
 	matrix4_from_matrix3(&mat, val);
 
-	da_copy_array(param->cur_value, &mat, sizeof(mat));
+	set_param_value(param, &mat, sizeof(mat));
 }
 
 void gs_shader_set_matrix4(gs_sparam_t *param, const struct matrix4 *val)
 {
-	da_copy_array(param->cur_value, val, sizeof(*val));
+	set_param_value(param, val, sizeof(*val));
 }
 
 void gs_shader_set_vec2(gs_sparam_t *param, const struct vec2 *val)
 {
-	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+	set_param_value(param, val->ptr, sizeof(*val));
 }
 
 void gs_shader_set_vec3(gs_sparam_t *param, const struct vec3 *val)
 {
-	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+	set_param_value(param, val->ptr, sizeof(*val));
 }
 
 void gs_shader_set_vec4(gs_sparam_t *param, const struct vec4 *val)
 {
-	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+	set_param_value(param, val->ptr, sizeof(*val));
 }
 
 void gs_shader_set_texture(gs_sparam_t *param, gs_texture_t *val)
@@ -443,8 +460,7 @@ static inline bool validate_param(struct program_param *pp,
 	return true;
 }
 
-static void program_set_param_data(struct gs_program *program,
-		struct program_param *pp)
+static void program_set_param_data(struct program_param *pp)
 {
 	void *array = pp->param->cur_value.array;
 
@@ -503,25 +519,41 @@ static void program_set_param_data(struct gs_program *program,
 					(float*)array);
 			gl_success("glUniformMatrix4fv");
 		}
+	}
+}
 
-	} else if (pp->param->type == GS_SHADER_PARAM_TEXTURE) {
-		if (pp->param->next_sampler) {
-			program->device->cur_samplers[pp->param->sampler_id] =
-				pp->param->next_sampler;
-			pp->param->next_sampler = NULL;
-		}
+static void program_set_texture(struct gs_program *program,
+		struct program_param *pp)
+{
+	if (pp->param->next_sampler) {
+		program->device->cur_samplers[pp->param->sampler_id] =
+			pp->param->next_sampler;
+		pp->param->next_sampler = NULL;
+	}
 
+	/* the texture unit of a sampler never changes within a program */
+	if (pp->serial != pp->param->serial) {
 		glUniform1i(pp->obj, pp->param->texture_id);
-		device_load_texture(program->device, pp->param->texture,
-				pp->param->texture_id);
+		gl_success("glUniform1i");
+		pp->serial = pp->param->serial;
 	}
+
+	device_load_texture(program->device, pp->param->texture,
+			pp->param->texture_id);
 }
 
 void program_update_params(struct gs_program *program)
 {
 	for (size_t i = 0; i < program->params.num; i++) {
 		struct program_param *pp = program->params.array + i;
-		program_set_param_data(program, pp);
+
+		if (pp->param->type == GS_SHADER_PARAM_TEXTURE) {
+			program_set_texture(program, pp);
+
+		} else if (pp->serial != pp->param->serial) {
+			program_set_param_data(pp);
+			pp->serial = pp->param->serial;
+		}
 	}
 }
 
@@ -587,7 +619,8 @@ static bool assign_program_param(struct gs_program *program,
 		return true;
 	}
 
-	info.param = param;
+	info.param  = param;
+	info.serial = 0;
 	da_push_back(program->params, &info);
 	return true;
 }
@@ -614,38 +647,69 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+static bool link_program(struct gs_program *program)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
 	int linked = false;
 
-	program->device        = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader  = device->cur_pixel_shader;
-
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
-
 	glAttachShader(program->obj, program->vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
 	glAttachShader(program->obj, program->pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
-		goto error_detach_vertex;
+		goto detach_vertex;
+
+	if (program->device->program_cache.supported) {
+		glProgramParameteri(program->obj,
+				GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		gl_success("glProgramParameteri");
+	}
 
 	glLinkProgram(program->obj);
 	if (!gl_success("glLinkProgram"))
-		goto error;
+		goto detach;
 
 	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
 	if (!gl_success("glGetProgramiv"))
-		goto error;
+		goto detach;
 
-	if (linked == GL_FALSE) {
+	if (linked == GL_FALSE)
 		print_link_errors(program->obj);
+
+detach:
+	glDetachShader(program->obj, program->pixel_shader->obj);
+	gl_success("glDetachShader (pixel)");
+
+detach_vertex:
+	glDetachShader(program->obj, program->vertex_shader->obj);
+	gl_success("glDetachShader (vertex)");
+
+	return linked == GL_TRUE;
+}
+
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+	bool from_cache;
+	uint64_t start;
+
+	program->device        = device;
+	program->id            = ++device->next_program_id;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader  = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
 		goto error;
+
+	from_cache = gl_program_cache_load(program);
+	if (!from_cache) {
+		start = os_gettime_ns();
+		if (!link_program(program))
+			goto error;
+
+		device->program_cache.linked++;
+		device->program_cache.link_time_ns += os_gettime_ns() - start;
 	}
 
 	if (!assign_program_attribs(program))
@@ -653,11 +717,8 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	if (!assign_program_params(program))
 		goto error;
 
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
+	if (!from_cache)
+		gl_program_cache_store(program);
 
 	program->next = device->first_program;
 	program->prev_next = &device->first_program;
@@ -668,14 +729,6 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	return program;
 
 error:
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
-error_detach_vertex:
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-error_detach_neither:
 	gs_program_destroy(program);
 	return NULL;
 }
@@ -740,7 +793,7 @@ void gs_shader_set_val(gs_sparam_t *param, const void *val, size_t size)
 	if (param->type == GS_SHADER_PARAM_TEXTURE)
 		gs_shader_set_texture(param, *(gs_texture_t**)val);
 	else
-		da_copy_array(param->cur_value, val, size);
+		set_param_value(param, val, size);
 }
 
 void gs_shader_set_default(gs_sparam_t *param)
@@ -15,8 +15,15 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <util/platform.h>
 #include "gl-subsystem.h"
 
+/* upper bounds of the map wait histogram buckets in microseconds, the last
+ * bucket holds everything above */
+static const uint32_t map_wait_bounds[GL_MAP_WAIT_BUCKETS - 1] = {
+	0, 250, 500, 1000, 2000, 4000, 8000
+};
+
 static bool create_pixel_pack_buffer(struct gs_stage_surface *surf)
 {
 	GLsizeiptr size;
@@ -65,9 +72,34 @@ gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
 	return surf;
 }
 
+static void delete_fence(struct gs_stage_surface *surf)
+{
+	if (surf->fence) {
+		glDeleteSync(surf->fence);
+		gl_success("glDeleteSync");
+		surf->fence = NULL;
+	}
+}
+
+/* the copy into the pack buffer is only queued, so a fence is inserted right
+ * after it to be able to tell when it has actually completed */
+static void insert_fence(struct gs_stage_surface *surf)
+{
+	delete_fence(surf);
+
+	if (!surf->device->sync_supported)
+		return;
+
+	surf->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!gl_success("glFenceSync"))
+		surf->fence = NULL;
+}
+
 void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
 {
 	if (stagesurf) {
+		delete_fence(stagesurf);
+
 		if (stagesurf->pack_buffer)
 			gl_delete_buffers(1, &stagesurf->pack_buffer);
 
@@ -141,6 +173,7 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glReadPixels"))
 		goto failed_unbind_all;
 
+	insert_fence(dst);
 	success = true;
 
 failed_unbind_all:
@@ -174,6 +207,8 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glGetTexImage"))
 		goto failed;
 
+	insert_fence(dst);
+
 	gl_bind_texture(GL_TEXTURE_2D, 0);
 	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 	return;
@@ -204,9 +239,99 @@ enum gs_color_format gs_stagesurface_get_color_format(
 	return stagesurf->format;
 }
 
+bool gs_stagesurface_is_ready(gs_stagesurf_t *stagesurf)
+{
+	GLenum status;
+
+	if (!stagesurf->fence)
+		return true;
+
+	/* the flush bit makes sure the fence is actually submitted, otherwise
+	 * it could never signal */
+	status = glClientWaitSync(stagesurf->fence,
+			GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (!gl_success("glClientWaitSync"))
+		return true;
+
+	return status == GL_ALREADY_SIGNALED ||
+	       status == GL_CONDITION_SATISFIED;
+}
+
+static void record_map_wait(struct gs_device *device, uint64_t wait_ns)
+{
+	uint64_t wait_us = wait_ns / 1000;
+	size_t i;
+
+	for (i = 0; i < GL_MAP_WAIT_BUCKETS - 1; i++) {
+		if (wait_us <= map_wait_bounds[i])
+			break;
+	}
+
+	device->map_waits[i]++;
+}
+
+/* waits for the copy to complete before the buffer is mapped, so that the
+ * time spent blocking on the GPU can be measured on its own */
+static void wait_for_fence(struct gs_stage_surface *surf)
+{
+	uint64_t start;
+	uint64_t wait_ns = 0;
+	GLenum status;
+
+	if (!surf->fence)
+		return;
+
+	status = glClientWaitSync(surf->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		start = os_gettime_ns();
+		do {
+			status = glClientWaitSync(surf->fence,
+					GL_SYNC_FLUSH_COMMANDS_BIT,
+					1000000000ULL);
+		} while (status == GL_TIMEOUT_EXPIRED);
+		wait_ns = os_gettime_ns() - start;
+	}
+
+	gl_success("glClientWaitSync");
+	record_map_wait(surf->device, wait_ns);
+	delete_fence(surf);
+}
+
+void gl_log_map_waits(struct gs_device *device)
+{
+	struct dstr str = {0};
+	uint32_t total = 0;
+
+	for (size_t i = 0; i < GL_MAP_WAIT_BUCKETS; i++)
+		total += device->map_waits[i];
+	if (!total)
+		return;
+
+	for (size_t i = 0; i < GL_MAP_WAIT_BUCKETS; i++) {
+		if (i == 0)
+			dstr_catf(&str, "\n\tready:     ");
+		else if (i < GL_MAP_WAIT_BUCKETS - 1)
+			dstr_catf(&str, "\n\t<= %5u us: ",
+					map_wait_bounds[i]);
+		else
+			dstr_catf(&str, "\n\t>  %5u us: ",
+					map_wait_bounds[i - 1]);
+
+		dstr_catf(&str, "%u (%.1f%%)", device->map_waits[i],
+				(double)device->map_waits[i] * 100.0 /
+				(double)total);
+	}
+
+	blog(LOG_INFO, "Stage surface map waits (%u maps):%s", total,
+			str.array);
+	dstr_free(&str);
+}
+
 bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 		uint32_t *linesize)
 {
+	wait_for_fence(stagesurf);
+
 	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, stagesurf->pack_buffer))
 		goto fail;
 
@@ -135,6 +135,10 @@ static bool gl_init_extensions(struct gs_device* device)
 		gl_enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 	}
 
+	device->sync_supported = GLAD_GL_VERSION_3_2 || GLAD_GL_ARB_sync;
+	device->buffer_storage_supported = device->sync_supported &&
+		(GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage);
+
 	if (GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_copy_image)
 		device->copy_type = COPY_TYPE_ARB;
 	else if (GLAD_GL_NV_copy_image)
@@ -145,12 +149,53 @@ static bool gl_init_extensions(struct gs_device* device)
 	return true;
 }
 
+static void gl_init_state(struct gs_device *device)
+{
+	struct gl_state *state = &device->state;
+
+	state->active_texture = GL_TEXTURE0;
+	state->vao            = 0;
+	state->front_face     = GL_CCW;
+	state->blend          = false;
+	state->blend_src_c    = GL_ONE;
+	state->blend_dst_c    = GL_ZERO;
+	state->blend_src_a    = GL_ONE;
+	state->blend_dst_a    = GL_ZERO;
+
+	/* the initial viewport depends on the window, so make sure the first
+	 * viewport that is set never matches */
+	state->viewport[2]    = -1;
+	state->viewport[3]    = -1;
+}
+
+static bool gl_set_active_texture(struct gs_device *device, GLenum unit)
+{
+	if (device->state.active_texture == unit)
+		return true;
+	if (!gl_active_texture(unit))
+		return false;
+
+	device->state.active_texture = unit;
+	return true;
+}
+
+bool gl_set_vertex_array(struct gs_device *device, GLuint vao)
+{
+	if (device->state.vao == vao)
+		return true;
+	if (!gl_bind_vertex_array(vao))
+		return false;
+
+	device->state.vao = vao;
+	return true;
+}
+
 static void clear_textures(struct gs_device *device)
 {
 	GLenum i;
 	for (i = 0; i < GS_MAX_TEXTURES; i++) {
 		if (device->cur_textures[i]) {
-			gl_active_texture(GL_TEXTURE0 + i);
+			gl_set_active_texture(device, GL_TEXTURE0 + i);
 			gl_bind_texture(device->cur_textures[i]->gl_target, 0);
 			device->cur_textures[i] = NULL;
 		}
@@ -232,6 +277,9 @@ int device_create(gs_device_t **p_device, uint32_t adapter)
 	blog(LOG_INFO, "OpenGL loaded successfully, version %s, shading "
 			"language %s", glVersion, glShadingLanguage);
 
+	gl_program_cache_init(device);
+	gl_init_state(device);
+
 	gl_enable(GL_CULL_FACE);
 	
 	device_leave_context(device);
@@ -262,6 +310,8 @@ void device_destroy(gs_device_t *device)
 		while (device->first_program)
 			gs_program_destroy(device->first_program);
 
+		gl_program_cache_free(device);
+		gl_log_map_waits(device);
 		da_free(device->proj_stack);
 		gl_platform_destroy(device->plat);
 		bfree(device);
@@ -470,7 +520,7 @@ void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
 	if (cur_tex == tex)
 		return;
 
-	if (!gl_active_texture(GL_TEXTURE0 + unit))
+	if (!gl_set_active_texture(device, GL_TEXTURE0 + unit))
 		goto fail;
 
 	/* the target for the previous text may not be the same as the
@@ -517,7 +567,8 @@ static bool load_sampler_on_textures(gs_device_t *device, gs_samplerstate_t *ss,
 		if (param->type == GS_SHADER_PARAM_TEXTURE &&
 		    param->sampler_id == (uint32_t)sampler_unit &&
 		    param->texture) {
-			if (!gl_active_texture(GL_TEXTURE0 + param->texture_id))
+			if (!gl_set_active_texture(device,
+						GL_TEXTURE0 + param->texture_id))
 				return false;
 			if (!load_texture_sampler(param->texture, ss))
 				return false;
@@ -920,6 +971,7 @@ static void update_viewproj_matrix(struct gs_device *device)
 {
 	struct gs_shader *vs = device->cur_vertex_shader;
 	struct matrix4 cur_proj;
+	GLenum front_face;
 
 	gs_matrix_get(&device->cur_view);
 	matrix4_copy(&cur_proj, &device->cur_proj);
@@ -930,12 +982,16 @@ static void update_viewproj_matrix(struct gs_device *device)
 		cur_proj.z.y = -cur_proj.z.y;
 		cur_proj.t.y = -cur_proj.t.y;
 
-		glFrontFace(GL_CW);
+		front_face = GL_CW;
 	} else {
-		glFrontFace(GL_CCW);
+		front_face = GL_CCW;
 	}
 
-	gl_success("glFrontFace");
+	if (device->state.front_face != front_face) {
+		glFrontFace(front_face);
+		if (gl_success("glFrontFace"))
+			device->state.front_face = front_face;
+	}
 
 	matrix4_mul(&device->cur_viewproj, &device->cur_view, &cur_proj);
 	matrix4_transpose(&device->cur_viewproj, &device->cur_viewproj);
@@ -989,11 +1045,6 @@ void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
 
 	load_vb_buffers(program, device->cur_vertex_buffer, ib);
 
-	if (program != device->cur_program && device->cur_program) {
-		glUseProgram(0);
-		gl_success("glUseProgram (zero)");
-	}
-
 	if (program != device->cur_program) {
 		device->cur_program = program;
 
@@ -1098,12 +1149,18 @@ enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
 
 void device_enable_blending(gs_device_t *device, bool enable)
 {
+	bool success;
+
+	if (device->state.blend == enable)
+		return;
+
 	if (enable)
-		gl_enable(GL_BLEND);
+		success = gl_enable(GL_BLEND);
 	else
-		gl_disable(GL_BLEND);
+		success = gl_disable(GL_BLEND);
 
-	UNUSED_PARAMETER(device);
+	if (success)
+		device->state.blend = enable;
 }
 
 void device_enable_depth_test(gs_device_t *device, bool enable)
@@ -1144,17 +1201,38 @@ void device_enable_color(gs_device_t *device, bool red, bool green,
 	UNUSED_PARAMETER(device);
 }
 
+static inline bool blend_function_set(const struct gl_state *state,
+		GLenum src_c, GLenum dst_c, GLenum src_a, GLenum dst_a)
+{
+	return state->blend_src_c == src_c && state->blend_dst_c == dst_c &&
+	       state->blend_src_a == src_a && state->blend_dst_a == dst_a;
+}
+
+static inline void store_blend_function(struct gl_state *state,
+		GLenum src_c, GLenum dst_c, GLenum src_a, GLenum dst_a)
+{
+	state->blend_src_c = src_c;
+	state->blend_dst_c = dst_c;
+	state->blend_src_a = src_a;
+	state->blend_dst_a = dst_a;
+}
+
 void device_blend_function(gs_device_t *device, enum gs_blend_type src,
 		enum gs_blend_type dest)
 {
 	GLenum gl_src = convert_gs_blend_type(src);
 	GLenum gl_dst = convert_gs_blend_type(dest);
 
+	if (blend_function_set(&device->state, gl_src, gl_dst, gl_src, gl_dst))
+		return;
+
 	glBlendFunc(gl_src, gl_dst);
-	if (!gl_success("glBlendFunc"))
+	if (!gl_success("glBlendFunc")) {
 		blog(LOG_ERROR, "device_blend_function (GL) failed");
+		return;
+	}
 
-	UNUSED_PARAMETER(device);
+	store_blend_function(&device->state, gl_src, gl_dst, gl_src, gl_dst);
 }
 
 void device_blend_function_separate(gs_device_t *device,
@@ -1166,11 +1244,18 @@ void device_blend_function_separate(gs_device_t *device,
 	GLenum gl_src_a = convert_gs_blend_type(src_a);
 	GLenum gl_dst_a = convert_gs_blend_type(dest_a);
 
+	if (blend_function_set(&device->state, gl_src_c, gl_dst_c,
+				gl_src_a, gl_dst_a))
+		return;
+
 	glBlendFuncSeparate(gl_src_c, gl_dst_c, gl_src_a, gl_dst_a);
-	if (!gl_success("glBlendFuncSeparate"))
+	if (!gl_success("glBlendFuncSeparate")) {
 		blog(LOG_ERROR, "device_blend_function_separate (GL) failed");
+		return;
+	}
 
-	UNUSED_PARAMETER(device);
+	store_blend_function(&device->state, gl_src_c, gl_dst_c,
+			gl_src_a, gl_dst_a);
 }
 
 void device_depth_function(gs_device_t *device, enum gs_depth_test test)
@@ -1227,6 +1312,7 @@ static inline uint32_t get_target_height(const struct gs_device *device)
 void device_set_viewport(gs_device_t *device, int x, int y, int width,
 		int height)
 {
+	GLint *viewport = device->state.viewport;
 	uint32_t base_height = 0;
 	int gl_y = 0;
 
@@ -1241,9 +1327,18 @@ void device_set_viewport(gs_device_t *device, int x, int y, int width,
 	if (base_height)
 		gl_y = base_height - y - height;
 
-	glViewport(x, gl_y, width, height);
-	if (!gl_success("glViewport"))
-		blog(LOG_ERROR, "device_set_viewport (GL) failed");
+	if (viewport[0] != x     || viewport[1] != gl_y ||
+	    viewport[2] != width || viewport[3] != height) {
+		glViewport(x, gl_y, width, height);
+		if (gl_success("glViewport")) {
+			viewport[0] = x;
+			viewport[1] = gl_y;
+			viewport[2] = width;
+			viewport[3] = height;
+		} else {
+			blog(LOG_ERROR, "device_set_viewport (GL) failed");
+		}
+	}
 
 	device->cur_viewport.x  = x;
 	device->cur_viewport.y  = y;
@@ -1341,6 +1436,12 @@ void device_projection_pop(gs_device_t *device)
 	da_pop_back(device->proj_stack);
 }
 
+uint64_t device_get_api_calls(const gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return gl_call_count;
+}
+
 void gs_swapchain_destroy(gs_swapchain_t *swapchain)
 {
 	if (!swapchain)
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <util/darray.h>
+#include <util/dstr.h>
 #include <util/threading.h>
 #include <graphics/graphics.h>
 #include <graphics/device-exports.h>
@@ -309,7 +310,7 @@ struct gs_shader_param {
 
 	DARRAY(uint8_t)      cur_value;
 	DARRAY(uint8_t)      def_value;
-	bool                 changed;
+	uint64_t             serial;
 };
 
 enum attrib_type {
@@ -331,6 +332,7 @@ struct gs_shader {
 	gs_device_t          *device;
 	enum gs_shader_type  type;
 	GLuint               obj;
+	uint64_t             hash;
 
 	struct gs_shader_param  *viewproj;
 	struct gs_shader_param  *world;
@@ -343,11 +345,13 @@ struct gs_shader {
 struct program_param {
 	GLint                  obj;
 	struct gs_shader_param *param;
+	uint64_t               serial;
 };
 
 struct gs_program {
 	gs_device_t                  *device;
 	GLuint                       obj;
+	uint64_t                     id;
 	struct gs_shader             *vertex_shader;
 	struct gs_shader             *pixel_shader;
 
@@ -362,6 +366,40 @@ extern struct gs_program *gs_program_create(struct gs_device *device);
 extern void gs_program_destroy(struct gs_program *program);
 extern void program_update_params(struct gs_program *shader);
 
+struct gl_program_cache {
+	struct dstr          path;
+	bool                 supported;
+	uint64_t             driver_hash;
+
+	long                 loaded;
+	long                 linked;
+	uint64_t             load_time_ns;
+	uint64_t             link_time_ns;
+};
+
+extern uint64_t gl_hash_string(uint64_t hash, const char *str);
+extern void gl_program_cache_init(struct gs_device *device);
+extern void gl_program_cache_free(struct gs_device *device);
+extern bool gl_program_cache_load(struct gs_program *program);
+extern void gl_program_cache_store(struct gs_program *program);
+
+/* persistently mapped storage of a dynamic vertex buffer.  every flush
+ * writes to the next slot of the ring, and a slot is only written again once
+ * the fence inserted when it was left has signaled */
+struct gl_stream_buffer {
+	GLuint               buffer;
+	uint8_t              *ptr;
+	size_t               slot_size;
+	size_t               num_slots;
+	size_t               slot;
+	DARRAY(GLsync)       fences;
+
+	size_t               normal_offset;
+	size_t               tangent_offset;
+	size_t               color_offset;
+	DARRAY(size_t)       uv_offsets;
+};
+
 struct gs_vertex_buffer {
 	GLuint               vao;
 	GLuint               vertex_buffer;
@@ -375,10 +413,14 @@ struct gs_vertex_buffer {
 	size_t               num;
 	bool                 dynamic;
 	struct gs_vb_data    *data;
+
+	struct gl_stream_buffer stream;
+	uint64_t             layout_program;
 };
 
 extern bool load_vb_buffers(struct gs_program *program,
 		struct gs_vertex_buffer *vb, struct gs_index_buffer *ib);
+extern bool gl_set_vertex_array(struct gs_device *device, GLuint vao);
 
 struct gs_index_buffer {
 	GLuint               buffer;
@@ -439,8 +481,11 @@ struct gs_stage_surface {
 	GLint                gl_internal_format;
 	GLenum               gl_type;
 	GLuint               pack_buffer;
+	GLsync               fence;
 };
 
+extern void gl_log_map_waits(struct gs_device *device);
+
 struct gs_zstencil_buffer {
 	gs_device_t          *device;
 	GLuint               buffer;
@@ -475,9 +520,27 @@ static inline void fbo_info_destroy(struct fbo_info *fbo)
 	}
 }
 
+/* shadow copy of the GL state set by the device, so that calls which would
+ * not change anything can be skipped */
+struct gl_state {
+	GLenum               active_texture;
+	GLuint               vao;
+	GLenum               front_face;
+	bool                 blend;
+	GLenum               blend_src_c;
+	GLenum               blend_dst_c;
+	GLenum               blend_src_a;
+	GLenum               blend_dst_a;
+	GLint                viewport[4];
+};
+
+#define GL_MAP_WAIT_BUCKETS 8
+
 struct gs_device {
 	struct gl_platform   *plat;
 	enum copy_type       copy_type;
+	bool                 sync_supported;
+	bool                 buffer_storage_supported;
 
 	gs_texture_t         *cur_render_target;
 	gs_zstencil_t        *cur_zstencil_buffer;
@@ -492,6 +555,12 @@ struct gs_device {
 	struct gs_program    *cur_program;
 
 	struct gs_program    *first_program;
+	uint64_t             next_program_id;
+	struct gl_program_cache program_cache;
+
+	struct gl_state      state;
+
+	uint32_t             map_waits[GL_MAP_WAIT_BUCKETS];
 
 	enum gs_cull_mode    cur_cull_mode;
 	struct gs_rect       cur_viewport;
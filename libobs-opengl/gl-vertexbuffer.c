@@ -18,11 +18,296 @@
 #include <graphics/vec3.h>
 #include "gl-subsystem.h"
 
+/* ------------------------------------------------------------------------- */
+/* streamed dynamic buffers */
+
+#define STREAM_MIN_SLOTS 4
+#define STREAM_MAX_SIZE  (16 * 1024 * 1024)
+
+static inline size_t stream_align(size_t size)
+{
+	return (size + 15) & ~(size_t)15;
+}
+
+/* every attribute gets a fixed offset within a slot, sized for the number of
+ * vertices the buffer was created with */
+static void init_stream_layout(struct gs_vertex_buffer *vb)
+{
+	struct gl_stream_buffer *stream = &vb->stream;
+	struct gs_vb_data *data = vb->data;
+	size_t vec3_size = stream_align(vb->num * sizeof(struct vec3));
+	size_t pos = vec3_size;
+
+	if (data->normals) {
+		stream->normal_offset = pos;
+		pos += vec3_size;
+	}
+
+	if (data->tangents) {
+		stream->tangent_offset = pos;
+		pos += vec3_size;
+	}
+
+	if (data->colors) {
+		stream->color_offset = pos;
+		pos += stream_align(vb->num * sizeof(uint32_t));
+	}
+
+	for (size_t i = 0; i < data->num_tex; i++) {
+		struct gs_tvertarray *tv = data->tvarray+i;
+
+		da_push_back(stream->uv_offsets, &pos);
+		da_push_back(vb->uv_sizes, &tv->width);
+		pos += stream_align(vb->num * sizeof(float) * tv->width);
+	}
+
+	stream->slot_size = pos;
+}
+
+static bool create_stream_storage(size_t size, GLuint *p_buffer,
+		uint8_t **p_ptr)
+{
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+		GL_MAP_COHERENT_BIT;
+	GLuint buffer;
+	void *ptr = NULL;
+
+	if (!gl_gen_buffers(1, &buffer))
+		return false;
+	if (!gl_bind_buffer(GL_ARRAY_BUFFER, buffer))
+		goto fail;
+
+	glBufferStorage(GL_ARRAY_BUFFER, (GLsizeiptr)size, NULL, flags);
+	if (gl_success("glBufferStorage")) {
+		ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)size,
+				flags);
+		if (!gl_success("glMapBufferRange"))
+			ptr = NULL;
+	}
+
+	gl_bind_buffer(GL_ARRAY_BUFFER, 0);
+	if (!ptr)
+		goto fail;
+
+	*p_buffer = buffer;
+	*p_ptr    = ptr;
+	return true;
+
+fail:
+	gl_delete_buffers(1, &buffer);
+	return false;
+}
+
+static void delete_stream_fences(struct gl_stream_buffer *stream)
+{
+	for (size_t i = 0; i < stream->fences.num; i++) {
+		if (stream->fences.array[i]) {
+			glDeleteSync(stream->fences.array[i]);
+			gl_success("glDeleteSync");
+		}
+	}
+
+	memset(stream->fences.array, 0, stream->fences.num * sizeof(GLsync));
+}
+
+static void free_stream(struct gl_stream_buffer *stream)
+{
+	delete_stream_fences(stream);
+
+	/* deleting the buffer also releases the mapping */
+	if (stream->buffer)
+		gl_delete_buffers(1, &stream->buffer);
+
+	da_free(stream->fences);
+	da_free(stream->uv_offsets);
+}
+
+/* the mapping is write-only, so arrays left out of an update keep their
+ * previous contents by being copied from the CPU-side data of the buffer,
+ * which is kept up to date with every array that is updated */
+static inline void copy_stream_data(uint8_t *dst, void *cpu_data,
+		const void *src, size_t size)
+{
+	if (!src)
+		src = cpu_data;
+	else if (cpu_data && cpu_data != src)
+		memcpy(cpu_data, src, size);
+
+	if (src)
+		memcpy(dst, src, size);
+}
+
+static void write_stream_slot(struct gs_vertex_buffer *vb, uint8_t *dst,
+		const struct gs_vb_data *data)
+{
+	struct gl_stream_buffer *stream = &vb->stream;
+	struct gs_vb_data *cpu_data = vb->data;
+	size_t vec3_size = data->num * sizeof(struct vec3);
+
+	copy_stream_data(dst, cpu_data->points, data->points, vec3_size);
+
+	if (cpu_data->normals)
+		copy_stream_data(dst + stream->normal_offset,
+				cpu_data->normals, data->normals, vec3_size);
+
+	if (cpu_data->tangents)
+		copy_stream_data(dst + stream->tangent_offset,
+				cpu_data->tangents, data->tangents, vec3_size);
+
+	if (cpu_data->colors)
+		copy_stream_data(dst + stream->color_offset,
+				cpu_data->colors, data->colors,
+				data->num * sizeof(uint32_t));
+
+	for (size_t i = 0; i < stream->uv_offsets.num; i++) {
+		size_t offset = stream->uv_offsets.array[i];
+		size_t size = data->num * sizeof(float) *
+			vb->uv_sizes.array[i];
+		const void *src = i < data->num_tex ?
+			data->tvarray[i].array : NULL;
+
+		copy_stream_data(dst + offset, cpu_data->tvarray[i].array,
+				src, size);
+	}
+}
+
+static bool create_stream(struct gs_vertex_buffer *vb)
+{
+	struct gl_stream_buffer *stream = &vb->stream;
+
+	init_stream_layout(vb);
+
+	if (!create_stream_storage(stream->slot_size * STREAM_MIN_SLOTS,
+				&stream->buffer, &stream->ptr))
+		return false;
+
+	stream->num_slots = STREAM_MIN_SLOTS;
+	da_resize(stream->fences, STREAM_MIN_SLOTS);
+	memset(stream->fences.array, 0, STREAM_MIN_SLOTS * sizeof(GLsync));
+
+	write_stream_slot(vb, stream->ptr, vb->data);
+	return true;
+}
+
+static inline bool fence_signaled(GLsync fence)
+{
+	GLenum status;
+
+	if (!fence)
+		return true;
+
+	status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	gl_success("glClientWaitSync");
+
+	return status == GL_ALREADY_SIGNALED ||
+	       status == GL_CONDITION_SATISFIED;
+}
+
+static void wait_for_fence(GLsync fence)
+{
+	GLenum status;
+
+	do {
+		status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+				1000000000ULL);
+	} while (status == GL_TIMEOUT_EXPIRED);
+
+	gl_success("glClientWaitSync");
+}
+
+/* when the GPU still reads the next slot, the ring is doubled instead of
+ * waiting for it.  the old buffer stays alive for as long as draws that are
+ * still in flight need it */
+static bool grow_stream(struct gs_vertex_buffer *vb,
+		const struct gs_vb_data *data)
+{
+	struct gl_stream_buffer *stream = &vb->stream;
+	size_t num_slots = stream->num_slots * 2;
+	GLuint buffer;
+	uint8_t *ptr;
+
+	if (stream->slot_size * num_slots > STREAM_MAX_SIZE)
+		return false;
+	if (!create_stream_storage(stream->slot_size * num_slots,
+				&buffer, &ptr))
+		return false;
+
+	write_stream_slot(vb, ptr, data);
+
+	delete_stream_fences(stream);
+	gl_delete_buffers(1, &stream->buffer);
+
+	stream->buffer    = buffer;
+	stream->ptr       = ptr;
+	stream->num_slots = num_slots;
+	stream->slot      = 0;
+
+	da_resize(stream->fences, num_slots);
+	memset(stream->fences.array, 0, num_slots * sizeof(GLsync));
+	return true;
+}
+
+static bool flush_stream(struct gs_vertex_buffer *vb,
+		const struct gs_vb_data *data)
+{
+	struct gl_stream_buffer *stream = &vb->stream;
+	size_t next = (stream->slot + 1) % stream->num_slots;
+	GLsync *fence;
+
+	if (data->num > vb->num) {
+		blog(LOG_ERROR, "Vertex buffer update has more vertices than "
+		                "the buffer was created with");
+		return false;
+	}
+
+	/* every draw that reads the current slot has been issued by now */
+	fence = stream->fences.array + stream->slot;
+	if (*fence) {
+		glDeleteSync(*fence);
+		gl_success("glDeleteSync");
+	}
+
+	*fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!gl_success("glFenceSync"))
+		*fence = NULL;
+
+	fence = stream->fences.array + next;
+	if (!fence_signaled(*fence)) {
+		if (grow_stream(vb, data))
+			goto finish;
+
+		wait_for_fence(*fence);
+	}
+
+	if (*fence) {
+		glDeleteSync(*fence);
+		gl_success("glDeleteSync");
+		*fence = NULL;
+	}
+
+	stream->slot = next;
+	write_stream_slot(vb, stream->ptr + next * stream->slot_size, data);
+
+finish:
+	/* the attribute pointers have to point at the new slot */
+	vb->layout_program = 0;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static bool create_buffers(struct gs_vertex_buffer *vb)
 {
 	GLenum usage = vb->dynamic ? GL_STREAM_DRAW : GL_STATIC_DRAW;
 	size_t i;
 
+	if (vb->dynamic && vb->device->buffer_storage_supported) {
+		if (!create_stream(vb))
+			return false;
+
+		return gl_gen_vertex_arrays(1, &vb->vao);
+	}
+
 	if (!gl_create_buffer(GL_ARRAY_BUFFER, &vb->vertex_buffer,
 				vb->data->num * sizeof(struct vec3),
 				vb->data->points, usage))
@@ -109,8 +394,13 @@ void gs_vertexbuffer_destroy(gs_vertbuffer_t *vb)
 			gl_delete_buffers((GLsizei)vb->uv_buffers.num,
 					vb->uv_buffers.array);
 
-		if (vb->vao)
+		free_stream(&vb->stream);
+
+		if (vb->vao) {
+			if (vb->device->state.vao == vb->vao)
+				vb->device->state.vao = 0;
 			gl_delete_vertex_arrays(1, &vb->vao);
+		}
 
 		da_free(vb->uv_sizes);
 		da_free(vb->uv_buffers);
@@ -133,6 +423,12 @@ static inline void gs_vertexbuffer_flush_internal(gs_vertbuffer_t *vb,
 		goto failed;
 	}
 
+	if (vb->stream.buffer) {
+		if (!flush_stream(vb, data))
+			goto failed;
+		return;
+	}
+
 	if (data->points) {
 		if (!update_buffer(GL_ARRAY_BUFFER, vb->vertex_buffer,
 					data->points,
@@ -192,12 +488,50 @@ struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
 	return vb->data;
 }
 
+static inline GLuint get_stream_buffer(struct gs_vertex_buffer *vb,
+		enum attrib_type type, size_t index, GLint *width,
+		GLenum *gl_type, size_t *offset)
+{
+	struct gl_stream_buffer *stream = &vb->stream;
+	struct gs_vb_data *data = vb->data;
+
+	*gl_type = GL_FLOAT;
+	*width   = 4;
+	*offset  = stream->slot * stream->slot_size;
+
+	if (type == ATTRIB_POSITION) {
+		return stream->buffer;
+	} else if (type == ATTRIB_NORMAL && data->normals) {
+		*offset += stream->normal_offset;
+		return stream->buffer;
+	} else if (type == ATTRIB_TANGENT && data->tangents) {
+		*offset += stream->tangent_offset;
+		return stream->buffer;
+	} else if (type == ATTRIB_COLOR && data->colors) {
+		*gl_type = GL_UNSIGNED_BYTE;
+		*offset += stream->color_offset;
+		return stream->buffer;
+	} else if (type == ATTRIB_TEXCOORD &&
+	           index < stream->uv_offsets.num) {
+		*width   = (GLint)vb->uv_sizes.array[index];
+		*offset += stream->uv_offsets.array[index];
+		return stream->buffer;
+	}
+
+	return 0;
+}
+
 static inline GLuint get_vb_buffer(struct gs_vertex_buffer *vb,
 		enum attrib_type type, size_t index, GLint *width,
-		GLenum *gl_type)
+		GLenum *gl_type, size_t *offset)
 {
+	if (vb->stream.buffer)
+		return get_stream_buffer(vb, type, index, width, gl_type,
+				offset);
+
 	*gl_type = GL_FLOAT;
 	*width   = 4;
+	*offset  = 0;
 
 	if (type == ATTRIB_POSITION) {
 		return vb->vertex_buffer;
@@ -225,9 +559,11 @@ static bool load_vb_buffer(struct shader_attrib *attrib,
 	GLenum type;
 	GLint width;
 	GLuint buffer;
+	size_t offset;
 	bool success = true;
 
-	buffer = get_vb_buffer(vb, attrib->type, attrib->index, &width, &type);
+	buffer = get_vb_buffer(vb, attrib->type, attrib->index, &width, &type,
+			&offset);
 	if (!buffer) {
 		blog(LOG_ERROR, "Vertex buffer does not have the required "
 		                "inputs for vertex shader");
@@ -237,7 +573,8 @@ static bool load_vb_buffer(struct shader_attrib *attrib,
 	if (!gl_bind_buffer(GL_ARRAY_BUFFER, buffer))
 		return false;
 
-	glVertexAttribPointer(id, width, type, GL_TRUE, 0, 0);
+	glVertexAttribPointer(id, width, type, GL_TRUE, 0,
+			(const GLvoid*)offset);
 	if (!gl_success("glVertexAttribPointer"))
 		success = false;
 
@@ -257,13 +594,20 @@ bool load_vb_buffers(struct gs_program *program, struct gs_vertex_buffer *vb,
 	struct gs_shader *shader = program->vertex_shader;
 	size_t i;
 
-	if (!gl_bind_vertex_array(vb->vao))
+	if (!gl_set_vertex_array(vb->device, vb->vao))
 		return false;
 
-	for (i = 0; i < shader->attribs.num; i++) {
-		struct shader_attrib *attrib = shader->attribs.array+i;
-		if (!load_vb_buffer(attrib, vb, program->attribs.array[i]))
-			return false;
+	/* the attribute pointers are stored in the vertex array object, so
+	 * they only have to be set up again when the program changes */
+	if (vb->layout_program != program->id) {
+		for (i = 0; i < shader->attribs.num; i++) {
+			struct shader_attrib *attrib = shader->attribs.array+i;
+			if (!load_vb_buffer(attrib, vb,
+						program->attribs.array[i]))
+				return false;
+		}
+
+		vb->layout_program = program->id;
 	}
 
 	if (ib && !gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ib->buffer))
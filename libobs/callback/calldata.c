@@ -130,7 +130,7 @@ static inline void cd_set_first_param(calldata_t *data, const char *name,
 		capacity = 128;
 
 	data->capacity = capacity;
-	data->stack    = bmalloc(capacity);
+	data->stack    = bmalloc_tag(capacity, BMEM_TAG_CALLDATA);
 
 	pos = data->stack;
 	cd_copy_string(&pos, name, name_len);
@@ -157,7 +157,16 @@ static inline bool cd_ensure_capacity(calldata_t *data, uint8_t **pos,
 	if (new_capacity < new_size)
 		new_capacity = new_size;
 
-	data->stack    = brealloc(data->stack, new_capacity);
+	if (data->on_stack) {
+		uint8_t *stack = bmalloc_tag(new_capacity, BMEM_TAG_CALLDATA);
+		memcpy(stack, data->stack, data->size);
+		data->stack    = stack;
+		data->on_stack = false;
+	} else {
+		data->stack    = brealloc_tag(data->stack, new_capacity,
+				BMEM_TAG_CALLDATA);
+	}
+
 	data->capacity = new_capacity;
 
 	*pos = data->stack + offset;
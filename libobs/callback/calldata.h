@@ -48,6 +48,7 @@ struct calldata {
 	size_t  size;     /* size of the stack, in bytes */
 	size_t  capacity; /* capacity of the stack, in bytes */
 	bool    fixed;    /* fixed size (using call stack) */
+	bool    on_stack; /* using call stack until it is outgrown */
 };
 
 typedef struct calldata calldata_t;
@@ -69,9 +70,22 @@ static inline void calldata_init_fixed(struct calldata *data, uint8_t *stack,
 	calldata_clear(data);
 }
 
+/* like calldata_init_fixed, but moves the parameters to the heap instead of
+ * failing if they outgrow the stack buffer */
+static inline void calldata_init_stack(struct calldata *data, uint8_t *stack,
+		size_t size)
+{
+	data->stack = stack;
+	data->capacity = size;
+	data->fixed = false;
+	data->on_stack = true;
+	data->size = 0;
+	calldata_clear(data);
+}
+
 static inline void calldata_free(struct calldata *data)
 {
-	if (!data->fixed)
+	if (!data->fixed && !data->on_stack)
 		bfree(data->stack);
 }
 
@@ -90,7 +104,8 @@ static inline void calldata_clear(struct calldata *data)
 
 static inline calldata_t *calldata_create(void)
 {
-	return (calldata_t*)bzalloc(sizeof(struct calldata));
+	return (calldata_t*)bzalloc_tag(sizeof(struct calldata),
+			BMEM_TAG_CALLDATA);
 }
 
 static inline void calldata_destroy(calldata_t *cd)
@@ -16,44 +16,247 @@
 
 #include "../util/darray.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/*
+ * Callbacks are stored in immutable, reference counted lists.  Connecting or
+ * disconnecting replaces the list of a signal with a modified copy, while an
+ * emission only takes a reference to the current list under a short lock and
+ * then calls the callbacks without holding any lock, so emitting never
+ * allocates and callbacks are free to connect, disconnect or emit.
+ *
+ * A disconnected callback is flagged as removed, which the emissions still
+ * using an older list check before calling it.  Disconnecting then waits for
+ * calls that are already in progress on other threads, so once
+ * signal_handler_disconnect returns the callback is never called again.
+ */
+
 struct signal_callback {
-	signal_callback_t callback;
-	void              *data;
-	bool              remove;
-	bool              keep_ref;
+	signal_callback_t        callback;
+	global_signal_callback_t global_callback;
+	void                     *data;
+	bool                     keep_ref;
+
+	volatile bool            remove;
+	volatile long            calling;
+	volatile long            refs;
+};
+
+struct callback_list {
+	volatile long            refs;
+	size_t                   num;
+	struct signal_callback   **array;
 };
 
+/* callbacks being called by the current thread, innermost first */
+struct signal_call_frame {
+	struct signal_callback   *cb;
+	struct signal_call_frame *prev;
+};
+
+static THREAD_LOCAL struct signal_call_frame *current_frame = NULL;
+
+static inline void callback_release(struct signal_callback *cb)
+{
+	if (os_atomic_dec_long(&cb->refs) == 0)
+		bfree(cb);
+}
+
+static struct callback_list *callback_list_create(size_t num)
+{
+	struct callback_list *list;
+
+	list = bmalloc(sizeof(struct callback_list) +
+			sizeof(struct signal_callback*) * num);
+	list->refs  = 1;
+	list->num   = 0;
+	list->array = (struct signal_callback**)(list + 1);
+	return list;
+}
+
+static inline void callback_list_push(struct callback_list *list,
+		struct signal_callback *cb)
+{
+	os_atomic_inc_long(&cb->refs);
+	list->array[list->num++] = cb;
+}
+
+static void callback_list_release(struct callback_list *list)
+{
+	if (list && os_atomic_dec_long(&list->refs) == 0) {
+		for (size_t i = 0; i < list->num; i++)
+			callback_release(list->array[i]);
+		bfree(list);
+	}
+}
+
+static inline struct callback_list *callback_list_acquire(
+		pthread_mutex_t *mutex, struct callback_list *const *p_list)
+{
+	struct callback_list *list;
+
+	pthread_mutex_lock(mutex);
+	list = *p_list;
+	if (list)
+		os_atomic_inc_long(&list->refs);
+	pthread_mutex_unlock(mutex);
+
+	return list;
+}
+
+/* mutex must be held */
+static void callback_list_add(struct callback_list **p_list,
+		struct signal_callback *cb)
+{
+	struct callback_list *old_list = *p_list;
+	size_t num = old_list ? old_list->num : 0;
+	struct callback_list *list = callback_list_create(num + 1);
+
+	for (size_t i = 0; i < num; i++)
+		callback_list_push(list, old_list->array[i]);
+	callback_list_push(list, cb);
+
+	*p_list = list;
+	callback_list_release(old_list);
+}
+
+/* removes the given callback, or every callback flagged as removed if cb is
+ * NULL, and returns the number of removed callbacks that held a reference
+ * to the signal handler.  mutex must be held */
+static long callback_list_remove(struct callback_list **p_list,
+		struct signal_callback *cb)
+{
+	struct callback_list *old_list = *p_list;
+	struct callback_list *list;
+	long removed_refs = 0;
+	size_t removed = 0;
+
+	if (!old_list)
+		return 0;
+
+	list = callback_list_create(old_list->num);
+
+	for (size_t i = 0; i < old_list->num; i++) {
+		struct signal_callback *cur = old_list->array[i];
+		bool remove = cb ? (cur == cb) :
+			os_atomic_load_bool(&cur->remove);
+
+		if (!remove) {
+			callback_list_push(list, cur);
+		} else {
+			os_atomic_set_bool(&cur->remove, true);
+			if (cur->keep_ref)
+				removed_refs++;
+			removed++;
+		}
+	}
+
+	if (!removed) {
+		callback_list_release(list);
+		return 0;
+	}
+
+	if (!list->num) {
+		callback_list_release(list);
+		list = NULL;
+	}
+
+	*p_list = list;
+	callback_list_release(old_list);
+	return removed_refs;
+}
+
+/* mutex must be held */
+static struct signal_callback *callback_list_find(struct callback_list *list,
+		signal_callback_t callback, global_signal_callback_t global,
+		void *data)
+{
+	for (size_t i = 0; list && i < list->num; i++) {
+		struct signal_callback *cb = list->array[i];
+
+		if (cb->callback == callback && cb->global_callback == global &&
+		    cb->data == data && !os_atomic_load_bool(&cb->remove))
+			return cb;
+	}
+
+	return NULL;
+}
+
+static struct signal_callback *signal_callback_create(
+		signal_callback_t callback, global_signal_callback_t global,
+		void *data, bool keep_ref)
+{
+	struct signal_callback *cb = bzalloc(sizeof(struct signal_callback));
+	cb->callback        = callback;
+	cb->global_callback = global;
+	cb->data            = data;
+	cb->keep_ref        = keep_ref;
+	cb->refs            = 1;
+	return cb;
+}
+
+/* waits until no other thread is calling a removed callback.  calls made by
+ * this thread further up the stack are not waited for */
+static void wait_for_callback(struct signal_callback *cb)
+{
+	long own_calls = 0;
+
+	for (struct signal_call_frame *frame = current_frame; frame;
+	     frame = frame->prev) {
+		if (frame->cb == cb)
+			own_calls++;
+	}
+
+	while (os_atomic_load_long(&cb->calling) > own_calls)
+		os_sleep_ms(1);
+}
+
+/* the calling count is raised before the removed flag is checked, so a
+ * disconnect either prevents the call or waits for it */
+static inline bool begin_callback(struct signal_call_frame *frame,
+		struct signal_callback *cb)
+{
+	os_atomic_inc_long(&cb->calling);
+
+	if (os_atomic_load_bool(&cb->remove)) {
+		os_atomic_dec_long(&cb->calling);
+		return false;
+	}
+
+	frame->cb = cb;
+	return true;
+}
+
+static inline void end_callback(struct signal_call_frame *frame)
+{
+	os_atomic_dec_long(&frame->cb->calling);
+	frame->cb = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
 struct signal_info {
 	struct decl_info               func;
-	DARRAY(struct signal_callback) callbacks;
+	struct callback_list           *callbacks;
 	pthread_mutex_t                mutex;
-	bool                           signalling;
 
 	struct signal_info             *next;
 };
 
 static inline struct signal_info *signal_info_create(struct decl_info *info)
 {
-	pthread_mutexattr_t attr;
 	struct signal_info *si;
 
-	if (pthread_mutexattr_init(&attr) != 0)
-		return NULL;
-	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
-		return NULL;
-
 	si = bmalloc(sizeof(struct signal_info));
 
 	si->func       = *info;
 	si->next       = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
+	si->callbacks  = NULL;
 
-	if (pthread_mutex_init(&si->mutex, &attr) != 0) {
+	if (pthread_mutex_init(&si->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
@@ -69,38 +272,18 @@ static inline void signal_info_destroy(struct signal_info *si)
 	if (si) {
 		pthread_mutex_destroy(&si->mutex);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
+		callback_list_release(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si,
-		signal_callback_t callback, void *data)
-{
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array+i;
-
-		if (sc->callback == callback && sc->data == data)
-			return i;
-	}
-
-	return DARRAY_INVALID;
-}
-
-struct global_callback_info {
-	global_signal_callback_t callback;
-	void                     *data;
-	long                     signaling;
-	bool                     remove;
-};
-
 struct signal_handler {
-	struct signal_info *first;
-	pthread_mutex_t    mutex;
-	volatile long      refs;
+	struct signal_info   *first;
+	pthread_mutex_t      mutex;
+	volatile long        refs;
 
-	DARRAY(struct global_callback_info) global_callbacks;
-	pthread_mutex_t                     global_callbacks_mutex;
+	struct callback_list *global_callbacks;
+	pthread_mutex_t      global_callbacks_mutex;
 };
 
 static struct signal_info *getsignal(signal_handler_t *handler,
@@ -130,18 +313,12 @@ signal_handler_t *signal_handler_create(void)
 	handler->first = NULL;
 	handler->refs = 1;
 
-	pthread_mutexattr_t attr;
-	if (pthread_mutexattr_init(&attr) != 0)
-		return NULL;
-	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
-		return NULL;
-
 	if (pthread_mutex_init(&handler->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Couldn't create signal handler mutex!");
 		bfree(handler);
 		return NULL;
 	}
-	if (pthread_mutex_init(&handler->global_callbacks_mutex, &attr) != 0) {
+	if (pthread_mutex_init(&handler->global_callbacks_mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Couldn't create signal handler global "
 				"callbacks mutex!");
 		pthread_mutex_destroy(&handler->mutex);
@@ -161,7 +338,7 @@ static void signal_handler_actually_destroy(signal_handler_t *handler)
 		sig = next;
 	}
 
-	da_free(handler->global_callbacks);
+	callback_list_release(handler->global_callbacks);
 	pthread_mutex_destroy(&handler->global_callbacks_mutex);
 	pthread_mutex_destroy(&handler->mutex);
 	bfree(handler);
@@ -210,8 +387,7 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 		bool keep_ref)
 {
 	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false, keep_ref};
-	size_t idx;
+	struct signal_callback *cb;
 
 	if (!handler)
 		return;
@@ -233,9 +409,12 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
+	if (keep_ref ||
+	    !callback_list_find(sig->callbacks, callback, NULL, data)) {
+		cb = signal_callback_create(callback, NULL, data, keep_ref);
+		callback_list_add(&sig->callbacks, cb);
+		callback_release(cb);
+	}
 
 	pthread_mutex_unlock(&sig->mutex);
 }
@@ -271,102 +450,111 @@ void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 		signal_callback_t callback, void *data)
 {
 	struct signal_info *sig = getsignal_locked(handler, signal);
-	bool keep_ref = false;
-	size_t idx;
+	struct signal_callback *cb;
+	long removed_refs = 0;
 
 	if (!sig)
 		return;
 
 	pthread_mutex_lock(&sig->mutex);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
-		}
+	cb = callback_list_find(sig->callbacks, callback, NULL, data);
+	if (cb) {
+		os_atomic_inc_long(&cb->refs);
+		removed_refs = callback_list_remove(&sig->callbacks, cb);
 	}
 
 	pthread_mutex_unlock(&sig->mutex);
 
-	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
+	if (!cb)
+		return;
+
+	wait_for_callback(cb);
+	callback_release(cb);
+
+	if (removed_refs && os_atomic_dec_long(&handler->refs) == 0) {
 		signal_handler_actually_destroy(handler);
 	}
 }
 
-static THREAD_LOCAL struct signal_callback *current_signal_cb = NULL;
-static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
-
 void signal_handler_remove_current(void)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
-		current_global_cb->remove = true;
+	if (current_frame && current_frame->cb)
+		os_atomic_set_bool(&current_frame->cb->remove, true);
+}
+
+static inline long remove_flagged(pthread_mutex_t *mutex,
+		struct callback_list **p_list)
+{
+	long removed_refs;
+
+	pthread_mutex_lock(mutex);
+	removed_refs = callback_list_remove(p_list, NULL);
+	pthread_mutex_unlock(mutex);
+
+	return removed_refs;
 }
 
 void signal_handler_signal(signal_handler_t *handler, const char *signal,
 		calldata_t *params)
 {
 	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct signal_call_frame frame = {NULL, current_frame};
+	struct callback_list *list;
 	long remove_refs = 0;
+	bool removed = false;
 
 	if (!sig)
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
-
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array+i;
-		if (!cb->remove) {
-			current_signal_cb = cb;
-			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
-		}
-	}
+	current_frame = &frame;
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array+i-1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
+	list = callback_list_acquire(&sig->mutex, &sig->callbacks);
+	if (list) {
+		for (size_t i = 0; i < list->num; i++) {
+			struct signal_callback *cb = list->array[i];
+
+			if (begin_callback(&frame, cb)) {
+				cb->callback(cb->data, params);
+				end_callback(&frame);
+			}
 
-			da_erase(sig->callbacks, i-1);
+			if (os_atomic_load_bool(&cb->remove))
+				removed = true;
 		}
+
+		callback_list_release(list);
+
+		if (removed)
+			remove_refs = remove_flagged(&sig->mutex,
+					&sig->callbacks);
 	}
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+	list = callback_list_acquire(&handler->global_callbacks_mutex,
+			&handler->global_callbacks);
+	if (list) {
+		removed = false;
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
+		for (size_t i = 0; i < list->num; i++) {
+			struct signal_callback *cb = list->array[i];
 
-	if (handler->global_callbacks.num) {
-		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
-			struct global_callback_info *cb =
-				handler->global_callbacks.array + i;
-
-			if (!cb->remove) {
-				cb->signaling++;
-				current_global_cb = cb;
-				cb->callback(cb->data, signal, params);
-				current_global_cb = NULL;
-				cb->signaling--;
+			if (begin_callback(&frame, cb)) {
+				cb->global_callback(cb->data, signal, params);
+				end_callback(&frame);
 			}
+
+			if (os_atomic_load_bool(&cb->remove))
+				removed = true;
 		}
 
-		for (size_t i = handler->global_callbacks.num; i > 0; i--) {
-			struct global_callback_info *cb =
-				handler->global_callbacks.array + (i - 1);
+		callback_list_release(list);
 
-			if (cb->remove && !cb->signaling)
-				da_erase(handler->global_callbacks, i - 1);
-		}	
+		if (removed)
+			remove_flagged(&handler->global_callbacks_mutex,
+					&handler->global_callbacks);
 	}
 
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	current_frame = frame.prev;
 
 	if (remove_refs) {
 		os_atomic_set_long(&handler->refs,
@@ -378,17 +566,19 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 void signal_handler_connect_global(signal_handler_t *handler,
 		global_signal_callback_t callback, void *data)
 {
-	struct global_callback_info cb_data = {callback, data, 0, false};
-	size_t idx;
+	struct signal_callback *cb;
 
 	if (!handler || !callback)
 		return;
 
 	pthread_mutex_lock(&handler->global_callbacks_mutex);
 
-	idx = da_find(handler->global_callbacks, &cb_data, 0);
-	if (idx == DARRAY_INVALID)
-		da_push_back(handler->global_callbacks, &cb_data);
+	if (!callback_list_find(handler->global_callbacks, NULL, callback,
+				data)) {
+		cb = signal_callback_create(NULL, callback, data, false);
+		callback_list_add(&handler->global_callbacks, cb);
+		callback_release(cb);
+	}
 
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
@@ -396,24 +586,24 @@ void signal_handler_connect_global(signal_handler_t *handler,
 void signal_handler_disconnect_global(signal_handler_t *handler,
 		global_signal_callback_t callback, void *data)
 {
-	struct global_callback_info cb_data = {callback, data, false};
-	size_t idx;
+	struct signal_callback *cb;
 
 	if (!handler || !callback)
 		return;
 
 	pthread_mutex_lock(&handler->global_callbacks_mutex);
 
-	idx = da_find(handler->global_callbacks, &cb_data, 0);
-	if (idx != DARRAY_INVALID) {
-		struct global_callback_info *cb =
-			handler->global_callbacks.array + idx;
-
-		if (cb->signaling)
-			cb->remove = true;
-		else
-			da_erase(handler->global_callbacks, idx);
+	cb = callback_list_find(handler->global_callbacks, NULL, callback,
+			data);
+	if (cb) {
+		os_atomic_inc_long(&cb->refs);
+		callback_list_remove(&handler->global_callbacks, cb);
 	}
 
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+
+	if (cb) {
+		wait_for_callback(cb);
+		callback_release(cb);
+	}
 }
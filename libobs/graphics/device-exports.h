@@ -143,6 +143,13 @@ EXPORT void device_frustum(gs_device_t *device, float left, float right,
 EXPORT void device_projection_push(gs_device_t *device);
 EXPORT void device_projection_pop(gs_device_t *device);
 
+/* optional: not every renderer can cache compiled shaders */
+EXPORT void device_set_shader_cache_path(gs_device_t *device,
+		const char *path);
+
+/* optional: total number of calls made into the underlying graphics API */
+EXPORT uint64_t device_get_api_calls(const gs_device_t *device);
+
 #ifdef __cplusplus
 }
 #endif
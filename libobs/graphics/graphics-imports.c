@@ -172,6 +172,9 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_shader_set_next_sampler);
 
 	GRAPHICS_IMPORT_OPTIONAL(device_nv12_available);
+	GRAPHICS_IMPORT_OPTIONAL(device_set_shader_cache_path);
+	GRAPHICS_IMPORT_OPTIONAL(device_get_api_calls);
+	GRAPHICS_IMPORT_OPTIONAL(gs_stagesurface_is_ready);
 
 	/* OSX/Cocoa specific functions */
 #ifdef __APPLE__
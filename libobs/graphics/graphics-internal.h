@@ -233,6 +233,10 @@ struct gs_exports {
 			gs_samplerstate_t *sampler);
 
 	bool (*device_nv12_available)(gs_device_t *device);
+	void (*device_set_shader_cache_path)(gs_device_t *device,
+			const char *path);
+	uint64_t (*device_get_api_calls)(const gs_device_t *device);
+	bool (*gs_stagesurface_is_ready)(gs_stagesurf_t *stagesurf);
 
 #ifdef __APPLE__
 	/* OSX/Cocoa specific functions */
@@ -284,6 +288,14 @@ struct blend_state {
 	enum gs_blend_type dest_a;
 };
 
+struct render_target_entry {
+	gs_texture_t           *tex;
+	uint32_t               cx;
+	uint32_t               cy;
+	enum gs_color_format   format;
+	uint64_t               release_time;
+};
+
 struct graphics_subsystem {
 	void                   *module;
 	gs_device_t            *device;
@@ -299,6 +311,23 @@ struct graphics_subsystem {
 
 	gs_vertbuffer_t        *sprite_buffer;
 
+	DARRAY(struct render_target_entry) render_target_pool;
+	DARRAY(gs_texrender_t*) released_texrenders;
+
+	gs_vertbuffer_t        *batch_buffer;
+	size_t                 batch_capacity;
+	size_t                 batch_count;
+	gs_effect_t            *batch_effect;
+	const char             *batch_tech;
+	gs_technique_t         *batch_technique;
+	gs_eparam_t            *batch_images[GS_MAX_TEXTURES];
+	gs_texture_t           *batch_textures[GS_MAX_TEXTURES];
+	size_t                 batch_num_textures;
+	size_t                 batch_max_textures;
+	enum gs_color_format   batch_format;
+	bool                   batch_rect;
+	struct blend_state     batch_blend;
+
 	bool                   using_immediate;
 	struct gs_vb_data      *vbd;
 	gs_vertbuffer_t        *immediate_vertbuffer;
@@ -230,8 +230,15 @@ void gs_destroy(graphics_t *graphics)
 			effect = next;
 		}
 
+		for (size_t i = 0; i < graphics->render_target_pool.num; i++)
+			graphics->exports.gs_texture_destroy(
+				graphics->render_target_pool.array[i].tex);
+
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->sprite_buffer);
+		if (graphics->batch_buffer)
+			graphics->exports.gs_vertexbuffer_destroy(
+					graphics->batch_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->immediate_vertbuffer);
 		graphics->exports.device_destroy(graphics->device);
@@ -244,6 +251,8 @@ void gs_destroy(graphics_t *graphics)
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
+	da_free(graphics->render_target_pool);
+	da_free(graphics->released_texrenders);
 	if (graphics->module)
 		os_dlclose(graphics->module);
 	bfree(graphics);
@@ -1064,6 +1073,344 @@ void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 	gs_draw(GS_TRISTRIP, 0, 0);
 }
 
+/* ------------------------------------------------------------------------- */
+
+#define BATCH_VERTS_PER_SPRITE 6
+
+/* the texture coordinates of batched sprites are (u, v, slot, 0), where slot
+ * is the index of the sprite's texture in the batch */
+static bool sprite_batch_reserve(graphics_t *graphics, size_t count)
+{
+	size_t capacity = graphics->batch_capacity ?
+		graphics->batch_capacity : 64;
+	size_t num_verts = graphics->batch_count * BATCH_VERTS_PER_SPRITE;
+	struct gs_vb_data *old_vbd = NULL;
+	struct gs_vb_data *vbd;
+	gs_vertbuffer_t *buffer;
+
+	if (graphics->batch_buffer && count <= graphics->batch_capacity)
+		return true;
+
+	while (capacity < count)
+		capacity *= 2;
+
+	vbd = gs_vbdata_create();
+	vbd->num     = capacity * BATCH_VERTS_PER_SPRITE;
+	vbd->points  = bzalloc(sizeof(struct vec3) * vbd->num);
+	vbd->num_tex = 1;
+	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 4;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec4) * vbd->num);
+
+	if (graphics->batch_buffer) {
+		old_vbd = gs_vertexbuffer_get_data(graphics->batch_buffer);
+		memcpy(vbd->points, old_vbd->points,
+				sizeof(struct vec3) * num_verts);
+		memcpy(vbd->tvarray[0].array, old_vbd->tvarray[0].array,
+				sizeof(struct vec4) * num_verts);
+	}
+
+	buffer = graphics->exports.device_vertexbuffer_create(
+			graphics->device, vbd, GS_DYNAMIC);
+	if (!buffer)
+		return false;
+
+	if (graphics->batch_buffer)
+		gs_vertexbuffer_destroy(graphics->batch_buffer);
+
+	graphics->batch_buffer   = buffer;
+	graphics->batch_capacity = capacity;
+	return true;
+}
+
+static inline bool blend_states_equal(const struct blend_state *a,
+		const struct blend_state *b)
+{
+	return a->enabled == b->enabled &&
+	       a->src_c   == b->src_c &&
+	       a->dest_c  == b->dest_c &&
+	       a->src_a   == b->src_a &&
+	       a->dest_a  == b->dest_a;
+}
+
+static inline bool sprite_batch_matches(graphics_t *graphics,
+		gs_effect_t *effect, const char *tech,
+		enum gs_color_format format, bool rect)
+{
+	return graphics->batch_effect == effect &&
+	       graphics->batch_format == format &&
+	       graphics->batch_rect   == rect &&
+	       strcmp(graphics->batch_tech, tech) == 0 &&
+	       blend_states_equal(&graphics->batch_blend,
+			       &graphics->cur_blend_state);
+}
+
+/* sprites with different textures can only share a draw call if the effect
+ * has a "<tech>Batch" technique, which samples image, image1, image2 ... by
+ * the slot in the texture coordinates */
+static void sprite_batch_start(graphics_t *graphics, gs_effect_t *effect,
+		const char *tech, enum gs_color_format format, bool rect)
+{
+	gs_technique_t *batch_tech = NULL;
+	char name[64];
+
+	graphics->batch_effect       = effect;
+	graphics->batch_tech         = tech;
+	graphics->batch_format       = format;
+	graphics->batch_rect         = rect;
+	graphics->batch_blend        = graphics->cur_blend_state;
+	graphics->batch_num_textures = 0;
+	graphics->batch_max_textures = 1;
+	graphics->batch_images[0]    = gs_effect_get_param_by_name(effect,
+			"image");
+
+	if (!rect) {
+		snprintf(name, sizeof(name), "%sBatch", tech);
+		batch_tech = gs_effect_get_technique(effect, name);
+	}
+
+	if (!batch_tech) {
+		graphics->batch_technique = gs_effect_get_technique(effect,
+				tech);
+		return;
+	}
+
+	graphics->batch_technique = batch_tech;
+
+	while (graphics->batch_max_textures < GS_MAX_TEXTURES) {
+		gs_eparam_t *param;
+
+		snprintf(name, sizeof(name), "image%d",
+				(int)graphics->batch_max_textures);
+		param = gs_effect_get_param_by_name(effect, name);
+		if (!param)
+			break;
+
+		graphics->batch_images[graphics->batch_max_textures++] = param;
+	}
+}
+
+/* returns the slot of the texture in the batch, or -1 if the batch already
+ * uses as many textures as it can */
+static int sprite_batch_get_slot(graphics_t *graphics, gs_texture_t *tex)
+{
+	for (size_t i = 0; i < graphics->batch_num_textures; i++) {
+		if (graphics->batch_textures[i] == tex)
+			return (int)i;
+	}
+
+	if (graphics->batch_num_textures == graphics->batch_max_textures)
+		return -1;
+
+	graphics->batch_textures[graphics->batch_num_textures] = tex;
+	return (int)graphics->batch_num_textures++;
+}
+
+void gs_sprite_batch_add(gs_effect_t *effect, const char *tech,
+		gs_texture_t *tex, uint32_t flip, uint32_t width,
+		uint32_t height)
+{
+	graphics_t *graphics = thread_graphics;
+	static const size_t order[BATCH_VERTS_PER_SPRITE] = {0, 1, 2, 2, 1, 3};
+	struct vec3 points[4];
+	struct vec2 uvs[4];
+	struct gs_tvertarray tvarray = {2, uvs};
+	struct gs_vb_data sprite = {0};
+	struct gs_vb_data *data;
+	struct matrix4 world;
+	enum gs_color_format format;
+	struct vec4 *uv_out;
+	float fcx, fcy;
+	size_t start;
+	bool rect;
+	int slot;
+
+	if (!gs_valid_p2("gs_sprite_batch_add", effect, tex))
+		return;
+
+	if (gs_get_texture_type(tex) != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "A sprite must be a 2D texture");
+		return;
+	}
+
+	if (!tech)
+		tech = "Draw";
+
+	format = gs_texture_get_color_format(tex);
+	rect   = gs_texture_is_rect(tex);
+
+	if (graphics->batch_count &&
+	    !sprite_batch_matches(graphics, effect, tech, format, rect))
+		gs_sprite_batch_flush();
+
+	if (!graphics->batch_count)
+		sprite_batch_start(graphics, effect, tech, format, rect);
+
+	slot = sprite_batch_get_slot(graphics, tex);
+	if (slot < 0) {
+		gs_sprite_batch_flush();
+		sprite_batch_start(graphics, effect, tech, format, rect);
+		slot = sprite_batch_get_slot(graphics, tex);
+	}
+
+	if (!sprite_batch_reserve(graphics, graphics->batch_count + 1))
+		return;
+
+	fcx = width  ? (float)width  : (float)gs_texture_get_width(tex);
+	fcy = height ? (float)height : (float)gs_texture_get_height(tex);
+
+	sprite.points  = points;
+	sprite.tvarray = &tvarray;
+	if (rect)
+		build_sprite_rect(&sprite, tex, fcx, fcy, flip);
+	else
+		build_sprite_norm(&sprite, fcx, fcy, flip);
+
+	/* the sprites are drawn with an identity world matrix, so they are
+	 * transformed here instead */
+	gs_matrix_get(&world);
+	for (size_t i = 0; i < 4; i++)
+		vec3_transform(&points[i], &points[i], &world);
+
+	data   = gs_vertexbuffer_get_data(graphics->batch_buffer);
+	start  = graphics->batch_count * BATCH_VERTS_PER_SPRITE;
+	uv_out = (struct vec4*)data->tvarray[0].array + start;
+
+	for (size_t i = 0; i < BATCH_VERTS_PER_SPRITE; i++) {
+		const struct vec2 *uv = uvs + order[i];
+
+		vec3_copy(data->points + start + i, points + order[i]);
+		vec4_set(uv_out + i, uv->x, uv->y, (float)slot, 0.0f);
+	}
+
+	graphics->batch_count++;
+}
+
+void gs_sprite_batch_flush(void)
+{
+	graphics_t *graphics = thread_graphics;
+	struct blend_state *blend;
+	struct gs_vb_data *data;
+	struct gs_vb_data upload;
+	gs_technique_t *tech;
+	uint32_t num_verts;
+	size_t passes;
+
+	if (!gs_valid("gs_sprite_batch_flush"))
+		return;
+	if (!graphics->batch_count)
+		return;
+
+	blend     = &graphics->batch_blend;
+	tech      = graphics->batch_technique;
+	num_verts = (uint32_t)(graphics->batch_count * BATCH_VERTS_PER_SPRITE);
+
+	/* only the vertices of this batch are uploaded, not the whole
+	 * capacity of the buffer */
+	data = gs_vertexbuffer_get_data(graphics->batch_buffer);
+	upload = *data;
+	upload.num = num_verts;
+
+	gs_vertexbuffer_flush_direct(graphics->batch_buffer, &upload);
+	gs_load_vertexbuffer(graphics->batch_buffer);
+	gs_load_indexbuffer(NULL);
+
+	gs_blend_state_push();
+	gs_enable_blending(blend->enabled);
+	gs_blend_function_separate(blend->src_c, blend->dest_c,
+			blend->src_a, blend->dest_a);
+
+	gs_matrix_push();
+	gs_matrix_identity();
+
+	for (size_t i = 0; i < graphics->batch_num_textures; i++)
+		gs_effect_set_texture(graphics->batch_images[i],
+				graphics->batch_textures[i]);
+
+	passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw(GS_TRIS, 0, num_verts);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+
+	gs_matrix_pop();
+	gs_blend_state_pop();
+
+	graphics->batch_count        = 0;
+	graphics->batch_effect       = NULL;
+	graphics->batch_tech         = NULL;
+	graphics->batch_technique    = NULL;
+	graphics->batch_num_textures = 0;
+}
+
+#define RENDER_TARGET_IDLE_NS  3000000000ULL
+
+/* the pool is kept in release order, so the targets that have been idle the
+ * longest are always at the front.  there is no limit on the number of free
+ * targets: everything released during a frame is needed again next frame,
+ * so capping it would recreate targets every frame */
+static void trim_render_target_pool(graphics_t *graphics)
+{
+	uint64_t now = os_gettime_ns();
+
+	while (graphics->render_target_pool.num) {
+		struct render_target_entry *entry =
+			graphics->render_target_pool.array;
+
+		if (now - entry->release_time < RENDER_TARGET_IDLE_NS)
+			break;
+
+		gs_texture_destroy(entry->tex);
+		da_erase(graphics->render_target_pool, 0);
+	}
+}
+
+gs_texture_t *gs_render_target_acquire(uint32_t cx, uint32_t cy,
+		enum gs_color_format format)
+{
+	graphics_t *graphics = thread_graphics;
+	gs_texture_t *tex;
+
+	if (!gs_valid("gs_render_target_acquire"))
+		return NULL;
+
+	/* prefer the most recently released target */
+	for (size_t i = graphics->render_target_pool.num; i > 0; i--) {
+		struct render_target_entry *entry =
+			graphics->render_target_pool.array + (i - 1);
+
+		if (entry->cx == cx && entry->cy == cy &&
+		    entry->format == format) {
+			tex = entry->tex;
+			da_erase(graphics->render_target_pool, i - 1);
+			return tex;
+		}
+	}
+
+	trim_render_target_pool(graphics);
+	return gs_texture_create(cx, cy, format, 1, NULL, GS_RENDER_TARGET);
+}
+
+void gs_render_target_release(gs_texture_t *tex)
+{
+	graphics_t *graphics = thread_graphics;
+	struct render_target_entry entry;
+
+	if (!tex || !gs_valid("gs_render_target_release"))
+		return;
+
+	entry.tex          = tex;
+	entry.cx           = gs_texture_get_width(tex);
+	entry.cy           = gs_texture_get_height(tex);
+	entry.format       = gs_texture_get_color_format(tex);
+	entry.release_time = os_gettime_ns();
+
+	da_push_back(graphics->render_target_pool, &entry);
+	trim_render_target_pool(graphics);
+}
+
 void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 		float left, float right, float top, float bottom, float znear)
 {
@@ -2423,6 +2770,19 @@ bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 	return graphics->exports.gs_stagesurface_map(stagesurf, data, linesize);
 }
 
+bool gs_stagesurface_is_ready(gs_stagesurf_t *stagesurf)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_stagesurface_is_ready", stagesurf))
+		return false;
+
+	if (!graphics->exports.gs_stagesurface_is_ready)
+		return true;
+
+	return graphics->exports.gs_stagesurface_is_ready(stagesurf);
+}
+
 void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 {
 	graphics_t *graphics = thread_graphics;
@@ -2557,6 +2917,30 @@ bool gs_nv12_available(void)
 			thread_graphics->device);
 }
 
+void gs_set_shader_cache_path(const char *path)
+{
+	if (!gs_valid("gs_set_shader_cache_path"))
+		return;
+
+	if (!thread_graphics->exports.device_set_shader_cache_path)
+		return;
+
+	thread_graphics->exports.device_set_shader_cache_path(
+			thread_graphics->device, path);
+}
+
+uint64_t gs_get_api_calls(void)
+{
+	if (!gs_valid("gs_get_api_calls"))
+		return 0;
+
+	if (!thread_graphics->exports.device_get_api_calls)
+		return 0;
+
+	return thread_graphics->exports.device_get_api_calls(
+			thread_graphics->device);
+}
+
 #ifdef __APPLE__
 
 /** Platform specific functions */
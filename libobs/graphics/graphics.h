@@ -435,6 +435,37 @@ EXPORT void gs_texrender_end(gs_texrender_t *texrender);
 EXPORT void gs_texrender_reset(gs_texrender_t *texrender);
 EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 
+/**
+ * Returns the render target to the pool right away, so other texture
+ * renders can use it later in the same frame.  The contents are lost, and
+ * the next gs_texrender_begin renders again even without a reset.  The
+ * depth buffer is kept.
+ */
+EXPORT void gs_texrender_release(gs_texrender_t *texrender);
+
+/**
+ * Like gs_texrender_release, but the contents stay valid until
+ * gs_texrender_end_frame, for texture renders that are drawn more than
+ * once a frame.
+ */
+EXPORT void gs_texrender_release_deferred(gs_texrender_t *texrender);
+
+/** Returns the targets of all deferred releases to the pool */
+EXPORT void gs_texrender_end_frame(void);
+
+/* ---------------------------------------------------
+ * render target pool
+ * --------------------------------------------------- */
+
+/**
+ * Borrows a render target of the given size and format, creating a new one
+ * only if no matching target is free.  Targets are only destroyed once they
+ * stay unused for a few seconds.
+ */
+EXPORT gs_texture_t *gs_render_target_acquire(uint32_t cx, uint32_t cy,
+		enum gs_color_format format);
+EXPORT void gs_render_target_release(gs_texture_t *tex);
+
 /* ---------------------------------------------------
  * graphics subsystem
  * --------------------------------------------------- */
@@ -479,6 +510,7 @@ struct gs_init_data {
 
 #define GS_DEVICE_OPENGL      1
 #define GS_DEVICE_DIRECT3D_11 2
+#define GS_DEVICE_NULL        3
 
 EXPORT const char *gs_get_device_name(void);
 EXPORT int gs_get_device_type(void);
@@ -556,6 +588,26 @@ EXPORT void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 EXPORT void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
 
+/**
+ * Adds a sprite of the given texture at the current matrix to the sprite
+ * batch.  Consecutive sprites with the same effect, technique, blend state
+ * and texture format are drawn with a single draw call when the batch is
+ * flushed.  Sprites with different textures only share a batch if the
+ * effect has a "<tech>Batch" technique that picks the texture (image,
+ * image1, image2 ...) by the slot in the z coordinate of TEXCOORD0, like the
+ * DrawBatch technique of the default effect.
+ *
+ * The batch is flushed automatically when a sprite that does not match is
+ * added, and must be flushed with gs_sprite_batch_flush before changing the
+ * render target, viewport or projection, or drawing anything else.
+ *
+ * Must not be called inside an effect technique.
+ */
+EXPORT void gs_sprite_batch_add(gs_effect_t *effect, const char *tech,
+		gs_texture_t *tex, uint32_t flip, uint32_t width,
+		uint32_t height);
+EXPORT void gs_sprite_batch_flush(void);
+
 EXPORT void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 		float left, float right, float top, float bottom, float znear);
 
@@ -738,6 +790,11 @@ EXPORT bool     gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 		uint32_t *linesize);
 EXPORT void     gs_stagesurface_unmap(gs_stagesurf_t *stagesurf);
 
+/** Returns whether the last copy into the surface has completed, so that
+ * mapping it will not have to wait for the GPU.  Renderers that cannot tell
+ * always return true. */
+EXPORT bool     gs_stagesurface_is_ready(gs_stagesurf_t *stagesurf);
+
 EXPORT void     gs_zstencil_destroy(gs_zstencil_t *zstencil);
 
 EXPORT void     gs_samplerstate_destroy(gs_samplerstate_t *samplerstate);
@@ -761,6 +818,14 @@ EXPORT enum gs_index_type gs_indexbuffer_get_type(
 
 EXPORT bool     gs_nv12_available(void);
 
+/** Sets the directory the renderer may use to cache compiled shaders between
+ * sessions.  Does nothing if the renderer does not support it. */
+EXPORT void     gs_set_shader_cache_path(const char *path);
+
+/** Returns the total number of calls made into the underlying graphics API
+ * so far, or 0 if the renderer does not count them. */
+EXPORT uint64_t gs_get_api_calls(void);
+
 #ifdef __APPLE__
 
 /** platform specific function for creating (GL_TEXTURE_RECTANGLE) textures
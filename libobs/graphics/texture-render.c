@@ -21,7 +21,7 @@
  */
 
 #include <assert.h>
-#include "graphics.h"
+#include "graphics-internal.h"
 
 struct gs_texture_render {
 	gs_texture_t  *target, *prev_target;
@@ -33,6 +33,7 @@ struct gs_texture_render {
 	enum gs_zstencil_format zsformat;
 
 	bool rendered;
+	bool release_pending;
 };
 
 gs_texrender_t *gs_texrender_create(enum gs_color_format format,
@@ -49,35 +50,45 @@ gs_texrender_t *gs_texrender_create(enum gs_color_format format,
 void gs_texrender_destroy(gs_texrender_t *texrender)
 {
 	if (texrender) {
-		gs_texture_destroy(texrender->target);
+		graphics_t *graphics = gs_get_context();
+		if (texrender->release_pending && graphics)
+			da_erase_item(graphics->released_texrenders,
+					&texrender);
+
+		gs_render_target_release(texrender->target);
 		gs_zstencil_destroy(texrender->zs);
 		bfree(texrender);
 	}
 }
 
+/* the depth buffer stays with the texrender for as long as its size does,
+ * only the color target is shared through the pool */
 static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
 		uint32_t cy)
 {
 	if (!texrender)
 		return false;
 
-	gs_texture_destroy(texrender->target);
-	gs_zstencil_destroy(texrender->zs);
-
+	gs_render_target_release(texrender->target);
 	texrender->target = NULL;
-	texrender->zs     = NULL;
-	texrender->cx     = cx;
-	texrender->cy     = cy;
 
-	texrender->target = gs_texture_create(cx, cy, texrender->format,
-			1, NULL, GS_RENDER_TARGET);
+	if (texrender->cx != cx || texrender->cy != cy) {
+		gs_zstencil_destroy(texrender->zs);
+		texrender->zs = NULL;
+	}
+
+	texrender->cx = cx;
+	texrender->cy = cy;
+
+	texrender->target = gs_render_target_acquire(cx, cy,
+			texrender->format);
 	if (!texrender->target)
 		return false;
 
-	if (texrender->zsformat != GS_ZS_NONE) {
+	if (texrender->zsformat != GS_ZS_NONE && !texrender->zs) {
 		texrender->zs = gs_zstencil_create(cx, cy, texrender->zsformat);
 		if (!texrender->zs) {
-			gs_texture_destroy(texrender->target);
+			gs_render_target_release(texrender->target);
 			texrender->target = NULL;
 
 			return false;
@@ -87,6 +98,22 @@ static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
 	return true;
 }
 
+static void texrender_return_target(gs_texrender_t *texrender)
+{
+	gs_render_target_release(texrender->target);
+	texrender->target   = NULL;
+	texrender->rendered = false;
+}
+
+static void texrender_cancel_release(gs_texrender_t *texrender)
+{
+	if (texrender->release_pending) {
+		graphics_t *graphics = gs_get_context();
+		da_erase_item(graphics->released_texrenders, &texrender);
+		texrender->release_pending = false;
+	}
+}
+
 bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
 {
 	if (!texrender || texrender->rendered)
@@ -95,13 +122,12 @@ bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
 	if (!cx || !cy)
 		return false;
 
-	if (texrender->cx != cx || texrender->cy != cy)
+	texrender_cancel_release(texrender);
+
+	if (!texrender->target || texrender->cx != cx || texrender->cy != cy)
 		if (!texrender_resetbuffer(texrender, cx, cy))
 			return false;
 
-	if (!texrender->target)
-		return false;
-
 	gs_viewport_push();
 	gs_projection_push();
 	gs_matrix_push();
@@ -140,3 +166,42 @@ gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
 {
 	return texrender ? texrender->target : NULL;
 }
+
+void gs_texrender_release(gs_texrender_t *texrender)
+{
+	if (!texrender || !texrender->target)
+		return;
+
+	texrender_cancel_release(texrender);
+	texrender_return_target(texrender);
+}
+
+void gs_texrender_release_deferred(gs_texrender_t *texrender)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!texrender || !texrender->target || texrender->release_pending)
+		return;
+	if (!graphics)
+		return;
+
+	texrender->release_pending = true;
+	da_push_back(graphics->released_texrenders, &texrender);
+}
+
+void gs_texrender_end_frame(void)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics)
+		return;
+
+	for (size_t i = 0; i < graphics->released_texrenders.num; i++) {
+		gs_texrender_t *texrender =
+			graphics->released_texrenders.array[i];
+
+		texrender_return_target(texrender);
+		texrender->release_pending = false;
+	}
+
+	da_resize(graphics->released_texrenders, 0);
+}
@@ -46,7 +46,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[1] = size;
 		size += (width/2) * (height/2);
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = bmalloc_tag(size, BMEM_TAG_FRAME);
 		frame->data[1] = (uint8_t*)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t*)frame->data[0] + offsets[1];
 		frame->linesize[0] = width;
@@ -60,7 +60,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[0] = size;
 		size += (width/2) * (height/2) * 2;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = bmalloc_tag(size, BMEM_TAG_FRAME);
 		frame->data[1] = (uint8_t*)frame->data[0] + offsets[0];
 		frame->linesize[0] = width;
 		frame->linesize[1] = width;
@@ -69,7 +69,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_Y800:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = bmalloc_tag(size, BMEM_TAG_FRAME);
 		frame->linesize[0] = width;
 		break;
 
@@ -78,7 +78,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_UYVY:
 		size = width * height * 2;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = bmalloc_tag(size, BMEM_TAG_FRAME);
 		frame->linesize[0] = width*2;
 		break;
 
@@ -87,14 +87,14 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_BGRX:
 		size = width * height * 4;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = bmalloc_tag(size, BMEM_TAG_FRAME);
 		frame->linesize[0] = width*4;
 		break;
 
 	case VIDEO_FORMAT_I444:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size * 3);
+		frame->data[0] = bmalloc_tag(size * 3, BMEM_TAG_FRAME);
 		frame->data[1] = (uint8_t*)frame->data[0] + size;
 		frame->data[2] = (uint8_t*)frame->data[1] + size;
 		frame->linesize[0] = width;
@@ -131,6 +131,8 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	/* -------------------------------- */
 
+	frame_info->frame.trace.ts[VIDEO_TRACE_DISPATCH] = os_gettime_ns();
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
@@ -468,6 +470,10 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		cfi->count = count;
 		cfi->skipped = 0;
 
+		memset(&cfi->frame.trace, 0, sizeof(cfi->frame.trace));
+		cfi->frame.trace.ts[VIDEO_TRACE_RENDER]   = timestamp;
+		cfi->frame.trace.ts[VIDEO_TRACE_READBACK] = os_gettime_ns();
+
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
 		locked = true;
@@ -64,10 +64,29 @@ enum video_range_type {
 	VIDEO_RANGE_FULL
 };
 
+/* points in the pipeline at which a frame is stamped, from its render to
+ * the socket write of the packet it was encoded to */
+enum video_trace_stage {
+	VIDEO_TRACE_RENDER,       /* render of the frame began */
+	VIDEO_TRACE_READBACK,     /* frame read back and passed to video-io */
+	VIDEO_TRACE_DISPATCH,     /* video-io passed the frame to its inputs */
+	VIDEO_TRACE_ENCODE_START, /* frame submitted to the encoder */
+	VIDEO_TRACE_ENCODE_END,   /* packet of the frame returned by encoder */
+	VIDEO_TRACE_INTERLEAVE,   /* packet left the interleave buffer */
+	VIDEO_TRACE_SEND,         /* packet written by the output */
+
+	VIDEO_TRACE_STAGES
+};
+
+struct video_trace {
+	uint64_t          ts[VIDEO_TRACE_STAGES];
+};
+
 struct video_data {
 	uint8_t           *data[MAX_AV_PLANES];
 	uint32_t          linesize[MAX_AV_PLANES];
 	uint64_t          timestamp;
+	struct video_trace trace;
 };
 
 struct video_output_info {
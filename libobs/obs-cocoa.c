@@ -1325,3 +1325,20 @@ bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *plat,
 
 	return false;
 }
+
+bool obs_hotkeys_platform_has_events(obs_hotkeys_platform_t *plat)
+{
+	UNUSED_PARAMETER(plat);
+	return false;
+}
+
+bool obs_hotkeys_platform_wait_event(obs_hotkeys_platform_t *plat)
+{
+	UNUSED_PARAMETER(plat);
+	return false;
+}
+
+void obs_hotkeys_platform_wake(obs_hotkeys_platform_t *plat)
+{
+	UNUSED_PARAMETER(plat);
+}
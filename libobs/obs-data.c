@@ -27,11 +27,19 @@
 #include "obs-data.h"
 
 #include <jansson.h>
+#include <locale.h>
+#include <math.h>
+
+/* objects with at least this many items get a hash index of their names */
+#define OBS_DATA_INDEX_THRESHOLD 32
 
 struct obs_data_item {
 	volatile long        ref;
 	struct obs_data      *parent;
+	struct obs_data_item *prev;
 	struct obs_data_item *next;
+	struct obs_data_item *hash_next;
+	uint32_t             name_hash;
 	enum obs_data_type   type;
 	size_t               name_len;
 	size_t               data_len;
@@ -46,6 +54,12 @@ struct obs_data {
 	volatile long        ref;
 	char                 *json;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+	size_t               num_items;
+
+	/* only allocated once num_items reaches OBS_DATA_INDEX_THRESHOLD */
+	struct obs_data_item **index;
+	size_t               index_size;
 };
 
 struct obs_data_array {
@@ -83,6 +97,18 @@ static inline size_t get_name_align_size(const char *name)
 	return total_size - sizeof(struct obs_data_item);
 }
 
+static inline uint32_t hash_item_name(const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
 static inline char *get_item_name(struct obs_data_item *item)
 {
 	return (char*)item + sizeof(struct obs_data_item);
@@ -276,10 +302,11 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 
 	item = bzalloc(total_size);
 
-	item->capacity = total_size;
-	item->type     = type;
-	item->name_len = name_size;
-	item->ref      = 1;
+	item->capacity  = total_size;
+	item->type      = type;
+	item->name_len  = name_size;
+	item->name_hash = hash_item_name(name);
+	item->ref       = 1;
 
 	if (default_data) {
 		item->default_len = size;
@@ -300,45 +327,163 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	return item;
 }
 
-static struct obs_data_item **get_item_prev_next(struct obs_data *data,
-		struct obs_data_item *current)
+/* ------------------------------------------------------------------------- */
+/* Item list and name index */
+
+static inline struct obs_data_item **get_index_bucket(struct obs_data *data,
+		uint32_t hash)
 {
-	if (!current || !data)
-		return NULL;
+	return &data->index[hash & (data->index_size - 1)];
+}
 
-	struct obs_data_item **prev_next = &data->first_item;
-	struct obs_data_item *item       = data->first_item;
+static void obs_data_index_rebuild(struct obs_data *data, size_t size)
+{
+	struct obs_data_item *item;
 
-	while (item) {
-		if (item == current)
-			return prev_next;
+	bfree(data->index);
+	data->index = bzalloc(size * sizeof(struct obs_data_item*));
+	data->index_size = size;
+
+	for (item = data->first_item; item; item = item->next) {
+		struct obs_data_item **bucket =
+			get_index_bucket(data, item->name_hash);
 
-		prev_next = &item->next;
-		item      = item->next;
+		item->hash_next = *bucket;
+		*bucket = item;
 	}
+}
 
-	return NULL;
+static void obs_data_index_add(struct obs_data *data,
+		struct obs_data_item *item)
+{
+	struct obs_data_item **bucket;
+
+	if (!data->index && data->num_items < OBS_DATA_INDEX_THRESHOLD)
+		return;
+
+	/* the item is already linked in, so a rebuild picks it up as well */
+	if (data->num_items > data->index_size) {
+		obs_data_index_rebuild(data, data->index_size ?
+				data->index_size * 2 :
+				OBS_DATA_INDEX_THRESHOLD * 2);
+		return;
+	}
+
+	bucket = get_index_bucket(data, item->name_hash);
+	item->hash_next = *bucket;
+	*bucket = item;
+}
+
+static void obs_data_index_replace(struct obs_data *data,
+		struct obs_data_item *old_ptr, struct obs_data_item *new_ptr)
+{
+	struct obs_data_item **bucket;
+
+	if (!data->index)
+		return;
+
+	bucket = get_index_bucket(data, new_ptr->name_hash);
+	while (*bucket && *bucket != old_ptr)
+		bucket = &(*bucket)->hash_next;
+
+	if (*bucket)
+		*bucket = new_ptr;
+}
+
+static inline bool obs_data_item_attached(struct obs_data_item *item)
+{
+	return item->parent &&
+		(item->prev || item->parent->first_item == item);
+}
+
+/* keeps the list sorted by name.  items are usually added in order (json
+ * files are written in list order), so the end of the list is checked
+ * first */
+static void obs_data_item_attach(struct obs_data *data,
+		struct obs_data_item *item)
+{
+	const char *name = get_item_name(item);
+	struct obs_data_item *next = NULL;
+
+	item->parent = data;
+
+	if (data->last_item &&
+	    strcmp(get_item_name(data->last_item), name) > 0) {
+		next = data->first_item;
+		while (strcmp(get_item_name(next), name) < 0)
+			next = next->next;
+	}
+
+	item->next = next;
+	item->prev = next ? next->prev : data->last_item;
+
+	if (item->prev)
+		item->prev->next = item;
+	else
+		data->first_item = item;
+
+	if (next)
+		next->prev = item;
+	else
+		data->last_item = item;
+
+	data->num_items++;
+	obs_data_index_add(data, item);
 }
 
 static inline void obs_data_item_detach(struct obs_data_item *item)
 {
-	struct obs_data_item **prev_next = get_item_prev_next(item->parent,
-			item);
+	struct obs_data *data = item->parent;
 
-	if (prev_next) {
-		*prev_next = item->next;
-		item->next = NULL;
+	if (!obs_data_item_attached(item))
+		return;
+
+	if (item->prev)
+		item->prev->next = item->next;
+	else
+		data->first_item = item->next;
+
+	if (item->next)
+		item->next->prev = item->prev;
+	else
+		data->last_item = item->prev;
+
+	if (data->index) {
+		struct obs_data_item **bucket =
+			get_index_bucket(data, item->name_hash);
+
+		while (*bucket && *bucket != item)
+			bucket = &(*bucket)->hash_next;
+		if (*bucket)
+			*bucket = item->hash_next;
 	}
+
+	data->num_items--;
+	item->prev = NULL;
+	item->next = NULL;
+	item->hash_next = NULL;
 }
 
+/* called after an item has been reallocated */
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 		struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next = get_item_prev_next(new_ptr->parent,
-			old_ptr);
+	struct obs_data *data = new_ptr->parent;
+
+	if (!data || (!new_ptr->prev && data->first_item != old_ptr))
+		return;
 
-	if (prev_next)
-		*prev_next = new_ptr;
+	if (new_ptr->prev)
+		new_ptr->prev->next = new_ptr;
+	else
+		data->first_item = new_ptr;
+
+	if (new_ptr->next)
+		new_ptr->next->prev = new_ptr;
+	else
+		data->last_item = new_ptr;
+
+	obs_data_index_replace(data, old_ptr, new_ptr);
 }
 
 static struct obs_data_item *obs_data_item_ensure_capacity(
@@ -536,87 +681,234 @@ static void obs_data_add_json_item(obs_data_t *data, const char *key,
 
 /* ------------------------------------------------------------------------- */
 
-static inline void set_json_string(json_t *json, const char *name,
-		obs_data_item_t *item)
+/*
+ * JSON writer
+ *
+ * Writes obs_data straight to text instead of building a json_t tree first.
+ * The output is identical to json_dumps with JSON_PRESERVE_ORDER and
+ * JSON_INDENT(4), including which values are left out: strings that are not
+ * valid UTF-8 and numbers that are not finite cannot be stored by jansson,
+ * so they are skipped here as well.
+ */
+
+#define JSON_INDENT_SIZE 4
+
+static bool json_utf8_valid(const char *str)
 {
-	const char *val = obs_data_item_get_string(item);
-	json_object_set_new(json, name, json_string(val));
+	const uint8_t *pos = (const uint8_t*)str;
+
+	while (*pos) {
+		uint32_t c = *(pos++);
+		uint32_t min;
+		int count;
+
+		if (c < 0x80)
+			continue;
+		else if (c >= 0xC2 && c <= 0xDF)
+			count = 1, min = 0x80, c &= 0x1F;
+		else if (c >= 0xE0 && c <= 0xEF)
+			count = 2, min = 0x800, c &= 0x0F;
+		else if (c >= 0xF0 && c <= 0xF4)
+			count = 3, min = 0x10000, c &= 0x07;
+		else
+			return false;
+
+		while (count--) {
+			if ((*pos & 0xC0) != 0x80)
+				return false;
+			c = (c << 6) | (*(pos++) & 0x3F);
+		}
+
+		if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+			return false;
+	}
+
+	return true;
 }
 
-static inline void set_json_number(json_t *json, const char *name,
-		obs_data_item_t *item)
+static inline void json_write_indent(struct dstr *json, int depth)
 {
-	enum obs_data_number_type type = obs_data_item_numtype(item);
+	size_t count = (size_t)depth * JSON_INDENT_SIZE;
 
-	if (type == OBS_DATA_NUM_INT) {
-		long long val = obs_data_item_get_int(item);
-		json_object_set_new(json, name, json_integer(val));
-	} else {
-		double val = obs_data_item_get_double(item);
-		json_object_set_new(json, name, json_real(val));
-	}
+	dstr_ensure_capacity(json, json->len + count + 2);
+	json->array[json->len++] = '\n';
+	memset(json->array + json->len, ' ', count);
+	json->len += count;
+	json->array[json->len] = 0;
 }
 
-static inline void set_json_bool(json_t *json, const char *name,
-		obs_data_item_t *item)
+static void json_write_string(struct dstr *json, const char *str)
 {
-	bool val = obs_data_item_get_bool(item);
-	json_object_set_new(json, name, val ? json_true() : json_false());
+	const char *start = str;
+
+	dstr_cat_ch(json, '"');
+
+	for (; *str; str++) {
+		uint8_t c = (uint8_t)*str;
+		char seq[8];
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		dstr_ncat(json, start, str - start);
+		start = str + 1;
+
+		switch (c) {
+		case '"':  dstr_cat(json, "\\\""); break;
+		case '\\': dstr_cat(json, "\\\\"); break;
+		case '\b': dstr_cat(json, "\\b"); break;
+		case '\f': dstr_cat(json, "\\f"); break;
+		case '\n': dstr_cat(json, "\\n"); break;
+		case '\r': dstr_cat(json, "\\r"); break;
+		case '\t': dstr_cat(json, "\\t"); break;
+		default:
+			snprintf(seq, sizeof(seq), "\\u%04X", (unsigned)c);
+			dstr_cat(json, seq);
+		}
+	}
+
+	dstr_ncat(json, start, str - start);
+	dstr_cat_ch(json, '"');
 }
 
-static json_t *obs_data_to_json(obs_data_t *data);
+/* same format as jansson: 17 significant digits, and always a '.' or an
+ * exponent so that the value is read back as a double */
+static void json_write_double(struct dstr *json, double val)
+{
+	char buf[64];
+	char point = *localeconv()->decimal_point;
+	char *exp;
+
+	snprintf(buf, sizeof(buf), "%.17g", val);
 
-static inline void set_json_obj(json_t *json, const char *name,
-		obs_data_item_t *item)
+	if (point != '.') {
+		char *pos = strchr(buf, point);
+		if (pos)
+			*pos = '.';
+	}
+
+	exp = strchr(buf, 'e');
+	if (exp) {
+		char *digits = exp + 1;
+		char *end;
+
+		if (*digits == '+')
+			memmove(digits, digits + 1, strlen(digits));
+		else if (*digits == '-')
+			digits++;
+
+		end = digits;
+		while (*end == '0' && end[1])
+			end++;
+		if (end != digits)
+			memmove(digits, end, strlen(end) + 1);
+
+	} else if (!strchr(buf, '.')) {
+		strcat(buf, ".0");
+	}
+
+	dstr_cat(json, buf);
+}
+
+static bool json_item_valid(struct obs_data_item *item)
 {
-	obs_data_t *obj = obs_data_item_get_obj(item);
-	json_object_set_new(json, name, obs_data_to_json(obj));
-	obs_data_release(obj);
+	if (!obs_data_item_has_user_value(item))
+		return false;
+	if (!json_utf8_valid(get_item_name(item)))
+		return false;
+
+	if (item->type == OBS_DATA_STRING)
+		return json_utf8_valid(obs_data_item_get_string(item));
+
+	if (item->type == OBS_DATA_NUMBER &&
+	    obs_data_item_numtype(item) == OBS_DATA_NUM_DOUBLE)
+		return isfinite(obs_data_item_get_double(item));
+
+	return item->type != OBS_DATA_NULL;
 }
 
-static inline void set_json_array(json_t *json, const char *name,
-		obs_data_item_t *item)
+static void json_write_obj(struct dstr *json, struct obs_data *data,
+		int depth);
+
+static void json_write_array(struct dstr *json, struct obs_data_array *array,
+		int depth)
 {
-	json_t           *jarray = json_array();
-	obs_data_array_t *array   = obs_data_item_get_array(item);
-	size_t           count   = obs_data_array_count(array);
+	size_t count = array ? array->objects.num : 0;
+
+	dstr_cat_ch(json, '[');
+	if (!count) {
+		dstr_cat_ch(json, ']');
+		return;
+	}
 
-	for (size_t idx = 0; idx < count; idx++) {
-		obs_data_t *sub_item = obs_data_array_item(array, idx);
-		json_t     *jitem   = obs_data_to_json(sub_item);
-		json_array_append_new(jarray, jitem);
-		obs_data_release(sub_item);
+	for (size_t i = 0; i < count; i++) {
+		if (i)
+			dstr_cat_ch(json, ',');
+		json_write_indent(json, depth + 1);
+		json_write_obj(json, array->objects.array[i], depth + 1);
 	}
 
-	json_object_set_new(json, name, jarray);
-	obs_data_array_release(array);
+	json_write_indent(json, depth);
+	dstr_cat_ch(json, ']');
+}
+
+static void json_write_item(struct dstr *json, struct obs_data_item *item,
+		int depth)
+{
+	json_write_string(json, get_item_name(item));
+	dstr_cat(json, ": ");
+
+	switch (item->type) {
+	case OBS_DATA_STRING:
+		json_write_string(json, obs_data_item_get_string(item));
+		break;
+
+	case OBS_DATA_NUMBER:
+		if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT)
+			dstr_catf(json, "%lld", obs_data_item_get_int(item));
+		else
+			json_write_double(json, obs_data_item_get_double(item));
+		break;
+
+	case OBS_DATA_BOOLEAN:
+		dstr_cat(json, obs_data_item_get_bool(item) ? "true" : "false");
+		break;
+
+	case OBS_DATA_OBJECT:
+		json_write_obj(json, get_item_obj(item), depth);
+		break;
+
+	case OBS_DATA_ARRAY:
+		json_write_array(json, get_item_array(item), depth);
+		break;
+
+	case OBS_DATA_NULL:
+		break;
+	}
 }
 
-static json_t *obs_data_to_json(obs_data_t *data)
+static void json_write_obj(struct dstr *json, struct obs_data *data,
+		int depth)
 {
-	json_t *json = json_object();
-	obs_data_item_t *item = NULL;
+	struct obs_data_item *item = data ? data->first_item : NULL;
+	bool empty = true;
 
-	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
-		enum obs_data_type type = obs_data_item_gettype(item);
-		const char *name        = get_item_name(item);
+	dstr_cat_ch(json, '{');
 
-		if (!obs_data_item_has_user_value(item))
+	for (; item; item = item->next) {
+		if (!json_item_valid(item))
 			continue;
 
-		if (type == OBS_DATA_STRING)
-			set_json_string(json, name, item);
-		else if (type == OBS_DATA_NUMBER)
-			set_json_number(json, name, item);
-		else if (type == OBS_DATA_BOOLEAN)
-			set_json_bool(json, name, item);
-		else if (type == OBS_DATA_OBJECT)
-			set_json_obj(json, name, item);
-		else if (type == OBS_DATA_ARRAY)
-			set_json_array(json, name, item);
+		if (!empty)
+			dstr_cat_ch(json, ',');
+		json_write_indent(json, depth + 1);
+		json_write_item(json, item, depth + 1);
+		empty = false;
 	}
 
-	return json;
+	if (!empty)
+		json_write_indent(json, depth);
+	dstr_cat_ch(json, '}');
 }
 
 /* ------------------------------------------------------------------------- */
@@ -709,8 +1001,8 @@ static inline void obs_data_destroy(struct obs_data *data)
 		item = next;
 	}
 
-	/* NOTE: don't use bfree for json text, allocated by json */
-	free(data->json);
+	bfree(data->index);
+	bfree(data->json);
 	bfree(data);
 }
 
@@ -726,13 +1018,13 @@ const char *obs_data_get_json(obs_data_t *data)
 {
 	if (!data) return NULL;
 
-	/* NOTE: don't use libobs bfree for json text */
-	free(data->json);
-	data->json = NULL;
+	struct dstr json = {0};
+
+	bfree(data->json);
 
-	json_t *root = obs_data_to_json(data);
-	data->json = json_dumps(root, JSON_PRESERVE_ORDER | JSON_INDENT(4));
-	json_decref(root);
+	dstr_reserve(&json, 4096);
+	json_write_obj(&json, data, 0);
+	data->json = json.array;
 
 	return data->json;
 }
@@ -764,12 +1056,30 @@ bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 
 static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
-	if (!data) return NULL;
+	if (!data || !name) return NULL;
 
-	struct obs_data_item *item = data->first_item;
+	uint32_t hash = hash_item_name(name);
+	struct obs_data_item *item;
+
+	if (data->index) {
+		item = *get_index_bucket(data, hash);
+
+		while (item) {
+			if (item->name_hash == hash &&
+			    strcmp(get_item_name(item), name) == 0)
+				return item;
+
+			item = item->hash_next;
+		}
+
+		return NULL;
+	}
+
+	item = data->first_item;
 
 	while (item) {
-		if (strcmp(get_item_name(item), name) == 0)
+		if (item->name_hash == hash &&
+		    strcmp(get_item_name(item), name) == 0)
 			return item;
 
 		item = item->next;
@@ -788,31 +1098,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 	if ((!item || (item && !*item)) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
 				default_data, autoselect_data);
-
-		obs_data_item_t *prev = obs_data_first(data);
-		obs_data_item_t *next = obs_data_first(data);
-		obs_data_item_next(&next);
-		for (; prev && next; obs_data_item_next(&prev),
-				obs_data_item_next(&next)) {
-			if (strcmp(get_item_name(next), name) > 0)
-				break;
-		}
-
-		new_item->parent = data;
-		if (prev && strcmp(get_item_name(prev), name) < 0) {
-			prev->next     = new_item;
-			new_item->next = next;
-
-		} else {
-			data->first_item = new_item;
-			new_item->next   = prev;
-		}
-
-		if (!prev)
-			data->first_item = new_item;
-
-		obs_data_item_release(&prev);
-		obs_data_item_release(&next);
+		if (new_item)
+			obs_data_item_attach(data, new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
@@ -23,10 +23,11 @@
 #define set_encoder_active(encoder, val) \
 	os_atomic_set_bool(&encoder->active, val)
 
-struct obs_encoder_info *find_encoder(const char *id)
+/* must be called with obs->modules_mutex held */
+struct obs_encoder_info *find_loaded_encoder(const char *id)
 {
 	for (size_t i = 0; i < obs->encoder_types.num; i++) {
-		struct obs_encoder_info *info = obs->encoder_types.array+i;
+		struct obs_encoder_info *info = obs->encoder_types.array[i];
 
 		if (strcmp(info->id, id) == 0)
 			return info;
@@ -35,6 +36,23 @@ struct obs_encoder_info *find_encoder(const char *id)
 	return NULL;
 }
 
+struct obs_encoder_info *find_encoder(const char *id)
+{
+	struct obs_encoder_info *info;
+
+	pthread_mutex_lock(&obs->modules_mutex);
+	info = find_loaded_encoder(id);
+	pthread_mutex_unlock(&obs->modules_mutex);
+
+	if (!info && obs_load_deferred_module(OBS_TYPE_CLASS_ENCODER, id)) {
+		pthread_mutex_lock(&obs->modules_mutex);
+		info = find_loaded_encoder(id);
+		pthread_mutex_unlock(&obs->modules_mutex);
+	}
+
+	return info;
+}
+
 const char *obs_encoder_get_display_name(const char *id)
 {
 	struct obs_encoder_info *ei = find_encoder(id);
@@ -251,6 +269,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 
 		if (encoder->context.data)
 			encoder->info.destroy(encoder->context.data);
+		obs_metric_destroy(encoder->encode_time_metric);
 		da_free(encoder->callbacks);
 		pthread_mutex_destroy(&encoder->init_mutex);
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
@@ -539,6 +558,8 @@ static inline void obs_encoder_start_internal(obs_encoder_t *encoder,
 
 	if (first) {
 		encoder->cur_pts = 0;
+		memset(encoder->frame_traces, 0,
+				sizeof(encoder->frame_traces));
 		add_connection(encoder);
 	}
 }
@@ -878,6 +899,55 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 	}
 }
 
+static const double encode_time_bounds[] = {
+	0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.05, 0.1
+};
+
+static void create_encode_time_metric(struct obs_encoder *encoder)
+{
+	struct dstr labels = {0};
+	obs_metric_label(&labels, "encoder", encoder->context.name);
+
+	encoder->encode_time_metric = obs_metric_create_histogram(
+			"obs_encoder_encode_seconds", labels.array,
+			"Time spent in each encode call",
+			encode_time_bounds,
+			sizeof(encode_time_bounds) / sizeof(double));
+
+	dstr_free(&labels);
+}
+
+static inline struct encoder_frame_trace *get_frame_trace(
+		struct obs_encoder *encoder, int64_t pts)
+{
+	uint64_t idx = (uint64_t)pts / (encoder->timebase_num ?
+			encoder->timebase_num : 1);
+	return &encoder->frame_traces[idx % ENCODER_TRACE_FRAMES];
+}
+
+static inline void push_frame_trace(struct obs_encoder *encoder,
+		int64_t pts, const struct video_trace *trace)
+{
+	struct encoder_frame_trace *ft = get_frame_trace(encoder, pts);
+
+	ft->pts   = pts;
+	ft->trace = *trace;
+	ft->trace.ts[VIDEO_TRACE_ENCODE_START] = os_gettime_ns();
+}
+
+static inline void pop_frame_trace(struct obs_encoder *encoder,
+		struct encoder_packet *pkt)
+{
+	struct encoder_frame_trace *ft = get_frame_trace(encoder, pkt->pts);
+
+	if (ft->pts != pkt->pts || !ft->trace.ts[VIDEO_TRACE_RENDER])
+		return;
+
+	pkt->trace = ft->trace;
+	pkt->trace.ts[VIDEO_TRACE_ENCODE_END] = os_gettime_ns();
+	ft->trace.ts[VIDEO_TRACE_RENDER] = 0;
+}
+
 static const char *do_encode_name = "do_encode";
 void do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 {
@@ -895,11 +965,21 @@ void do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 	pkt.timebase_den = encoder->timebase_den;
 	pkt.encoder = encoder;
 
+	if (!encoder->encode_time_metric)
+		create_encode_time_metric(encoder);
+
 	profile_start(encoder->profile_encoder_encode_name);
+	uint64_t encode_start = os_gettime_ns();
 	success = encoder->info.encode(encoder->context.data, frame, &pkt,
 			&received);
+	obs_metric_observe(encoder->encode_time_metric,
+			(double)(os_gettime_ns() - encode_start) / 1000000000.0);
 
 	profile_end(encoder->profile_encoder_encode_name);
+
+	if (received && encoder->info.type == OBS_ENCODER_VIDEO)
+		pop_frame_trace(encoder, &pkt);
+
 	if (pkt.type != 99) {
 		send_off_encoder_packet(encoder, success, received, &pkt);
 	}
@@ -940,6 +1020,9 @@ static void receive_video(void *param, struct video_data *frame)
 	enc_frame.frames = 1;
 	enc_frame.pts    = encoder->cur_pts;
 
+	if (frame->trace.ts[VIDEO_TRACE_RENDER])
+		push_frame_trace(encoder, enc_frame.pts, &frame->trace);
+
 	do_encode(encoder, &enc_frame);
 
 	encoder->cur_pts += encoder->timebase_num;
@@ -1124,7 +1207,7 @@ void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 	long *p_refs;
 
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
+	p_refs = bmalloc_tag(src->size + sizeof(long), BMEM_TAG_PACKET);
 	dst->data = (void*)(p_refs + 1);
 	*p_refs = 1;
 	memcpy(dst->data, src->data, src->size);
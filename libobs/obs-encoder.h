@@ -83,6 +83,9 @@ struct encoder_packet {
 
 	/** Encoder from which the track originated from */
 	obs_encoder_t         *encoder;
+
+	/** Pipeline timestamps of the frame (video only, set by libobs) */
+	struct video_trace    trace;
 	int	r;
 };
 
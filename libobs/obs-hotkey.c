@@ -138,7 +138,8 @@ void obs_hotkey_pair_set_descriptions(obs_hotkey_pair_id id,
 static void hotkey_signal(const char *signal, obs_hotkey_t *hotkey)
 {
 	calldata_t data;
-	calldata_init(&data);
+	uint8_t stack[128];
+	calldata_init_stack(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "key", hotkey);
 
 	signal_handler_signal(obs->hotkeys.signals, signal, &data);
@@ -1370,10 +1371,41 @@ static inline void query_hotkeys()
 
 #define NBSP "\xC2\xA0"
 
+/* the bindings are only evaluated when the platform reports that the state
+ * of a key or button changed, instead of every 25 ms */
+static void hotkey_event_loop(void)
+{
+	obs_hotkeys_platform_t *context = obs->hotkeys.platform_context;
+	const char *hotkey_thread_name = "obs_hotkey_thread(events)";
+
+	profile_register_root(hotkey_thread_name, 0);
+
+	while (os_event_try(obs->hotkeys.stop_event) == EAGAIN) {
+		if (!obs_hotkeys_platform_wait_event(context))
+			continue;
+		if (!lock())
+			continue;
+
+		profile_start(hotkey_thread_name);
+		query_hotkeys();
+		profile_end(hotkey_thread_name);
+
+		unlock();
+
+		profile_reenable_thread();
+	}
+}
+
 void *obs_hotkey_thread(void *arg)
 {
 	UNUSED_PARAMETER(arg);
 
+	if (obs_hotkeys_platform_has_events(obs->hotkeys.platform_context)) {
+		blog(LOG_INFO, "Hotkeys: using input events");
+		hotkey_event_loop();
+		return NULL;
+	}
+
 	const char *hotkey_thread_name =
 		profile_store_name(obs_get_profiler_name_store(),
 				"obs_hotkey_thread(%g"NBSP"ms)", 25.);
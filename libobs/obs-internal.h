@@ -37,6 +37,7 @@
 #include "obs.h"
 
 #define NUM_TEXTURES 2
+#define NUM_COPY_SURFACES 3
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
 #define NUM_ENCODE_TEXTURE_FRAMES_TO_WAIT 1
@@ -79,6 +80,14 @@ static inline bool obs_object_valid(const void *obj, const char *f,
 /* ------------------------------------------------------------------------- */
 /* modules */
 
+enum obs_type_class {
+	OBS_TYPE_CLASS_SOURCE,
+	OBS_TYPE_CLASS_OUTPUT,
+	OBS_TYPE_CLASS_ENCODER,
+	OBS_TYPE_CLASS_SERVICE,
+	OBS_TYPE_CLASS_COUNT
+};
+
 struct obs_module {
 	char *mod_name;
 	const char *file;
@@ -87,6 +96,12 @@ struct obs_module {
 	void *module;
 	bool loaded;
 
+	/* type IDs registered by obs_module_load, for the module manifest */
+	DARRAY(char*) types[OBS_TYPE_CLASS_COUNT];
+	bool registers_ui;
+	uint64_t open_ns;
+	uint64_t load_ns;
+
 	bool        (*load)(void);
 	void        (*unload)(void);
 	void        (*post_load)(void);
@@ -103,6 +118,27 @@ struct obs_module {
 
 extern void free_module(struct obs_module *mod);
 
+/* a module listed in the module manifest that has not been opened yet */
+struct obs_deferred_module {
+	char *bin_path;
+	char *data_path;
+	DARRAY(char*) types[OBS_TYPE_CLASS_COUNT];
+};
+
+extern void free_deferred_module(struct obs_deferred_module *mod);
+extern void obs_module_add_type(enum obs_type_class cls, const char *id);
+
+/* loads the deferred module that provides the given type, or waits for a
+ * load in progress on another thread.  called without any lock held after a
+ * lookup failed, and returns true if the lookup should be repeated */
+extern bool obs_load_deferred_module(enum obs_type_class cls, const char *id);
+
+/* loads every deferred module that provides types of the given class */
+extern void obs_load_deferred_modules(enum obs_type_class cls);
+
+/* whether any module is still waiting to be loaded on demand */
+extern bool obs_have_deferred_modules(void);
+
 struct obs_module_path {
 	char *bin;
 	char *data;
@@ -165,6 +201,14 @@ void obs_hotkeys_platform_free(struct obs_core_hotkeys *hotkeys);
 bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *context,
 		obs_key_t key);
 
+/* platforms that deliver key events instead of being polled return true from
+ * obs_hotkeys_platform_has_events.  obs_hotkeys_platform_wait_event then
+ * blocks until a key state changes (returns true) or until
+ * obs_hotkeys_platform_wake is called (returns false) */
+bool obs_hotkeys_platform_has_events(obs_hotkeys_platform_t *context);
+bool obs_hotkeys_platform_wait_event(obs_hotkeys_platform_t *context);
+void obs_hotkeys_platform_wake(obs_hotkeys_platform_t *context);
+
 const char *obs_get_hotkey_translation(obs_key_t key, const char *def);
 
 struct obs_context_data;
@@ -239,14 +283,13 @@ struct obs_tex_frame {
 
 struct obs_core_video {
 	graphics_t                      *graphics;
-	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
+	gs_stagesurf_t                  *copy_surfaces[NUM_COPY_SURFACES];
 	gs_texture_t                    *render_textures[NUM_TEXTURES];
 	gs_texture_t                    *output_textures[NUM_TEXTURES];
 	gs_texture_t                    *convert_textures[NUM_TEXTURES];
 	gs_texture_t                    *convert_uv_textures[NUM_TEXTURES];
 	bool                            textures_rendered[NUM_TEXTURES];
 	bool                            textures_output[NUM_TEXTURES];
-	bool                            textures_copied[NUM_TEXTURES];
 	bool                            textures_converted[NUM_TEXTURES];
 	bool                            using_nv12_tex;
 	struct circlebuf                vframe_info_buffer;
@@ -263,6 +306,9 @@ struct obs_core_video {
 	gs_effect_t                     *premultiplied_alpha_effect;
 	gs_samplerstate_t               *point_sampler;
 	gs_stagesurf_t                  *mapped_surface;
+	int                             first_copy_surface;
+	int                             copies_queued;
+	uint32_t                        readback_skips;
 	int                             cur_texture;
 	long                            raw_active;
 	long                            gpu_encoder_active;
@@ -285,6 +331,26 @@ struct obs_core_video {
 	uint32_t                        lagged_frames;
 	bool                            thread_initialized;
 
+	uint64_t                        render_frame;
+	uint64_t                        render_cache_hits;
+	uint64_t                        render_cache_misses;
+
+	uint64_t                        content_hash;
+	bool                            content_hash_valid;
+	uint32_t                        main_frames;
+	uint32_t                        static_frames;
+
+	uint64_t                        api_calls_start;
+	uint64_t                        api_calls_last;
+	uint64_t                        api_calls_peak;
+	uint32_t                        api_call_frames;
+
+	obs_metric_t                    *frame_time_metric;
+	obs_metric_t                    *frames_metric;
+	obs_metric_t                    *lagged_frames_metric;
+	obs_metric_t                    *output_frames_metric;
+	obs_metric_t                    *skipped_frames_metric;
+
 	bool                            gpu_conversion;
 	const char                      *conversion_tech;
 	uint32_t                        conversion_height;
@@ -397,19 +463,75 @@ struct obs_core_hotkeys {
 	char                            *sceneitem_hide;
 };
 
+/* ------------------------------------------------------------------------- */
+/* metrics */
+
+struct obs_core_metrics {
+	pthread_mutex_t                 mutex;
+	DARRAY(obs_metric_t*)           metrics;
+
+	obs_metric_t                    *allocs_metric;
+	obs_metric_t                    *resident_size_metric;
+	obs_metric_t                    *audio_buffering_metric;
+
+	pthread_t                       server_thread;
+	bool                            server_active;
+	volatile bool                   server_stopping;
+	int                             server_fd;
+	char                            *server_path;
+};
+
+extern bool obs_init_metrics(void);
+extern void obs_free_metrics(void);
+extern void obs_init_video_metrics(void);
+extern void obs_free_video_metrics(void);
+
+/* appends name="value" to a label list, escaping the value */
+extern void obs_metric_label(struct dstr *labels, const char *name,
+		const char *value);
+
+/* ------------------------------------------------------------------------- */
+
 struct obs_core {
 	struct obs_module               *first_module;
 	DARRAY(struct obs_module_path)  module_paths;
 
-	DARRAY(struct obs_source_info)  source_types;
-	DARRAY(struct obs_source_info)  input_types;
-	DARRAY(struct obs_source_info)  filter_types;
-	DARRAY(struct obs_source_info)  transition_types;
-	DARRAY(struct obs_output_info)  output_types;
-	DARRAY(struct obs_encoder_info) encoder_types;
-	DARRAY(struct obs_service_info) service_types;
-	DARRAY(struct obs_modal_ui)     modal_ui_callbacks;
-	DARRAY(struct obs_modeless_ui)  modeless_ui_callbacks;
+	/* modules can be loaded on demand from any thread that looks up a
+	 * type, so module loading takes two locks, in this order:
+	 *
+	 *  - module_load_mutex (recursive) is held while a module's
+	 *    obs_module_load and post_load run, which may take any other
+	 *    lock.  it protects loading_module and modules_post_loaded.
+	 *  - modules_mutex protects the module list, the registered type
+	 *    arrays and the deferred modules.  it is only held to read,
+	 *    update or log those, never while module code runs.
+	 *
+	 * a lookup that has to load a module takes module_load_mutex, so no
+	 * other libobs lock (such as sources_mutex) may be held when looking
+	 * up a type that a deferred module provides.  obs_load_sources loads
+	 * the modules of a collection before it locks sources_mutex. */
+	pthread_mutex_t                 module_load_mutex;
+	pthread_mutex_t                 modules_mutex;
+	bool                            lazy_modules;
+	bool                            modules_post_loaded;
+	struct obs_module               *loading_module;
+	DARRAY(struct obs_deferred_module) deferred_modules;
+	long                            deferred_loading;
+
+	/* each registered type is allocated once and stays where it is
+	 * until shutdown, so the pointers handed out by get_source_info,
+	 * find_output, find_encoder and find_service remain valid after the
+	 * lock is released, even when a module loaded on demand grows the
+	 * arrays.  input/filter/transition_types point into source_types */
+	DARRAY(struct obs_source_info*)  source_types;
+	DARRAY(struct obs_source_info*)  input_types;
+	DARRAY(struct obs_source_info*)  filter_types;
+	DARRAY(struct obs_source_info*)  transition_types;
+	DARRAY(struct obs_output_info*)  output_types;
+	DARRAY(struct obs_encoder_info*) encoder_types;
+	DARRAY(struct obs_service_info*) service_types;
+	DARRAY(struct obs_modal_ui*)     modal_ui_callbacks;
+	DARRAY(struct obs_modeless_ui*)  modeless_ui_callbacks;
 
 	signal_handler_t                *signals;
 	proc_handler_t                  *procs;
@@ -425,6 +547,7 @@ struct obs_core {
 	struct obs_core_audio           audio;
 	struct obs_core_data            data;
 	struct obs_core_hotkeys         hotkeys;
+	struct obs_core_metrics         metrics;
 };
 
 extern struct obs_core *obs;
@@ -579,6 +702,9 @@ struct obs_source {
 	/* signals to call the source update in the video thread */
 	bool                            defer_update;
 
+	/* incremented whenever the output of the source may have changed */
+	volatile long                   content_serial;
+
 	/* ensures show/hide are only called once */
 	volatile long                   show_refs;
 
@@ -685,6 +811,17 @@ struct obs_source {
 	gs_texrender_t                  *filter_texrender;
 	enum obs_allow_direct_render    allow_direct;
 	bool                            rendering_filter;
+	gs_effect_t                     *fused_effect;
+	uint64_t                        fused_hash;
+
+	/* render cache: sources drawn more than once in the previous frame
+	 * are rendered once per frame to a texture, which is then drawn for
+	 * every reference */
+	gs_texrender_t                  *render_cache;
+	uint64_t                        render_cache_frame;
+	uint64_t                        render_count_frame;
+	uint32_t                        render_count;
+	uint32_t                        prev_render_count;
 
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id              mute_unmute_key;
@@ -729,10 +866,19 @@ struct obs_source {
 };
 
 extern struct obs_source_info *get_source_info(const char *id);
+extern struct obs_source_info *find_loaded_source(const char *id);
 extern bool obs_source_init_context(struct obs_source *source,
 		obs_data_t *settings, const char *name,
 		obs_data_t *hotkey_data, bool private);
 
+/* creation split in three steps so that the create callbacks of a scene
+ * collection can run on worker threads, see obs_load_sources */
+extern obs_source_t *obs_source_create_deferred(const char *id,
+		const char *name, obs_data_t *settings,
+		obs_data_t *hotkey_data);
+extern void *obs_source_create_data(obs_source_t *source);
+extern void obs_source_finish_create(obs_source_t *source, void *data);
+
 extern bool obs_transition_init(obs_source_t *transition);
 extern void obs_transition_free(obs_source_t *transition);
 extern void obs_transition_tick(obs_source_t *transition);
@@ -741,6 +887,30 @@ extern void obs_transition_enum_sources(obs_source_t *transition,
 extern void obs_transition_save(obs_source_t *source, obs_data_t *data);
 extern void obs_transition_load(obs_source_t *source, obs_data_t *data);
 
+/* the texture a scene batches for a source with get_sprite_texture.  counts
+ * as a render of the source, so it is the render cache while the source is
+ * shown more than once a frame */
+extern gs_texture_t *obs_source_get_sprite_texture(obs_source_t *source);
+
+static inline void hash_content(uint64_t *hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		*hash ^= bytes[i];
+		*hash *= 0x100000001b3ULL;
+	}
+}
+
+#define CONTENT_HASH_INIT 0xcbf29ce484222325ULL
+
+/* these return false if any part of the tree can change on its own, in
+ * which case the hash is meaningless */
+extern bool obs_source_hash_content(obs_source_t *source, uint64_t *hash);
+extern bool obs_scene_hash_content(obs_scene_t *scene, uint64_t *hash);
+extern bool obs_transition_hash_content(obs_source_t *transition,
+		uint64_t *hash);
+
 struct audio_monitor *audio_monitor_create(obs_source_t *source);
 void audio_monitor_reset(struct audio_monitor *monitor);
 extern void audio_monitor_destroy(struct audio_monitor *monitor);
@@ -816,6 +986,8 @@ extern void deinterlace_process_last_frame(obs_source_t *source,
 extern void deinterlace_update_async_video(obs_source_t *source);
 extern void deinterlace_render(obs_source_t *s);
 
+extern bool obs_source_render_fused_filters(obs_source_t *filter);
+
 
 /* ------------------------------------------------------------------------- */
 /* outputs  */
@@ -918,6 +1090,13 @@ struct obs_output {
 	volatile bool                   delay_capturing;
 
 	char                            *last_error_message;
+
+	obs_metric_t                    *dropped_frames_metric;
+	obs_metric_t                    *total_frames_metric;
+	obs_metric_t                    *total_bytes_metric;
+	obs_metric_t                    *congestion_metric;
+
+	const char                      *profile_latency_name;
 	char sid[64];
 	char token[64];
 	char roomid[64];
@@ -943,6 +1122,7 @@ extern void obs_output_actual_stop(obs_output_t *output, bool force,
 		uint64_t ts);
 
 extern const struct obs_output_info *find_output(const char *id);
+extern const struct obs_output_info *find_loaded_output(const char *id);
 
 extern void obs_output_remove_encoder(struct obs_output *output,
 		struct obs_encoder *encoder);
@@ -966,6 +1146,14 @@ struct encoder_callback {
 	void *param;
 };
 
+/* enough for the lookahead and b-frame delay of any common encoder */
+#define ENCODER_TRACE_FRAMES 128
+
+struct encoder_frame_trace {
+	int64_t                         pts;
+	struct video_trace              trace;
+};
+
 struct obs_encoder {
 	struct obs_context_data         context;
 	struct obs_encoder_info         info;
@@ -1025,9 +1213,15 @@ struct obs_encoder {
 	DARRAY(struct encoder_callback) callbacks;
 
 	const char                      *profile_encoder_encode_name;
+	obs_metric_t                    *encode_time_metric;
+
+	/* traces of the frames still inside the encoder, indexed by pts so
+	 * that delayed or reordered packets find the trace of their frame */
+	struct encoder_frame_trace      frame_traces[ENCODER_TRACE_FRAMES];
 };
 
 extern struct obs_encoder_info *find_encoder(const char *id);
+extern struct obs_encoder_info *find_loaded_encoder(const char *id);
 
 extern bool obs_encoder_initialize(obs_encoder_t *encoder);
 extern void obs_encoder_shutdown(obs_encoder_t *encoder);
@@ -1075,6 +1269,7 @@ struct obs_service {
 };
 
 extern const struct obs_service_info *find_service(const char *id);
+extern const struct obs_service_info *find_loaded_service(const char *id);
 
 extern void obs_service_activate(struct obs_service *service);
 extern void obs_service_deactivate(struct obs_service *service, bool remove);
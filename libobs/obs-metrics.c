@@ -0,0 +1,698 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <errno.h>
+#include <math.h>
+#include "util/dstr.h"
+#include "util/platform.h"
+#include "obs-internal.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Metrics registry
+ *
+ * Counters and gauges either hold a value that is updated by the code that
+ * owns them, or are collected through a callback when the metrics are read,
+ * which keeps statistics that are already tracked elsewhere (dropped frames,
+ * output bytes, ...) free of any extra cost.  The registry is serialized in
+ * the Prometheus text format, optionally served on a Unix domain socket.
+ */
+
+struct obs_metric {
+	enum obs_metric_type type;
+	char                 *name;
+	char                 *labels;
+	char                 *help;
+
+	obs_metric_collect_t collect;
+	void                 *param;
+
+	pthread_mutex_t      mutex;
+	double               value;
+
+	/* histograms: buckets[num_bounds] counts values above every bound */
+	double               *bounds;
+	uint64_t             *buckets;
+	size_t               num_bounds;
+	uint64_t             count;
+	double               sum;
+};
+
+static obs_metric_t *metric_create(enum obs_metric_type type,
+		const char *name, const char *labels, const char *help)
+{
+	struct obs_metric *metric;
+
+	if (!obs)
+		return NULL;
+	if (!obs_ptr_valid(name, "obs_metric_create"))
+		return NULL;
+
+	metric = bzalloc(sizeof(struct obs_metric));
+	if (pthread_mutex_init(&metric->mutex, NULL) != 0) {
+		bfree(metric);
+		return NULL;
+	}
+
+	metric->type   = type;
+	metric->name   = bstrdup(name);
+	metric->labels = bstrdup(labels);
+	metric->help   = bstrdup(help);
+	return metric;
+}
+
+static obs_metric_t *metric_register(obs_metric_t *metric)
+{
+	struct obs_core_metrics *metrics = &obs->metrics;
+
+	pthread_mutex_lock(&metrics->mutex);
+	da_push_back(metrics->metrics, &metric);
+	pthread_mutex_unlock(&metrics->mutex);
+	return metric;
+}
+
+static void metric_free(obs_metric_t *metric)
+{
+	pthread_mutex_destroy(&metric->mutex);
+	bfree(metric->name);
+	bfree(metric->labels);
+	bfree(metric->help);
+	bfree(metric->bounds);
+	bfree(metric->buckets);
+	bfree(metric);
+}
+
+obs_metric_t *obs_metric_create(enum obs_metric_type type,
+		const char *name, const char *labels, const char *help)
+{
+	obs_metric_t *metric;
+
+	if (type == OBS_METRIC_HISTOGRAM) {
+		blog(LOG_ERROR, "obs_metric_create: use "
+				"obs_metric_create_histogram for histograms");
+		return NULL;
+	}
+
+	metric = metric_create(type, name, labels, help);
+	return metric ? metric_register(metric) : NULL;
+}
+
+obs_metric_t *obs_metric_create_collected(enum obs_metric_type type,
+		const char *name, const char *labels, const char *help,
+		obs_metric_collect_t collect, void *param)
+{
+	obs_metric_t *metric;
+
+	if (type == OBS_METRIC_HISTOGRAM ||
+	    !obs_ptr_valid(collect, "obs_metric_create_collected"))
+		return NULL;
+
+	metric = metric_create(type, name, labels, help);
+	if (!metric)
+		return NULL;
+
+	metric->collect = collect;
+	metric->param   = param;
+	return metric_register(metric);
+}
+
+obs_metric_t *obs_metric_create_histogram(const char *name,
+		const char *labels, const char *help,
+		const double *bounds, size_t num_bounds)
+{
+	obs_metric_t *metric;
+
+	if (!obs_ptr_valid(bounds, "obs_metric_create_histogram") ||
+	    !num_bounds)
+		return NULL;
+
+	metric = metric_create(OBS_METRIC_HISTOGRAM, name, labels, help);
+	if (!metric)
+		return NULL;
+
+	metric->bounds = bmemdup(bounds, sizeof(double) * num_bounds);
+	metric->buckets = bzalloc(sizeof(uint64_t) * (num_bounds + 1));
+	metric->num_bounds = num_bounds;
+	return metric_register(metric);
+}
+
+void obs_metric_destroy(obs_metric_t *metric)
+{
+	if (!metric)
+		return;
+
+	if (obs) {
+		struct obs_core_metrics *metrics = &obs->metrics;
+
+		pthread_mutex_lock(&metrics->mutex);
+		da_erase_item(metrics->metrics, &metric);
+		pthread_mutex_unlock(&metrics->mutex);
+	}
+
+	metric_free(metric);
+}
+
+void obs_metric_add(obs_metric_t *metric, double val)
+{
+	if (!metric)
+		return;
+
+	pthread_mutex_lock(&metric->mutex);
+	metric->value += val;
+	pthread_mutex_unlock(&metric->mutex);
+}
+
+void obs_metric_set(obs_metric_t *metric, double val)
+{
+	if (!metric)
+		return;
+
+	pthread_mutex_lock(&metric->mutex);
+	metric->value = val;
+	pthread_mutex_unlock(&metric->mutex);
+}
+
+void obs_metric_observe(obs_metric_t *metric, double val)
+{
+	size_t idx = 0;
+
+	if (!metric || metric->type != OBS_METRIC_HISTOGRAM)
+		return;
+
+	while (idx < metric->num_bounds && val > metric->bounds[idx])
+		idx++;
+
+	pthread_mutex_lock(&metric->mutex);
+	metric->buckets[idx]++;
+	metric->count++;
+	metric->sum += val;
+	pthread_mutex_unlock(&metric->mutex);
+}
+
+void obs_metric_label(struct dstr *labels, const char *name,
+		const char *value)
+{
+	if (!dstr_is_empty(labels))
+		dstr_cat_ch(labels, ',');
+
+	dstr_cat(labels, name);
+	dstr_cat(labels, "=\"");
+
+	for (; value && *value; value++) {
+		if (*value == '\\' || *value == '"')
+			dstr_cat_ch(labels, '\\');
+		if (*value == '\n')
+			dstr_cat(labels, "\\n");
+		else
+			dstr_cat_ch(labels, *value);
+	}
+
+	dstr_cat_ch(labels, '"');
+}
+
+/* ------------------------------------------------------------------------- */
+/* Prometheus text format */
+
+static const char *metric_type_name(enum obs_metric_type type)
+{
+	switch (type) {
+	case OBS_METRIC_COUNTER:   return "counter";
+	case OBS_METRIC_GAUGE:     return "gauge";
+	case OBS_METRIC_HISTOGRAM: return "histogram";
+	}
+
+	return "untyped";
+}
+
+static void cat_value(struct dstr *out, double val)
+{
+	if (isnan(val))
+		dstr_cat(out, "NaN");
+	else if (isinf(val))
+		dstr_cat(out, val > 0.0 ? "+Inf" : "-Inf");
+	else
+		dstr_catf(out, "%.15g", val);
+}
+
+static void cat_sample(struct dstr *out, const obs_metric_t *metric,
+		const char *suffix, const char *extra_label, double val)
+{
+	bool has_labels = metric->labels && *metric->labels;
+
+	dstr_cat(out, metric->name);
+	dstr_cat(out, suffix);
+
+	if (has_labels || extra_label) {
+		dstr_cat_ch(out, '{');
+		if (has_labels)
+			dstr_cat(out, metric->labels);
+		if (has_labels && extra_label)
+			dstr_cat_ch(out, ',');
+		if (extra_label)
+			dstr_cat(out, extra_label);
+		dstr_cat_ch(out, '}');
+	}
+
+	dstr_cat_ch(out, ' ');
+	cat_value(out, val);
+	dstr_cat_ch(out, '\n');
+}
+
+static void cat_histogram(struct dstr *out, obs_metric_t *metric)
+{
+	struct dstr le = {0};
+	uint64_t total = 0;
+
+	pthread_mutex_lock(&metric->mutex);
+
+	for (size_t i = 0; i < metric->num_bounds; i++) {
+		total += metric->buckets[i];
+
+		dstr_copy(&le, "le=\"");
+		cat_value(&le, metric->bounds[i]);
+		dstr_cat_ch(&le, '"');
+		cat_sample(out, metric, "_bucket", le.array, (double)total);
+	}
+
+	cat_sample(out, metric, "_bucket", "le=\"+Inf\"",
+			(double)metric->count);
+	cat_sample(out, metric, "_sum", NULL, metric->sum);
+	cat_sample(out, metric, "_count", NULL, (double)metric->count);
+
+	pthread_mutex_unlock(&metric->mutex);
+	dstr_free(&le);
+}
+
+static void cat_metric(struct dstr *out, obs_metric_t *metric)
+{
+	double val;
+
+	if (metric->type == OBS_METRIC_HISTOGRAM) {
+		cat_histogram(out, metric);
+		return;
+	}
+
+	if (metric->collect) {
+		val = metric->collect(metric->param);
+	} else {
+		pthread_mutex_lock(&metric->mutex);
+		val = metric->value;
+		pthread_mutex_unlock(&metric->mutex);
+	}
+
+	cat_sample(out, metric, "", NULL, val);
+}
+
+/* metrics that share a name are written together under a single HELP/TYPE
+ * header, in the order the first of them was registered */
+static void build_metrics_text(struct dstr *out)
+{
+	struct obs_core_metrics *metrics = &obs->metrics;
+
+	pthread_mutex_lock(&metrics->mutex);
+
+	for (size_t i = 0; i < metrics->metrics.num; i++) {
+		obs_metric_t *metric = metrics->metrics.array[i];
+		bool written = false;
+
+		for (size_t j = 0; j < i && !written; j++)
+			written = strcmp(metrics->metrics.array[j]->name,
+					metric->name) == 0;
+		if (written)
+			continue;
+
+		if (metric->help && *metric->help)
+			dstr_catf(out, "# HELP %s %s\n", metric->name,
+					metric->help);
+		dstr_catf(out, "# TYPE %s %s\n", metric->name,
+				metric_type_name(metric->type));
+
+		for (size_t j = i; j < metrics->metrics.num; j++) {
+			obs_metric_t *other = metrics->metrics.array[j];
+			if (strcmp(other->name, metric->name) == 0)
+				cat_metric(out, other);
+		}
+	}
+
+	pthread_mutex_unlock(&metrics->mutex);
+}
+
+char *obs_metrics_get_text(void)
+{
+	struct dstr out = {0};
+
+	if (!obs)
+		return NULL;
+
+	build_metrics_text(&out);
+	if (!out.array)
+		dstr_copy(&out, "");
+	return out.array;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Socket server */
+
+#ifndef _WIN32
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define METRICS_REQUEST_TIMEOUT_MS 100
+#define METRICS_POLL_INTERVAL_MS   250
+
+static void send_all(int fd, const char *data, size_t size)
+{
+	while (size) {
+		ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+		if (sent <= 0)
+			return;
+
+		data += sent;
+		size -= (size_t)sent;
+	}
+}
+
+/* HTTP clients (Prometheus itself, or curl --unix-socket) get a response
+ * header; anything else, such as socat or nc -U, just receives the text */
+static void serve_client(int fd)
+{
+	struct pollfd pfd = {fd, POLLIN, 0};
+	struct dstr text = {0};
+	char request[512];
+	ssize_t len = 0;
+
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+	if (poll(&pfd, 1, METRICS_REQUEST_TIMEOUT_MS) > 0)
+		len = recv(fd, request, sizeof(request), 0);
+
+	build_metrics_text(&text);
+
+	if (len >= 4 && strncmp(request, "GET ", 4) == 0) {
+		char header[192];
+		int header_len = snprintf(header, sizeof(header),
+				"HTTP/1.0 200 OK\r\n"
+				"Content-Type: text/plain; version=0.0.4\r\n"
+				"Content-Length: %u\r\n"
+				"Connection: close\r\n\r\n",
+				(unsigned)text.len);
+		send_all(fd, header, (size_t)header_len);
+	}
+
+	if (text.len)
+		send_all(fd, text.array, text.len);
+	dstr_free(&text);
+}
+
+static void *metrics_server_thread(void *param)
+{
+	struct obs_core_metrics *metrics = param;
+
+	os_set_thread_name("libobs: metrics server");
+
+	while (!os_atomic_load_bool(&metrics->server_stopping)) {
+		struct pollfd pfd = {metrics->server_fd, POLLIN, 0};
+		int client;
+
+		if (poll(&pfd, 1, METRICS_POLL_INTERVAL_MS) <= 0)
+			continue;
+
+		client = accept(metrics->server_fd, NULL, NULL);
+		if (client < 0)
+			continue;
+
+		serve_client(client);
+		close(client);
+	}
+
+	return NULL;
+}
+
+/* only ever removes a socket, never a file that happens to be in the way */
+static void unlink_socket(const char *path)
+{
+	struct stat st;
+
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+}
+
+bool obs_metrics_start_server(const char *path)
+{
+	struct obs_core_metrics *metrics;
+	struct sockaddr_un addr;
+	int fd;
+
+	if (!obs || !obs_ptr_valid(path, "obs_metrics_start_server"))
+		return false;
+
+	metrics = &obs->metrics;
+	obs_metrics_stop_server();
+
+	memset(&addr, 0, sizeof(addr));
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		blog(LOG_WARNING, "Metrics socket path is too long: %s", path);
+		return false;
+	}
+
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		blog(LOG_WARNING, "Failed to create metrics socket: %s",
+				strerror(errno));
+		return false;
+	}
+
+	unlink_socket(path);
+
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+	    chmod(path, 0600) != 0 ||
+	    listen(fd, 4) != 0) {
+		blog(LOG_WARNING, "Failed to listen on metrics socket "
+				"'%s': %s", path, strerror(errno));
+		close(fd);
+		unlink_socket(path);
+		return false;
+	}
+
+	metrics->server_fd = fd;
+	metrics->server_stopping = false;
+
+	if (pthread_create(&metrics->server_thread, NULL,
+				metrics_server_thread, metrics) != 0) {
+		blog(LOG_WARNING, "Failed to create metrics server thread");
+		close(fd);
+		unlink_socket(path);
+		return false;
+	}
+
+	metrics->server_path = bstrdup(path);
+	metrics->server_active = true;
+
+	blog(LOG_INFO, "Serving metrics on '%s'", path);
+	return true;
+}
+
+void obs_metrics_stop_server(void)
+{
+	struct obs_core_metrics *metrics;
+
+	if (!obs || !obs->metrics.server_active)
+		return;
+
+	metrics = &obs->metrics;
+	os_atomic_set_bool(&metrics->server_stopping, true);
+	pthread_join(metrics->server_thread, NULL);
+
+	close(metrics->server_fd);
+	unlink_socket(metrics->server_path);
+
+	bfree(metrics->server_path);
+	metrics->server_path = NULL;
+	metrics->server_active = false;
+}
+
+#else
+
+bool obs_metrics_start_server(const char *path)
+{
+	blog(LOG_WARNING, "Serving metrics is not supported on this "
+			"platform (%s)", path);
+	return false;
+}
+
+void obs_metrics_stop_server(void)
+{
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Core metrics */
+
+static const double frame_time_bounds[] = {
+	0.001, 0.002, 0.004, 0.008, 0.012, 0.016, 0.025, 0.033, 0.05, 0.1
+};
+
+static double get_allocs(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)bnum_allocs();
+}
+
+static double get_resident_size(void *param)
+{
+	UNUSED_PARAMETER(param);
+#ifdef __linux__
+	/* statm reports pages on linux */
+	return (double)os_get_proc_resident_size() *
+		(double)sysconf(_SC_PAGESIZE);
+#else
+	return (double)os_get_proc_resident_size();
+#endif
+}
+
+static double get_audio_buffering(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->audio.total_buffering_ticks;
+}
+
+bool obs_init_metrics(void)
+{
+	struct obs_core_metrics *metrics = &obs->metrics;
+
+	if (pthread_mutex_init(&metrics->mutex, NULL) != 0)
+		return false;
+
+	metrics->allocs_metric = obs_metric_create_collected(
+			OBS_METRIC_GAUGE, "obs_memory_allocations", NULL,
+			"Number of live libobs heap allocations",
+			get_allocs, NULL);
+	metrics->resident_size_metric = obs_metric_create_collected(
+			OBS_METRIC_GAUGE, "obs_process_resident_memory_bytes",
+			NULL, "Resident memory size of the process",
+			get_resident_size, NULL);
+	metrics->audio_buffering_metric = obs_metric_create_collected(
+			OBS_METRIC_GAUGE, "obs_audio_buffering_ticks", NULL,
+			"Audio buffering, in ticks of 1024 samples",
+			get_audio_buffering, NULL);
+	return true;
+}
+
+void obs_free_metrics(void)
+{
+	struct obs_core_metrics *metrics = &obs->metrics;
+
+	obs_metrics_stop_server();
+
+	obs_metric_destroy(metrics->allocs_metric);
+	obs_metric_destroy(metrics->resident_size_metric);
+	obs_metric_destroy(metrics->audio_buffering_metric);
+
+	/* any other metric is owned by an object that outlived libobs */
+	if (metrics->metrics.num)
+		blog(LOG_WARNING, "%u metrics were never destroyed",
+				(unsigned)metrics->metrics.num);
+
+	da_free(metrics->metrics);
+	pthread_mutex_destroy(&metrics->mutex);
+}
+
+static double get_rendered_frames(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->video.total_frames;
+}
+
+static double get_lagged_frames(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)obs->video.lagged_frames;
+}
+
+static double get_output_frames(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)video_output_get_total_frames(obs->video.video);
+}
+
+static double get_skipped_frames(void *param)
+{
+	UNUSED_PARAMETER(param);
+	return (double)video_output_get_skipped_frames(obs->video.video);
+}
+
+/* the video metrics are destroyed before the video output is closed, and
+ * the registry lock keeps the output alive while they are being read */
+void obs_init_video_metrics(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	video->frame_time_metric = obs_metric_create_histogram(
+			"obs_video_frame_render_seconds", NULL,
+			"Time spent rendering each frame",
+			frame_time_bounds,
+			sizeof(frame_time_bounds) / sizeof(double));
+	video->frames_metric = obs_metric_create_collected(
+			OBS_METRIC_COUNTER, "obs_video_rendered_frames_total",
+			NULL, "Frames rendered by the graphics thread",
+			get_rendered_frames, NULL);
+	video->lagged_frames_metric = obs_metric_create_collected(
+			OBS_METRIC_COUNTER, "obs_video_lagged_frames_total",
+			NULL, "Frames missed due to rendering lag",
+			get_lagged_frames, NULL);
+	video->output_frames_metric = obs_metric_create_collected(
+			OBS_METRIC_COUNTER, "obs_video_output_frames_total",
+			NULL, "Frames sent to the video output",
+			get_output_frames, NULL);
+	video->skipped_frames_metric = obs_metric_create_collected(
+			OBS_METRIC_COUNTER, "obs_video_skipped_frames_total",
+			NULL, "Frames skipped due to encoding lag",
+			get_skipped_frames, NULL);
+}
+
+void obs_free_video_metrics(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	obs_metric_destroy(video->frame_time_metric);
+	obs_metric_destroy(video->frames_metric);
+	obs_metric_destroy(video->lagged_frames_metric);
+	obs_metric_destroy(video->output_frames_metric);
+	obs_metric_destroy(video->skipped_frames_metric);
+
+	video->frame_time_metric     = NULL;
+	video->frames_metric         = NULL;
+	video->lagged_frames_metric  = NULL;
+	video->output_frames_metric  = NULL;
+	video->skipped_frames_metric = NULL;
+}
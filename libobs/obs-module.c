@@ -15,6 +15,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <sys/stat.h>
+
 #include "util/platform.h"
 #include "util/dstr.h"
 
@@ -113,14 +115,19 @@ int obs_open_module(obs_module_t **module, const char *path,
 	mod.file      = (!mod.file) ? mod.bin_path : (mod.file + 1);
 	mod.mod_name  = get_module_name(mod.file);
 	mod.data_path = bstrdup(data_path);
-	mod.next      = obs->first_module;
 
 	if (mod.file) {
 		blog(LOG_DEBUG, "Loading module: %s", mod.file);
 	}
 
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	mod.next = obs->first_module;
 	*module = bmemdup(&mod, sizeof(mod));
 	obs->first_module = (*module);
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+
 	mod.set_pointer(*module);
 
 	if (mod.set_locale)
@@ -131,6 +138,9 @@ int obs_open_module(obs_module_t **module, const char *path,
 
 bool obs_init_module(obs_module_t *module)
 {
+	struct obs_module *prev_loading;
+	uint64_t start;
+
 	if (!module || !obs)
 		return false;
 	if (module->loaded)
@@ -141,7 +151,19 @@ bool obs_init_module(obs_module_t *module)
 				"obs_init_module(%s)", module->file);
 	profile_start(profile_name);
 
+	/* a deferred module can be loaded from within another module's
+	 * obs_module_load, so the previous one is restored afterwards */
+	pthread_mutex_lock(&obs->module_load_mutex);
+	prev_loading = obs->loading_module;
+	obs->loading_module = module;
+	start = os_gettime_ns();
+
 	module->loaded = module->load();
+
+	module->load_ns = os_gettime_ns() - start;
+	obs->loading_module = prev_loading;
+	pthread_mutex_unlock(&obs->module_load_mutex);
+
 	if (!module->loaded)
 		blog(LOG_WARNING, "Failed to initialize module '%s'",
 				module->file);
@@ -152,10 +174,23 @@ bool obs_init_module(obs_module_t *module)
 
 void obs_log_loaded_modules(void)
 {
+	pthread_mutex_lock(&obs->modules_mutex);
+
 	blog(LOG_INFO, "  Loaded Modules:");
 
 	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
 		blog(LOG_INFO, "    %s", mod->file);
+
+	if (obs->deferred_modules.num)
+		blog(LOG_INFO, "  Deferred Modules:");
+
+	for (size_t i = 0; i < obs->deferred_modules.num; i++) {
+		const char *path = obs->deferred_modules.array[i].bin_path;
+		const char *file = strrchr(path, '/');
+		blog(LOG_INFO, "    %s", file ? file + 1 : path);
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
 }
 
 const char *obs_get_module_file_name(obs_module_t *module)
@@ -233,9 +268,294 @@ void obs_add_module_path(const char *bin, const char *data)
 	da_push_back(obs->module_paths, &omp);
 }
 
+/* ------------------------------------------------------------------------- */
+/* module manifest */
+
+/*
+ * The module manifest lists the types each module registered the last time
+ * it was loaded, keyed by the module's binary path.  Entries are only trusted
+ * while the size and modification time of the binary are unchanged.  Modules
+ * that registered UI callbacks or no types at all are never deferred, as they
+ * cannot be loaded on demand by a type lookup.
+ */
+
+#define MODULE_MANIFEST_FILE "module-manifest.json"
+
+static const char *manifest_type_keys[OBS_TYPE_CLASS_COUNT] = {
+	"sources",
+	"outputs",
+	"encoders",
+	"services"
+};
+
+static const char *type_class_names[OBS_TYPE_CLASS_COUNT] = {
+	"source",
+	"output",
+	"encoder",
+	"service"
+};
+
+struct module_scan {
+	obs_data_t *old_modules;
+	obs_data_t *modules;
+	size_t     num_cached;
+	bool       dirty;
+};
+
+static inline double ns_to_ms(uint64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+void obs_set_lazy_module_loading(bool enable)
+{
+	if (obs)
+		obs->lazy_modules = enable;
+}
+
+void obs_module_add_type(enum obs_type_class cls, const char *id)
+{
+	struct obs_module *mod = obs->loading_module;
+	char *copy;
+
+	if (!mod || !id)
+		return;
+
+	copy = bstrdup(id);
+	da_push_back(mod->types[cls], &copy);
+}
+
+static void free_type_ids(struct darray *ids)
+{
+	char **array = ids->array;
+
+	for (size_t i = 0; i < ids->num; i++)
+		bfree(array[i]);
+	darray_free(ids);
+}
+
+void free_deferred_module(struct obs_deferred_module *mod)
+{
+	for (size_t cls = 0; cls < OBS_TYPE_CLASS_COUNT; cls++)
+		free_type_ids(&mod->types[cls].da);
+	bfree(mod->bin_path);
+	bfree(mod->data_path);
+}
+
+static char *get_module_manifest_path(void)
+{
+	struct dstr path = {0};
+
+	if (!obs->module_config_path)
+		return NULL;
+
+	dstr_copy(&path, obs->module_config_path);
+	if (!dstr_is_empty(&path) && dstr_end(&path) != '/')
+		dstr_cat_ch(&path, '/');
+	dstr_cat(&path, MODULE_MANIFEST_FILE);
+	return path.array;
+}
+
+static obs_data_t *load_module_manifest(const char *path)
+{
+	obs_data_t *manifest = obs_data_create_from_json_file_safe(path, "bak");
+	obs_data_t *modules = NULL;
+
+	if (!manifest)
+		return NULL;
+
+	if (obs_data_get_int(manifest, "api_version") == LIBOBS_API_VER)
+		modules = obs_data_get_obj(manifest, "modules");
+
+	obs_data_release(manifest);
+	return modules;
+}
+
+static void save_module_manifest(const char *path, obs_data_t *modules)
+{
+	obs_data_t *manifest = obs_data_create();
+
+	obs_data_set_int(manifest, "api_version", LIBOBS_API_VER);
+	obs_data_set_obj(manifest, "modules", modules);
+
+	os_mkdirs(obs->module_config_path);
+	if (!obs_data_save_json_safe(manifest, path, "tmp", "bak"))
+		blog(LOG_WARNING, "Failed to save module manifest '%s'", path);
+
+	obs_data_release(manifest);
+}
+
+static size_t count_manifest_entries(obs_data_t *modules)
+{
+	obs_data_item_t *item = obs_data_first(modules);
+	size_t count = 0;
+
+	for (; item != NULL; obs_data_item_next(&item))
+		count++;
+
+	return count;
+}
+
+static inline bool manifest_entry_valid(obs_data_t *entry,
+		const struct stat *st)
+{
+	return obs_data_get_bool(entry, "deferrable") &&
+	       obs_data_get_int(entry, "size") == (long long)st->st_size &&
+	       obs_data_get_int(entry, "mtime") == (long long)st->st_mtime;
+}
+
+static bool defer_module(struct module_scan *scan,
+		const struct obs_module_info *info, obs_data_t *entry)
+{
+	struct obs_deferred_module mod = {0};
+	size_t count = 0;
+
+	for (size_t cls = 0; cls < OBS_TYPE_CLASS_COUNT; cls++) {
+		obs_data_array_t *ids = obs_data_get_array(entry,
+				manifest_type_keys[cls]);
+		size_t num = obs_data_array_count(ids);
+
+		for (size_t i = 0; i < num; i++) {
+			obs_data_t *item = obs_data_array_item(ids, i);
+			const char *id = obs_data_get_string(item, "id");
+
+			if (*id) {
+				char *copy = bstrdup(id);
+				da_push_back(mod.types[cls], &copy);
+			}
+
+			obs_data_release(item);
+		}
+
+		count += mod.types[cls].num;
+		obs_data_array_release(ids);
+	}
+
+	if (!count) {
+		free_deferred_module(&mod);
+		return false;
+	}
+
+	mod.bin_path  = bstrdup(info->bin_path);
+	mod.data_path = bstrdup(info->data_path);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+	da_push_back(obs->deferred_modules, &mod);
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return true;
+}
+
+static bool defer_cached_module(struct module_scan *scan,
+		const struct obs_module_info *info, const struct stat *st)
+{
+	obs_data_t *entry = obs_data_get_obj(scan->old_modules,
+			info->bin_path);
+	bool deferred = false;
+
+	if (entry && manifest_entry_valid(entry, st) &&
+	    defer_module(scan, info, entry)) {
+		obs_data_set_obj(scan->modules, info->bin_path, entry);
+		scan->num_cached++;
+		deferred = true;
+	}
+
+	obs_data_release(entry);
+	return deferred;
+}
+
+static void add_manifest_entry(struct module_scan *scan,
+		struct obs_module *mod, const struct stat *st)
+{
+	obs_data_t *entry = obs_data_create();
+	size_t count = 0;
+
+	obs_data_set_int(entry, "size", (long long)st->st_size);
+	obs_data_set_int(entry, "mtime", (long long)st->st_mtime);
+
+	for (size_t cls = 0; cls < OBS_TYPE_CLASS_COUNT; cls++) {
+		obs_data_array_t *ids = obs_data_array_create();
+
+		for (size_t i = 0; i < mod->types[cls].num; i++) {
+			obs_data_t *item = obs_data_create();
+			obs_data_set_string(item, "id",
+					mod->types[cls].array[i]);
+			obs_data_array_push_back(ids, item);
+			obs_data_release(item);
+		}
+
+		count += mod->types[cls].num;
+		obs_data_set_array(entry, manifest_type_keys[cls], ids);
+		obs_data_array_release(ids);
+	}
+
+	obs_data_set_bool(entry, "deferrable",
+			mod->loaded && count && !mod->registers_ui);
+
+	obs_data_set_obj(scan->modules, mod->bin_path, entry);
+	obs_data_release(entry);
+	scan->dirty = true;
+}
+
+static int cmp_module_load_time(const void *a, const void *b)
+{
+	const struct obs_module *mod_a = *(const struct obs_module**)a;
+	const struct obs_module *mod_b = *(const struct obs_module**)b;
+	uint64_t time_a = mod_a->open_ns + mod_a->load_ns;
+	uint64_t time_b = mod_b->open_ns + mod_b->load_ns;
+
+	return (time_a < time_b) ? 1 : ((time_a > time_b) ? -1 : 0);
+}
+
+static void log_module_load_times(uint64_t total_ns)
+{
+	DARRAY(struct obs_module*) modules = {0};
+	size_t num_deferred;
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
+		da_push_back(modules, &mod);
+	num_deferred = obs->deferred_modules.num;
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+
+	qsort(modules.array, modules.num, sizeof(struct obs_module*),
+			cmp_module_load_time);
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Module loading took %.2f ms:", ns_to_ms(total_ns));
+
+	for (size_t i = 0; i < modules.num; i++) {
+		struct obs_module *mod = modules.array[i];
+		blog(LOG_INFO, "    %-32s open: %8.2f ms, load: %8.2f ms",
+				mod->file, ns_to_ms(mod->open_ns),
+				ns_to_ms(mod->load_ns));
+	}
+
+	if (num_deferred)
+		blog(LOG_INFO, "    %d module(s) deferred until first use",
+				(int)num_deferred);
+
+	da_free(modules);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static void load_all_callback(void *param, const struct obs_module_info *info)
 {
+	struct module_scan *scan = param;
 	obs_module_t *module;
+	struct stat st;
+	bool have_stat = false;
+	uint64_t start;
+
+	if (scan->modules) {
+		have_stat = os_stat(info->bin_path, &st) == 0;
+		if (have_stat && defer_cached_module(scan, info, &st))
+			return;
+	}
+
+	start = os_gettime_ns();
 
 	int code = obs_open_module(&module, info->bin_path, info->data_path);
 	if (code != MODULE_SUCCESS) {
@@ -244,9 +564,11 @@ static void load_all_callback(void *param, const struct obs_module_info *info)
 		return;
 	}
 
+	module->open_ns = os_gettime_ns() - start;
 	obs_init_module(module);
 
-	UNUSED_PARAMETER(param);
+	if (scan->modules && have_stat)
+		add_manifest_entry(scan, module, &st);
 }
 
 static const char *obs_load_all_modules_name = "obs_load_all_modules";
@@ -256,21 +578,200 @@ static const char *reset_win32_symbol_paths_name = "reset_win32_symbol_paths";
 
 void obs_load_all_modules(void)
 {
+	struct module_scan scan = {0};
+	char *manifest_path = NULL;
+	uint64_t start = os_gettime_ns();
+
 	profile_start(obs_load_all_modules_name);
-	obs_find_modules(load_all_callback, NULL);
+
+	if (obs->lazy_modules)
+		manifest_path = get_module_manifest_path();
+	if (manifest_path) {
+		scan.old_modules = load_module_manifest(manifest_path);
+		scan.modules = obs_data_create();
+	}
+
+	obs_find_modules(load_all_callback, &scan);
 #ifdef _WIN32
 	profile_start(reset_win32_symbol_paths_name);
+	pthread_mutex_lock(&obs->modules_mutex);
 	reset_win32_symbol_paths();
+	pthread_mutex_unlock(&obs->modules_mutex);
 	profile_end(reset_win32_symbol_paths_name);
 #endif
+
+	if (scan.modules && (scan.dirty || scan.num_cached !=
+				count_manifest_entries(scan.old_modules)))
+		save_module_manifest(manifest_path, scan.modules);
+
 	profile_end(obs_load_all_modules_name);
+
+	log_module_load_times(os_gettime_ns() - start);
+
+	obs_data_release(scan.old_modules);
+	obs_data_release(scan.modules);
+	bfree(manifest_path);
 }
 
 void obs_post_load_modules(void)
 {
-	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
+	obs_module_t *first;
+
+	/* held throughout so that a module loaded on demand meanwhile gets
+	 * its post_load called exactly once */
+	pthread_mutex_lock(&obs->module_load_mutex);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+	first = obs->first_module;
+	pthread_mutex_unlock(&obs->modules_mutex);
+
+	for (obs_module_t *mod = first; !!mod; mod = mod->next)
 		if (mod->post_load)
 			mod->post_load();
+
+	obs->modules_post_loaded = true;
+	pthread_mutex_unlock(&obs->module_load_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* deferred module loading */
+
+/* must be called with obs->modules_mutex held */
+static size_t find_deferred_module(enum obs_type_class cls, const char *id)
+{
+	for (size_t i = 0; i < obs->deferred_modules.num; i++) {
+		struct obs_deferred_module *mod = obs->deferred_modules.array+i;
+
+		for (size_t j = 0; j < mod->types[cls].num; j++) {
+			if (!id || strcmp(mod->types[cls].array[j], id) == 0)
+				return i;
+		}
+	}
+
+	return DARRAY_INVALID;
+}
+
+/* the module is taken off the list before it is loaded, as it can look up
+ * types of other deferred modules from its obs_module_load */
+static bool take_deferred_module(enum obs_type_class cls, const char *id,
+		struct obs_deferred_module *mod)
+{
+	size_t idx;
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	idx = find_deferred_module(cls, id);
+	if (idx != DARRAY_INVALID) {
+		*mod = obs->deferred_modules.array[idx];
+		da_erase(obs->deferred_modules, idx);
+		obs->deferred_loading++;
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return idx != DARRAY_INVALID;
+}
+
+/* must be called with obs->module_load_mutex held */
+static void load_deferred_module(struct obs_deferred_module *mod,
+		enum obs_type_class cls, const char *id)
+{
+	obs_module_t *module;
+	uint64_t start = os_gettime_ns();
+	int code;
+
+	code = obs_open_module(&module, mod->bin_path, mod->data_path);
+	if (code != MODULE_SUCCESS) {
+		blog(LOG_WARNING, "Failed to load deferred module '%s': %d",
+				mod->bin_path, code);
+		goto finish;
+	}
+
+	module->open_ns = os_gettime_ns() - start;
+	obs_init_module(module);
+
+	if (obs->modules_post_loaded && module->post_load)
+		module->post_load();
+
+#ifdef _WIN32
+	pthread_mutex_lock(&obs->modules_mutex);
+	reset_win32_symbol_paths();
+	pthread_mutex_unlock(&obs->modules_mutex);
+#endif
+
+	if (id)
+		blog(LOG_INFO, "Loaded deferred module '%s' for %s '%s' "
+				"in %.2f ms", module->file,
+				type_class_names[cls], id,
+				ns_to_ms(os_gettime_ns() - start));
+	else
+		blog(LOG_INFO, "Loaded deferred module '%s' to enumerate "
+				"%s types in %.2f ms", module->file,
+				type_class_names[cls],
+				ns_to_ms(os_gettime_ns() - start));
+
+finish:
+	pthread_mutex_lock(&obs->modules_mutex);
+	obs->deferred_loading--;
+	pthread_mutex_unlock(&obs->modules_mutex);
+
+	free_deferred_module(mod);
+}
+
+bool obs_load_deferred_module(enum obs_type_class cls, const char *id)
+{
+	struct obs_deferred_module mod;
+	bool wait;
+
+	if (!obs || !id)
+		return false;
+
+	/* module_load_mutex is only taken if a deferred module provides the
+	 * type, or another thread may be registering it right now */
+	pthread_mutex_lock(&obs->modules_mutex);
+	wait = obs->deferred_loading > 0 ||
+		find_deferred_module(cls, id) != DARRAY_INVALID;
+	pthread_mutex_unlock(&obs->modules_mutex);
+
+	if (wait) {
+		pthread_mutex_lock(&obs->module_load_mutex);
+
+		if (take_deferred_module(cls, id, &mod))
+			load_deferred_module(&mod, cls, id);
+
+		pthread_mutex_unlock(&obs->module_load_mutex);
+	}
+
+	/* the module may also have finished loading on another thread after
+	 * the lookup failed */
+	return wait || obs->lazy_modules;
+}
+
+void obs_load_deferred_modules(enum obs_type_class cls)
+{
+	struct obs_deferred_module mod;
+
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->module_load_mutex);
+
+	while (take_deferred_module(cls, NULL, &mod))
+		load_deferred_module(&mod, cls, NULL);
+
+	pthread_mutex_unlock(&obs->module_load_mutex);
+}
+
+bool obs_have_deferred_modules(void)
+{
+	bool deferred;
+
+	if (!obs)
+		return false;
+
+	pthread_mutex_lock(&obs->modules_mutex);
+	deferred = obs->deferred_modules.num > 0 || obs->deferred_loading > 0;
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return deferred;
 }
 
 static inline void make_data_dir(struct dstr *parsed_data_dir,
@@ -427,7 +928,12 @@ void obs_enum_modules(obs_enum_module_callback_t callback, void *param)
 	if (!obs)
 		return;
 
+	/* modules are only ever added to the front of the list, so the rest
+	 * of it can be walked without holding the lock */
+	pthread_mutex_lock(&obs->modules_mutex);
 	module = obs->first_module;
+	pthread_mutex_unlock(&obs->modules_mutex);
+
 	while (module) {
 		callback(param, module);
 		module = module->next;
@@ -451,6 +957,9 @@ void free_module(struct obs_module *mod)
 		/* os_dlclose(mod->module); */
 	}
 
+	for (size_t cls = 0; cls < OBS_TYPE_CLASS_COUNT; cls++)
+		free_type_ids(&mod->types[cls].da);
+
 	bfree(mod->mod_name);
 	bfree(mod->bin_path);
 	bfree(mod->data_path);
@@ -506,6 +1015,7 @@ cleanup:
 #define REGISTER_OBS_DEF(size_var, structure, dest, info)                 \
 	do {                                                              \
 		struct structure data = {0};                              \
+		struct structure *item;                                   \
 		if (!size_var) {                                          \
 			blog(LOG_ERROR, "Tried to register " #structure   \
 			               " outside of obs_module_load");    \
@@ -523,7 +1033,8 @@ cleanup:
 		}                                                         \
                                                                           \
 		memcpy(&data, info, size_var);                            \
-		da_push_back(dest, &data);                                \
+		item = bmemdup(&data, sizeof(data));                      \
+		da_push_back(dest, &item);                                \
 	} while (false)
 
 #define CHECK_REQUIRED_VAL(type, info, val, func) \
@@ -559,9 +1070,10 @@ cleanup:
 #define service_warn(format, ...) \
 	blog(LOG_WARNING, "obs_register_service: " format, ##__VA_ARGS__)
 
-void obs_register_source_s(const struct obs_source_info *info, size_t size)
+static void register_source(const struct obs_source_info *info, size_t size)
 {
 	struct obs_source_info data = {0};
+	struct obs_source_info *item;
 	struct darray *array = NULL;
 
 	if (info->type == OBS_SOURCE_TYPE_INPUT) {
@@ -576,7 +1088,7 @@ void obs_register_source_s(const struct obs_source_info *info, size_t size)
 		goto error;
 	}
 
-	if (get_source_info(info->id)) {
+	if (find_loaded_source(info->id)) {
 		source_warn("Source '%s' already exists!  "
 		                  "Duplicate library?", info->id);
 		goto error;
@@ -643,18 +1155,27 @@ void obs_register_source_s(const struct obs_source_info *info, size_t size)
 		goto error;
 	}
 
+	item = bmemdup(&data, sizeof(data));
 	if (array)
-		darray_push_back(sizeof(struct obs_source_info), array, &data);
-	da_push_back(obs->source_types, &data);
+		darray_push_back(sizeof(struct obs_source_info*), array, &item);
+	da_push_back(obs->source_types, &item);
+	obs_module_add_type(OBS_TYPE_CLASS_SOURCE, data.id);
 	return;
 
 error:
 	HANDLE_ERROR(size, obs_source_info, info);
 }
 
-void obs_register_output_s(const struct obs_output_info *info, size_t size)
+void obs_register_source_s(const struct obs_source_info *info, size_t size)
 {
-	if (find_output(info->id)) {
+	pthread_mutex_lock(&obs->modules_mutex);
+	register_source(info, size);
+	pthread_mutex_unlock(&obs->modules_mutex);
+}
+
+static void register_output(const struct obs_output_info *info, size_t size)
+{
+	if (find_loaded_output(info->id)) {
 		output_warn("Output id '%s' already exists!  "
 		                  "Duplicate library?", info->id);
 		goto error;
@@ -688,15 +1209,23 @@ void obs_register_output_s(const struct obs_output_info *info, size_t size)
 #undef CHECK_REQUIRED_VAL_
 
 	REGISTER_OBS_DEF(size, obs_output_info, obs->output_types, info);
+	obs_module_add_type(OBS_TYPE_CLASS_OUTPUT, info->id);
 	return;
 
 error:
 	HANDLE_ERROR(size, obs_output_info, info);
 }
 
-void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
+void obs_register_output_s(const struct obs_output_info *info, size_t size)
+{
+	pthread_mutex_lock(&obs->modules_mutex);
+	register_output(info, size);
+	pthread_mutex_unlock(&obs->modules_mutex);
+}
+
+static void register_encoder(const struct obs_encoder_info *info, size_t size)
 {
-	if (find_encoder(info->id)) {
+	if (find_loaded_encoder(info->id)) {
 		encoder_warn("Encoder id '%s' already exists!  "
 		                  "Duplicate library?", info->id);
 		goto error;
@@ -718,15 +1247,23 @@ void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
 #undef CHECK_REQUIRED_VAL_
 
 	REGISTER_OBS_DEF(size, obs_encoder_info, obs->encoder_types, info);
+	obs_module_add_type(OBS_TYPE_CLASS_ENCODER, info->id);
 	return;
 
 error:
 	HANDLE_ERROR(size, obs_encoder_info, info);
 }
 
-void obs_register_service_s(const struct obs_service_info *info, size_t size)
+void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
 {
-	if (find_service(info->id)) {
+	pthread_mutex_lock(&obs->modules_mutex);
+	register_encoder(info, size);
+	pthread_mutex_unlock(&obs->modules_mutex);
+}
+
+static void register_service(const struct obs_service_info *info, size_t size)
+{
+	if (find_loaded_service(info->id)) {
 		service_warn("Service id '%s' already exists!  "
 		                  "Duplicate library?", info->id);
 		goto error;
@@ -740,13 +1277,21 @@ void obs_register_service_s(const struct obs_service_info *info, size_t size)
 #undef CHECK_REQUIRED_VAL_
 
 	REGISTER_OBS_DEF(size, obs_service_info, obs->service_types, info);
+	obs_module_add_type(OBS_TYPE_CLASS_SERVICE, info->id);
 	return;
 
 error:
 	HANDLE_ERROR(size, obs_service_info, info);
 }
 
-void obs_register_modal_ui_s(const struct obs_modal_ui *info, size_t size)
+void obs_register_service_s(const struct obs_service_info *info, size_t size)
+{
+	pthread_mutex_lock(&obs->modules_mutex);
+	register_service(info, size);
+	pthread_mutex_unlock(&obs->modules_mutex);
+}
+
+static void register_modal_ui(const struct obs_modal_ui *info, size_t size)
 {
 #define CHECK_REQUIRED_VAL_(info, val, func) \
 	CHECK_REQUIRED_VAL(struct obs_modal_ui, info, val, func)
@@ -756,13 +1301,22 @@ void obs_register_modal_ui_s(const struct obs_modal_ui *info, size_t size)
 #undef CHECK_REQUIRED_VAL_
 
 	REGISTER_OBS_DEF(size, obs_modal_ui, obs->modal_ui_callbacks, info);
+	if (obs->loading_module)
+		obs->loading_module->registers_ui = true;
 	return;
 
 error:
 	HANDLE_ERROR(size, obs_modal_ui, info);
 }
 
-void obs_register_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
+void obs_register_modal_ui_s(const struct obs_modal_ui *info, size_t size)
+{
+	pthread_mutex_lock(&obs->modules_mutex);
+	register_modal_ui(info, size);
+	pthread_mutex_unlock(&obs->modules_mutex);
+}
+
+static void register_modeless_ui(const struct obs_modeless_ui *info, size_t size)
 {
 #define CHECK_REQUIRED_VAL_(info, val, func) \
 	CHECK_REQUIRED_VAL(struct obs_modeless_ui, info, val, func)
@@ -773,8 +1327,17 @@ void obs_register_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
 
 	REGISTER_OBS_DEF(size, obs_modeless_ui, obs->modeless_ui_callbacks,
 			info);
+	if (obs->loading_module)
+		obs->loading_module->registers_ui = true;
 	return;
 
 error:
 	HANDLE_ERROR(size, obs_modeless_ui, info);
 }
+
+void obs_register_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
+{
+	pthread_mutex_lock(&obs->modules_mutex);
+	register_modeless_ui(info, size);
+	pthread_mutex_unlock(&obs->modules_mutex);
+}
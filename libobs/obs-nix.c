@@ -23,6 +23,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #if defined(__FreeBSD__)
 #include <sys/sysctl.h>
 #endif
@@ -362,6 +365,14 @@ struct obs_hotkeys_platform {
 	bool pressed[XINPUT_MOUSE_LEN];
 	bool update[XINPUT_MOUSE_LEN];
 	bool button_pressed[XINPUT_MOUSE_LEN];
+
+	/* with XInput 2.2 the key state is tracked from raw key events
+	 * instead of being queried from the server for every key.  they
+	 * arrive on a connection that only the hotkey thread reads */
+	bool events;
+	xcb_connection_t *event_connection;
+	int wake_pipe[2];
+	uint8_t keys[32];
 #endif
 };
 
@@ -770,25 +781,93 @@ static inline xcb_window_t root_window(obs_hotkeys_platform_t *context,
 }
 
 #if USE_XINPUT
-static inline void registerMouseEvents(struct obs_core_hotkeys *hotkeys)
+static void select_input_events(xcb_connection_t *connection,
+		xcb_window_t window, uint32_t events)
 {
-	obs_hotkeys_platform_t *context    = hotkeys->platform_context;
-	xcb_connection_t       *connection = XGetXCBConnection(
-			context->display);
-	xcb_window_t           window      = root_window(context, connection);
-
 	struct {
 		xcb_input_event_mask_t    head;
 		xcb_input_xi_event_mask_t mask;
 	} mask;
 	mask.head.deviceid = XCB_INPUT_DEVICE_ALL_MASTER;
 	mask.head.mask_len = sizeof(mask.mask) / sizeof(uint32_t);
-	mask.mask          = XCB_INPUT_XI_EVENT_MASK_RAW_BUTTON_PRESS |
-			XCB_INPUT_XI_EVENT_MASK_RAW_BUTTON_RELEASE;
+	mask.mask          = (xcb_input_xi_event_mask_t)events;
 
 	xcb_input_xi_select_events(connection, window, 1, &mask.head);
 	xcb_flush(connection);
 }
+
+/* raw events are only delivered to the root window regardless of grabs
+ * since XInput 2.2, older servers keep using the polling thread.
+ *
+ * the events are selected on a connection of their own.  the UI thread
+ * makes round trips on the shared display (XLookupString fetches the
+ * keymap), and events that such a round trip reads into xcb's queue would
+ * not wake up a poll() on the shared connection's file descriptor */
+static bool init_key_events(obs_hotkeys_platform_t *context)
+{
+	xcb_input_xi_query_version_cookie_t cookie;
+	xcb_input_xi_query_version_reply_t *reply;
+	xcb_query_keymap_reply_t *keymap;
+	xcb_connection_t *connection;
+	bool supported;
+
+	connection = xcb_connect(XDisplayString(context->display), NULL);
+	if (xcb_connection_has_error(connection))
+		goto fail;
+
+	cookie = xcb_input_xi_query_version(connection, 2, 2);
+	reply = xcb_input_xi_query_version_reply(connection, cookie, NULL);
+	supported = reply && (reply->major_version > 2 ||
+			(reply->major_version == 2 &&
+			 reply->minor_version >= 2));
+	free(reply);
+
+	if (!supported)
+		goto fail;
+	if (pipe(context->wake_pipe) != 0)
+		goto fail;
+
+	for (size_t i = 0; i < 2; i++) {
+		fcntl(context->wake_pipe[i], F_SETFL, O_NONBLOCK);
+		fcntl(context->wake_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	/* the keymap is read after selecting the events, so no key change
+	 * falls between the two */
+	select_input_events(connection, root_window(context, connection),
+			XCB_INPUT_XI_EVENT_MASK_RAW_KEY_PRESS |
+			XCB_INPUT_XI_EVENT_MASK_RAW_KEY_RELEASE |
+			XCB_INPUT_XI_EVENT_MASK_RAW_BUTTON_PRESS |
+			XCB_INPUT_XI_EVENT_MASK_RAW_BUTTON_RELEASE);
+
+	keymap = xcb_query_keymap_reply(connection,
+			xcb_query_keymap(connection), NULL);
+	if (keymap)
+		memcpy(context->keys, keymap->keys, sizeof(context->keys));
+	free(keymap);
+
+	context->event_connection = connection;
+	return true;
+
+fail:
+	xcb_disconnect(connection);
+	return false;
+}
+
+static inline void registerInputEvents(struct obs_core_hotkeys *hotkeys)
+{
+	obs_hotkeys_platform_t *context    = hotkeys->platform_context;
+	xcb_connection_t       *connection = XGetXCBConnection(
+			context->display);
+
+	context->events = init_key_events(context);
+	if (context->events)
+		return;
+
+	select_input_events(connection, root_window(context, connection),
+			XCB_INPUT_XI_EVENT_MASK_RAW_BUTTON_PRESS |
+			XCB_INPUT_XI_EVENT_MASK_RAW_BUTTON_RELEASE);
+}
 #endif
 
 bool obs_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys)
@@ -801,7 +880,7 @@ bool obs_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys)
 	hotkeys->platform_context->display = display;
 
 #if USE_XINPUT
-	registerMouseEvents(hotkeys);
+	registerInputEvents(hotkeys);
 #endif
 	fill_base_keysyms(hotkeys);
 	fill_keycodes(hotkeys);
@@ -815,6 +894,14 @@ void obs_hotkeys_platform_free(struct obs_core_hotkeys *hotkeys)
 	for (size_t i = 0; i < OBS_KEY_LAST_VALUE; i++)
 		da_free(context->keycodes[i].list);
 
+#if USE_XINPUT
+	if (context->events) {
+		close(context->wake_pipe[0]);
+		close(context->wake_pipe[1]);
+		xcb_disconnect(context->event_connection);
+	}
+#endif
+
 	XCloseDisplay(context->display);
 	bfree(context->keysyms);
 	bfree(context);
@@ -986,48 +1073,120 @@ static bool mouse_button_pressed(xcb_connection_t *connection,
 	return ret;
 }
 
-static inline bool keycode_pressed(xcb_query_keymap_reply_t *reply,
-		xcb_keycode_t code)
+static inline bool keycode_pressed(const uint8_t *keys, xcb_keycode_t code)
 {
-	return (reply->keys[code / 8] & (1 << (code % 8))) != 0;
+	return (keys[code / 8] & (1 << (code % 8))) != 0;
+}
+
+static bool keycodes_pressed(obs_hotkeys_platform_t *context,
+		const uint8_t *keys, obs_key_t key)
+{
+	struct keycode_list *codes = &context->keycodes[key];
+
+	if (key == OBS_KEY_META)
+		return keycode_pressed(keys, context->super_l_code) ||
+		       keycode_pressed(keys, context->super_r_code);
+
+	for (size_t i = 0; i < codes->list.num; i++) {
+		if (keycode_pressed(keys, codes->list.array[i]))
+			return true;
+	}
+
+	return false;
 }
 
 static bool key_pressed(xcb_connection_t *connection,
 		obs_hotkeys_platform_t *context, obs_key_t key)
 {
-	struct keycode_list *codes = &context->keycodes[key];
 	xcb_generic_error_t *error = NULL;
 	xcb_query_keymap_reply_t *reply;
 	bool pressed = false;
 
 	reply = xcb_query_keymap_reply(connection,
 			xcb_query_keymap(connection), &error);
-	if (error) {
+	if (error)
 		blog(LOG_WARNING, "xcb_query_keymap failed");
-
-	} else if (key == OBS_KEY_META) {
-		pressed = keycode_pressed(reply, context->super_l_code) ||
-		          keycode_pressed(reply, context->super_r_code);
-
-	} else {
-		for (size_t i = 0; i < codes->list.num; i++) {
-			if (keycode_pressed(reply, codes->list.array[i])) {
-				pressed = true;
-				break;
-			}
-		}
-	}
+	else
+		pressed = keycodes_pressed(context, reply->keys, key);
 
 	free(reply);
 	free(error);
 	return pressed;
 }
 
+#if USE_XINPUT
+/* Mouse 2 for OBS is Right Click and Mouse 3 is Wheel Click, X buttons 4 to 7
+ * are the wheel axes */
+static inline size_t mouse_button_index(obs_key_t key)
+{
+	switch (key) {
+	case OBS_KEY_MOUSE1: return 0;
+	case OBS_KEY_MOUSE2: return 2;
+	case OBS_KEY_MOUSE3: return 1;
+	default:             return 7 + (key - OBS_KEY_MOUSE4);
+	}
+}
+
+static inline void set_keycode_pressed(uint8_t *keys, uint32_t code,
+		bool pressed)
+{
+	if (code >= 256)
+		return;
+
+	if (pressed)
+		keys[code / 8] |= (uint8_t)(1 << (code % 8));
+	else
+		keys[code / 8] &= (uint8_t)~(1 << (code % 8));
+}
+
+/* returns true if the event changed the state of a key or button */
+static bool handle_input_event(obs_hotkeys_platform_t *context,
+		xcb_generic_event_t *ev)
+{
+	xcb_input_raw_key_press_event_t *key;
+	xcb_input_raw_button_press_event_t *button;
+	uint16_t type;
+
+	if ((ev->response_type & ~0x80) != XCB_GE_GENERIC)
+		return false;
+
+	type = ((xcb_ge_event_t*)ev)->event_type;
+	switch (type) {
+	case XCB_INPUT_RAW_KEY_PRESS:
+	case XCB_INPUT_RAW_KEY_RELEASE:
+		key = (xcb_input_raw_key_press_event_t*)ev;
+		set_keycode_pressed(context->keys, key->detail,
+				type == XCB_INPUT_RAW_KEY_PRESS);
+		return true;
+
+	case XCB_INPUT_RAW_BUTTON_PRESS:
+	case XCB_INPUT_RAW_BUTTON_RELEASE:
+		button = (xcb_input_raw_button_press_event_t*)ev;
+		if (button->detail < 1 || button->detail > XINPUT_MOUSE_LEN)
+			return false;
+
+		context->button_pressed[button->detail - 1] =
+			type == XCB_INPUT_RAW_BUTTON_PRESS;
+		return true;
+	}
+
+	return false;
+}
+#endif
+
 bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *context,
 		obs_key_t key)
 {
 	xcb_connection_t *conn = XGetXCBConnection(context->display);
 
+#if USE_XINPUT
+	if (context->events) {
+		if (key >= OBS_KEY_MOUSE1 && key <= OBS_KEY_MOUSE29)
+			return context->button_pressed[mouse_button_index(key)];
+		return keycodes_pressed(context, context->keys, key);
+	}
+#endif
+
 	if (key >= OBS_KEY_MOUSE1 && key <= OBS_KEY_MOUSE29) {
 		return mouse_button_pressed(conn, context, key);
 	} else {
@@ -1035,6 +1194,66 @@ bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *context,
 	}
 }
 
+bool obs_hotkeys_platform_has_events(obs_hotkeys_platform_t *context)
+{
+#if USE_XINPUT
+	return context->events;
+#else
+	UNUSED_PARAMETER(context);
+	return false;
+#endif
+}
+
+bool obs_hotkeys_platform_wait_event(obs_hotkeys_platform_t *context)
+{
+#if USE_XINPUT
+	xcb_connection_t *connection = context->event_connection;
+	xcb_generic_event_t *ev;
+	bool changed;
+
+	if (!context->events)
+		return false;
+
+	while (!(ev = xcb_poll_for_event(connection))) {
+		struct pollfd fds[2] = {
+			{context->wake_pipe[0], POLLIN, 0},
+			{xcb_get_file_descriptor(connection), POLLIN, 0}
+		};
+		char buf[16];
+
+		/* a broken connection only waits for the wakeup */
+		nfds_t num = xcb_connection_has_error(connection) ? 1 : 2;
+
+		if (poll(fds, num, -1) < 0 && errno != EINTR)
+			return false;
+
+		if (fds[0].revents) {
+			while (read(context->wake_pipe[0], buf, sizeof(buf)) > 0);
+			return false;
+		}
+	}
+
+	changed = handle_input_event(context, ev);
+	free(ev);
+	return changed;
+#else
+	UNUSED_PARAMETER(context);
+	return false;
+#endif
+}
+
+void obs_hotkeys_platform_wake(obs_hotkeys_platform_t *context)
+{
+#if USE_XINPUT
+	char wake = 0;
+
+	if (context->events && write(context->wake_pipe[1], &wake, 1) != 1)
+		blog(LOG_WARNING, "Failed to wake hotkey thread: %d", errno);
+#else
+	UNUSED_PARAMETER(context);
+#endif
+}
+
 static bool get_key_translation(struct dstr *dstr, xcb_keycode_t keycode)
 {
 	xcb_connection_t *connection;
@@ -55,16 +55,34 @@ static inline bool data_capture_ending(const struct obs_output *output)
 	return os_atomic_load_bool(&output->end_data_capture_thread_active);
 }
 
-const struct obs_output_info *find_output(const char *id)
+/* must be called with obs->modules_mutex held */
+const struct obs_output_info *find_loaded_output(const char *id)
 {
 	size_t i;
 	for (i = 0; i < obs->output_types.num; i++)
-		if (strcmp(obs->output_types.array[i].id, id) == 0)
-			return obs->output_types.array+i;
+		if (strcmp(obs->output_types.array[i]->id, id) == 0)
+			return obs->output_types.array[i];
 
 	return NULL;
 }
 
+const struct obs_output_info *find_output(const char *id)
+{
+	const struct obs_output_info *info;
+
+	pthread_mutex_lock(&obs->modules_mutex);
+	info = find_loaded_output(id);
+	pthread_mutex_unlock(&obs->modules_mutex);
+
+	if (!info && obs_load_deferred_module(OBS_TYPE_CLASS_OUTPUT, id)) {
+		pthread_mutex_lock(&obs->modules_mutex);
+		info = find_loaded_output(id);
+		pthread_mutex_unlock(&obs->modules_mutex);
+	}
+
+	return info;
+}
+
 const char *obs_output_get_display_name(const char *id)
 {
 	const struct obs_output_info *info = find_output(id);
@@ -94,6 +112,65 @@ static bool init_output_handlers(struct obs_output *output, const char *name,
 	return true;
 }
 
+static double get_dropped_frames_metric(void *param)
+{
+	struct obs_output *output = param;
+	return output->context.data ?
+		(double)obs_output_get_frames_dropped(output) : 0.0;
+}
+
+static double get_total_frames_metric(void *param)
+{
+	return (double)obs_output_get_total_frames(param);
+}
+
+static double get_total_bytes_metric(void *param)
+{
+	struct obs_output *output = param;
+	return output->context.data ?
+		(double)obs_output_get_total_bytes(output) : 0.0;
+}
+
+static double get_congestion_metric(void *param)
+{
+	struct obs_output *output = param;
+	return output->context.data ?
+		(double)obs_output_get_congestion(output) : 0.0;
+}
+
+static void create_output_metrics(struct obs_output *output)
+{
+	struct dstr labels = {0};
+	obs_metric_label(&labels, "output", output->context.name);
+
+	output->dropped_frames_metric = obs_metric_create_collected(
+			OBS_METRIC_COUNTER, "obs_output_dropped_frames_total",
+			labels.array, "Frames dropped by the output",
+			get_dropped_frames_metric, output);
+	output->total_frames_metric = obs_metric_create_collected(
+			OBS_METRIC_COUNTER, "obs_output_frames_total",
+			labels.array, "Frames sent to the output",
+			get_total_frames_metric, output);
+	output->total_bytes_metric = obs_metric_create_collected(
+			OBS_METRIC_COUNTER, "obs_output_bytes_total",
+			labels.array, "Bytes written by the output",
+			get_total_bytes_metric, output);
+	output->congestion_metric = obs_metric_create_collected(
+			OBS_METRIC_GAUGE, "obs_output_congestion",
+			labels.array, "Output congestion, from 0 to 1",
+			get_congestion_metric, output);
+
+	dstr_free(&labels);
+}
+
+static void free_output_metrics(struct obs_output *output)
+{
+	obs_metric_destroy(output->dropped_frames_metric);
+	obs_metric_destroy(output->total_frames_metric);
+	obs_metric_destroy(output->total_bytes_metric);
+	obs_metric_destroy(output->congestion_metric);
+}
+
 obs_output_t *obs_output_create(const char *id, const char *name,
 		obs_data_t *settings, obs_data_t *hotkey_data)
 {
@@ -151,6 +228,7 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 	if (info)
 		output->context.data = info->create(output->context.settings,
 				output);
+	create_output_metrics(output);
 	if (!output->context.data)
 		blog(LOG_ERROR, "Failed to create output '%s'!", name);
 
@@ -172,6 +250,7 @@ static inline void free_packets(struct obs_output *output)
 void obs_output_destroy(obs_output_t *output)
 {
 	if (output) {
+		free_output_metrics(output);
 		obs_context_data_remove(&output->context);
 
 		blog(LOG_DEBUG, "output '%s' destroyed", output->context.name);
@@ -1068,6 +1147,83 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 }
 #endif
 
+/* ------------------------------------------------------------------------- */
+/* Frame latency */
+
+static const char *latency_stage_names[VIDEO_TRACE_STAGES - 1] = {
+	"render_readback",
+	"video_io",
+	"encode_queue",
+	"encode",
+	"interleave",
+	"send"
+};
+
+static void record_frame_latency(struct obs_output *output,
+		const struct video_trace *trace)
+{
+	profile_interval_t stages[VIDEO_TRACE_STAGES - 1];
+
+	/* frames rendered by the gpu encoder path or packets that could not
+	 * be matched to their frame are not traced */
+	if (!trace->ts[VIDEO_TRACE_RENDER])
+		return;
+
+	for (size_t i = 0; i < VIDEO_TRACE_STAGES - 1; i++) {
+		if (trace->ts[i + 1] < trace->ts[i])
+			return;
+
+		stages[i].name       = latency_stage_names[i];
+		stages[i].start_time = trace->ts[i];
+		stages[i].end_time   = trace->ts[i + 1];
+	}
+
+	if (!output->profile_latency_name)
+		output->profile_latency_name = profile_store_name(
+				obs_get_profiler_name_store(),
+				"frame_latency(%s)", output->context.name);
+
+	profile_record(output->profile_latency_name,
+			trace->ts[VIDEO_TRACE_RENDER],
+			trace->ts[VIDEO_TRACE_SEND],
+			stages, VIDEO_TRACE_STAGES - 1);
+}
+
+static inline void send_encoded_packet(struct obs_output *output,
+		struct encoder_packet *packet)
+{
+	bool traced = packet->type == OBS_ENCODER_VIDEO;
+
+	if (traced)
+		packet->trace.ts[VIDEO_TRACE_INTERLEAVE] = os_gettime_ns();
+
+	output->info.encoded_packet(output->context.data, packet);
+
+	if (traced && (output->info.flags & OBS_OUTPUT_ASYNC_SEND) == 0) {
+		packet->trace.ts[VIDEO_TRACE_SEND] = os_gettime_ns();
+		record_frame_latency(output, &packet->trace);
+	}
+}
+
+void obs_output_packet_sent(obs_output_t *output,
+		const struct encoder_packet *packet)
+{
+	struct video_trace trace;
+
+	if (!obs_output_valid(output, "obs_output_packet_sent"))
+		return;
+	if (!obs_ptr_valid(packet, "obs_output_packet_sent"))
+		return;
+	if (packet->type != OBS_ENCODER_VIDEO)
+		return;
+
+	trace = packet->trace;
+	trace.ts[VIDEO_TRACE_SEND] = os_gettime_ns();
+	record_frame_latency(output, &trace);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline void send_interleaved(struct obs_output *output)
 {
 	struct encoder_packet out = output->interleaved_packets.array[0];
@@ -1116,7 +1272,7 @@ static inline void send_interleaved(struct obs_output *output)
 #endif
 	}
 
-	output->info.encoded_packet(output->context.data, &out);
+	send_encoded_packet(output, &out);
 	obs_encoder_packet_release(&out);
 }
 
@@ -1514,7 +1670,7 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 		if (packet->type == OBS_ENCODER_AUDIO)
 			packet->track_idx = get_track_index(output, packet);
 
-		output->info.encoded_packet(output->context.data, packet);
+		send_encoded_packet(output, packet);
 
 		if (packet->type == OBS_ENCODER_VIDEO)
 			output->total_frames++;
@@ -1663,8 +1819,9 @@ static inline void signal_reconnect_success(struct obs_output *output)
 static inline void signal_stop(struct obs_output *output)
 {
 	struct calldata params;
+	uint8_t stack[128];
 
-	calldata_init(&params);
+	calldata_init_stack(&params, stack, sizeof(stack));
 	calldata_set_string(&params, "last_error", output->last_error_message);
 	calldata_set_int(&params, "code", output->stop_code);
 	calldata_set_ptr(&params, "output", output);
@@ -517,6 +517,10 @@ static inline void render_item(struct obs_scene_item *item)
 		uint32_t cx = calc_cx(item, width);
 		uint32_t cy = calc_cy(item, height);
 
+		/* the pending sprites have to be drawn before the render
+		 * target changes */
+		gs_sprite_batch_flush();
+
 		if (cx && cy && gs_texrender_begin(item->item_render, cx, cy)) {
 			float cx_scale = (float)width  / (float)cx;
 			float cy_scale = (float)height / (float)cy;
@@ -541,16 +545,51 @@ static inline void render_item(struct obs_scene_item *item)
 		}
 	}
 
+	gs_sprite_batch_flush();
+
 	gs_matrix_push();
 	gs_matrix_mul(&item->draw_transform);
 	if (item->item_render) {
 		render_item_texture(item);
+
+		/* a scene drawn again this frame comes from its render
+		 * cache, so the target can go straight back to the pool */
+		gs_texrender_release(item->item_render);
 	} else {
 		obs_source_video_render(item->source);
 	}
 	gs_matrix_pop();
 }
 
+/* items that only draw a texture are added to the sprite batch, so that
+ * consecutive items drawing textures of the same format take a single draw
+ * call */
+static bool batch_item(struct obs_scene_item *item)
+{
+	struct obs_source *source = item->source;
+	uint32_t flags = source->info.output_flags;
+	gs_texture_t *tex;
+
+	if (item->item_render || !source->info.get_sprite_texture)
+		return false;
+	if (!source->enabled || !source->context.data || source->filters.num)
+		return false;
+	if ((flags & (OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_ASYNC)) != 0)
+		return false;
+
+	tex = obs_source_get_sprite_texture(source);
+	if (!tex)
+		return false;
+
+	gs_matrix_push();
+	gs_matrix_mul(&item->draw_transform);
+	gs_sprite_batch_add(obs->video.default_effect, "Draw", tex, 0,
+			obs_source_get_width(source),
+			obs_source_get_height(source));
+	gs_matrix_pop();
+	return true;
+}
+
 static void scene_video_tick(void *data, float seconds)
 {
 	struct obs_scene *scene = data;
@@ -611,6 +650,52 @@ static void update_transforms_and_prune_sources(obs_scene_t *scene,
 		resize_group(group_sceneitem);
 }
 
+bool obs_scene_hash_content(obs_scene_t *scene, uint64_t *hash)
+{
+	struct obs_scene_item *item;
+	bool success = true;
+
+	if (!scene)
+		return true;
+
+	video_lock(scene);
+
+	hash_content(hash, &scene->cx, sizeof(scene->cx));
+	hash_content(hash, &scene->cy, sizeof(scene->cy));
+
+	item = scene->first_item;
+	while (item && success) {
+		hash_content(hash, &item, sizeof(item));
+		hash_content(hash, &item->user_visible,
+				sizeof(item->user_visible));
+
+		/* pending transform updates and removals are only applied
+		 * while rendering */
+		if (item->removed || item->update_transform ||
+		    os_atomic_load_long(&item->defer_update)) {
+			success = false;
+
+		} else if (item->user_visible) {
+			hash_content(hash, &item->draw_transform,
+					sizeof(item->draw_transform));
+			hash_content(hash, &item->crop, sizeof(item->crop));
+			hash_content(hash, &item->scale_filter,
+					sizeof(item->scale_filter));
+			hash_content(hash, &item->last_width,
+					sizeof(item->last_width));
+			hash_content(hash, &item->last_height,
+					sizeof(item->last_height));
+
+			success = obs_source_hash_content(item->source, hash);
+		}
+
+		item = item->next;
+	}
+
+	video_unlock(scene);
+	return success;
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	DARRAY(struct obs_scene_item*) remove_items;
@@ -631,12 +716,15 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 
 	item = scene->first_item;
 	while (item) {
-		if (item->user_visible)
+		/* render_item only flushes the batch once it actually draws
+		 * something else */
+		if (item->user_visible && !batch_item(item))
 			render_item(item);
 
 		item = item->next;
 	}
 
+	gs_sprite_batch_flush();
 	gs_blend_state_pop();
 
 	video_unlock(scene);
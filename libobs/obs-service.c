@@ -17,16 +17,34 @@
 
 #include "obs-internal.h"
 
-const struct obs_service_info *find_service(const char *id)
+/* must be called with obs->modules_mutex held */
+const struct obs_service_info *find_loaded_service(const char *id)
 {
 	size_t i;
 	for (i = 0; i < obs->service_types.num; i++)
-		if (strcmp(obs->service_types.array[i].id, id) == 0)
-			return obs->service_types.array+i;
+		if (strcmp(obs->service_types.array[i]->id, id) == 0)
+			return obs->service_types.array[i];
 
 	return NULL;
 }
 
+const struct obs_service_info *find_service(const char *id)
+{
+	const struct obs_service_info *info;
+
+	pthread_mutex_lock(&obs->modules_mutex);
+	info = find_loaded_service(id);
+	pthread_mutex_unlock(&obs->modules_mutex);
+
+	if (!info && obs_load_deferred_module(OBS_TYPE_CLASS_SERVICE, id)) {
+		pthread_mutex_lock(&obs->modules_mutex);
+		info = find_loaded_service(id);
+		pthread_mutex_unlock(&obs->modules_mutex);
+	}
+
+	return info;
+}
+
 const char *obs_service_get_display_name(const char *id)
 {
 	const struct obs_service_info *info = find_service(id);
@@ -0,0 +1,232 @@
+/******************************************************************************
+    Copyright (C) 2026 by OBS Studio contributors
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+
+/*
+ * Fused filter chains
+ *
+ * A run of consecutive fusable filters (OBS_SOURCE_FUSABLE) is rendered by
+ * the first filter of the run with a single generated effect: the shader
+ * code of every filter is pasted into one effect with its own prefix, and
+ * the pixel shader calls the filters' functions from the innermost to the
+ * outermost, clamping the result of each one like a render target would.
+ * The generated effect is kept by the first filter of the run and rebuilt
+ * whenever the combined shader code changes.
+ */
+
+#define MAX_FUSED_FILTERS 8
+
+static const char *fused_effect_header =
+"uniform float4x4 ViewProj;\n"
+"uniform texture2d image;\n"
+"\n"
+"sampler_state def_sampler {\n"
+"	Filter   = Linear;\n"
+"	AddressU = Clamp;\n"
+"	AddressV = Clamp;\n"
+"};\n"
+"\n"
+"struct VertInOut {\n"
+"	float4 pos : POSITION;\n"
+"	float2 uv  : TEXCOORD0;\n"
+"};\n"
+"\n"
+"VertInOut VSDefault(VertInOut vert_in)\n"
+"{\n"
+"	VertInOut vert_out;\n"
+"	vert_out.pos = mul(float4(vert_in.pos.xyz, 1.0), ViewProj);\n"
+"	vert_out.uv  = vert_in.uv;\n"
+"	return vert_out;\n"
+"}\n"
+"\n";
+
+static const char *fused_effect_footer =
+"	return rgba;\n"
+"}\n"
+"\n"
+"technique Draw\n"
+"{\n"
+"	pass\n"
+"	{\n"
+"		vertex_shader = VSDefault(vert_in);\n"
+"		pixel_shader  = PSFused(vert_in);\n"
+"	}\n"
+"}\n";
+
+static inline void get_fused_prefix(char *prefix, size_t size, size_t idx)
+{
+	snprintf(prefix, size, "fused%d_", (int)idx);
+}
+
+static inline bool filter_fusable(const obs_source_t *filter)
+{
+	return (filter->info.output_flags & OBS_SOURCE_FUSABLE) != 0 &&
+		filter->info.get_fused_shader &&
+		filter->info.set_fused_params &&
+		filter->context.data;
+}
+
+/* disabled filters pass their input through untouched, so they are skipped
+ * instead of ending the run */
+static size_t get_fused_chain(obs_source_t *filter, obs_source_t **chain,
+		const char **shaders)
+{
+	size_t count = 0;
+
+	while (filter && filter->filter_parent && count < MAX_FUSED_FILTERS) {
+		if (filter->enabled) {
+			const char *shader;
+
+			if (!filter_fusable(filter))
+				break;
+
+			shader = filter->info.get_fused_shader(
+					filter->context.data);
+			if (!shader)
+				break;
+
+			shaders[count] = shader;
+			chain[count++] = filter;
+		}
+
+		filter = filter->filter_target;
+	}
+
+	return count;
+}
+
+static uint64_t hash_fused_chain(const char **shaders, size_t count)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < count; i++) {
+		const char *str = shaders[i];
+
+		while (*str) {
+			hash ^= (uint8_t)*(str++);
+			hash *= 0x100000001b3ULL;
+		}
+
+		hash ^= 0xff;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static gs_effect_t *create_fused_effect(const char **shaders, size_t count)
+{
+	struct dstr code = {0};
+	struct dstr shader = {0};
+	char *errors = NULL;
+	char prefix[16];
+	gs_effect_t *effect;
+
+	dstr_copy(&code, fused_effect_header);
+
+	for (size_t i = 0; i < count; i++) {
+		get_fused_prefix(prefix, sizeof(prefix), i);
+
+		dstr_copy(&shader, shaders[i]);
+		dstr_replace(&shader, "$", prefix);
+		dstr_cat_dstr(&code, &shader);
+		dstr_cat(&code, "\n");
+	}
+
+	dstr_cat(&code, "float4 PSFused(VertInOut vert_in) : TARGET\n{\n"
+			"\tfloat4 rgba = image.Sample(def_sampler, "
+			"vert_in.uv);\n");
+
+	/* unfused, every filter writes to an 8-bit render target that clamps
+	 * its output, so each stage is clamped the same way here */
+	for (size_t i = count; i > 0; i--) {
+		get_fused_prefix(prefix, sizeof(prefix), i - 1);
+		dstr_catf(&code, "\trgba = saturate(%smain(rgba));\n", prefix);
+	}
+
+	dstr_cat(&code, fused_effect_footer);
+
+	effect = gs_effect_create(code.array, NULL, &errors);
+	if (!effect)
+		blog(LOG_WARNING, "Failed to create fused filter effect, "
+				"rendering filters separately:\n%s",
+				errors ? errors : "(unknown error)");
+
+	bfree(errors);
+	dstr_free(&shader);
+	dstr_free(&code);
+	return effect;
+}
+
+bool obs_source_render_fused_filters(obs_source_t *filter)
+{
+	obs_source_t *chain[MAX_FUSED_FILTERS];
+	const char *shaders[MAX_FUSED_FILTERS];
+	obs_source_t *last;
+	char prefix[16];
+	uint64_t hash;
+	size_t count;
+
+	if (!filter_fusable(filter))
+		return false;
+
+	count = get_fused_chain(filter, chain, shaders);
+	if (count < 2)
+		return false;
+
+	/* a failed build keeps its hash so it is not retried every frame */
+	hash = hash_fused_chain(shaders, count);
+	if (filter->fused_hash != hash) {
+		gs_effect_destroy(filter->fused_effect);
+		filter->fused_effect = create_fused_effect(shaders, count);
+		filter->fused_hash = hash;
+	}
+
+	if (!filter->fused_effect)
+		return false;
+
+	/* the last filter of the run renders its target exactly like it would
+	 * for itself, and then draws it once with the combined effect */
+	last = chain[count - 1];
+	if (!obs_source_process_filter_begin(last, GS_RGBA,
+				OBS_ALLOW_DIRECT_RENDERING))
+		return true;
+
+	for (size_t i = 0; i < count; i++) {
+		get_fused_prefix(prefix, sizeof(prefix), i);
+		chain[i]->info.set_fused_params(chain[i]->context.data,
+				filter->fused_effect, prefix);
+	}
+
+	obs_source_process_filter_end(last, filter->fused_effect, 0, 0);
+	return true;
+}
+
+gs_eparam_t *obs_fused_effect_get_param(gs_effect_t *effect,
+		const char *prefix, const char *name)
+{
+	char full_name[256];
+
+	if (!obs_ptr_valid(prefix, "obs_fused_effect_get_param"))
+		return NULL;
+	if (!obs_ptr_valid(name, "obs_fused_effect_get_param"))
+		return NULL;
+
+	snprintf(full_name, sizeof(full_name), "%s%s", prefix, name);
+	return gs_effect_get_param_by_name(effect, full_name);
+}
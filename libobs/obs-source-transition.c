@@ -665,6 +665,33 @@ static inline void handle_stop(obs_source_t *transition)
 			"transition_stop");
 }
 
+bool obs_transition_hash_content(obs_source_t *transition, uint64_t *hash)
+{
+	obs_source_t *source;
+	struct matrix4 matrix;
+	bool transitioning;
+	bool success = true;
+
+	lock_transition(transition);
+	transitioning = transition->transitioning_video ||
+	                transition->transitioning_audio;
+	source = transition->transition_sources[0];
+	obs_source_addref(source);
+	matrix = transition->transition_matrices[0];
+	unlock_transition(transition);
+
+	if (transitioning) {
+		success = false;
+	} else {
+		hash_content(hash, &matrix, sizeof(matrix));
+		if (source)
+			success = obs_source_hash_content(source, hash);
+	}
+
+	obs_source_release(source);
+	return success;
+}
+
 void obs_transition_video_render(obs_source_t *transition,
 		obs_transition_video_render_callback_t callback)
 {
@@ -722,6 +749,9 @@ void obs_transition_video_render(obs_source_t *transition,
 			callback(transition->context.data, tex[0], tex[1], t,
 					cx, cy);
 
+		gs_texrender_release(transition->transition_texrender[0]);
+		gs_texrender_release(transition->transition_texrender[1]);
+
 	} else if (state.transitioning_audio) {
 		if (state.s[1]) {
 			gs_matrix_push();
@@ -40,10 +40,11 @@ static inline bool deinterlacing_enabled(const struct obs_source *source)
 	return source->deinterlace_mode != OBS_DEINTERLACE_MODE_DISABLE;
 }
 
-struct obs_source_info *get_source_info(const char *id)
+/* must be called with obs->modules_mutex held */
+struct obs_source_info *find_loaded_source(const char *id)
 {
 	for (size_t i = 0; i < obs->source_types.num; i++) {
-		struct obs_source_info *info = &obs->source_types.array[i];
+		struct obs_source_info *info = obs->source_types.array[i];
 		if (strcmp(info->id, id) == 0)
 			return info;
 	}
@@ -51,6 +52,23 @@ struct obs_source_info *get_source_info(const char *id)
 	return NULL;
 }
 
+struct obs_source_info *get_source_info(const char *id)
+{
+	struct obs_source_info *info;
+
+	pthread_mutex_lock(&obs->modules_mutex);
+	info = find_loaded_source(id);
+	pthread_mutex_unlock(&obs->modules_mutex);
+
+	if (!info && obs_load_deferred_module(OBS_TYPE_CLASS_SOURCE, id)) {
+		pthread_mutex_lock(&obs->modules_mutex);
+		info = find_loaded_source(id);
+		pthread_mutex_unlock(&obs->modules_mutex);
+	}
+
+	return info;
+}
+
 static const char *source_signals[] = {
 	"void destroy(ptr source)",
 	"void remove(ptr source)",
@@ -294,9 +312,8 @@ static void obs_source_init_audio_hotkeys(struct obs_source *source)
 			obs_source_hotkey_push_to_talk, source);
 }
 
-static obs_source_t *obs_source_create_internal(const char *id,
-		const char *name, obs_data_t *settings,
-		obs_data_t *hotkey_data, bool private)
+static obs_source_t *obs_source_alloc(const char *id, const char *name,
+		obs_data_t *settings, obs_data_t *hotkey_data, bool private)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
@@ -339,30 +356,61 @@ static obs_source_t *obs_source_create_internal(const char *id,
 	if (!private)
 		obs_source_init_audio_hotkeys(source);
 
+	return source;
+
+fail:
+	blog(LOG_ERROR, "obs_source_create failed");
+	obs_source_destroy(source);
+	return NULL;
+}
+
+obs_source_t *obs_source_create_deferred(const char *id, const char *name,
+		obs_data_t *settings, obs_data_t *hotkey_data)
+{
+	return obs_source_alloc(id, name, settings, hotkey_data, false);
+}
+
+void *obs_source_create_data(obs_source_t *source)
+{
+	if (!source->info.create)
+		return NULL;
+
+	return source->info.create(source->context.settings, source);
+}
+
+void obs_source_finish_create(obs_source_t *source, void *data)
+{
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info)
-		source->context.data = info->create(source->context.settings,
-				source);
+	source->context.data = data;
 	if (!source->context.data)
-		blog(LOG_ERROR, "Failed to create source '%s'!", name);
+		blog(LOG_ERROR, "Failed to create source '%s'!",
+				source->context.name);
 
 	blog(LOG_DEBUG, "%ssource '%s' (%s) created",
-			private ? "private " : "", name, id);
+			source->context.private ? "private " : "",
+			source->context.name, source->info.id);
 
 	source->flags = source->default_flags;
 	source->enabled = true;
 
-	if (!private) {
+	if (!source->context.private) {
 		obs_source_dosignal(source, "source_create", NULL);
 	}
+}
 
-	return source;
+static obs_source_t *obs_source_create_internal(const char *id,
+		const char *name, obs_data_t *settings,
+		obs_data_t *hotkey_data, bool private)
+{
+	obs_source_t *source = obs_source_alloc(id, name, settings,
+			hotkey_data, private);
 
-fail:
-	blog(LOG_ERROR, "obs_source_create failed");
-	obs_source_destroy(source);
-	return NULL;
+	if (source)
+		obs_source_finish_create(source,
+				obs_source_create_data(source));
+
+	return source;
 }
 
 obs_source_t *obs_source_create(const char *id, const char *name,
@@ -581,6 +629,10 @@ void obs_source_destroy(struct obs_source *source)
 		gs_texture_destroy(source->async_prev_texture);
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	if (source->fused_effect)
+		gs_effect_destroy(source->fused_effect);
+	if (source->render_cache)
+		gs_texrender_destroy(source->render_cache);
 	gs_leave_context();
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
@@ -803,6 +855,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 		source->info.update(source->context.data,
 				source->context.settings);
 
+	os_atomic_inc_long(&source->content_serial);
 	source->defer_update = false;
 }
 
@@ -819,6 +872,54 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				source->context.settings);
+		os_atomic_inc_long(&source->content_serial);
+	}
+}
+
+void obs_source_content_changed(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_content_changed"))
+		return;
+
+	os_atomic_inc_long(&source->content_serial);
+}
+
+bool obs_source_hash_content(obs_source_t *source, uint64_t *hash)
+{
+	uint32_t flags = source->info.output_flags;
+	long serial = os_atomic_load_long(&source->content_serial);
+	bool success = true;
+
+	hash_content(hash, &source, sizeof(source));
+	hash_content(hash, &serial, sizeof(serial));
+	hash_content(hash, &source->enabled, sizeof(source->enabled));
+
+	if (!source->enabled || !source->context.data)
+		return true;
+	if (source->defer_update)
+		return false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; success && i < source->filters.num; i++)
+		success = obs_source_hash_content(source->filters.array[i],
+				hash);
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	if (!success)
+		return false;
+
+	switch (source->info.type) {
+	case OBS_SOURCE_TYPE_SCENE:
+		return obs_scene_hash_content(source->context.data, hash);
+	case OBS_SOURCE_TYPE_TRANSITION:
+		return obs_transition_hash_content(source, hash);
+	default:
+		/* audio sources and filters never change the picture */
+		if ((flags & OBS_SOURCE_VIDEO) == 0)
+			return true;
+
+		return (flags & OBS_SOURCE_STATIC_CONTENT) != 0 &&
+		       (flags & OBS_SOURCE_ASYNC) == 0;
 	}
 }
 
@@ -1811,6 +1912,10 @@ static inline void render_video(obs_source_t *source)
 	if (source->filters.num && !source->rendering_filter)
 		obs_source_render_filters(source);
 
+	else if (source->filter_parent &&
+	         obs_source_render_fused_filters(source))
+		return;
+
 	else if (source->info.video_render)
 		obs_source_main_render(source);
 
@@ -1824,13 +1929,162 @@ static inline void render_video(obs_source_t *source)
 		obs_source_render_async_video(source);
 }
 
+static inline bool can_cache_render(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (source->info.type != OBS_SOURCE_TYPE_INPUT &&
+	    source->info.type != OBS_SOURCE_TYPE_SCENE)
+		return false;
+	if ((flags & OBS_SOURCE_VIDEO) == 0)
+		return false;
+
+	/* async sources without filters already just draw a texture */
+	if ((flags & OBS_SOURCE_ASYNC) != 0 && !source->filters.num)
+		return false;
+
+	return !source->rendering_filter && source->enabled &&
+		source->context.data;
+}
+
+static inline void count_render(obs_source_t *source, uint64_t frame)
+{
+	if (source->render_count_frame != frame) {
+		source->prev_render_count =
+			(source->render_count_frame + 1 == frame) ?
+			source->render_count : 0;
+		source->render_count_frame = frame;
+		source->render_count = 0;
+	}
+
+	source->render_count++;
+}
+
+static bool update_render_cache(obs_source_t *source)
+{
+	uint32_t cx = obs_source_get_width(source);
+	uint32_t cy = obs_source_get_height(source);
+	bool success = false;
+
+	if (!cx || !cy)
+		return false;
+
+	/* a scene may be in the middle of a sprite batch */
+	gs_sprite_batch_flush();
+
+	if (!source->render_cache)
+		source->render_cache = gs_texrender_create(GS_RGBA,
+				GS_ZS_NONE);
+
+	gs_texrender_reset(source->render_cache);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(source->render_cache, cx, cy)) {
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		render_video(source);
+
+		gs_texrender_end(source->render_cache);
+
+		/* the cache is drawn for every reference this frame and
+		 * rendered again next frame, so its target goes back to the
+		 * pool at the end of this one */
+		gs_texrender_release_deferred(source->render_cache);
+		success = true;
+	}
+
+	gs_blend_state_pop();
+	return success;
+}
+
+static void draw_render_cache(obs_source_t *source)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(source->render_cache);
+	gs_effect_t *effect;
+
+	if (!tex)
+		return;
+
+	/* draw with the caller's effect if it has one active, the same way
+	 * the source itself would have been drawn */
+	if (gs_get_effect()) {
+		obs_source_draw(tex, 0, 0, 0, 0, false);
+		return;
+	}
+
+	effect = obs->video.default_effect;
+	while (gs_effect_loop(effect, "Draw"))
+		obs_source_draw(tex, 0, 0, 0, 0, false);
+}
+
+/* returns true if the render cache holds this frame's output of the
+ * source.  the first reference of a frame renders the source to the cache,
+ * later references in the same frame only use the cached texture */
+static bool use_render_cache(obs_source_t *source)
+{
+	struct obs_core_video *video = &obs->video;
+	uint64_t frame = video->render_frame;
+
+	if (!can_cache_render(source))
+		return false;
+
+	count_render(source, frame);
+	if (source->prev_render_count < 2 && source->render_count < 2) {
+		/* no longer shown more than once a frame */
+		if (source->render_cache) {
+			gs_texrender_destroy(source->render_cache);
+			source->render_cache = NULL;
+		}
+		return false;
+	}
+
+	if (source->render_cache_frame != frame) {
+		if (!update_render_cache(source))
+			return false;
+
+		source->render_cache_frame = frame;
+		video->render_cache_misses++;
+	} else {
+		video->render_cache_hits++;
+	}
+
+	return true;
+}
+
+static bool render_cached(obs_source_t *source)
+{
+	if (!use_render_cache(source))
+		return false;
+
+	draw_render_cache(source);
+	return true;
+}
+
+gs_texture_t *obs_source_get_sprite_texture(obs_source_t *source)
+{
+	if (!source->info.get_sprite_texture || !source->context.data)
+		return NULL;
+
+	if (use_render_cache(source))
+		return gs_texrender_get_texture(source->render_cache);
+
+	return source->info.get_sprite_texture(source->context.data);
+}
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_video_render"))
 		return;
 
 	obs_source_addref(source);
-	render_video(source);
+	if (!render_cached(source))
+		render_video(source);
 	obs_source_release(source);
 }
 
@@ -2887,10 +3141,11 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 	if (!name || !*name || !source->context.name ||
 			strcmp(name, source->context.name) != 0) {
 		struct calldata data;
+		uint8_t stack[128];
 		char *prev_name = bstrdup(source->context.name);
 		obs_context_data_setname(&source->context, name);
 
-		calldata_init(&data);
+		calldata_init_stack(&data, stack, sizeof(stack));
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_string(&data, "new_name", source->context.name);
 		calldata_set_string(&data, "prev_name", prev_name);
@@ -3054,6 +3309,7 @@ void obs_source_process_filter_tech_end(obs_source_t *filter, gs_effect_t *effec
 	} else {
 		texture = gs_texrender_get_texture(filter->filter_texrender);
 		render_filter_tex(texture, effect, width, height, tech);
+		gs_texrender_release(filter->filter_texrender);
 	}
 }
 
@@ -3079,6 +3335,11 @@ void obs_source_process_filter_end(obs_source_t *filter, gs_effect_t *effect,
 		if (texture)
 			render_filter_tex(texture, effect, width, height,
 					"Draw");
+
+		/* sources drawn again this frame come from the render
+		 * cache, so the filtered input can go straight back to the
+		 * pool */
+		gs_texrender_release(filter->filter_texrender);
 	}
 }
 
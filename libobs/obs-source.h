@@ -140,6 +140,38 @@ enum obs_balance_type {
  */
 #define OBS_SOURCE_CAP_DISABLED (1<<10)
 
+/**
+ * Filter is a simple per-pixel function of its input color
+ *
+ * Consecutive enabled filters with this flag are combined by libobs into a
+ * single effect and rendered in one pass instead of one pass per filter.
+ * Requires the get_fused_shader and set_fused_params callbacks.  The
+ * video_render callback is still used when the filter is not next to
+ * another fusable filter.
+ */
+#define OBS_SOURCE_FUSABLE (1<<11)
+
+/**
+ * Source output only changes when its settings are updated or when it calls
+ * obs_source_content_changed
+ *
+ * If every video source shown in the main view has this flag, libobs
+ * reuses the previous main texture instead of rendering it again while
+ * nothing changes.
+ */
+#define OBS_SOURCE_STATIC_CONTENT (1<<12)
+
+/**
+ * Source create callback is safe to call from any thread, at the same time
+ * as the create callbacks of other sources
+ *
+ * When a scene collection is loaded, sources with this flag are created on
+ * a pool of worker threads.  Everything else about loading (settings,
+ * filters, signals, the load callback) still happens on the loading thread
+ * in the order of the collection.
+ */
+#define OBS_SOURCE_PARALLEL_CREATE (1<<13)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -457,6 +489,50 @@ struct obs_source_info {
 	 * @return          The properties data
 	 */
 	obs_properties_t *(*get_properties2)(void *data, void *type_data);
+
+	/**
+	 * Gets the shader code of a fusable filter (OBS_SOURCE_FUSABLE)
+	 *
+	 * The code declares the uniforms of the filter and a function with
+	 * the signature:
+	 *
+	 *   float4 $main(float4 rgba)
+	 *
+	 * which returns the filtered color of a single pixel.  Every global
+	 * name in the code must start with '$', which libobs replaces with a
+	 * prefix that is unique within the combined effect.  The code must
+	 * not declare ViewProj, image, samplers for image, vertex shaders or
+	 * techniques.
+	 *
+	 * @param  data  Filter data
+	 * @return       Shader code, owned by the filter
+	 */
+	const char *(*get_fused_shader)(void *data);
+
+	/**
+	 * Sets the uniforms of a fusable filter in a combined effect
+	 *
+	 * Use obs_fused_effect_get_param to look up the uniforms declared by
+	 * get_fused_shader.
+	 *
+	 * @param  data    Filter data
+	 * @param  effect  Combined effect
+	 * @param  prefix  Prefix that replaced '$' in the shader code
+	 */
+	void (*set_fused_params)(void *data, gs_effect_t *effect,
+			const char *prefix);
+
+	/**
+	 * Gets the texture of a source whose video_render callback only draws
+	 * that texture at the size of the source with the effect it is given
+	 *
+	 * Scenes use this to batch consecutive items that draw textures of
+	 * the same format into a single draw call.
+	 *
+	 * @param  data  Source data
+	 * @return       The texture, or NULL to draw with video_render
+	 */
+	gs_texture_t *(*get_sprite_texture)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include <time.h>
+#include <inttypes.h>
 #include <stdlib.h>
 
 #include "obs.h"
@@ -95,6 +96,9 @@ static inline void render_displays(void)
 
 	pthread_mutex_unlock(&obs->data.displays_mutex);
 
+	/* displays are the last to draw anything this frame */
+	gs_texrender_end_frame();
+
 	gs_leave_context();
 }
 
@@ -115,12 +119,69 @@ static inline void unmap_last_surface(struct obs_core_video *video)
 	}
 }
 
+static bool hash_main_view(uint64_t *hash)
+{
+	struct obs_view *view = &obs->data.main_view;
+	bool success;
+
+	/* draw callbacks can draw anything */
+	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	success = obs->data.draw_callbacks.num == 0;
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+
+	if (!success)
+		return false;
+
+	pthread_mutex_lock(&view->channels_mutex);
+
+	for (size_t i = 0; success && i < MAX_CHANNELS; i++) {
+		struct obs_source *source = view->channels[i];
+
+		hash_content(hash, &source, sizeof(source));
+		if (source)
+			success = !source->removed &&
+				obs_source_hash_content(source, hash);
+	}
+
+	pthread_mutex_unlock(&view->channels_mutex);
+	return success;
+}
+
+/* the main texture can be reused if everything in the main view is static
+ * and nothing changed since the previous texture was rendered */
+static inline bool main_texture_unchanged(struct obs_core_video *video,
+		int prev_texture)
+{
+	uint64_t hash = CONTENT_HASH_INIT;
+	bool valid = hash_main_view(&hash);
+	bool unchanged = valid &&
+		video->content_hash_valid &&
+		video->content_hash == hash &&
+		video->textures_rendered[prev_texture];
+
+	video->content_hash = hash;
+	video->content_hash_valid = valid;
+	return unchanged;
+}
+
 static const char *render_main_texture_name = "render_main_texture";
 static inline void render_main_texture(struct obs_core_video *video,
-		int cur_texture)
+		int cur_texture, int prev_texture)
 {
 	profile_start(render_main_texture_name);
 
+	video->main_frames++;
+
+	if (main_texture_unchanged(video, prev_texture)) {
+		gs_copy_texture(video->render_textures[cur_texture],
+				video->render_textures[prev_texture]);
+		video->textures_rendered[cur_texture] = true;
+		video->static_frames++;
+
+		profile_end(render_main_texture_name);
+		return;
+	}
+
 	struct vec4 clear_color;
 	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 0.0f);
 
@@ -372,7 +433,8 @@ static inline void stage_output_texture(struct obs_core_video *video,
 
 	gs_texture_t   *texture;
 	bool        texture_ready;
-	gs_stagesurf_t *copy = video->copy_surfaces[cur_texture];
+	gs_stagesurf_t *copy;
+	int            copy_idx;
 
 	if (video->gpu_conversion) {
 		texture = video->convert_textures[prev_texture];
@@ -384,12 +446,18 @@ static inline void stage_output_texture(struct obs_core_video *video,
 
 	unmap_last_surface(video);
 
-	if (!texture_ready)
+	/* download_frame always leaves a free surface, so staging never
+	 * overwrites a frame that has not been mapped yet */
+	if (!texture_ready || video->copies_queued == NUM_COPY_SURFACES)
 		goto end;
 
+	copy_idx = (video->first_copy_surface + video->copies_queued) %
+		NUM_COPY_SURFACES;
+	copy = video->copy_surfaces[copy_idx];
+
 	gs_stage_texture(copy, texture);
 
-	video->textures_copied[cur_texture] = true;
+	video->copies_queued++;
 
 end:
 	profile_end(stage_output_texture_name);
@@ -496,7 +564,7 @@ static inline void render_video(struct obs_core_video *video,
 	gs_enable_depth_test(false);
 	gs_set_cull_mode(GS_NEITHER);
 
-	render_main_texture(video, cur_texture);
+	render_main_texture(video, cur_texture, prev_texture);
 
 	if (raw_active || gpu_active) {
 		render_output_texture(video, cur_texture, prev_texture);
@@ -535,13 +603,28 @@ static inline void render_video(struct obs_core_video *video,
 }
 
 static inline bool download_frame(struct obs_core_video *video,
-		int prev_texture, struct video_data *frame)
+		struct video_data *frame)
 {
-	gs_stagesurf_t *surface = video->copy_surfaces[prev_texture];
+	gs_stagesurf_t *surface =
+		video->copy_surfaces[video->first_copy_surface];
 
-	if (!video->textures_copied[prev_texture])
+	/* the newest surface was only just staged this frame */
+	if (video->copies_queued < 2)
 		return false;
 
+	/* rather than stalling on a copy the GPU has not finished yet, the
+	 * surface is kept for a later frame.  once every surface is in use
+	 * the oldest one has to be mapped so the next frame can be staged */
+	if (video->copies_queued < NUM_COPY_SURFACES &&
+	    !gs_stagesurface_is_ready(surface)) {
+		video->readback_skips++;
+		return false;
+	}
+
+	video->first_copy_surface =
+		(video->first_copy_surface + 1) % NUM_COPY_SURFACES;
+	video->copies_queued--;
+
 	if (!gs_stagesurface_map(surface, &frame->data[0], &frame->linesize[0]))
 		return false;
 
@@ -758,6 +841,29 @@ static const char *output_frame_render_video_name = "render_video";
 static const char *output_frame_download_frame_name = "download_frame";
 static const char *output_frame_gs_flush_name = "gs_flush";
 static const char *output_frame_output_video_data_name = "output_video_data";
+/* the renderer keeps a running total of the graphics API calls it made, so
+ * the difference between two frames covers everything rendered in between,
+ * including the displays */
+static inline void count_api_calls(struct obs_core_video *video)
+{
+	uint64_t calls = gs_get_api_calls();
+	uint64_t delta;
+
+	if (!calls)
+		return;
+
+	if (!video->api_calls_last) {
+		video->api_calls_start = calls;
+	} else {
+		delta = calls - video->api_calls_last;
+		if (delta > video->api_calls_peak)
+			video->api_calls_peak = delta;
+		video->api_call_frames++;
+	}
+
+	video->api_calls_last = calls;
+}
+
 static inline void output_frame(bool raw_active, const bool gpu_active)
 {
 	struct obs_core_video *video = &obs->video;
@@ -765,20 +871,22 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	int prev_texture = cur_texture == 0 ? NUM_TEXTURES-1 : cur_texture-1;
 	struct video_data frame;
 	bool active = raw_active || gpu_active;
-	bool frame_ready;
+	bool frame_ready = false;
 
 	memset(&frame, 0, sizeof(struct video_data));
 
 	profile_start(output_frame_gs_context_name);
 	gs_enter_context(video->graphics);
 
+	count_api_calls(video);
+
 	profile_start(output_frame_render_video_name);
 	render_video(video, raw_active, gpu_active, cur_texture, prev_texture);
 	profile_end(output_frame_render_video_name);
 
 	if (raw_active) {
 		profile_start(output_frame_download_frame_name);
-		frame_ready = download_frame(video, prev_texture, &frame);
+		frame_ready = download_frame(video, &frame);
 		profile_end(output_frame_download_frame_name);
 	}
 
@@ -809,7 +917,8 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 static void clear_base_frame_data(void)
 {
 	struct obs_core_video *video = &obs->video;
-	memset(video->textures_copied, 0, sizeof(video->textures_copied));
+	video->first_copy_surface = 0;
+	video->copies_queued = 0;
 	memset(video->textures_converted, 0, sizeof(video->textures_converted));
 	circlebuf_free(&video->vframe_info_buffer);
 	video->cur_texture = 0;
@@ -818,7 +927,8 @@ static void clear_base_frame_data(void)
 static void clear_raw_frame_data(void)
 {
 	struct obs_core_video *video = &obs->video;
-	memset(video->textures_copied, 0, sizeof(video->textures_copied));
+	video->first_copy_surface = 0;
+	video->copies_queued = 0;
 	memset(video->textures_converted, 0, sizeof(video->textures_converted));
 	circlebuf_free(&video->vframe_info_buffer);
 }
@@ -831,6 +941,54 @@ static void clear_gpu_frame_data(void)
 }
 #endif
 
+/* allocator calls made by the whole process while the graphics thread runs,
+ * reported per rendered frame */
+struct alloc_snapshot {
+	struct bmem_tag_stats tags[BMEM_TAG_COUNT];
+	uint64_t              system_calls;
+};
+
+static void get_alloc_snapshot(struct alloc_snapshot *snap)
+{
+	for (size_t i = 0; i < BMEM_TAG_COUNT; i++)
+		bmem_get_tag_stats((enum bmem_tag)i, &snap->tags[i]);
+	snap->system_calls = bmem_get_system_calls();
+}
+
+static void log_alloc_stats(const struct alloc_snapshot *start,
+		uint64_t frames)
+{
+	struct alloc_snapshot end;
+	uint64_t calls = 0;
+
+	if (!frames)
+		return;
+
+	get_alloc_snapshot(&end);
+
+	for (size_t i = 0; i < BMEM_TAG_COUNT; i++)
+		calls += end.tags[i].calls - start->tags[i].calls;
+
+	blog(LOG_INFO, "Allocator calls per frame (%s allocator): %.1f, "
+			"%.1f reaching the system allocator",
+			bmem_arena_active() ? "arena" : "system",
+			(double)calls / (double)frames,
+			(double)(end.system_calls - start->system_calls) /
+			(double)frames);
+
+	for (size_t i = 0; i < BMEM_TAG_COUNT; i++) {
+		uint64_t tag_calls = end.tags[i].calls - start->tags[i].calls;
+		uint64_t tag_bytes = end.tags[i].bytes - start->tags[i].bytes;
+
+		if (tag_calls)
+			blog(LOG_INFO, "\t%s: %.1f calls, %.1f KB per frame",
+					bmem_get_tag_name((enum bmem_tag)i),
+					(double)tag_calls / (double)frames,
+					(double)tag_bytes / 1024.0 /
+					(double)frames);
+	}
+}
+
 static const char *tick_sources_name = "tick_sources";
 static const char *render_displays_name = "render_displays";
 static const char *output_frame_name = "output_frame";
@@ -841,6 +999,8 @@ void *obs_graphics_thread(void *param)
 	uint64_t frame_time_total_ns = 0;
 	uint64_t fps_total_ns = 0;
 	uint32_t fps_total_frames = 0;
+	uint64_t frames = 0;
+	struct alloc_snapshot alloc_start;
 	bool gpu_was_active = false;
 	bool raw_was_active = false;
 	bool was_active = false;
@@ -856,6 +1016,8 @@ void *obs_graphics_thread(void *param)
 
 	srand((unsigned int)time(NULL));
 
+	get_alloc_snapshot(&alloc_start);
+
 	while (!video_output_stopped(obs->video.video)) {
 		uint64_t frame_start = os_gettime_ns();
 		uint64_t frame_time_ns;
@@ -885,6 +1047,8 @@ void *obs_graphics_thread(void *param)
 		last_time = tick_sources(obs->video.video_time, last_time);
 		profile_end(tick_sources_name);
 
+		obs->video.render_frame++;
+
 		profile_start(output_frame_name);
 		output_frame(raw_active, gpu_active);
 		profile_end(output_frame_name);
@@ -894,6 +1058,8 @@ void *obs_graphics_thread(void *param)
 		profile_end(render_displays_name);
 
 		frame_time_ns = os_gettime_ns() - frame_start;
+		obs_metric_observe(obs->video.frame_time_metric,
+				(double)frame_time_ns / 1000000000.0);
 
 		profile_end(video_thread_name);
 
@@ -905,6 +1071,7 @@ void *obs_graphics_thread(void *param)
 		frame_time_total_ns += frame_time_ns;
 		fps_total_ns += (obs->video.video_time - last_time);
 		fps_total_frames++;
+		frames++;
 
 		if (fps_total_ns >= 1000000000ULL) {
 			obs->video.video_fps = (double)fps_total_frames /
@@ -918,6 +1085,34 @@ void *obs_graphics_thread(void *param)
 		}
 	}
 
+	if (obs->video.main_frames)
+		blog(LOG_INFO, "Main texture reused for %"PRIu32" of %"PRIu32
+				" frames (%.1f%%)",
+				obs->video.static_frames,
+				obs->video.main_frames,
+				(double)obs->video.static_frames * 100.0 /
+				(double)obs->video.main_frames);
+
+	if (obs->video.render_cache_hits || obs->video.render_cache_misses)
+		blog(LOG_INFO, "Source render cache: %"PRIu64" renders, "
+				"%"PRIu64" reused",
+				obs->video.render_cache_misses,
+				obs->video.render_cache_hits);
+
+	if (obs->video.readback_skips)
+		blog(LOG_INFO, "Frames delayed waiting for readback: %"PRIu32,
+				obs->video.readback_skips);
+
+	if (obs->video.api_call_frames)
+		blog(LOG_INFO, "Graphics API calls per frame: %.1f average, "
+				"%"PRIu64" peak",
+				(double)(obs->video.api_calls_last -
+					obs->video.api_calls_start) /
+				(double)obs->video.api_call_frames,
+				obs->video.api_calls_peak);
+
+	log_alloc_stats(&alloc_start, frames);
+
 	UNUSED_PARAMETER(param);
 	return NULL;
 }
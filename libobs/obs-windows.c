@@ -575,6 +575,23 @@ bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *context,
 	return vk_down(obs_key_to_virtual_key(key));
 }
 
+bool obs_hotkeys_platform_has_events(obs_hotkeys_platform_t *context)
+{
+	UNUSED_PARAMETER(context);
+	return false;
+}
+
+bool obs_hotkeys_platform_wait_event(obs_hotkeys_platform_t *context)
+{
+	UNUSED_PARAMETER(context);
+	return false;
+}
+
+void obs_hotkeys_platform_wake(obs_hotkeys_platform_t *context)
+{
+	UNUSED_PARAMETER(context);
+}
+
 void obs_key_to_str(obs_key_t key, struct dstr *str)
 {
 	wchar_t name[128] = L"";
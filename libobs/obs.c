@@ -215,7 +215,7 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 		video->conversion_height : ovi->output_height;
 	size_t i;
 
-	for (i = 0; i < NUM_TEXTURES; i++) {
+	for (i = 0; i < NUM_COPY_SURFACES; i++) {
 #ifdef _WIN32
 		if (video->using_nv12_tex) {
 			video->copy_surfaces[i] = gs_stagesurface_create_nv12(
@@ -233,7 +233,9 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 #ifdef _WIN32
 		}
 #endif
+	}
 
+	for (i = 0; i < NUM_TEXTURES; i++) {
 		video->render_textures[i] = gs_texture_create(
 				ovi->base_width, ovi->base_height,
 				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
@@ -287,6 +289,17 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 
 	gs_enter_context(video->graphics);
 
+	if (obs->module_config_path) {
+		struct dstr cache_path = {0};
+		dstr_copy(&cache_path, obs->module_config_path);
+		if (dstr_end(&cache_path) != '/')
+			dstr_cat_ch(&cache_path, '/');
+		dstr_catf(&cache_path, "%s/shader-cache",
+				ovi->graphics_module);
+		gs_set_shader_cache_path(cache_path.array);
+		dstr_free(&cache_path);
+	}
+
 	char *filename = obs_find_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename,
 			NULL);
@@ -418,6 +431,8 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	}
 
+	obs_init_video_metrics();
+
 	gs_enter_context(video->graphics);
 
 	if (ovi->gpu_conversion && !obs_init_gpu_conversion(ovi))
@@ -464,6 +479,8 @@ static void obs_free_video(void)
 	struct obs_core_video *video = &obs->video;
 
 	if (video->video) {
+		obs_free_video_metrics();
+
 		video_output_close(video->video);
 		video->video = NULL;
 
@@ -477,14 +494,17 @@ static void obs_free_video(void)
 			video->mapped_surface = NULL;
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t i = 0; i < NUM_COPY_SURFACES; i++) {
 			gs_stagesurface_destroy(video->copy_surfaces[i]);
+			video->copy_surfaces[i] = NULL;
+		}
+
+		for (size_t i = 0; i < NUM_TEXTURES; i++) {
 			gs_texture_destroy(video->render_textures[i]);
 			gs_texture_destroy(video->convert_textures[i]);
 			gs_texture_destroy(video->convert_uv_textures[i]);
 			gs_texture_destroy(video->output_textures[i]);
 
-			video->copy_surfaces[i]       = NULL;
 			video->render_textures[i]     = NULL;
 			video->convert_textures[i]    = NULL;
 			video->convert_uv_textures[i] = NULL;
@@ -500,8 +520,8 @@ static void obs_free_video(void)
 				sizeof(video->textures_rendered));
 		memset(&video->textures_output, 0,
 				sizeof(video->textures_output));
-		memset(&video->textures_copied, 0,
-				sizeof(video->textures_copied));
+		video->first_copy_surface = 0;
+		video->copies_queued = 0;
 		memset(&video->textures_converted, 0,
 				sizeof(video->textures_converted));
 
@@ -776,6 +796,7 @@ static inline void stop_hotkeys(void)
 
 	if (hotkeys->hotkey_thread_initialized) {
 		os_event_signal(hotkeys->stop_event);
+		obs_hotkeys_platform_wake(hotkeys->platform_context);
 		pthread_join(hotkeys->hotkey_thread, &thread_ret);
 		hotkeys->hotkey_thread_initialized = false;
 	}
@@ -806,6 +827,30 @@ extern const struct obs_source_info group_info;
 
 extern void log_system_info(void);
 
+static bool obs_init_module_loading(void)
+{
+	pthread_mutexattr_t attr;
+	bool success = false;
+
+	if (pthread_mutex_init(&obs->modules_mutex, NULL) != 0)
+		return false;
+
+	/* lazily loaded modules can look up the types of other deferred
+	 * modules while they are being loaded */
+	if (pthread_mutexattr_init(&attr) != 0)
+		return false;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		goto fail;
+	if (pthread_mutex_init(&obs->module_load_mutex, &attr) != 0)
+		goto fail;
+
+	success = true;
+
+fail:
+	pthread_mutexattr_destroy(&attr);
+	return success;
+}
+
 static bool obs_init(const char *locale, const char *module_config_path,
 		profiler_name_store_t *store)
 {
@@ -813,6 +858,9 @@ static bool obs_init(const char *locale, const char *module_config_path,
 
 	pthread_mutex_init_value(&obs->audio.monitoring_mutex);
 	pthread_mutex_init_value(&obs->video.gpu_encoder_mutex);
+	pthread_mutex_init_value(&obs->metrics.mutex);
+	pthread_mutex_init_value(&obs->modules_mutex);
+	pthread_mutex_init_value(&obs->module_load_mutex);
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -829,6 +877,10 @@ static bool obs_init(const char *locale, const char *module_config_path,
 		return false;
 	if (!obs_init_hotkeys())
 		return false;
+	if (!obs_init_metrics())
+		return false;
+	if (!obs_init_module_loading())
+		return false;
 
 	if (module_config_path)
 		obs->module_config_path = bstrdup(module_config_path);
@@ -957,12 +1009,21 @@ void obs_shutdown(void)
 	if (!obs)
 		return;
 
+	/* modules that were never used are not loaded just to be unloaded
+	 * again by a type lookup during shutdown */
+	pthread_mutex_lock(&obs->modules_mutex);
+	for (size_t i = 0; i < obs->deferred_modules.num; i++)
+		free_deferred_module(obs->deferred_modules.array+i);
+	da_free(obs->deferred_modules);
+	pthread_mutex_unlock(&obs->modules_mutex);
+
 #define FREE_REGISTERED_TYPES(structure, list) \
 	do { \
 		for (size_t i = 0; i < list.num; i++) { \
-			struct structure *item = &list.array[i]; \
+			struct structure *item = list.array[i]; \
 			if (item->type_data && item->free_type_data) \
 				item->free_type_data(item->type_data); \
+			bfree(item); \
 		} \
 		da_free(list); \
 	} while (false)
@@ -988,6 +1049,7 @@ void obs_shutdown(void)
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	obs_free_metrics();
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -1004,6 +1066,9 @@ void obs_shutdown(void)
 	}
 	core->first_module = NULL;
 
+	pthread_mutex_destroy(&core->modules_mutex);
+	pthread_mutex_destroy(&core->module_load_mutex);
+
 	for (size_t i = 0; i < core->module_paths.num; i++)
 		free_module_path(core->module_paths.array+i);
 	da_free(core->module_paths);
@@ -1046,7 +1111,10 @@ void obs_set_locale(const char *locale)
 		bfree(obs->locale);
 	obs->locale = bstrdup(locale);
 
+	pthread_mutex_lock(&obs->modules_mutex);
 	module = obs->first_module;
+	pthread_mutex_unlock(&obs->modules_mutex);
+
 	while (module) {
 		if (module->set_locale)
 			module->set_locale(locale);
@@ -1199,72 +1267,142 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 
 bool obs_enum_source_types(size_t idx, const char **id)
 {
+	bool success = false;
+
 	if (!obs) return false;
 
-	if (idx >= obs->source_types.num)
-		return false;
-	*id = obs->source_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules(OBS_TYPE_CLASS_SOURCE);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	if (idx < obs->source_types.num) {
+		*id = obs->source_types.array[idx]->id;
+		success = true;
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return success;
 }
 
 bool obs_enum_input_types(size_t idx, const char **id)
 {
+	bool success = false;
+
 	if (!obs) return false;
 
-	if (idx >= obs->input_types.num)
-		return false;
-	*id = obs->input_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules(OBS_TYPE_CLASS_SOURCE);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	if (idx < obs->input_types.num) {
+		*id = obs->input_types.array[idx]->id;
+		success = true;
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return success;
 }
 
 bool obs_enum_filter_types(size_t idx, const char **id)
 {
+	bool success = false;
+
 	if (!obs) return false;
 
-	if (idx >= obs->filter_types.num)
-		return false;
-	*id = obs->filter_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules(OBS_TYPE_CLASS_SOURCE);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	if (idx < obs->filter_types.num) {
+		*id = obs->filter_types.array[idx]->id;
+		success = true;
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return success;
 }
 
 bool obs_enum_transition_types(size_t idx, const char **id)
 {
+	bool success = false;
+
 	if (!obs) return false;
 
-	if (idx >= obs->transition_types.num)
-		return false;
-	*id = obs->transition_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules(OBS_TYPE_CLASS_SOURCE);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	if (idx < obs->transition_types.num) {
+		*id = obs->transition_types.array[idx]->id;
+		success = true;
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return success;
 }
 
 bool obs_enum_output_types(size_t idx, const char **id)
 {
+	bool success = false;
+
 	if (!obs) return false;
 
-	if (idx >= obs->output_types.num)
-		return false;
-	*id = obs->output_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules(OBS_TYPE_CLASS_OUTPUT);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	if (idx < obs->output_types.num) {
+		*id = obs->output_types.array[idx]->id;
+		success = true;
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return success;
 }
 
 bool obs_enum_encoder_types(size_t idx, const char **id)
 {
+	bool success = false;
+
 	if (!obs) return false;
 
-	if (idx >= obs->encoder_types.num)
-		return false;
-	*id = obs->encoder_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules(OBS_TYPE_CLASS_ENCODER);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	if (idx < obs->encoder_types.num) {
+		*id = obs->encoder_types.array[idx]->id;
+		success = true;
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return success;
 }
 
 bool obs_enum_service_types(size_t idx, const char **id)
 {
+	bool success = false;
+
 	if (!obs) return false;
 
-	if (idx >= obs->service_types.num)
-		return false;
-	*id = obs->service_types.array[idx].id;
-	return true;
+	if (idx == 0)
+		obs_load_deferred_modules(OBS_TYPE_CLASS_SERVICE);
+
+	pthread_mutex_lock(&obs->modules_mutex);
+
+	if (idx < obs->service_types.num) {
+		*id = obs->service_types.array[idx]->id;
+		success = true;
+	}
+
+	pthread_mutex_unlock(&obs->modules_mutex);
+	return success;
 }
 
 void obs_enter_graphics(void)
@@ -1294,7 +1432,7 @@ static inline struct obs_modal_ui *get_modal_ui_callback(const char *id,
 		const char *task, const char *target)
 {
 	for (size_t i = 0; i < obs->modal_ui_callbacks.num; i++) {
-		struct obs_modal_ui *callback = obs->modal_ui_callbacks.array+i;
+		struct obs_modal_ui *callback = obs->modal_ui_callbacks.array[i];
 
 		if (strcmp(callback->id,     id)     == 0 &&
 		    strcmp(callback->task,   task)   == 0 &&
@@ -1310,7 +1448,7 @@ static inline struct obs_modeless_ui *get_modeless_ui_callback(const char *id,
 {
 	for (size_t i = 0; i < obs->modeless_ui_callbacks.num; i++) {
 		struct obs_modeless_ui *callback;
-		callback = obs->modeless_ui_callbacks.array+i;
+		callback = obs->modeless_ui_callbacks.array[i];
 
 		if (strcmp(callback->id,     id)     == 0 &&
 		    strcmp(callback->task,   task)   == 0 &&
@@ -1364,7 +1502,8 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 
 	struct obs_source *prev_source;
 	struct obs_view *view = &obs->data.main_view;
-	struct calldata params = {0};
+	struct calldata params;
+	uint8_t stack[128];
 
 	pthread_mutex_lock(&view->channels_mutex);
 
@@ -1372,6 +1511,7 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 
 	prev_source = view->channels[channel];
 
+	calldata_init_stack(&params, stack, sizeof(stack));
 	calldata_set_int(&params, "channel", channel);
 	calldata_set_ptr(&params, "prev_source", prev_source);
 	calldata_set_ptr(&params, "source", source);
@@ -1661,10 +1801,12 @@ gs_texture_t *obs_get_main_texture(void)
 
 void obs_set_master_volume(float volume)
 {
-	struct calldata data = {0};
+	struct calldata data;
+	uint8_t stack[128];
 
 	if (!obs) return;
 
+	calldata_init_stack(&data, stack, sizeof(stack));
 	calldata_set_float(&data, "volume", volume);
 	signal_handler_signal(obs->signals, "master_volume", &data);
 	volume = (float)calldata_float(&data, "volume");
@@ -1678,14 +1820,9 @@ float obs_get_master_volume(void)
 	return obs ? obs->audio.user_volume : 0.0f;
 }
 
-static obs_source_t *obs_load_source_type(obs_data_t *source_data)
+static void obs_load_source_settings(obs_source_t *source,
+		obs_data_t *source_data)
 {
-	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
-	obs_source_t *source;
-	const char   *name    = obs_data_get_string(source_data, "name");
-	const char   *id      = obs_data_get_string(source_data, "id");
-	obs_data_t   *settings = obs_data_get_obj(source_data, "settings");
-	obs_data_t   *hotkeys  = obs_data_get_obj(source_data, "hotkeys");
 	double       volume;
 	double       balance;
 	int64_t      sync;
@@ -1695,10 +1832,6 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 	int          di_mode;
 	int          monitoring_type;
 
-	source = obs_source_create(id, name, settings, hotkeys);
-
-	obs_data_release(hotkeys);
-
 	obs_data_set_default_double(source_data, "volume", 1.0);
 	volume = obs_data_get_double(source_data, "volume");
 	obs_source_set_volume(source, (float)volume);
@@ -1758,6 +1891,22 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 		obs_data_get_obj(source_data, "private_settings");
 	if (!source->private_settings)
 		source->private_settings = obs_data_create();
+}
+
+static obs_source_t *obs_load_source_type(obs_data_t *source_data)
+{
+	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
+	obs_source_t *source;
+	const char   *name    = obs_data_get_string(source_data, "name");
+	const char   *id      = obs_data_get_string(source_data, "id");
+	obs_data_t   *settings = obs_data_get_obj(source_data, "settings");
+	obs_data_t   *hotkeys  = obs_data_get_obj(source_data, "hotkeys");
+
+	source = obs_source_create(id, name, settings, hotkeys);
+
+	obs_data_release(hotkeys);
+
+	obs_load_source_settings(source, source_data);
 
 	if (filters) {
 		size_t count = obs_data_array_count(filters);
@@ -1789,14 +1938,258 @@ obs_source_t *obs_load_source(obs_data_t *source_data)
 	return obs_load_source_type(source_data);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Scene collection loading
+ *
+ * A collection is loaded in three passes:
+ *
+ * 1. every source and filter is allocated and added to the source list in
+ *    collection order, without calling its create callback
+ * 2. the create callbacks are called.  Sources with
+ *    OBS_SOURCE_PARALLEL_CREATE are spread over a pool of worker threads,
+ *    all other sources are created in order on the loading thread
+ * 3. in collection order again, the sources are finished (source_create
+ *    signal, saved settings, filters), and then loaded
+ *
+ * Scenes only reference their items by name and create them in their load
+ * callback, so all scene items resolve to fully created sources. */
+
+#define MAX_LOAD_THREADS 8
+
+struct source_load_job {
+	obs_source_t *source;
+	void         *data;
+	uint64_t     create_ns;
+	bool         parallel;
+};
+
+struct source_load_type {
+	const char   *id;
+	size_t       count;
+	uint64_t     create_ns;
+	uint64_t     load_ns;
+};
+
+struct source_loader {
+	DARRAY(struct source_load_job)  jobs;
+	DARRAY(struct source_load_type) types;
+	volatile long                   next_job;
+};
+
+static void prepare_source_load(struct source_loader *loader,
+		obs_data_t *source_data)
+{
+	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
+	const char   *name     = obs_data_get_string(source_data, "name");
+	const char   *id       = obs_data_get_string(source_data, "id");
+	obs_data_t   *settings = obs_data_get_obj(source_data, "settings");
+	obs_data_t   *hotkeys  = obs_data_get_obj(source_data, "hotkeys");
+	struct source_load_job *job = da_push_back_new(loader->jobs);
+
+	job->source = obs_source_create_deferred(id, name, settings, hotkeys);
+	job->parallel = job->source &&
+		(job->source->info.output_flags &
+		 OBS_SOURCE_PARALLEL_CREATE) != 0;
+
+	obs_data_release(hotkeys);
+	obs_data_release(settings);
+
+	/* filters are pushed after their source, which is the order that
+	 * finish_source_load consumes them in */
+	if (filters) {
+		size_t count = obs_data_array_count(filters);
+
+		for (size_t i = 0; i < count; i++) {
+			obs_data_t *filter_data =
+				obs_data_array_item(filters, i);
+			prepare_source_load(loader, filter_data);
+			obs_data_release(filter_data);
+		}
+
+		obs_data_array_release(filters);
+	}
+}
+
+static void run_source_load_job(struct source_load_job *job)
+{
+	uint64_t start = os_gettime_ns();
+
+	job->data = obs_source_create_data(job->source);
+	job->create_ns = os_gettime_ns() - start;
+}
+
+static void run_parallel_load_jobs(struct source_loader *loader)
+{
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&loader->next_job) - 1;
+		if (idx >= loader->jobs.num)
+			break;
+
+		if (loader->jobs.array[idx].parallel)
+			run_source_load_job(&loader->jobs.array[idx]);
+	}
+}
+
+static void *source_load_thread(void *param)
+{
+	os_set_thread_name("libobs: source loader");
+	run_parallel_load_jobs(param);
+	return NULL;
+}
+
+static void run_source_load_jobs(struct source_loader *loader)
+{
+	pthread_t threads[MAX_LOAD_THREADS];
+	size_t num_threads = 0;
+	size_t num_parallel = 0;
+	size_t max_threads;
+
+	for (size_t i = 0; i < loader->jobs.num; i++) {
+		if (loader->jobs.array[i].parallel)
+			num_parallel++;
+	}
+
+	/* the loading thread takes parallel jobs as well once it is done with
+	 * the ones that have to be created in order */
+	max_threads = (size_t)os_get_logical_cores();
+	if (max_threads > MAX_LOAD_THREADS)
+		max_threads = MAX_LOAD_THREADS;
+
+	while (num_threads + 1 < max_threads && num_threads + 1 < num_parallel) {
+		if (pthread_create(&threads[num_threads], NULL,
+					source_load_thread, loader) != 0)
+			break;
+		num_threads++;
+	}
+
+	for (size_t i = 0; i < loader->jobs.num; i++) {
+		struct source_load_job *job = &loader->jobs.array[i];
+		if (job->source && !job->parallel)
+			run_source_load_job(job);
+	}
+
+	run_parallel_load_jobs(loader);
+
+	for (size_t i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+}
+
+static struct source_load_type *get_source_load_type(
+		struct source_loader *loader, const char *id)
+{
+	struct source_load_type *type;
+
+	for (size_t i = 0; i < loader->types.num; i++) {
+		type = &loader->types.array[i];
+		if (strcmp(type->id, id) == 0)
+			return type;
+	}
+
+	type = da_push_back_new(loader->types);
+	type->id = id;
+	return type;
+}
+
+static obs_source_t *finish_source_load(struct source_loader *loader,
+		obs_data_t *source_data, size_t *idx)
+{
+	struct source_load_job *job = &loader->jobs.array[(*idx)++];
+	obs_data_array_t *filters;
+	obs_source_t *source = job->source;
+
+	if (source) {
+		struct source_load_type *type =
+			get_source_load_type(loader, source->info.id);
+		type->count++;
+		type->create_ns += job->create_ns;
+
+		obs_source_finish_create(source, job->data);
+		obs_load_source_settings(source, source_data);
+	}
+
+	filters = obs_data_get_array(source_data, "filters");
+	if (filters) {
+		size_t count = obs_data_array_count(filters);
+
+		for (size_t i = 0; i < count; i++) {
+			obs_data_t *filter_data =
+				obs_data_array_item(filters, i);
+
+			obs_source_t *filter = finish_source_load(loader,
+					filter_data, idx);
+			if (filter) {
+				if (source)
+					obs_source_filter_add(source, filter);
+				obs_source_release(filter);
+			}
+
+			obs_data_release(filter_data);
+		}
+
+		obs_data_array_release(filters);
+	}
+
+	return source;
+}
+
+static void log_source_load(struct source_loader *loader, size_t count,
+		uint64_t load_ns)
+{
+	size_t num_parallel = 0;
+
+	for (size_t i = 0; i < loader->jobs.num; i++) {
+		if (loader->jobs.array[i].parallel)
+			num_parallel++;
+	}
+
+	blog(LOG_INFO, "Loaded %d sources (%d including filters, %d created in "
+			"parallel) in %.2f ms",
+			(int)count, (int)loader->jobs.num, (int)num_parallel,
+			(double)load_ns / 1000000.0);
+
+	for (size_t i = 0; i < loader->types.num; i++) {
+		struct source_load_type *type = &loader->types.array[i];
+
+		blog(LOG_INFO, "    %s: %d, create %.2f ms, load %.2f ms",
+				type->id, (int)type->count,
+				(double)type->create_ns / 1000000.0,
+				(double)type->load_ns / 1000000.0);
+	}
+}
+
+/* loading a module runs its code, which may lock the sources mutex, so the
+ * deferred modules of a collection are loaded before it is locked */
+static void load_source_modules(obs_data_array_t *array)
+{
+	size_t count = obs_data_array_count(array);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *source_data = obs_data_array_item(array, i);
+		obs_data_array_t *filters =
+			obs_data_get_array(source_data, "filters");
+
+		get_source_info(obs_data_get_string(source_data, "id"));
+
+		if (filters) {
+			load_source_modules(filters);
+			obs_data_array_release(filters);
+		}
+
+		obs_data_release(source_data);
+	}
+}
+
 void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 		void *private_data)
 {
 	if (!obs) return;
 
 	struct obs_core_data *data = &obs->data;
+	struct source_loader loader = {0};
 	DARRAY(obs_source_t*) sources;
+	uint64_t start = os_gettime_ns();
 	size_t count;
+	size_t idx = 0;
 	size_t i;
 
 	da_init(sources);
@@ -1804,11 +2197,27 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 	count = obs_data_array_count(array);
 	da_reserve(sources, count);
 
+	if (obs_have_deferred_modules())
+		load_source_modules(array);
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	for (i = 0; i < count; i++) {
+		obs_data_t *source_data = obs_data_array_item(array, i);
+		prepare_source_load(&loader, source_data);
+		obs_data_release(source_data);
+	}
+
+	/* create callbacks are allowed to create or look up other sources,
+	 * which needs the sources mutex on the worker threads */
+	pthread_mutex_unlock(&data->sources_mutex);
+	run_source_load_jobs(&loader);
 	pthread_mutex_lock(&data->sources_mutex);
 
 	for (i = 0; i < count; i++) {
 		obs_data_t   *source_data = obs_data_array_item(array, i);
-		obs_source_t *source      = obs_load_source(source_data);
+		obs_source_t *source      = finish_source_load(&loader,
+				source_data, &idx);
 
 		da_push_back(sources, &source);
 
@@ -1820,20 +2229,29 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 		obs_source_t *source = sources.array[i];
 		obs_data_t *source_data = obs_data_array_item(array, i);
 		if (source) {
+			uint64_t load_start = os_gettime_ns();
+
 			if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 				obs_transition_load(source, source_data);
 			obs_source_load(source);
 			if (cb)
 				cb(private_data, source);
+
+			get_source_load_type(&loader, source->info.id)->load_ns
+				+= os_gettime_ns() - load_start;
 		}
 		obs_data_release(source_data);
 	}
 
+	log_source_load(&loader, count, os_gettime_ns() - start);
+
 	for (i = 0; i < sources.num; i++)
 		obs_source_release(sources.array[i]);
 
 	pthread_mutex_unlock(&data->sources_mutex);
 
+	da_free(loader.types);
+	da_free(loader.jobs);
 	da_free(sources);
 }
 
@@ -2254,6 +2672,11 @@ uint32_t obs_get_lagged_frames(void)
 	return obs ? obs->video.lagged_frames : 0;
 }
 
+uint32_t obs_get_static_frames(void)
+{
+	return obs ? obs->video.static_frames : 0;
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param)
@@ -62,6 +62,7 @@ typedef struct obs_service    obs_service_t;
 typedef struct obs_module     obs_module_t;
 typedef struct obs_fader      obs_fader_t;
 typedef struct obs_volmeter   obs_volmeter_t;
+typedef struct obs_metric     obs_metric_t;
 
 typedef struct obs_weak_source  obs_weak_source_t;
 typedef struct obs_weak_output  obs_weak_output_t;
@@ -435,6 +436,21 @@ EXPORT void obs_add_module_path(const char *bin, const char *data);
 /** Automatically loads all modules from module paths (convenience function) */
 EXPORT void obs_load_all_modules(void);
 
+/**
+ * Enables lazy module loading, must be called before obs_load_all_modules.
+ *
+ *   obs_load_all_modules writes a manifest of the source, output, encoder and
+ * service types that each module registers to the module config path.
+ * Modules that are listed in it with an unchanged binary are then not loaded
+ * at startup, but the first time one of their types is looked up or types
+ * of that kind are enumerated, on whichever thread does so.  Modules that
+ * register no types, or that register UI callbacks, are always loaded.
+ *
+ *   obs_module_load runs with the lock that protects the type lists held, so
+ * modules loaded this way should only register their types from it.
+ */
+EXPORT void obs_set_lazy_module_loading(bool enable);
+
 /** Notifies modules that all modules have been loaded.  This function should
  * be called after all modules have been loaded. */
 EXPORT void obs_post_load_modules(void);
@@ -714,6 +730,10 @@ EXPORT uint64_t obs_get_average_frame_time_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/** Gets the number of frames for which the main texture was reused because
+ * nothing in the main view changed */
+EXPORT uint32_t obs_get_static_frames(void);
+
 EXPORT bool obs_nv12_tex_active(void);
 
 EXPORT void obs_apply_private_data(obs_data_t *settings);
@@ -1132,6 +1152,12 @@ EXPORT void obs_source_output_audio(obs_source_t *source,
 /** Signal an update to any currently used properties via 'update_properties' */
 EXPORT void obs_source_update_properties(obs_source_t *source);
 
+/**
+ * Signals that the output of a source with OBS_SOURCE_STATIC_CONTENT has
+ * changed, for example when it reloads an image or advances an animation.
+ */
+EXPORT void obs_source_content_changed(obs_source_t *source);
+
 /** Gets the current async video frame */
 EXPORT struct obs_source_frame *obs_source_get_frame(obs_source_t *source);
 
@@ -1178,6 +1204,13 @@ EXPORT void obs_source_process_filter_tech_end(obs_source_t *filter,
 /** Skips the filter if the filter is invalid and cannot be rendered */
 EXPORT void obs_source_skip_video_filter(obs_source_t *filter);
 
+/**
+ * Gets a uniform of a fusable filter (OBS_SOURCE_FUSABLE) from the combined
+ * effect passed to its set_fused_params callback.
+ */
+EXPORT gs_eparam_t *obs_fused_effect_get_param(gs_effect_t *effect,
+		const char *prefix, const char *name);
+
 /**
  * Adds an active child source.  Must be called by parent sources on child
  * sources when the child is added and active.  This ensures that the source is
@@ -1779,6 +1812,20 @@ EXPORT void obs_output_end_data_capture(obs_output_t *output);
  */
 EXPORT void obs_output_signal_stop(obs_output_t *output, int code);
 
+/**
+ * Signals that an encoded packet has been written out.
+ *
+ * Outputs with the OBS_OUTPUT_ASYNC_SEND flag, which write packets from
+ * their own thread, call this once a video packet has actually been sent so
+ * that the latency of its frame covers the send.  For other outputs the
+ * frame latency ends when their encoded_packet callback returns.
+ *
+ * @param  output  Output context
+ * @param  packet  Packet that was sent
+ */
+EXPORT void obs_output_packet_sent(obs_output_t *output,
+		const struct encoder_packet *packet);
+
 
 /* ------------------------------------------------------------------------- */
 /* Encoders */
@@ -2025,6 +2072,64 @@ EXPORT const char *obs_service_get_id(const obs_service_t *service);
 EXPORT const char *obs_service_get_output_type(const obs_service_t *service);
 
 
+/* ------------------------------------------------------------------------- */
+/* Metrics */
+
+enum obs_metric_type {
+	OBS_METRIC_COUNTER,
+	OBS_METRIC_GAUGE,
+	OBS_METRIC_HISTOGRAM
+};
+
+typedef double (*obs_metric_collect_t)(void *param);
+
+/**
+ * Creates a counter or gauge in the metrics registry.
+ *
+ * @param  name    Metric name, following the Prometheus naming rules
+ * @param  labels  Optional label list without braces, for example
+ *                 output="simple_stream".  Metrics sharing a name must
+ *                 differ by their labels.
+ * @param  help    Description of the metric
+ */
+EXPORT obs_metric_t *obs_metric_create(enum obs_metric_type type,
+		const char *name, const char *labels, const char *help);
+
+/**
+ * Creates a counter or gauge whose value is queried with the collect
+ * callback whenever the metrics are read, which costs nothing on the code
+ * paths that produce the value.  The callback may be called from any
+ * thread until the metric is destroyed, and must not block.
+ */
+EXPORT obs_metric_t *obs_metric_create_collected(enum obs_metric_type type,
+		const char *name, const char *labels, const char *help,
+		obs_metric_collect_t collect, void *param);
+
+/** Creates a histogram with the given ascending bucket upper bounds */
+EXPORT obs_metric_t *obs_metric_create_histogram(const char *name,
+		const char *labels, const char *help,
+		const double *bounds, size_t num_bounds);
+
+EXPORT void obs_metric_destroy(obs_metric_t *metric);
+
+/** Adds to a counter or gauge */
+EXPORT void obs_metric_add(obs_metric_t *metric, double val);
+/** Sets the value of a gauge */
+EXPORT void obs_metric_set(obs_metric_t *metric, double val);
+/** Records a value in a histogram */
+EXPORT void obs_metric_observe(obs_metric_t *metric, double val);
+
+/** Returns all metrics in the Prometheus text format.  Free with bfree */
+EXPORT char *obs_metrics_get_text(void);
+
+/**
+ * Serves the metrics on a Unix domain socket at the given path, both to
+ * HTTP GET requests and to plain connections.  Not available on Windows.
+ */
+EXPORT bool obs_metrics_start_server(const char *path);
+EXPORT void obs_metrics_stop_server(void);
+
+
 /* ------------------------------------------------------------------------- */
 /* Source frame allocation functions */
 EXPORT void obs_source_frame_init(struct obs_source_frame *frame,
@@ -35,8 +35,110 @@
 #define ALIGNMENT_HACK 1
 #endif
 
+/* ------------------------------------------------------------------------- */
+/* Thread data */
+
+/*
+ * Allocation statistics and the arena caches are kept per thread so that
+ * the allocator hot path never touches shared memory.  The thread data is
+ * linked into a global list the first time a thread allocates, and folded
+ * back into the global totals when the thread exits.
+ */
+
+#define ARENA_CLASSES 20
+
+struct arena_block {
+	struct arena_block *next;
+};
+
+struct arena_cache {
+	struct arena_block *head;
+	size_t             count;
+};
+
+struct bmem_thread {
+	struct bmem_tag_stats tags[BMEM_TAG_COUNT];
+	uint64_t              system_calls;
+	struct arena_cache    cache[ARENA_CLASSES];
+
+	bool                  registered;
+	bool                  exited;
+	struct bmem_thread    *prev;
+	struct bmem_thread    *next;
+};
+
+static THREAD_LOCAL struct bmem_thread thread_data;
+
+static pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+static struct bmem_thread *first_thread = NULL;
+static struct bmem_tag_stats retired_tags[BMEM_TAG_COUNT];
+static uint64_t retired_system_calls = 0;
+
+static void arena_flush_thread(struct bmem_thread *thread);
+
+static void thread_exit(void *data)
+{
+	struct bmem_thread *thread = data;
+
+	arena_flush_thread(thread);
+
+	pthread_mutex_lock(&thread_mutex);
+
+	for (size_t i = 0; i < BMEM_TAG_COUNT; i++) {
+		retired_tags[i].calls += thread->tags[i].calls;
+		retired_tags[i].bytes += thread->tags[i].bytes;
+	}
+	retired_system_calls += thread->system_calls;
+
+	if (thread->prev)
+		thread->prev->next = thread->next;
+	else
+		first_thread = thread->next;
+	if (thread->next)
+		thread->next->prev = thread->prev;
+
+	thread->exited = true;
+
+	pthread_mutex_unlock(&thread_mutex);
+}
+
+static void create_thread_key(void)
+{
+	pthread_key_create(&thread_key, thread_exit);
+}
+
+static void register_thread(struct bmem_thread *thread)
+{
+	thread->registered = true;
+
+	pthread_once(&thread_key_once, create_thread_key);
+	pthread_setspecific(thread_key, thread);
+
+	pthread_mutex_lock(&thread_mutex);
+	thread->next = first_thread;
+	if (first_thread)
+		first_thread->prev = thread;
+	first_thread = thread;
+	pthread_mutex_unlock(&thread_mutex);
+}
+
+static inline struct bmem_thread *get_thread(void)
+{
+	struct bmem_thread *thread = &thread_data;
+	if (!thread->registered)
+		register_thread(thread);
+	return thread;
+}
+
+/* ------------------------------------------------------------------------- */
+/* System allocator */
+
 static void *a_malloc(size_t size)
 {
+	get_thread()->system_calls++;
+
 #ifdef ALIGNED_MALLOC
 	return _aligned_malloc(size, ALIGNMENT);
 #elif ALIGNMENT_HACK
@@ -58,13 +160,16 @@ static void *a_malloc(size_t size)
 
 static void *a_realloc(void *ptr, size_t size)
 {
+	if (!ptr)
+		return a_malloc(size);
+
+	get_thread()->system_calls++;
+
 #ifdef ALIGNED_MALLOC
 	return _aligned_realloc(ptr, size, ALIGNMENT);
 #elif ALIGNMENT_HACK
 	long diff;
 
-	if (!ptr)
-		return a_malloc(size);
 	diff = ((char *)ptr)[-1];
 	ptr = realloc((char*)ptr - diff, size + diff);
 	if (ptr)
@@ -77,16 +182,276 @@ static void *a_realloc(void *ptr, size_t size)
 
 static void a_free(void *ptr)
 {
+	if (!ptr)
+		return;
+
+	get_thread()->system_calls++;
+
 #ifdef ALIGNED_MALLOC
 	_aligned_free(ptr);
 #elif ALIGNMENT_HACK
-	if (ptr)
-		free((char *)ptr - ((char*)ptr)[-1]);
+	free((char *)ptr - ((char*)ptr)[-1]);
 #else
 	free(ptr);
 #endif
 }
 
+/* ------------------------------------------------------------------------- */
+/* Arena allocator */
+
+/*
+ * Size-class allocator for the many small, short-lived allocations made by
+ * the containers and the per-frame paths.  Every block is preceded by a
+ * header of ALIGNMENT bytes holding its size class, so blocks keep the
+ * alignment of the system allocator.  Freed blocks go to a per-thread cache
+ * first; only when a cache runs empty or grows past its limit is half of it
+ * exchanged with the global pool of the class, under the pool's lock.  New
+ * blocks are carved from slabs that are never returned to the system.
+ * Allocations above the largest class go to the system allocator.
+ */
+
+#define ARENA_HEADER      ALIGNMENT
+#define ARENA_LARGE       0xffffffff
+#define ARENA_SLAB_SIZE   (64 * 1024)
+#define ARENA_CACHE_BYTES (128 * 1024)
+#define ARENA_SMALL_MAX   1024
+
+struct arena_header {
+	uint32_t size_class;
+	size_t   size;
+};
+
+struct arena_pool {
+	pthread_mutex_t    mutex;
+	struct arena_block *head;
+	size_t             count;
+};
+
+static const uint32_t class_sizes[ARENA_CLASSES] = {
+	32, 64, 96, 128, 192, 256, 384, 512, 768, 1024,
+	1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384, 24576, 32768
+};
+
+static uint8_t small_classes[ARENA_SMALL_MAX / 32 + 1];
+static struct arena_pool pools[ARENA_CLASSES];
+static bool arena_active = false;
+
+static inline uint32_t get_size_class(size_t size)
+{
+	if (size <= ARENA_SMALL_MAX)
+		return small_classes[(size + 31) / 32];
+
+	for (uint32_t i = small_classes[ARENA_SMALL_MAX / 32] + 1;
+	     i < ARENA_CLASSES; i++) {
+		if (size <= class_sizes[i])
+			return i;
+	}
+
+	return ARENA_LARGE;
+}
+
+static inline struct arena_header *get_header(void *ptr)
+{
+	return (struct arena_header*)((uint8_t*)ptr - ARENA_HEADER);
+}
+
+static inline size_t cache_limit(uint32_t size_class)
+{
+	size_t limit = ARENA_CACHE_BYTES / class_sizes[size_class];
+	return limit < 8 ? 8 : limit;
+}
+
+/* pool mutex must be held */
+static bool pool_grow(struct arena_pool *pool, uint32_t size_class)
+{
+	size_t stride = ARENA_HEADER + class_sizes[size_class];
+	size_t slab_size = ARENA_SLAB_SIZE;
+	uint8_t *slab;
+
+	if (slab_size < stride * 4)
+		slab_size = stride * 4;
+
+	slab = a_malloc(slab_size);
+	if (!slab)
+		return false;
+
+	for (size_t pos = 0; pos + stride <= slab_size; pos += stride) {
+		struct arena_block *block =
+			(struct arena_block*)(slab + pos + ARENA_HEADER);
+
+		get_header(block)->size_class = size_class;
+		block->next = pool->head;
+		pool->head = block;
+		pool->count++;
+	}
+
+	return true;
+}
+
+/* moves up to count blocks from one list to another */
+static inline size_t move_blocks(struct arena_block **src, size_t *src_count,
+		struct arena_block **dst, size_t *dst_count, size_t count)
+{
+	size_t moved = 0;
+
+	while (*src && moved < count) {
+		struct arena_block *block = *src;
+		*src = block->next;
+		block->next = *dst;
+		*dst = block;
+		moved++;
+	}
+
+	*src_count -= moved;
+	*dst_count += moved;
+	return moved;
+}
+
+static void cache_refill(struct arena_cache *cache, uint32_t size_class)
+{
+	struct arena_pool *pool = &pools[size_class];
+	size_t batch = cache_limit(size_class) / 2;
+
+	pthread_mutex_lock(&pool->mutex);
+	if (!pool->head)
+		pool_grow(pool, size_class);
+	move_blocks(&pool->head, &pool->count, &cache->head, &cache->count,
+			batch);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static void cache_release(struct arena_cache *cache, uint32_t size_class,
+		size_t count)
+{
+	struct arena_pool *pool = &pools[size_class];
+
+	pthread_mutex_lock(&pool->mutex);
+	move_blocks(&cache->head, &cache->count, &pool->head, &pool->count,
+			count);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static void arena_flush_thread(struct bmem_thread *thread)
+{
+	if (!arena_active)
+		return;
+
+	for (uint32_t i = 0; i < ARENA_CLASSES; i++) {
+		struct arena_cache *cache = &thread->cache[i];
+		if (cache->count)
+			cache_release(cache, i, cache->count);
+	}
+}
+
+static void *arena_malloc(size_t size)
+{
+	uint32_t size_class = get_size_class(size);
+	struct bmem_thread *thread;
+	struct arena_cache *cache;
+	struct arena_cache exited_cache = {0};
+	struct arena_block *block;
+
+	if (size_class == ARENA_LARGE) {
+		struct arena_header *header = a_malloc(ARENA_HEADER + size);
+		if (!header)
+			return NULL;
+
+		header->size_class = ARENA_LARGE;
+		header->size = size;
+		return (uint8_t*)header + ARENA_HEADER;
+	}
+
+	/* a thread that already exited has no cache left to use */
+	thread = get_thread();
+	cache = thread->exited ? &exited_cache : &thread->cache[size_class];
+
+	if (!cache->head)
+		cache_refill(cache, size_class);
+
+	block = cache->head;
+	if (!block)
+		return NULL;
+
+	cache->head = block->next;
+	cache->count--;
+
+	if (cache == &exited_cache && cache->count)
+		cache_release(cache, size_class, cache->count);
+
+	get_header(block)->size = size;
+	return block;
+}
+
+static void arena_free(void *ptr)
+{
+	struct arena_header *header;
+	struct bmem_thread *thread;
+	struct arena_cache *cache;
+	struct arena_cache exited_cache = {0};
+	struct arena_block *block = ptr;
+	uint32_t size_class;
+
+	if (!ptr)
+		return;
+
+	header = get_header(ptr);
+	size_class = header->size_class;
+
+	if (size_class == ARENA_LARGE) {
+		a_free(header);
+		return;
+	}
+
+	thread = get_thread();
+	cache = thread->exited ? &exited_cache : &thread->cache[size_class];
+
+	block->next = cache->head;
+	cache->head = block;
+	cache->count++;
+
+	if (cache == &exited_cache)
+		cache_release(cache, size_class, cache->count);
+	else if (cache->count > cache_limit(size_class))
+		cache_release(cache, size_class, cache->count / 2);
+}
+
+static void *arena_realloc(void *ptr, size_t size)
+{
+	struct arena_header *header;
+	uint32_t size_class;
+	void *new_ptr;
+
+	if (!ptr)
+		return arena_malloc(size);
+
+	header = get_header(ptr);
+	size_class = get_size_class(size);
+
+	if (header->size_class == ARENA_LARGE && size_class == ARENA_LARGE) {
+		header = a_realloc(header, ARENA_HEADER + size);
+		if (!header)
+			return NULL;
+
+		header->size = size;
+		return (uint8_t*)header + ARENA_HEADER;
+	}
+
+	if (header->size_class == size_class) {
+		header->size = size;
+		return ptr;
+	}
+
+	new_ptr = arena_malloc(size);
+	if (!new_ptr)
+		return NULL;
+
+	memcpy(new_ptr, ptr, header->size < size ? header->size : size);
+	arena_free(ptr);
+	return new_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static struct base_allocator alloc = {a_malloc, a_realloc, a_free};
 static long num_allocs = 0;
 
@@ -95,7 +460,49 @@ void base_set_allocator(struct base_allocator *defs)
 	memcpy(&alloc, defs, sizeof(struct base_allocator));
 }
 
-void *bmalloc(size_t size)
+bool base_use_arena_allocator(void)
+{
+	struct base_allocator arena = {arena_malloc, arena_realloc,
+		arena_free};
+	uint32_t size_class = 0;
+
+	if (arena_active)
+		return true;
+
+	/* blocks of the system allocator cannot be freed by the arena */
+	if (num_allocs != 0) {
+		blog(LOG_WARNING, "base_use_arena_allocator: memory was "
+				"already allocated, keeping the system "
+				"allocator");
+		return false;
+	}
+
+	for (size_t i = 0; i <= ARENA_SMALL_MAX / 32; i++) {
+		while (class_sizes[size_class] < i * 32)
+			size_class++;
+		small_classes[i] = (uint8_t)size_class;
+	}
+
+	for (size_t i = 0; i < ARENA_CLASSES; i++)
+		pthread_mutex_init(&pools[i].mutex, NULL);
+
+	arena_active = true;
+	base_set_allocator(&arena);
+	return true;
+}
+
+static inline void add_tag_stats(enum bmem_tag tag, size_t size)
+{
+	struct bmem_thread *thread = get_thread();
+
+	if ((unsigned)tag >= BMEM_TAG_COUNT)
+		tag = BMEM_TAG_DEFAULT;
+
+	thread->tags[tag].calls++;
+	thread->tags[tag].bytes += size;
+}
+
+void *bmalloc_tag(size_t size, enum bmem_tag tag)
 {
 	void *ptr = alloc.malloc(size);
 	if (!ptr && !size)
@@ -106,11 +513,12 @@ void *bmalloc(size_t size)
 				(unsigned long)size);
 	}
 
+	add_tag_stats(tag, size);
 	os_atomic_inc_long(&num_allocs);
 	return ptr;
 }
 
-void *brealloc(void *ptr, size_t size)
+void *brealloc_tag(void *ptr, size_t size, enum bmem_tag tag)
 {
 	if (!ptr)
 		os_atomic_inc_long(&num_allocs);
@@ -124,9 +532,20 @@ void *brealloc(void *ptr, size_t size)
 				(unsigned long)size);
 	}
 
+	add_tag_stats(tag, size);
 	return ptr;
 }
 
+void *bmalloc(size_t size)
+{
+	return bmalloc_tag(size, BMEM_TAG_DEFAULT);
+}
+
+void *brealloc(void *ptr, size_t size)
+{
+	return brealloc_tag(ptr, size, BMEM_TAG_DEFAULT);
+}
+
 void bfree(void *ptr)
 {
 	if (ptr)
@@ -139,6 +558,62 @@ long bnum_allocs(void)
 	return num_allocs;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Allocation statistics */
+
+static const char *tag_names[BMEM_TAG_COUNT] = {
+	"default",
+	"dstr",
+	"darray",
+	"circlebuf",
+	"calldata",
+	"packet",
+	"frame"
+};
+
+const char *bmem_get_tag_name(enum bmem_tag tag)
+{
+	return (unsigned)tag < BMEM_TAG_COUNT ? tag_names[tag] : NULL;
+}
+
+/* the counters of running threads are read without synchronization, so the
+ * totals are only approximate while other threads allocate */
+void bmem_get_tag_stats(enum bmem_tag tag, struct bmem_tag_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	if ((unsigned)tag >= BMEM_TAG_COUNT)
+		return;
+
+	pthread_mutex_lock(&thread_mutex);
+
+	*stats = retired_tags[tag];
+	for (struct bmem_thread *t = first_thread; t; t = t->next) {
+		stats->calls += t->tags[tag].calls;
+		stats->bytes += t->tags[tag].bytes;
+	}
+
+	pthread_mutex_unlock(&thread_mutex);
+}
+
+uint64_t bmem_get_system_calls(void)
+{
+	uint64_t calls;
+
+	pthread_mutex_lock(&thread_mutex);
+
+	calls = retired_system_calls;
+	for (struct bmem_thread *t = first_thread; t; t = t->next)
+		calls += t->system_calls;
+
+	pthread_mutex_unlock(&thread_mutex);
+	return calls;
+}
+
+bool bmem_arena_active(void)
+{
+	return arena_active;
+}
+
 int base_get_alignment(void)
 {
 	return ALIGNMENT;
@@ -33,14 +33,50 @@ struct base_allocator {
 
 EXPORT void base_set_allocator(struct base_allocator *defs);
 
+/* replaces the system allocator with a thread-caching size-class allocator.
+ * like base_set_allocator, this must be called before anything has been
+ * allocated; returns false if it was too late */
+EXPORT bool base_use_arena_allocator(void);
+EXPORT bool bmem_arena_active(void);
+
+/* allocation tags, used to attribute allocator calls to the subsystem that
+ * made them */
+enum bmem_tag {
+	BMEM_TAG_DEFAULT,
+	BMEM_TAG_DSTR,
+	BMEM_TAG_DARRAY,
+	BMEM_TAG_CIRCLEBUF,
+	BMEM_TAG_CALLDATA,
+	BMEM_TAG_PACKET,
+	BMEM_TAG_FRAME,
+
+	BMEM_TAG_COUNT
+};
+
+struct bmem_tag_stats {
+	uint64_t calls; /* bmalloc/brealloc calls */
+	uint64_t bytes; /* bytes requested by those calls */
+};
+
 EXPORT void *bmalloc(size_t size);
 EXPORT void *brealloc(void *ptr, size_t size);
 EXPORT void bfree(void *ptr);
 
+EXPORT void *bmalloc_tag(size_t size, enum bmem_tag tag);
+EXPORT void *brealloc_tag(void *ptr, size_t size, enum bmem_tag tag);
+
 EXPORT int base_get_alignment(void);
 
 EXPORT long bnum_allocs(void);
 
+EXPORT const char *bmem_get_tag_name(enum bmem_tag tag);
+EXPORT void bmem_get_tag_stats(enum bmem_tag tag,
+		struct bmem_tag_stats *stats);
+
+/* number of calls made to the system allocator, which with the arena
+ * allocator is only a fraction of the bmalloc/brealloc/bfree calls */
+EXPORT uint64_t bmem_get_system_calls(void);
+
 EXPORT void *bmemdup(const void *ptr, size_t size);
 
 static inline void *bzalloc(size_t size)
@@ -51,6 +87,14 @@ static inline void *bzalloc(size_t size)
 	return mem;
 }
 
+static inline void *bzalloc_tag(size_t size, enum bmem_tag tag)
+{
+	void *mem = bmalloc_tag(size, tag);
+	if (mem)
+		memset(mem, 0, size);
+	return mem;
+}
+
 static inline char *bstrdup_n(const char *str, size_t n)
 {
 	char *dup;
@@ -74,7 +74,7 @@ static inline void circlebuf_ensure_capacity(struct circlebuf *cb)
 	if (cb->size > new_capacity)
 		new_capacity = cb->size;
 
-	cb->data = brealloc(cb->data, new_capacity);
+	cb->data = brealloc_tag(cb->data, new_capacity, BMEM_TAG_CIRCLEBUF);
 	circlebuf_reorder_data(cb, new_capacity);
 	cb->capacity = new_capacity;
 }
@@ -84,7 +84,7 @@ static inline void circlebuf_reserve(struct circlebuf *cb, size_t capacity)
 	if (capacity <= cb->capacity)
 		return;
 
-	cb->data = brealloc(cb->data, capacity);
+	cb->data = brealloc_tag(cb->data, capacity, BMEM_TAG_CIRCLEBUF);
 	circlebuf_reorder_data(cb, capacity);
 	cb->capacity = capacity;
 }
@@ -17,6 +17,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <wchar.h>
+#include <ctype.h>
 #include "config-file.h"
 #include "threading.h"
 #include "platform.h"
@@ -54,10 +55,29 @@ static inline void config_section_free(struct config_section *section)
 	bfree(section->name);
 }
 
+/* maps a section/name pair to the position of its item, see the item index
+ * section below */
+struct config_index_entry {
+	uint32_t hash;
+	uint32_t section;
+	uint32_t item;
+	bool     used;
+};
+
+struct config_index {
+	struct config_index_entry *entries;
+	size_t size;
+	size_t num;
+	bool   valid;
+	bool   duplicate_sections;
+};
+
 struct config_data {
 	char *file;
 	struct darray sections; /* struct config_section */
 	struct darray defaults; /* struct config_section */
+	struct config_index sections_index;
+	struct config_index defaults_index;
 	pthread_mutex_t mutex;
 };
 
@@ -351,6 +371,7 @@ int config_open_defaults(config_t *config, const char *file)
 	if (!config)
 		return CONFIG_ERROR;
 
+	config->defaults_index.valid = false;
 	return config_parse_file(&config->defaults, file, false);
 }
 
@@ -490,6 +511,8 @@ void config_close(config_t *config)
 
 	darray_free(&config->defaults);
 	darray_free(&config->sections);
+	bfree(config->defaults_index.entries);
+	bfree(config->sections_index.entries);
 	bfree(config->file);
 	pthread_mutex_destroy(&config->mutex);
 	bfree(config);
@@ -519,60 +542,206 @@ unlock:
 	return name;
 }
 
-static const struct config_item *config_find_item(const struct darray *sections,
+/* ------------------------------------------------------------------------- */
+/* Item index
+ *
+ * Lookups go through an open addressing hash table of every item.  Names
+ * are compared with astrcmpi, so they are hashed in upper case.  Each entry
+ * points to the first matching item of the first matching section, which is
+ * what a linear search of the sections would find.  Items added by
+ * config_set_* are inserted directly; parsing a file or removing an item
+ * invalidates the table, and it is rebuilt on the next lookup. */
+
+static inline uint32_t hash_name(uint32_t hash, const char *str)
+{
+	if (!str)
+		str = "";
+
+	while (*str) {
+		hash ^= (uint8_t)toupper((uint8_t)*(str++));
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static inline uint32_t hash_item(const char *section, const char *name)
+{
+	uint32_t hash = hash_name(2166136261U, section);
+	hash ^= 0xFF;
+	hash *= 16777619U;
+	return hash_name(hash, name);
+}
+
+static inline struct config_section *get_section(const struct darray *sections,
+		size_t idx)
+{
+	return darray_item(sizeof(struct config_section), sections, idx);
+}
+
+static inline struct config_item *get_item(const struct darray *sections,
+		size_t section, size_t item)
+{
+	return darray_item(sizeof(struct config_item),
+			&get_section(sections, section)->items, item);
+}
+
+static inline bool entry_matches(const struct config_index_entry *entry,
+		const struct darray *sections, uint32_t hash,
 		const char *section, const char *name)
 {
-	size_t i, j;
+	return entry->hash == hash &&
+		astrcmpi(get_section(sections, entry->section)->name,
+				section) == 0 &&
+		astrcmpi(get_item(sections, entry->section, entry->item)->name,
+				name) == 0;
+}
 
-	for (i = 0; i < sections->num; i++) {
-		const struct config_section *sec = darray_item(
-				sizeof(struct config_section), sections, i);
+static void config_index_rebuild(struct config_index *index,
+		const struct darray *sections);
 
-		if (astrcmpi(sec->name, section) == 0) {
-			for (j = 0; j < sec->items.num; j++) {
-				struct config_item *item = darray_item(
-						sizeof(struct config_item),
-						&sec->items, j);
+static void config_index_add(struct config_index *index,
+		const struct darray *sections, size_t section, size_t item)
+{
+	const char *sec_name = get_section(sections, section)->name;
+	const char *item_name = get_item(sections, section, item)->name;
+	uint32_t hash = hash_item(sec_name, item_name);
+	size_t mask = index->size - 1;
+	struct config_index_entry *entry;
+
+	/* the new item is already in its section, so a rebuild adds it */
+	if ((index->num + 1) * 2 > index->size) {
+		config_index_rebuild(index, sections);
+		return;
+	}
+
+	for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+		entry = &index->entries[pos];
+
+		if (!entry->used)
+			break;
 
-				if (astrcmpi(item->name, name) == 0)
-					return item;
+		if (entry_matches(entry, sections, hash, sec_name,
+					item_name)) {
+			if (section < entry->section ||
+			    (section == entry->section && item < entry->item)) {
+				entry->section = (uint32_t)section;
+				entry->item    = (uint32_t)item;
 			}
+			return;
 		}
 	}
 
-	return NULL;
+	entry->hash    = hash;
+	entry->section = (uint32_t)section;
+	entry->item    = (uint32_t)item;
+	entry->used    = true;
+	index->num++;
+}
+
+static void config_index_rebuild(struct config_index *index,
+		const struct darray *sections)
+{
+	size_t count = 0;
+	size_t size = 16;
+
+	for (size_t i = 0; i < sections->num; i++)
+		count += get_section(sections, i)->items.num;
+	while (size < count * 2 + 2)
+		size *= 2;
+
+	bfree(index->entries);
+	index->entries = bzalloc(size * sizeof(struct config_index_entry));
+	index->size    = size;
+	index->num     = 0;
+	index->valid   = true;
+
+	/* only hand-edited files repeat a section */
+	index->duplicate_sections = false;
+	for (size_t i = 1; i < sections->num; i++) {
+		for (size_t j = 0; j < i; j++) {
+			if (astrcmpi(get_section(sections, i)->name,
+						get_section(sections, j)->name) == 0)
+				index->duplicate_sections = true;
+		}
+	}
+
+	for (size_t i = 0; i < sections->num; i++) {
+		struct config_section *sec = get_section(sections, i);
+
+		for (size_t j = 0; j < sec->items.num; j++)
+			config_index_add(index, sections, i, j);
+	}
+}
+
+static inline struct config_index *get_index(config_t *config,
+		const struct darray *sections)
+{
+	return sections == &config->defaults ?
+		&config->defaults_index : &config->sections_index;
+}
+
+static const struct config_index_entry *config_find_entry(config_t *config,
+		const struct darray *sections,
+		const char *section, const char *name)
+{
+	struct config_index *index = get_index(config, sections);
+	uint32_t hash = hash_item(section, name);
+	size_t mask;
+
+	if (!index->valid)
+		config_index_rebuild(index, sections);
+
+	mask = index->size - 1;
+
+	for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+		const struct config_index_entry *entry = &index->entries[pos];
+
+		if (!entry->used)
+			return NULL;
+		if (entry_matches(entry, sections, hash, section, name))
+			return entry;
+	}
+}
+
+static struct config_item *config_find_item(config_t *config,
+		const struct darray *sections,
+		const char *section, const char *name)
+{
+	const struct config_index_entry *entry = config_find_entry(config,
+			sections, section, name);
+
+	return entry ? get_item(sections, entry->section, entry->item) : NULL;
 }
 
 static void config_set_item(config_t *config, struct darray *sections,
 		const char *section, const char *name, char *value)
 {
+	struct config_index *index = get_index(config, sections);
+	const struct config_index_entry *entry;
 	struct config_section *sec = NULL;
-	struct config_section *array = sections->array;
 	struct config_item *item;
-	size_t i, j;
+	size_t i;
 
 	pthread_mutex_lock(&config->mutex);
 
+	entry = config_find_entry(config, sections, section, name);
+	if (entry && !index->duplicate_sections)
+		goto replace;
+
 	for (i = 0; i < sections->num; i++) {
-		struct config_section *cur_sec = array+i;
-		struct config_item *items = cur_sec->items.array;
+		struct config_section *cur_sec = get_section(sections, i);
 
 		if (astrcmpi(cur_sec->name, section) == 0) {
-			for (j = 0; j < cur_sec->items.num; j++) {
-				item = items+j;
-
-				if (astrcmpi(item->name, name) == 0) {
-					bfree(item->value);
-					item->value = value;
-					goto unlock;
-				}
-			}
-
 			sec = cur_sec;
 			break;
 		}
 	}
 
+	/* with repeated sections, only the first one is updated */
+	if (entry && entry->section == i)
+		goto replace;
+
 	if (!sec) {
 		sec = darray_push_back_new(sizeof(struct config_section),
 				sections);
@@ -583,6 +752,14 @@ static void config_set_item(config_t *config, struct darray *sections,
 	item->name  = bstrdup(name);
 	item->value = value;
 
+	config_index_add(index, sections, i, sec->items.num - 1);
+	goto unlock;
+
+replace:
+	item = get_item(sections, entry->section, entry->item);
+	bfree(item->value);
+	item->value = value;
+
 unlock:
 	pthread_mutex_unlock(&config->mutex);
 }
@@ -680,9 +857,9 @@ const char *config_get_string(config_t *config, const char *section,
 
 	pthread_mutex_lock(&config->mutex);
 
-	item = config_find_item(&config->sections, section, name);
+	item = config_find_item(config, &config->sections, section, name);
 	if (!item)
-		item = config_find_item(&config->defaults, section, name);
+		item = config_find_item(config, &config->defaults, section, name);
 	if (item)
 		value = item->value;
 
@@ -757,33 +934,26 @@ bool config_remove_value(config_t *config, const char *section,
 		const char *name)
 {
 	struct darray *sections = &config->sections;
+	const struct config_index_entry *entry;
 	bool success = false;
 
 	pthread_mutex_lock(&config->mutex);
 
-	for (size_t i = 0; i < sections->num; i++) {
-		struct config_section *sec = darray_item(
-				sizeof(struct config_section), sections, i);
-
-		if (astrcmpi(sec->name, section) != 0)
-			continue;
+	entry = config_find_entry(config, sections, section, name);
+	if (entry) {
+		struct config_section *sec = get_section(sections,
+				entry->section);
+		size_t idx = entry->item;
 
-		for (size_t j = 0; j < sec->items.num; j++) {
-			struct config_item *item = darray_item(
-					sizeof(struct config_item),
-					&sec->items, j);
+		config_item_free(darray_item(sizeof(struct config_item),
+					&sec->items, idx));
+		darray_erase(sizeof(struct config_item), &sec->items, idx);
 
-			if (astrcmpi(item->name, name) == 0) {
-				config_item_free(item);
-				darray_erase(sizeof(struct config_item),
-						&sec->items, j);
-				success = true;
-				goto unlock;
-			}
-		}
+		/* later items of the section have moved */
+		config->sections_index.valid = false;
+		success = true;
 	}
 
-unlock:
 	pthread_mutex_unlock(&config->mutex);
 	return success;
 }
@@ -796,7 +966,7 @@ const char *config_get_default_string(config_t *config,
 
 	pthread_mutex_lock(&config->mutex);
 
-	item = config_find_item(&config->defaults, section, name);
+	item = config_find_item(config, &config->defaults, section, name);
 	if (item)
 		value = item->value;
 
@@ -850,7 +1020,8 @@ bool config_has_user_value(config_t *config, const char *section,
 {
 	bool success;
 	pthread_mutex_lock(&config->mutex);
-	success = config_find_item(&config->sections, section, name) != NULL;
+	success = config_find_item(config, &config->sections,
+			section, name) != NULL;
 	pthread_mutex_unlock(&config->mutex);
 	return success;
 }
@@ -860,7 +1031,8 @@ bool config_has_default_value(config_t *config, const char *section,
 {
 	bool success;
 	pthread_mutex_lock(&config->mutex);
-	success = config_find_item(&config->defaults, section, name) != NULL;
+	success = config_find_item(config, &config->defaults,
+			section, name) != NULL;
 	pthread_mutex_unlock(&config->mutex);
 	return success;
 }
@@ -87,7 +87,7 @@ static inline void darray_reserve(const size_t element_size,
 	if (capacity == 0 || capacity <= dst->num)
 		return;
 
-	ptr = bmalloc(element_size*capacity);
+	ptr = bmalloc_tag(element_size*capacity, BMEM_TAG_DARRAY);
 	if (dst->num)
 		memcpy(ptr, dst->array, element_size*dst->num);
 	if (dst->array)
@@ -107,7 +107,7 @@ static inline void darray_ensure_capacity(const size_t element_size,
 	new_cap = (!dst->capacity) ? new_size : dst->capacity*2;
 	if (new_size > new_cap)
 		new_cap = new_size;
-	ptr = bmalloc(element_size*new_cap);
+	ptr = bmalloc_tag(element_size*new_cap, BMEM_TAG_DARRAY);
 	if (dst->capacity)
 		memcpy(ptr, dst->array, element_size*dst->capacity);
 	if (dst->array)
@@ -297,7 +297,7 @@ char **strlist_split(const char *str, char split_ch, bool include_empty)
 
 		cur_pos    = (count + 1) * sizeof(char *);
 		total_size += cur_pos;
-		out        = bmalloc(total_size);
+		out        = bmalloc_tag(total_size, BMEM_TAG_DSTR);
 		offset     = out + cur_pos;
 		table      = (char **)out;
 
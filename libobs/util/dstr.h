@@ -228,7 +228,8 @@ static inline void dstr_ensure_capacity(struct dstr *dst, const size_t new_size)
 	new_cap = (!dst->capacity) ? new_size : dst->capacity*2;
 	if (new_size > new_cap)
 		new_cap = new_size;
-	dst->array = (char*)brealloc(dst->array, new_cap);
+	dst->array = (char*)brealloc_tag(dst->array, new_cap,
+			BMEM_TAG_DSTR);
 	dst->capacity = new_cap;
 }
 
@@ -249,7 +250,8 @@ static inline void dstr_reserve(struct dstr *dst, const size_t capacity)
 	if (capacity == 0 || capacity <= dst->len)
 		return;
 
-	dst->array = (char*)brealloc(dst->array, capacity);
+	dst->array = (char*)brealloc_tag(dst->array, capacity,
+			BMEM_TAG_DSTR);
 	dst->capacity = capacity;
 }
 
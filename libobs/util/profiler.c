@@ -263,6 +263,158 @@ static DARRAY(profile_root_entry) root_entries;
 static THREAD_LOCAL profile_call *thread_context = NULL;
 static THREAD_LOCAL bool thread_enabled = true;
 
+/* ------------------------------------------------------------------------- */
+/* Event tracing */
+
+/*
+ * Besides the aggregated times, every profile_start/profile_end can also be
+ * recorded as a raw begin/end event so that a window of activity can be
+ * viewed as a timeline.  Each thread writes into its own ring without taking
+ * any lock; the collector copies the rings and drops whatever the owning
+ * thread may have overwritten during the copy.  The ring of a thread that
+ * exited is handed to the next thread that starts tracing.
+ */
+
+#define TRACE_RING_SIZE 65536 /* events per thread, must be a power of 2 */
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+enum profile_trace_type {
+	PROFILE_TRACE_BEGIN,
+	PROFILE_TRACE_END
+};
+
+typedef struct profile_trace_event profile_trace_event;
+struct profile_trace_event {
+	const char *name;
+	uint64_t time;
+	enum profile_trace_type type;
+};
+
+typedef struct profile_trace_ring profile_trace_ring;
+struct profile_trace_ring {
+	volatile long head;
+	volatile bool exited;
+	long tid;
+	const char *thread_name;
+	profile_trace_event events[TRACE_RING_SIZE];
+};
+
+static volatile bool trace_enabled = false;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(profile_trace_ring*) trace_rings;
+static volatile long trace_generation = 1;
+static long next_trace_tid = 0;
+
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+
+static THREAD_LOCAL profile_trace_ring *thread_ring = NULL;
+static THREAD_LOCAL long thread_ring_generation = 0;
+
+/* the key holds the trace id rather than the ring itself, because the ring
+ * may already have been freed by profiler_free when the thread exits */
+static void trace_thread_exit(void *data)
+{
+	long tid = (long)(intptr_t)data;
+
+	pthread_mutex_lock(&trace_mutex);
+	for (size_t i = 0; i < trace_rings.num; i++) {
+		profile_trace_ring *ring = trace_rings.array[i];
+		if (ring->tid == tid) {
+			os_atomic_set_bool(&ring->exited, true);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static void create_trace_key(void)
+{
+	pthread_key_create(&trace_key, trace_thread_exit);
+}
+
+static profile_trace_ring *acquire_trace_ring(void)
+{
+	profile_trace_ring *ring = NULL;
+
+	pthread_once(&trace_key_once, create_trace_key);
+
+	pthread_mutex_lock(&trace_mutex);
+	for (size_t i = 0; i < trace_rings.num; i++) {
+		if (trace_rings.array[i]->exited) {
+			ring = trace_rings.array[i];
+			break;
+		}
+	}
+
+	if (!ring) {
+		ring = bmalloc(sizeof(profile_trace_ring));
+		da_push_back(trace_rings, &ring);
+	}
+
+	ring->head        = 0;
+	ring->exited      = false;
+	ring->tid         = ++next_trace_tid;
+	ring->thread_name = NULL;
+
+	thread_ring_generation = trace_generation;
+	pthread_mutex_unlock(&trace_mutex);
+
+	pthread_setspecific(trace_key, (void*)(intptr_t)ring->tid);
+	return ring;
+}
+
+static inline profile_trace_ring *get_trace_ring(void)
+{
+	if (!thread_ring ||
+	    thread_ring_generation != os_atomic_load_long(&trace_generation))
+		thread_ring = acquire_trace_ring();
+
+	return thread_ring;
+}
+
+/* only the owning thread ever writes to a ring, so the head is simply
+ * published after the event has been filled in */
+static void trace_event(const char *name, uint64_t time,
+		enum profile_trace_type type, bool root)
+{
+	profile_trace_ring *ring = get_trace_ring();
+	profile_trace_event *event =
+		&ring->events[(unsigned long)ring->head & TRACE_RING_MASK];
+
+	if (root && !ring->thread_name)
+		ring->thread_name = name;
+
+	event->name = name;
+	event->time = time;
+	event->type = type;
+
+	os_atomic_inc_long(&ring->head);
+}
+
+void profiler_trace_start(void)
+{
+	os_atomic_set_bool(&trace_enabled, true);
+}
+
+void profiler_trace_stop(void)
+{
+	os_atomic_set_bool(&trace_enabled, false);
+}
+
+static void free_trace_rings(void)
+{
+	pthread_mutex_lock(&trace_mutex);
+	os_atomic_set_bool(&trace_enabled, false);
+
+	for (size_t i = 0; i < trace_rings.num; i++)
+		bfree(trace_rings.array[i]);
+	da_free(trace_rings);
+
+	os_atomic_inc_long(&trace_generation);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
@@ -390,6 +542,10 @@ void profile_start(const char *name)
 
 	thread_context = call;
 	call->start_time = os_gettime_ns();
+
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_event(name, call->start_time, PROFILE_TRACE_BEGIN,
+				!new_call.parent);
 }
 
 void profile_end(const char *name)
@@ -427,6 +583,9 @@ void profile_end(const char *name)
 
 	thread_context = call->parent;
 
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_event(call->name, end, PROFILE_TRACE_END, false);
+
 	call->end_time = end;
 #ifdef TRACK_OVERHEAD
 	call->overhead_end = os_gettime_ns();
@@ -438,6 +597,38 @@ void profile_end(const char *name)
 	merge_context(call);
 }
 
+void profile_record(const char *name, uint64_t start_time, uint64_t end_time,
+		const profile_interval_t *children, size_t num_children)
+{
+	profile_call *call;
+
+	if (!os_atomic_load_bool(&enabled))
+		return;
+
+	call = bzalloc(sizeof(profile_call));
+	call->name       = name;
+	call->start_time = start_time;
+	call->end_time   = end_time;
+#ifdef TRACK_OVERHEAD
+	call->overhead_start = start_time;
+	call->overhead_end   = end_time;
+#endif
+
+	for (size_t i = 0; i < num_children; i++) {
+		profile_call *child = da_push_back_new(call->children);
+		child->name       = children[i].name;
+		child->start_time = children[i].start_time;
+		child->end_time   = children[i].end_time;
+		child->parent     = call;
+#ifdef TRACK_OVERHEAD
+		child->overhead_start = child->start_time;
+		child->overhead_end   = child->end_time;
+#endif
+	}
+
+	merge_context(call);
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry*)second)->time_delta -
@@ -823,6 +1014,8 @@ void profiler_free(void)
 	}
 
 	da_free(old_root_entries);
+
+	free_trace_rings();
 }
 
 
@@ -1062,6 +1255,129 @@ bool profiler_snapshot_dump_csv_gz(const profiler_snapshot_t *snap,
 	return true;
 }
 
+typedef DARRAY(profile_trace_event) profile_trace_events;
+
+static void copy_trace_ring(profile_trace_ring *ring,
+		profile_trace_events *events)
+{
+	unsigned long end = (unsigned long)os_atomic_load_long(&ring->head);
+	unsigned long count = end < TRACE_RING_SIZE ? end : TRACE_RING_SIZE;
+	unsigned long start = end - count;
+	unsigned long new_end;
+	size_t overwritten = 0;
+
+	da_resize((*events), count);
+	for (unsigned long i = 0; i < count; i++)
+		events->array[i] = ring->events[(start + i) & TRACE_RING_MASK];
+
+	/* the owner may have written up to new_end while the events were
+	 * copied, and may be writing new_end itself, which reuses the slot of
+	 * new_end - TRACE_RING_SIZE */
+	new_end = (unsigned long)os_atomic_load_long(&ring->head);
+	if (new_end - start + 1 > TRACE_RING_SIZE)
+		overwritten = new_end - start + 1 - TRACE_RING_SIZE;
+	if (overwritten > count)
+		overwritten = count;
+	if (overwritten)
+		da_erase_range((*events), 0, overwritten);
+}
+
+static void trace_cat_name(struct dstr *buffer, const char *name)
+{
+	dstr_cat_ch(buffer, '"');
+	for (; name && *name; name++) {
+		if (*name == '"' || *name == '\\')
+			dstr_cat_ch(buffer, '\\');
+		if ((uint8_t)*name >= 0x20)
+			dstr_cat_ch(buffer, *name);
+	}
+	dstr_cat_ch(buffer, '"');
+}
+
+static void trace_dump_thread_name(FILE *f, struct dstr *buffer,
+		profile_trace_ring *ring, bool *first)
+{
+	dstr_printf(buffer, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+			"\"pid\":1,\"tid\":%ld,\"args\":{\"name\":",
+			*first ? "" : ",\n", ring->tid);
+	trace_cat_name(buffer, ring->thread_name ?
+			ring->thread_name : "(unnamed thread)");
+	dstr_cat(buffer, "}}");
+	fwrite(buffer->array, 1, buffer->len, f);
+	*first = false;
+}
+
+static void trace_dump_ring(FILE *f, struct dstr *buffer,
+		profile_trace_ring *ring, profile_trace_events *events,
+		uint64_t min_time, bool *first)
+{
+	bool named = false;
+	size_t depth = 0;
+
+	copy_trace_ring(ring, events);
+
+	for (size_t i = 0; i < events->num; i++) {
+		profile_trace_event *event = &events->array[i];
+		bool begin = event->type == PROFILE_TRACE_BEGIN;
+
+		if (event->time < min_time)
+			continue;
+
+		/* ends of calls that began before the window have no
+		 * matching begin event */
+		if (begin)
+			depth++;
+		else if (!depth)
+			continue;
+		else
+			depth--;
+
+		if (!named) {
+			trace_dump_thread_name(f, buffer, ring, first);
+			named = true;
+		}
+
+		dstr_copy(buffer, ",\n{\"name\":");
+		trace_cat_name(buffer, event->name);
+		dstr_catf(buffer, ",\"ph\":\"%s\",\"pid\":1,\"tid\":%ld,"
+				"\"ts\":%"PRIu64".%03u}",
+				begin ? "B" : "E", ring->tid,
+				event->time / 1000,
+				(unsigned)(event->time % 1000));
+		fwrite(buffer->array, 1, buffer->len, f);
+	}
+}
+
+bool profiler_trace_dump_json(const char *filename, uint64_t window_ns)
+{
+	profile_trace_events events = {0};
+	struct dstr buffer = {0};
+	uint64_t now = os_gettime_ns();
+	uint64_t min_time = (window_ns && window_ns < now) ?
+		now - window_ns : 0;
+	bool first = true;
+	FILE *f;
+
+	f = os_fopen(filename, "wb");
+	if (!f)
+		return false;
+
+	fputs("{\"traceEvents\":[\n", f);
+
+	pthread_mutex_lock(&trace_mutex);
+	for (size_t i = 0; i < trace_rings.num; i++)
+		trace_dump_ring(f, &buffer, trace_rings.array[i], &events,
+				min_time, &first);
+	pthread_mutex_unlock(&trace_mutex);
+
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+
+	dstr_free(&buffer);
+	da_free(events);
+	fclose(f);
+	return true;
+}
+
 size_t profiler_snapshot_num_roots(profiler_snapshot_t *snap)
 {
 	return snap ? snap->roots.num : 0;
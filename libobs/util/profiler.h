@@ -22,6 +22,21 @@ EXPORT void profile_end(const char *name);
 
 EXPORT void profile_reenable_thread(void);
 
+/* records an interval that was not measured by profile_start/profile_end,
+ * such as one that spans several threads, as a call of the root entry name
+ * with the given child intervals */
+struct profile_interval {
+	const char *name;
+	uint64_t start_time;
+	uint64_t end_time;
+};
+
+typedef struct profile_interval profile_interval_t;
+
+EXPORT void profile_record(const char *name, uint64_t start_time,
+		uint64_t end_time, const profile_interval_t *children,
+		size_t num_children);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler control */
 
@@ -33,6 +48,20 @@ EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
 EXPORT void profiler_free(void);
 
+/* ------------------------------------------------------------------------- */
+/* Event tracing */
+
+/* records every profile_start/profile_end as a timestamped event in a
+ * per-thread ring, in addition to the aggregated times */
+EXPORT void profiler_trace_start(void);
+EXPORT void profiler_trace_stop(void);
+
+/* writes the recorded events of the last window_ns nanoseconds (or all of
+ * them if 0) in the Chrome trace event format, which can be opened with
+ * chrome://tracing or Perfetto */
+EXPORT bool profiler_trace_dump_json(const char *filename,
+		uint64_t window_ns);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler name storage */
 
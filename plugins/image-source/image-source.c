@@ -64,6 +64,8 @@ static void image_source_load(struct image_source *context)
 		if (!context->image.loaded)
 			warn("failed to load texture '%s'", file);
 	}
+
+	obs_source_content_changed(context->source);
 }
 
 static void image_source_unload(struct image_source *context)
@@ -71,6 +73,8 @@ static void image_source_unload(struct image_source *context)
 	obs_enter_graphics();
 	gs_image_file_free(&context->image);
 	obs_leave_graphics();
+
+	obs_source_content_changed(context->source);
 }
 
 static void image_source_update(void *data, obs_data_t *settings)
@@ -157,6 +161,12 @@ static void image_source_render(void *data, gs_effect_t *effect)
 			context->image.cx, context->image.cy);
 }
 
+static gs_texture_t *image_source_get_sprite_texture(void *data)
+{
+	struct image_source *context = data;
+	return context->image.texture;
+}
+
 static void image_source_tick(void *data, float seconds)
 {
 	struct image_source *context = data;
@@ -190,6 +200,8 @@ static void image_source_tick(void *data, float seconds)
 				obs_enter_graphics();
 				gs_image_file_update_texture(&context->image);
 				obs_leave_graphics();
+
+				obs_source_content_changed(context->source);
 			}
 
 			context->active = false;
@@ -206,6 +218,8 @@ static void image_source_tick(void *data, float seconds)
 			obs_enter_graphics();
 			gs_image_file_update_texture(&context->image);
 			obs_leave_graphics();
+
+			obs_source_content_changed(context->source);
 		}
 	}
 
@@ -253,7 +267,8 @@ static obs_properties_t *image_source_properties(void *data)
 static struct obs_source_info image_source_info = {
 	.id             = "image_source",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_STATIC_CONTENT |
+	                  OBS_SOURCE_PARALLEL_CREATE,
 	.get_name       = image_source_get_name,
 	.create         = image_source_create,
 	.destroy        = image_source_destroy,
@@ -265,7 +280,8 @@ static struct obs_source_info image_source_info = {
 	.get_height     = image_source_getheight,
 	.video_render   = image_source_render,
 	.video_tick     = image_source_tick,
-	.get_properties = image_source_properties
+	.get_properties = image_source_properties,
+	.get_sprite_texture = image_source_get_sprite_texture
 };
 
 OBS_DECLARE_MODULE()
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2026 OBS Studio contributors
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Shared memory packet ring between obs-ffmpeg-mux and ffmpeg-mux.
+ *
+ * The packet payloads are written to a memfd-backed ring buffer instead of
+ * the process pipe; the pipe still carries every ffm_packet_info so packet
+ * order and end-of-stream are unchanged.  A payload is always stored
+ * contiguously: if it does not fit at the end of the ring, the writer skips
+ * to the start, and the reader applies the same rule to find it.
+ *
+ * The writer only blocks when the ring is full, and then sleeps on a futex
+ * that the reader wakes after releasing a packet.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+#define FFM_HAVE_SHM 1
+#else
+#define FFM_HAVE_SHM 0
+#endif
+
+#if FFM_HAVE_SHM
+
+#define FFM_SHM_MAGIC          0x4d534646 /* "FFSM" */
+#define FFM_SHM_DEFAULT_SIZE   (32 * 1024 * 1024)
+#define FFM_SHM_HEADER_SIZE    64
+#define FFM_SHM_WAIT_SLICE_MS  10
+
+struct ffm_shm_header {
+	uint32_t          magic;
+	uint32_t          capacity;
+	volatile uint64_t write_total;
+	volatile uint64_t read_total;
+	volatile uint32_t read_seq;
+	volatile uint32_t writer_waiting;
+};
+
+struct ffm_shm {
+	struct ffm_shm_header *header;
+	uint8_t               *data;
+	size_t                map_size;
+};
+
+static inline int ffm_shm_futex(volatile uint32_t *addr, int op, uint32_t val,
+		const struct timespec *timeout)
+{
+	return (int)syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+static inline bool ffm_shm_map(struct ffm_shm *shm, int fd, bool create,
+		uint32_t capacity)
+{
+	struct ffm_shm_header *header;
+	size_t map_size;
+	void *ptr;
+
+	if (create) {
+		map_size = FFM_SHM_HEADER_SIZE + (size_t)capacity;
+		if (ftruncate(fd, (off_t)map_size) != 0)
+			return false;
+	} else {
+		struct ffm_shm_header tmp;
+		if (pread(fd, &tmp, sizeof(tmp), 0) != sizeof(tmp))
+			return false;
+		if (tmp.magic != FFM_SHM_MAGIC)
+			return false;
+		map_size = FFM_SHM_HEADER_SIZE + (size_t)tmp.capacity;
+	}
+
+	ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED)
+		return false;
+
+	header = ptr;
+	if (create) {
+		memset(header, 0, sizeof(*header));
+		header->magic = FFM_SHM_MAGIC;
+		header->capacity = capacity;
+	}
+
+	shm->header = header;
+	shm->data = (uint8_t*)ptr + FFM_SHM_HEADER_SIZE;
+	shm->map_size = map_size;
+	return true;
+}
+
+static inline void ffm_shm_unmap(struct ffm_shm *shm)
+{
+	if (shm->header)
+		munmap(shm->header, shm->map_size);
+	memset(shm, 0, sizeof(*shm));
+}
+
+static inline bool ffm_shm_fits(struct ffm_shm *shm, uint32_t size)
+{
+	return shm->header && size <= shm->header->capacity / 2;
+}
+
+/* returns the number of bytes skipped at the end of the ring so that a
+ * payload of the given size can be stored contiguously */
+static inline uint32_t ffm_shm_skip(struct ffm_shm *shm, uint64_t total,
+		uint32_t size)
+{
+	uint32_t capacity = shm->header->capacity;
+	uint32_t pos = (uint32_t)(total % capacity);
+
+	return (pos + size > capacity) ? capacity - pos : 0;
+}
+
+static inline uint8_t *ffm_shm_ptr(struct ffm_shm *shm, uint64_t total,
+		uint32_t skip)
+{
+	return shm->data + (skip ? 0 : total % shm->header->capacity);
+}
+
+/* writer side: copies a payload into the ring, waiting up to timeout_ms for
+ * the reader to free enough space */
+static inline bool ffm_shm_write(struct ffm_shm *shm, const uint8_t *data,
+		uint32_t size, int timeout_ms)
+{
+	struct ffm_shm_header *header = shm->header;
+	uint64_t write_total = header->write_total;
+	uint32_t skip = ffm_shm_skip(shm, write_total, size);
+	uint64_t needed = (uint64_t)skip + size;
+	int waited_ms = 0;
+
+	for (;;) {
+		uint32_t seq = __atomic_load_n(&header->read_seq,
+				__ATOMIC_ACQUIRE);
+		uint64_t read_total = __atomic_load_n(&header->read_total,
+				__ATOMIC_ACQUIRE);
+		struct timespec ts = {0, FFM_SHM_WAIT_SLICE_MS * 1000000L};
+
+		if (header->capacity - (write_total - read_total) >= needed)
+			break;
+		if (waited_ms >= timeout_ms)
+			return false;
+
+		__atomic_store_n(&header->writer_waiting, 1, __ATOMIC_SEQ_CST);
+		ffm_shm_futex(&header->read_seq, FUTEX_WAIT, seq, &ts);
+		waited_ms += FFM_SHM_WAIT_SLICE_MS;
+	}
+
+	__atomic_store_n(&header->writer_waiting, 0, __ATOMIC_RELAXED);
+
+	memcpy(ffm_shm_ptr(shm, write_total, skip), data, size);
+	__atomic_store_n(&header->write_total, write_total + needed,
+			__ATOMIC_RELEASE);
+	return true;
+}
+
+/* reader side: returns the payload of the next shared packet.  it stays
+ * valid until ffm_shm_release is called */
+static inline uint8_t *ffm_shm_peek(struct ffm_shm *shm, uint32_t size)
+{
+	uint64_t read_total = shm->header->read_total;
+	return ffm_shm_ptr(shm, read_total,
+			ffm_shm_skip(shm, read_total, size));
+}
+
+static inline void ffm_shm_release(struct ffm_shm *shm, uint32_t size)
+{
+	struct ffm_shm_header *header = shm->header;
+	uint64_t read_total = header->read_total;
+	uint32_t skip = ffm_shm_skip(shm, read_total, size);
+
+	__atomic_store_n(&header->read_total, read_total + skip + size,
+			__ATOMIC_RELEASE);
+	__atomic_add_fetch(&header->read_seq, 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&header->writer_waiting, __ATOMIC_SEQ_CST))
+		ffm_shm_futex(&header->read_seq, FUTEX_WAKE, 1, NULL);
+}
+
+#endif
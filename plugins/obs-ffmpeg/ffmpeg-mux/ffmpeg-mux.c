@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ffmpeg-mux.h"
+#include "ffmpeg-mux-shm.h"
 
 #include <libavformat/avformat.h>
 
@@ -81,6 +82,7 @@ struct main_params {
 	int fps_den;
 	char *acodec;
 	char *muxer_settings;
+	int shm_fd;
 };
 
 struct audio_params {
@@ -105,6 +107,10 @@ struct ffmpeg_mux {
 	struct header          *audio_header;
 	int                    num_audio_streams;
 	bool                   initialized;
+	char                   *changed_file;
+#if FFM_HAVE_SHM
+	struct ffm_shm         shm;
+#endif
 	char error[4096];
 };
 
@@ -154,6 +160,12 @@ static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
 		free(ffm->audio);
 	}
 
+#if FFM_HAVE_SHM
+	ffm_shm_unmap(&ffm->shm);
+#endif
+
+	free(ffm->changed_file);
+
 	memset(ffm, 0, sizeof(*ffm));
 }
 
@@ -258,6 +270,10 @@ static bool init_params(int *argc, char ***argv, struct main_params *params,
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	params->shm_fd = -1;
+	if (*argc)
+		get_opt_int(argc, argv, &params->shm_fd, "shared memory fd");
+
 	return true;
 }
 
@@ -419,21 +435,55 @@ static size_t safe_read(void *vdata, size_t size)
 	return total;
 }
 
+/* returns the payload of a packet, either from the shared memory ring or
+ * read from the pipe into the resize buffer */
+static uint8_t *ffmpeg_mux_read_data(struct ffmpeg_mux *ffm,
+		struct ffm_packet_info *info, struct resize_buf *rb)
+{
+#if FFM_HAVE_SHM
+	if (info->shared) {
+		if (!ffm->shm.header)
+			return NULL;
+		return ffm_shm_peek(&ffm->shm, info->size);
+	}
+#endif
+
+	resize_buf_resize(rb, info->size);
+	if (safe_read(rb->buf, info->size) != info->size)
+		return NULL;
+
+	return rb->buf;
+}
+
+static void ffmpeg_mux_release_data(struct ffmpeg_mux *ffm,
+		struct ffm_packet_info *info)
+{
+#if FFM_HAVE_SHM
+	if (info->shared)
+		ffm_shm_release(&ffm->shm, info->size);
+#else
+	(void)ffm;
+	(void)info;
+#endif
+}
+
 static bool ffmpeg_mux_get_header(struct ffmpeg_mux *ffm)
 {
 	struct ffm_packet_info info = {0};
+	struct resize_buf rb = {0};
 
 	bool success = safe_read(&info, sizeof(info)) == sizeof(info);
 	if (success) {
-		uint8_t *data = malloc(info.size);
+		uint8_t *data = ffmpeg_mux_read_data(ffm, &info, &rb);
 
-		if (safe_read(data, info.size) == info.size) {
+		if (data) {
 			ffmpeg_mux_header(ffm, data, &info);
+			ffmpeg_mux_release_data(ffm, &info);
 		} else {
 			success = false;
 		}
 
-		free(data);
+		resize_buf_free(&rb);
 	}
 
 	return success;
@@ -551,6 +601,21 @@ static int ffmpeg_mux_init_context(struct ffmpeg_mux *ffm)
 	return FFM_SUCCESS;
 }
 
+#if FFM_HAVE_SHM
+static void ffmpeg_mux_init_shm(struct ffmpeg_mux *ffm)
+{
+	int fd = ffm->params.shm_fd;
+
+	if (fd <= 0)
+		return;
+
+	if (!ffm_shm_map(&ffm->shm, fd, false, 0))
+		puts("Failed to map shared memory packet buffer");
+
+	close(fd);
+}
+#endif
+
 static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc,
 		char *argv[])
 {
@@ -559,6 +624,10 @@ static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc,
 	if (!init_params(&argc, &argv, &ffm->params, &ffm->audio))
 		return FFM_ERROR;
 
+#if FFM_HAVE_SHM
+	ffmpeg_mux_init_shm(ffm);
+#endif
+
 	if (ffm->params.tracks) {
 		ffm->audio_header =
 			calloc(1, sizeof(struct header) * ffm->params.tracks);
@@ -586,6 +655,34 @@ static int ffmpeg_mux_init(struct ffmpeg_mux *ffm, int argc, char *argv[])
 	return ret;
 }
 
+/* finishes the current file and starts writing to a new one, reusing the
+ * stream parameters and codec headers */
+static int ffmpeg_mux_change_file(struct ffmpeg_mux *ffm, uint8_t *data,
+		struct ffm_packet_info *info)
+{
+	int ret;
+
+	if (!info->size || data[info->size - 1] != 0)
+		return FFM_ERROR;
+
+	if (ffm->initialized) {
+		av_write_trailer(ffm->output);
+		ffm->initialized = false;
+	}
+
+	free_avformat(ffm);
+
+	free(ffm->changed_file);
+	ffm->changed_file = strdup((const char*)data);
+	ffm->params.file = ffm->changed_file;
+
+	ret = ffmpeg_mux_init_context(ffm);
+	if (ret == FFM_SUCCESS)
+		ffm->initialized = true;
+
+	return ret;
+}
+
 static inline int get_index(struct ffmpeg_mux *ffm,
 		struct ffm_packet_info *info)
 {
@@ -684,12 +781,16 @@ int main(int argc, char *argv[])
 	}
 
 	while (!fail && safe_read(&info, sizeof(info)) == sizeof(info)) {
-		resize_buf_resize(&rb, info.size);
+		uint8_t *data = ffmpeg_mux_read_data(&ffm, &info, &rb);
 
-		if (safe_read(rb.buf, info.size) == info.size) {
-			ffmpeg_mux_packet(&ffm, rb.buf, &info);
-		} else {
+		if (!data) {
 			fail = true;
+		} else if (info.type == FFM_PACKET_CHANGE_FILE) {
+			fail = ffmpeg_mux_change_file(&ffm, data, &info) !=
+				FFM_SUCCESS;
+		} else {
+			ffmpeg_mux_packet(&ffm, data, &info);
+			ffmpeg_mux_release_data(&ffm, &info);
 		}
 	}
 
@@ -20,7 +20,8 @@
 
 enum ffm_packet_type {
 	FFM_PACKET_VIDEO,
-	FFM_PACKET_AUDIO
+	FFM_PACKET_AUDIO,
+	FFM_PACKET_CHANGE_FILE
 };
 
 #define FFM_SUCCESS      0
@@ -34,4 +35,5 @@ struct ffm_packet_info {
 	uint32_t             index;
 	enum ffm_packet_type type;
 	bool                 keyframe;
+	bool                 shared;
 };
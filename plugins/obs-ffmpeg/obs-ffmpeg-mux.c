@@ -25,9 +25,15 @@
 #include <util/circlebuf.h>
 #include <util/threading.h>
 #include "ffmpeg-mux/ffmpeg-mux.h"
+#include "ffmpeg-mux/ffmpeg-mux-shm.h"
+#include "obs-ffmpeg-split.h"
 
 #ifdef _WIN32
 #include "util/windows/win-version.h"
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include <libavformat/avformat.h>
@@ -39,6 +45,36 @@
 #define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
 
+/* payloads of older replay buffer GOPs can be moved to a memory-mapped cache
+ * file, in which case only the packet info stays in memory */
+struct replay_cache {
+	int               fd;
+	uint8_t           *data;
+	uint64_t          capacity;
+	uint64_t          write_total;
+	uint64_t          read_total;
+};
+
+struct replay_packet {
+	struct encoder_packet packet;
+	uint64_t              cache_pos;
+	bool                  cached;
+};
+
+/* a replay buffer save in progress.  the mux thread merges the packets of
+ * each track (video first, then each audio track) straight from the replay
+ * buffer; packets from the first unmerged one on are not purged until the
+ * save is done */
+#define REPLAY_TRACKS (MAX_AUDIO_MIXES + 1)
+
+struct replay_save {
+	uint64_t          end_seq;
+	uint64_t          min_seq;
+	uint64_t          cursors[REPLAY_TRACKS];
+	int64_t           usec_offsets[REPLAY_TRACKS];
+	int64_t           dts_offsets[REPLAY_TRACKS];
+};
+
 struct ffmpeg_muxer {
 	obs_output_t      *output;
 	os_process_pipe_t *pipe;
@@ -50,8 +86,19 @@ struct ffmpeg_muxer {
 	volatile bool     stopping;
 	volatile bool     capturing;
 
+#if FFM_HAVE_SHM
+	struct ffm_shm    shm;
+#endif
+
+	/* file splitting */
+	bool              split_file;
+	struct dstr       split_base_path;
+	struct ffmpeg_split split;
+
 	/* replay buffer */
+	pthread_mutex_t   packets_mutex;
 	struct circlebuf  packets;
+	uint64_t          packets_front_seq;
 	int64_t           cur_size;
 	int64_t           cur_time;
 	int64_t           max_size;
@@ -60,10 +107,18 @@ struct ffmpeg_muxer {
 	int               keyframes;
 	obs_hotkey_id     hotkey;
 
-	DARRAY(struct encoder_packet) mux_packets;
+	/* replay buffer disk cache */
+	struct replay_cache *cache;
+	int64_t           mem_size;
+	int64_t           max_mem_size;
+	size_t            num_cached;
+	bool              cache_full;
+
+	struct replay_save            save;
 	pthread_t                     mux_thread;
 	bool                          mux_thread_joinable;
 	volatile bool                 muxing;
+	bool                          clear_after_save;
 };
 
 static const char *ffmpeg_mux_getname(void *type)
@@ -72,21 +127,41 @@ static const char *ffmpeg_mux_getname(void *type)
 	return obs_module_text("FFmpegMuxer");
 }
 
+static void replay_cache_destroy(struct replay_cache *cache);
+
+static inline void replay_buffer_join_save(struct ffmpeg_muxer *stream)
+{
+	if (stream->mux_thread_joinable) {
+		pthread_join(stream->mux_thread, NULL);
+		stream->mux_thread_joinable = false;
+	}
+}
+
+/* must not run while a save reads the buffer, see replay_buffer_join_save
+ * and clear_after_save */
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
 	while (stream->packets.size > 0) {
-		struct encoder_packet pkt;
-		circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
-		obs_encoder_packet_release(&pkt);
+		struct replay_packet rp;
+		circlebuf_pop_front(&stream->packets, &rp, sizeof(rp));
+		obs_encoder_packet_release(&rp.packet);
 	}
 
 	circlebuf_free(&stream->packets);
+	replay_cache_destroy(stream->cache);
+	stream->cache = NULL;
+	stream->packets_front_seq = 0;
 	stream->cur_size = 0;
 	stream->cur_time = 0;
 	stream->max_size = 0;
 	stream->max_time = 0;
 	stream->save_ts = 0;
 	stream->keyframes = 0;
+	stream->mem_size = 0;
+	stream->max_mem_size = 0;
+	stream->num_cached = 0;
+	stream->cache_full = false;
+	stream->clear_after_save = false;
 }
 
 static void ffmpeg_mux_destroy(void *data)
@@ -94,12 +169,13 @@ static void ffmpeg_mux_destroy(void *data)
 	struct ffmpeg_muxer *stream = data;
 
 	replay_buffer_clear(stream);
-	if (stream->mux_thread_joinable)
-		pthread_join(stream->mux_thread, NULL);
-	da_free(stream->mux_packets);
 
 	os_process_pipe_destroy(stream->pipe);
+#if FFM_HAVE_SHM
+	ffm_shm_unmap(&stream->shm);
+#endif
 	dstr_free(&stream->path);
+	dstr_free(&stream->split_base_path);
 	bfree(stream);
 }
 
@@ -265,12 +341,71 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 	add_muxer_params(cmd, stream);
 }
 
+#if FFM_HAVE_SHM
+#define SHM_WRITE_TIMEOUT_MS 10000
+
+/* creates the shared memory packet ring for the muxer process.  the fd is
+ * inherited by the muxer process and closed here once it has started */
+static int create_shm(struct ffmpeg_muxer *stream)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	bool use_shm = obs_data_get_bool(settings, "shared_memory");
+	int fd;
+
+	obs_data_release(settings);
+
+	if (!use_shm)
+		return -1;
+
+	fd = (int)syscall(SYS_memfd_create, "obs-ffmpeg-mux", 0);
+	if (fd == -1) {
+		warn("Failed to create shared memory, falling back to pipe");
+		return -1;
+	}
+
+	if (!ffm_shm_map(&stream->shm, fd, true, FFM_SHM_DEFAULT_SIZE)) {
+		warn("Failed to map shared memory, falling back to pipe");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+#endif
+
 static inline void start_pipe(struct ffmpeg_muxer *stream, const char *path)
 {
 	struct dstr cmd;
 	build_command_line(stream, &cmd, path);
+
+#if FFM_HAVE_SHM
+	int shm_fd = create_shm(stream);
+	if (shm_fd != -1)
+		dstr_catf(&cmd, "%d ", shm_fd);
+#endif
+
 	stream->pipe = os_process_pipe_create(cmd.array, "w");
 	dstr_free(&cmd);
+
+#if FFM_HAVE_SHM
+	if (shm_fd != -1) {
+		close(shm_fd);
+		if (!stream->pipe)
+			ffm_shm_unmap(&stream->shm);
+		else
+			info("Using shared memory for packet data");
+	}
+#endif
+}
+
+static inline void stop_pipe(struct ffmpeg_muxer *stream)
+{
+	os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+
+#if FFM_HAVE_SHM
+	ffm_shm_unmap(&stream->shm);
+#endif
 }
 
 static bool ffmpeg_mux_start(void *data)
@@ -315,6 +450,20 @@ static bool ffmpeg_mux_start(void *data)
 	fclose(test_file);
 	os_unlink(path);
 
+	stream->split_file = obs_data_get_bool(settings, "split_file");
+	memset(&stream->split, 0, sizeof(stream->split));
+	stream->split.max_time =
+		obs_data_get_int(settings, "max_time_sec") * 1000000LL;
+	stream->split.max_size =
+		obs_data_get_int(settings, "max_size_mb") * (1024 * 1024);
+	dstr_copy(&stream->split_base_path, path);
+
+	if (stream->split_file &&
+	    !stream->split.max_time && !stream->split.max_size) {
+		warn("File splitting requires a maximum time or size");
+		stream->split_file = false;
+	}
+
 	start_pipe(stream, path);
 	obs_data_release(settings);
 
@@ -342,6 +491,9 @@ static int deactivate(struct ffmpeg_muxer *stream)
 	if (active(stream)) {
 		ret = os_process_pipe_destroy(stream->pipe);
 		stream->pipe = NULL;
+#if FFM_HAVE_SHM
+		ffm_shm_unmap(&stream->shm);
+#endif
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -396,6 +548,21 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 		.keyframe = packet->keyframe
 	};
 
+#if FFM_HAVE_SHM
+	/* the payload must be in the ring before its info structure can be
+	 * read from the pipe */
+	if (ffm_shm_fits(&stream->shm, info.size)) {
+		if (!ffm_shm_write(&stream->shm, packet->data, info.size,
+					SHM_WRITE_TIMEOUT_MS)) {
+			warn("Timed out writing packet data to shared memory");
+			signal_failure(stream);
+			return false;
+		}
+
+		info.shared = true;
+	}
+#endif
+
 	ret = os_process_pipe_write(stream->pipe, (const uint8_t*)&info,
 			sizeof(info));
 	if (ret != sizeof(info)) {
@@ -404,11 +571,14 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 		return false;
 	}
 
-	ret = os_process_pipe_write(stream->pipe, packet->data, packet->size);
-	if (ret != packet->size) {
-		warn("os_process_pipe_write for packet data failed");
-		signal_failure(stream);
-		return false;
+	if (!info.shared) {
+		ret = os_process_pipe_write(stream->pipe, packet->data,
+				packet->size);
+		if (ret != packet->size) {
+			warn("os_process_pipe_write for packet data failed");
+			signal_failure(stream);
+			return false;
+		}
 	}
 
 	stream->total_bytes += packet->size;
@@ -462,6 +632,60 @@ static bool send_headers(struct ffmpeg_muxer *stream)
 	return true;
 }
 
+/* ------------------------------------------------------------------------ */
+/* file splitting */
+
+/* tells the muxer process to finish the current file and continue with a
+ * new one.  the muxer keeps the codec headers, so the encoders keep running
+ * and no packets are lost */
+static bool send_change_file(struct ffmpeg_muxer *stream, const char *path)
+{
+	size_t size = strlen(path) + 1;
+	size_t ret;
+
+	struct ffm_packet_info info = {
+		.size = (uint32_t)size,
+		.type = FFM_PACKET_CHANGE_FILE
+	};
+
+	ret = os_process_pipe_write(stream->pipe, (const uint8_t*)&info,
+			sizeof(info));
+	if (ret != sizeof(info)) {
+		warn("os_process_pipe_write for info structure failed");
+		signal_failure(stream);
+		return false;
+	}
+
+	ret = os_process_pipe_write(stream->pipe, (const uint8_t*)path, size);
+	if (ret != size) {
+		warn("os_process_pipe_write for file name failed");
+		signal_failure(stream);
+		return false;
+	}
+
+	return true;
+}
+
+static bool change_file(struct ffmpeg_muxer *stream)
+{
+	struct dstr path = {0};
+	bool success;
+
+	ffmpeg_split_get_path(&stream->split, stream->split_base_path.array,
+			&path);
+	success = send_change_file(stream, path.array);
+
+	if (success) {
+		ffmpeg_split_next_segment(&stream->split);
+		info("Changed output file to '%s'", path.array);
+	}
+
+	dstr_free(&path);
+	return success;
+}
+
+/* ------------------------------------------------------------------------ */
+
 static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -474,6 +698,9 @@ static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 			return;
 
 		stream->sent_headers = true;
+
+		if (stream->split_file)
+			ffmpeg_split_reset_segment(&stream->split);
 	}
 
 	if (stopping(stream)) {
@@ -483,7 +710,18 @@ static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
-	write_packet(stream, packet);
+	if (stream->split_file) {
+		struct encoder_packet pkt = *packet;
+
+		if (ffmpeg_split_needed(&stream->split, &pkt) &&
+		    !change_file(stream))
+			return;
+
+		ffmpeg_split_offset_packet(&stream->split, &pkt);
+		write_packet(stream, &pkt);
+	} else {
+		write_packet(stream, packet);
+	}
 }
 
 static obs_properties_t *ffmpeg_mux_properties(void *unused)
@@ -495,6 +733,10 @@ static obs_properties_t *ffmpeg_mux_properties(void *unused)
 	obs_properties_add_text(props, "path",
 			obs_module_text("FilePath"),
 			OBS_TEXT_DEFAULT);
+#if FFM_HAVE_SHM
+	obs_properties_add_bool(props, "shared_memory",
+			obs_module_text("SharedMemory"));
+#endif
 	return props;
 }
 
@@ -557,6 +799,12 @@ static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 	UNUSED_PARAMETER(settings);
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
 	stream->output = output;
+	pthread_mutex_init_value(&stream->packets_mutex);
+
+	if (pthread_mutex_init(&stream->packets_mutex, NULL) != 0) {
+		bfree(stream);
+		return NULL;
+	}
 
 	stream->hotkey = obs_hotkey_register_output(output,
 			"ReplayBuffer.Save",
@@ -576,9 +824,223 @@ static void replay_buffer_destroy(void *data)
 	struct ffmpeg_muxer *stream = data;
 	if (stream->hotkey)
 		obs_hotkey_unregister(stream->hotkey);
+	replay_buffer_join_save(stream);
+	pthread_mutex_destroy(&stream->packets_mutex);
 	ffmpeg_mux_destroy(data);
 }
 
+/* ------------------------------------------------------------------------ */
+/* replay buffer disk cache */
+
+#ifndef _WIN32
+/* allocates the whole file up front where the platform can, so that running
+ * out of disk space fails here instead of with SIGBUS on a later write to
+ * the mapping */
+static bool reserve_cache_file(int fd, off_t size)
+{
+#if defined(__linux__)
+	return posix_fallocate(fd, 0, size) == 0;
+#else
+#if defined(__APPLE__)
+	fstore_t store = {
+		.fst_flags   = F_ALLOCATECONTIG | F_ALLOCATEALL,
+		.fst_posmode = F_PEOFPOSMODE,
+		.fst_offset  = 0,
+		.fst_length  = size
+	};
+
+	if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+		store.fst_flags = F_ALLOCATEALL;
+		if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+			return false;
+	}
+#endif
+	return ftruncate(fd, size) == 0;
+#endif
+}
+#endif
+
+static struct replay_cache *replay_cache_create(struct ffmpeg_muxer *stream,
+		uint64_t capacity)
+{
+#ifdef _WIN32
+	UNUSED_PARAMETER(capacity);
+	warn("Replay buffer disk cache is not supported on this platform");
+	return NULL;
+#else
+	static volatile long cache_id = 0;
+	struct replay_cache *cache;
+	struct dstr name = {0};
+	char *dir;
+	char *path;
+	void *data;
+	int fd;
+
+	dir = obs_module_config_path("");
+	os_mkdirs(dir);
+	bfree(dir);
+
+	dstr_printf(&name, "replay-cache-%ld.bin",
+			os_atomic_inc_long(&cache_id));
+	path = obs_module_config_path(name.array);
+	dstr_free(&name);
+
+	/* the file is unlinked right away so it never outlives the process */
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		warn("Failed to create replay buffer cache file '%s'", path);
+		bfree(path);
+		return NULL;
+	}
+
+	os_unlink(path);
+	bfree(path);
+
+	if (!reserve_cache_file(fd, (off_t)capacity)) {
+		warn("Failed to allocate %d MB for the replay buffer "
+		     "cache file", (int)(capacity / (1024 * 1024)));
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, (size_t)capacity, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		warn("Failed to map replay buffer cache file");
+		close(fd);
+		return NULL;
+	}
+
+	cache = bzalloc(sizeof(*cache));
+	cache->fd = fd;
+	cache->data = data;
+	cache->capacity = capacity;
+	return cache;
+#endif
+}
+
+static void replay_cache_destroy(struct replay_cache *cache)
+{
+	if (!cache)
+		return;
+
+#ifndef _WIN32
+	munmap(cache->data, (size_t)cache->capacity);
+	close(cache->fd);
+#endif
+	bfree(cache);
+}
+
+static inline uint8_t *replay_cache_data(struct replay_cache *cache,
+		const struct replay_packet *rp)
+{
+	return cache->data + rp->cache_pos % cache->capacity;
+}
+
+/* moves a packet's payload to the cache.  like the shared memory ring, each
+ * payload is stored contiguously, skipping to the start of the file if it
+ * would not fit at the end.  space is only reused once its packets have
+ * been purged */
+static bool replay_cache_store(struct ffmpeg_muxer *stream,
+		struct replay_packet *rp)
+{
+	struct replay_cache *cache = stream->cache;
+	uint64_t size = rp->packet.size;
+	uint64_t pos = cache->write_total % cache->capacity;
+	uint64_t skip = (pos + size > cache->capacity) ?
+		cache->capacity - pos : 0;
+	struct encoder_packet pkt;
+
+	if (cache->capacity - (cache->write_total - cache->read_total) <
+			skip + size)
+		return false;
+
+	rp->cache_pos = cache->write_total + skip;
+	memcpy(replay_cache_data(cache, rp), rp->packet.data, size);
+	cache->write_total = rp->cache_pos + size;
+
+	/* release the payload but keep the rest of the packet info */
+	pkt = rp->packet;
+	obs_encoder_packet_release(&pkt);
+	rp->packet.data = NULL;
+	rp->cached = true;
+	return true;
+}
+
+static inline bool is_keyframe_packet(struct replay_packet *rp)
+{
+	return rp->packet.type == OBS_ENCODER_VIDEO && rp->packet.keyframe;
+}
+
+/* moves the oldest GOPs still in memory to the cache until the memory used
+ * by payloads is back under the limit */
+static void replay_buffer_spill(struct ffmpeg_muxer *stream)
+{
+	const size_t size = sizeof(struct replay_packet);
+	size_t num_packets = stream->packets.size / size;
+	size_t idx = stream->num_cached;
+
+	if (!stream->cache)
+		return;
+
+	while (stream->mem_size > stream->max_mem_size && idx < num_packets) {
+		struct replay_packet *rp =
+			circlebuf_data(&stream->packets, idx * size);
+		int64_t pkt_size = (int64_t)rp->packet.size;
+
+		if (!replay_cache_store(stream, rp)) {
+			if (!stream->cache_full) {
+				warn("Replay buffer cache file is full, "
+				     "keeping packets in memory");
+				stream->cache_full = true;
+			}
+			return;
+		}
+
+		stream->cache_full = false;
+		stream->mem_size -= pkt_size;
+		stream->num_cached = ++idx;
+
+		/* always move complete GOPs */
+		while (idx < num_packets) {
+			rp = circlebuf_data(&stream->packets, idx * size);
+			if (is_keyframe_packet(rp) ||
+			    !replay_cache_store(stream, rp))
+				break;
+
+			stream->mem_size -= (int64_t)rp->packet.size;
+			stream->num_cached = ++idx;
+		}
+	}
+}
+
+static void replay_buffer_init_cache(struct ffmpeg_muxer *stream,
+		obs_data_t *settings)
+{
+	uint64_t capacity;
+
+	stream->max_mem_size =
+		obs_data_get_int(settings, "max_memory_mb") * (1024 * 1024);
+
+	if (!obs_data_get_bool(settings, "disk_cache"))
+		return;
+
+	if (!stream->max_size) {
+		warn("Replay buffer disk cache requires a maximum size");
+		return;
+	}
+
+	/* leave room for the GOPs kept beyond the size limit */
+	capacity = (uint64_t)(stream->max_size + stream->max_size / 4);
+	stream->cache = replay_cache_create(stream, capacity);
+
+	if (stream->cache)
+		info("Using replay buffer disk cache, memory limit: %d MB",
+				(int)(stream->max_mem_size / (1024 * 1024)));
+}
+
+/* ------------------------------------------------------------------------ */
+
 static bool replay_buffer_start(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -588,9 +1050,14 @@ static bool replay_buffer_start(void *data)
 	if (!obs_output_initialize_encoders(stream->output, 0))
 		return false;
 
+	/* a save still running from the last session clears the buffer when
+	 * it is done, which must happen before it is filled again */
+	replay_buffer_join_save(stream);
+
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+	replay_buffer_init_cache(stream, s);
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -601,46 +1068,69 @@ static bool replay_buffer_start(void *data)
 	return true;
 }
 
+static inline bool can_purge(struct ffmpeg_muxer *stream)
+{
+	return !os_atomic_load_bool(&stream->muxing) ||
+		stream->packets_front_seq < stream->save.min_seq;
+}
+
 static bool purge_front(struct ffmpeg_muxer *stream)
 {
-	struct encoder_packet pkt;
+	struct replay_packet rp;
 	bool keyframe;
 
-	circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
+	circlebuf_pop_front(&stream->packets, &rp, sizeof(rp));
+	stream->packets_front_seq++;
 
-	keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
+	keyframe = is_keyframe_packet(&rp);
 
 	if (keyframe)
 		stream->keyframes--;
 
+	if (rp.cached) {
+		stream->cache->read_total = rp.cache_pos + rp.packet.size;
+		stream->num_cached--;
+	} else {
+		stream->mem_size -= (int64_t)rp.packet.size;
+	}
+
 	if (!stream->packets.size) {
 		stream->cur_size = 0;
 		stream->cur_time = 0;
 	} else {
-		struct encoder_packet first;
+		struct replay_packet first;
 		circlebuf_peek_front(&stream->packets, &first, sizeof(first));
-		stream->cur_time = first.dts_usec;
-		stream->cur_size -= (int64_t)pkt.size;
+		stream->cur_time = first.packet.dts_usec;
+		stream->cur_size -= (int64_t)rp.packet.size;
 	}
 
-	obs_encoder_packet_release(&pkt);
+	obs_encoder_packet_release(&rp.packet);
 	return keyframe;
 }
 
-static inline void purge(struct ffmpeg_muxer *stream)
+/* returns false if packets still needed by a save kept it from purging */
+static inline bool purge(struct ffmpeg_muxer *stream)
 {
+	if (!can_purge(stream))
+		return false;
+
 	if (purge_front(stream)) {
-		struct encoder_packet pkt;
+		struct replay_packet rp;
 
 		for (;;) {
-			circlebuf_peek_front(&stream->packets, &pkt,
-					sizeof(pkt));
-			if (pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe)
-				return;
+			if (!can_purge(stream))
+				return true;
+
+			circlebuf_peek_front(&stream->packets, &rp,
+					sizeof(rp));
+			if (is_keyframe_packet(&rp))
+				return true;
 
 			purge_front(stream);
 		}
 	}
+
+	return true;
 }
 
 static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
@@ -651,51 +1141,118 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 			return;
 
 		while ((stream->cur_size + (int64_t)pkt->size) >
-				stream->max_size)
-			purge(stream);
+				stream->max_size) {
+			if (!purge(stream))
+				return;
+		}
 	}
 
 	if (!stream->packets.size || stream->keyframes <= 2)
 		return;
 
-	while ((pkt->dts_usec - stream->cur_time) > stream->max_time)
-		purge(stream);
+	while ((pkt->dts_usec - stream->cur_time) > stream->max_time) {
+		if (!purge(stream))
+			return;
+	}
 }
 
-static void insert_packet(struct darray *array, struct encoder_packet *packet,
-		int64_t video_offset, int64_t *audio_offsets,
-		int64_t video_dts_offset, int64_t *audio_dts_offsets)
+/* ------------------------------------------------------------------------ */
+/* replay buffer saving */
+
+static inline size_t replay_track(const struct encoder_packet *pkt)
 {
-	struct encoder_packet pkt;
-	DARRAY(struct encoder_packet) packets;
-	packets.da = *array;
-	size_t idx;
+	return pkt->type == OBS_ENCODER_VIDEO ? 0 : pkt->track_idx + 1;
+}
 
-	obs_encoder_packet_ref(&pkt, packet);
+static inline struct replay_packet *get_replay_packet(
+		struct ffmpeg_muxer *stream, uint64_t seq)
+{
+	size_t idx = (size_t)(seq - stream->packets_front_seq);
+	return circlebuf_data(&stream->packets,
+			idx * sizeof(struct replay_packet));
+}
 
-	if (pkt.type == OBS_ENCODER_VIDEO) {
-		pkt.dts_usec -= video_offset;
-		pkt.dts -= video_dts_offset;
-		pkt.pts -= video_dts_offset;
-	} else {
-		pkt.dts_usec -= audio_offsets[pkt.track_idx];
-		pkt.dts -= audio_dts_offsets[pkt.track_idx];
-		pkt.pts -= audio_dts_offsets[pkt.track_idx];
+/* returns the next packet of a track that has not been written yet.  the
+ * cursor only skips packets of other tracks, so the whole save scans the
+ * buffer once per track */
+static struct replay_packet *save_track_head(struct ffmpeg_muxer *stream,
+		size_t track)
+{
+	struct replay_save *save = &stream->save;
+
+	while (save->cursors[track] < save->end_seq) {
+		struct replay_packet *rp =
+			get_replay_packet(stream, save->cursors[track]);
+		if (replay_track(&rp->packet) == track)
+			return rp;
+
+		save->cursors[track]++;
 	}
 
-	for (idx = packets.num; idx > 0; idx--) {
-		struct encoder_packet *p = packets.array + (idx - 1);
-		if (p->dts_usec < pkt.dts_usec)
-			break;
+	return NULL;
+}
+
+/* picks the track head with the lowest dts.  each track is already in dts
+ * order, so this merges them without sorting */
+static bool save_next_packet(struct ffmpeg_muxer *stream,
+		struct replay_packet *out, size_t *out_track)
+{
+	struct replay_save *save = &stream->save;
+	struct replay_packet *best = NULL;
+	int64_t best_dts = 0;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+
+	for (size_t i = 0; i < REPLAY_TRACKS; i++) {
+		struct replay_packet *rp = save_track_head(stream, i);
+		int64_t dts_usec;
+
+		if (!rp)
+			continue;
+
+		dts_usec = rp->packet.dts_usec - save->usec_offsets[i];
+		if (!best || dts_usec < best_dts) {
+			best = rp;
+			best_dts = dts_usec;
+			*out_track = i;
+		}
+	}
+
+	/* the payload may be moved to the disk cache while it is written */
+	if (best) {
+		*out = *best;
+		if (!best->cached)
+			obs_encoder_packet_ref(&out->packet, &best->packet);
 	}
 
-	da_insert(packets, idx, &pkt);
-	*array = packets.da;
+	pthread_mutex_unlock(&stream->packets_mutex);
+	return best != NULL;
+}
+
+static void save_advance(struct ffmpeg_muxer *stream, size_t track)
+{
+	struct replay_save *save = &stream->save;
+	uint64_t min_seq = save->end_seq;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+
+	save->cursors[track]++;
+
+	for (size_t i = 0; i < REPLAY_TRACKS; i++) {
+		if (save->cursors[i] < min_seq)
+			min_seq = save->cursors[i];
+	}
+
+	save->min_seq = min_seq;
+	pthread_mutex_unlock(&stream->packets_mutex);
 }
 
 static void *replay_buffer_mux_thread(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
+	struct replay_save *save = &stream->save;
+	struct replay_packet rp;
+	size_t track;
 
 	start_pipe(stream, stream->path.array);
 
@@ -710,60 +1267,71 @@ static void *replay_buffer_mux_thread(void *data)
 		goto error;
 	}
 
-	for (size_t i = 0; i < stream->mux_packets.num; i++) {
-		struct encoder_packet *pkt = &stream->mux_packets.array[i];
-		write_packet(stream, pkt);
-		obs_encoder_packet_release(pkt);
+	while (save_next_packet(stream, &rp, &track)) {
+		struct encoder_packet *pkt = &rp.packet;
+		bool success;
+
+		pkt->dts_usec -= save->usec_offsets[track];
+		pkt->dts -= save->dts_offsets[track];
+		pkt->pts -= save->dts_offsets[track];
+
+		if (rp.cached) {
+			pkt->data = replay_cache_data(stream->cache, &rp);
+			success = write_packet(stream, pkt);
+		} else {
+			success = write_packet(stream, pkt);
+			obs_encoder_packet_release(pkt);
+		}
+
+		if (!success)
+			goto error;
+
+		save_advance(stream, track);
 	}
 
 	info("Wrote replay buffer to '%s'", stream->path.array);
 
 error:
-	os_process_pipe_destroy(stream->pipe);
-	stream->pipe = NULL;
-	da_free(stream->mux_packets);
+	stop_pipe(stream);
+
+	/* the output stopped during the save and left the buffer to us */
+	pthread_mutex_lock(&stream->packets_mutex);
 	os_atomic_set_bool(&stream->muxing, false);
+	if (stream->clear_after_save)
+		replay_buffer_clear(stream);
+	pthread_mutex_unlock(&stream->packets_mutex);
 	return NULL;
 }
 
 static void replay_buffer_save(struct ffmpeg_muxer *stream)
 {
-	const size_t size = sizeof(struct encoder_packet);
+	const size_t size = sizeof(struct replay_packet);
 	size_t num_packets = stream->packets.size / size;
-
-	da_reserve(stream->mux_packets, num_packets);
+	struct replay_save *save = &stream->save;
+	bool found[REPLAY_TRACKS] = {0};
 
 	/* ---------------------------- */
-	/* reorder packets */
+	/* find the start of each track */
+
+	memset(save, 0, sizeof(*save));
+	save->end_seq = stream->packets_front_seq + num_packets;
+	save->min_seq = stream->packets_front_seq;
 
-	bool found_video = false;
-	bool found_audio[MAX_AUDIO_MIXES] = {0};
-	int64_t video_offset = 0;
-	int64_t video_dts_offset = 0;
-	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
-	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
+	for (size_t i = 0; i < REPLAY_TRACKS; i++)
+		save->cursors[i] = stream->packets_front_seq;
 
 	for (size_t i = 0; i < num_packets; i++) {
-		struct encoder_packet *pkt;
-		pkt = circlebuf_data(&stream->packets, i * size);
-
-		if (pkt->type == OBS_ENCODER_VIDEO) {
-			if (!found_video) {
-				video_offset = pkt->dts_usec;
-				video_dts_offset = pkt->dts;
-				found_video = true;
-			}
-		} else {
-			if (!found_audio[pkt->track_idx]) {
-				found_audio[pkt->track_idx] = true;
-				audio_offsets[pkt->track_idx] = pkt->dts_usec;
-				audio_dts_offsets[pkt->track_idx] = pkt->dts;
-			}
-		}
+		struct replay_packet *rp;
+		size_t track;
 
-		insert_packet(&stream->mux_packets.da, pkt,
-				video_offset, audio_offsets,
-				video_dts_offset, audio_dts_offsets);
+		rp = circlebuf_data(&stream->packets, i * size);
+		track = replay_track(&rp->packet);
+
+		if (!found[track]) {
+			save->usec_offsets[track] = rp->packet.dts_usec;
+			save->dts_offsets[track] = rp->packet.dts;
+			found[track] = true;
+		}
 	}
 
 	/* ---------------------------- */
@@ -791,6 +1359,8 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 	os_atomic_set_bool(&stream->muxing, true);
 	stream->mux_thread_joinable = pthread_create(&stream->mux_thread, NULL,
 			replay_buffer_mux_thread, stream) == 0;
+	if (!stream->mux_thread_joinable)
+		os_atomic_set_bool(&stream->muxing, false);
 }
 
 static void deactivate_replay_buffer(struct ffmpeg_muxer *stream)
@@ -801,13 +1371,21 @@ static void deactivate_replay_buffer(struct ffmpeg_muxer *stream)
 	os_atomic_set_bool(&stream->active, false);
 	os_atomic_set_bool(&stream->sent_headers, false);
 	os_atomic_set_bool(&stream->stopping, false);
-	replay_buffer_clear(stream);
+
+	/* this is the encoder thread, so it never waits for a save to finish.
+	 * a save in progress clears the buffer itself once it is done */
+	pthread_mutex_lock(&stream->packets_mutex);
+	if (os_atomic_load_bool(&stream->muxing))
+		stream->clear_after_save = true;
+	else
+		replay_buffer_clear(stream);
+	pthread_mutex_unlock(&stream->packets_mutex);
 }
 
 static void replay_buffer_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
-	struct encoder_packet pkt;
+	struct replay_packet rp = {0};
 
 	if (!active(stream))
 		return;
@@ -819,26 +1397,31 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
-	obs_encoder_packet_ref(&pkt, packet);
-	replay_buffer_purge(stream, &pkt);
+	pthread_mutex_lock(&stream->packets_mutex);
+
+	obs_encoder_packet_ref(&rp.packet, packet);
+	replay_buffer_purge(stream, &rp.packet);
 
 	if (!stream->packets.size)
-		stream->cur_time = pkt.dts_usec;
-	stream->cur_size += pkt.size;
+		stream->cur_time = rp.packet.dts_usec;
+	stream->cur_size += rp.packet.size;
+	stream->mem_size += rp.packet.size;
 
-	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
+	circlebuf_push_back(&stream->packets, &rp, sizeof(rp));
 
 	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
 		stream->keyframes++;
 
+	replay_buffer_spill(stream);
+
+	pthread_mutex_unlock(&stream->packets_mutex);
+
 	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
 		if (os_atomic_load_bool(&stream->muxing))
 			return;
 
-		if (stream->mux_thread_joinable) {
-			pthread_join(stream->mux_thread, NULL);
-			stream->mux_thread_joinable = false;
-		}
+		/* only the exit of a finished save is left to wait for */
+		replay_buffer_join_save(stream);
 
 		stream->save_ts = 0;
 		replay_buffer_save(stream);
@@ -852,6 +1435,8 @@ static void replay_buffer_defaults(obs_data_t *s)
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
+	obs_data_set_default_bool(s, "disk_cache", false);
+	obs_data_set_default_int(s, "max_memory_mb", 64);
 }
 
 struct obs_output_info replay_buffer = {
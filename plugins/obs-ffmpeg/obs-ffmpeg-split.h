@@ -0,0 +1,101 @@
+#pragma once
+
+#include <obs.h>
+#include <util/dstr.h>
+
+/* decides where the ffmpeg muxer output switches files and rebases the
+ * timestamps of each file.  kept apart from the output so test-split can
+ * feed packets through it without a muxer process */
+struct ffmpeg_split {
+	int64_t           max_time;
+	int64_t           max_size;
+	int               count;      /* files finished so far */
+	int64_t           seg_start_usec;
+	int64_t           seg_size;
+	bool              seg_found_video;
+	bool              seg_found_audio[MAX_AUDIO_MIXES];
+	int64_t           seg_video_offset;
+	int64_t           seg_audio_offsets[MAX_AUDIO_MIXES];
+};
+
+static inline void ffmpeg_split_reset_segment(struct ffmpeg_split *split)
+{
+	split->seg_size = 0;
+	split->seg_found_video = false;
+	memset(split->seg_found_audio, 0, sizeof(split->seg_found_audio));
+}
+
+/* files only change on a video keyframe once the current file has video */
+static inline bool ffmpeg_split_needed(const struct ffmpeg_split *split,
+		const struct encoder_packet *packet)
+{
+	if (packet->type != OBS_ENCODER_VIDEO || !packet->keyframe ||
+	    !split->seg_found_video)
+		return false;
+
+	if (split->max_time &&
+	    packet->dts_usec - split->seg_start_usec >= split->max_time)
+		return true;
+
+	return split->max_size && split->seg_size >= split->max_size;
+}
+
+/* call after the new file was started */
+static inline void ffmpeg_split_next_segment(struct ffmpeg_split *split)
+{
+	split->count++;
+	ffmpeg_split_reset_segment(split);
+}
+
+/* each file starts its timestamps at the first packet of each track, the
+ * same way saved replays do */
+static inline void ffmpeg_split_offset_packet(struct ffmpeg_split *split,
+		struct encoder_packet *pkt)
+{
+	int64_t offset;
+
+	if (pkt->type == OBS_ENCODER_VIDEO) {
+		if (!split->seg_found_video) {
+			split->seg_found_video = true;
+			split->seg_video_offset = pkt->dts;
+			split->seg_start_usec = pkt->dts_usec;
+		}
+
+		offset = split->seg_video_offset;
+	} else {
+		size_t idx = pkt->track_idx;
+
+		if (!split->seg_found_audio[idx]) {
+			split->seg_found_audio[idx] = true;
+			split->seg_audio_offsets[idx] = pkt->dts;
+		}
+
+		offset = split->seg_audio_offsets[idx];
+	}
+
+	pkt->dts -= offset;
+	pkt->pts -= offset;
+
+	split->seg_size += (int64_t)pkt->size;
+}
+
+/* the path of the next file: "_2", "_3" ... inserted before the extension
+ * of the first file's path.  the first file keeps the path as it is, so
+ * the file started after count splits is number count + 2 */
+static inline void ffmpeg_split_get_path(const struct ffmpeg_split *split,
+		const char *base, struct dstr *dst)
+{
+	const char *slash = strrchr(base, '/');
+	const char *ext = strrchr(base, '.');
+#ifdef _WIN32
+	const char *bslash = strrchr(base, '\\');
+	if (bslash && (!slash || bslash > slash))
+		slash = bslash;
+#endif
+
+	if (!ext || (slash && ext < slash))
+		ext = base + strlen(base);
+
+	dstr_ncopy(dst, base, ext - base);
+	dstr_catf(dst, "_%d%s", split->count + 2, ext);
+}
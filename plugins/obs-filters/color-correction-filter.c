@@ -340,6 +340,37 @@ static void color_correction_filter_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+/*
+ * The same operations as PSColorFilterRGBA, as a per-pixel function that
+ * libobs can combine with the neighbouring filters into a single pass.
+ */
+static const char *color_correction_fused_shader =
+"uniform float3 $gamma;\n"
+"uniform float4x4 $color_matrix;\n"
+"\n"
+"float4 $main(float4 rgba)\n"
+"{\n"
+"	rgba.rgb = pow(rgba.rgb, $gamma);\n"
+"	return mul($color_matrix, rgba);\n"
+"}\n";
+
+static const char *color_correction_filter_get_fused_shader(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return color_correction_fused_shader;
+}
+
+static void color_correction_filter_set_fused_params(void *data,
+		gs_effect_t *effect, const char *prefix)
+{
+	struct color_correction_filter_data *filter = data;
+
+	gs_effect_set_vec3(obs_fused_effect_get_param(effect, prefix,
+				"gamma"), &filter->gamma);
+	gs_effect_set_matrix4(obs_fused_effect_get_param(effect, prefix,
+				"color_matrix"), &filter->final_matrix);
+}
+
 /*
  * This function sets the interface. the types (add_*_Slider), the type of
  * data collected (int), the internal name, user-facing name, minimum,
@@ -402,12 +433,14 @@ static void color_correction_filter_defaults(obs_data_t *settings)
 struct obs_source_info color_filter = {
 	.id = "color_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_FUSABLE,
 	.get_name = color_correction_filter_name,
 	.create = color_correction_filter_create,
 	.destroy = color_correction_filter_destroy,
 	.video_render = color_correction_filter_render,
 	.update = color_correction_filter_update,
 	.get_properties = color_correction_filter_properties,
-	.get_defaults = color_correction_filter_defaults
+	.get_defaults = color_correction_filter_defaults,
+	.get_fused_shader = color_correction_filter_get_fused_shader,
+	.set_fused_params = color_correction_filter_set_fused_params
 };
@@ -183,6 +183,52 @@ static void color_key_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+/* same as ProcessColorKey in color_key_filter.effect */
+static const char *color_key_fused_shader =
+"uniform float4 $color;\n"
+"uniform float $contrast;\n"
+"uniform float $brightness;\n"
+"uniform float $gamma;\n"
+"uniform float4 $key_color;\n"
+"uniform float $similarity;\n"
+"uniform float $smoothness;\n"
+"\n"
+"float4 $main(float4 rgba)\n"
+"{\n"
+"	rgba *= $color;\n"
+"	float colorDist = distance($key_color.rgb, rgba.rgb);\n"
+"	rgba.a *= saturate(max(colorDist - $similarity, 0.0) / $smoothness);\n"
+"	return float4(pow(rgba.rgb, float3($gamma, $gamma, $gamma)) *\n"
+"			$contrast + $brightness, rgba.a);\n"
+"}\n";
+
+static const char *color_key_get_fused_shader(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return color_key_fused_shader;
+}
+
+static void color_key_set_fused_params(void *data, gs_effect_t *effect,
+		const char *prefix)
+{
+	struct color_key_filter_data *filter = data;
+
+	gs_effect_set_vec4(obs_fused_effect_get_param(effect, prefix,
+				"color"), &filter->color);
+	gs_effect_set_float(obs_fused_effect_get_param(effect, prefix,
+				"contrast"), filter->contrast);
+	gs_effect_set_float(obs_fused_effect_get_param(effect, prefix,
+				"brightness"), filter->brightness);
+	gs_effect_set_float(obs_fused_effect_get_param(effect, prefix,
+				"gamma"), filter->gamma);
+	gs_effect_set_vec4(obs_fused_effect_get_param(effect, prefix,
+				"key_color"), &filter->key_color);
+	gs_effect_set_float(obs_fused_effect_get_param(effect, prefix,
+				"similarity"), filter->similarity);
+	gs_effect_set_float(obs_fused_effect_get_param(effect, prefix,
+				"smoothness"), filter->smoothness);
+}
+
 static bool key_type_changed(obs_properties_t *props, obs_property_t *p,
 		obs_data_t *settings)
 {
@@ -245,12 +291,14 @@ static void color_key_defaults(obs_data_t *settings)
 struct obs_source_info color_key_filter = {
 	.id                            = "color_key_filter",
 	.type                          = OBS_SOURCE_TYPE_FILTER,
-	.output_flags                  = OBS_SOURCE_VIDEO,
+	.output_flags                  = OBS_SOURCE_VIDEO | OBS_SOURCE_FUSABLE,
 	.get_name                      = color_key_name,
 	.create                        = color_key_create,
 	.destroy                       = color_key_destroy,
 	.video_render                  = color_key_render,
 	.update                        = color_key_update,
 	.get_properties                = color_key_properties,
-	.get_defaults                  = color_key_defaults
+	.get_defaults                  = color_key_defaults,
+	.get_fused_shader              = color_key_get_fused_shader,
+	.set_fused_params              = color_key_set_fused_params
 };
@@ -33,6 +33,63 @@ static void log_rtmp(int level, const char *format, va_list args)
 
 static inline size_t num_buffered_packets(struct rtmp_stream *stream);
 
+static inline size_t num_gops(struct rtmp_stream *stream)
+{
+	return stream->gops.size / sizeof(struct rtmp_gop);
+}
+
+static inline struct rtmp_gop *get_gop(struct rtmp_stream *stream, size_t idx)
+{
+	return circlebuf_data(&stream->gops, idx * sizeof(struct rtmp_gop));
+}
+
+static inline size_t num_gop_frames(struct circlebuf *frames)
+{
+	return frames->size / sizeof(struct rtmp_gop_frame);
+}
+
+static inline void free_gops(struct rtmp_stream *stream)
+{
+	while (stream->gops.size) {
+		struct rtmp_gop gop;
+		circlebuf_pop_front(&stream->gops, &gop, sizeof(gop));
+		circlebuf_free(&gop.refs);
+		circlebuf_free(&gop.nonrefs);
+	}
+}
+
+static inline void pop_gop_frames(struct circlebuf *frames, uint64_t seq)
+{
+	while (frames->size) {
+		struct rtmp_gop_frame *frame = circlebuf_data(frames, 0);
+		if (frame->seq >= seq)
+			break;
+		circlebuf_pop_front(frames, NULL, sizeof(*frame));
+	}
+}
+
+/* removes index entries for packets that have already left the buffer */
+static void trim_gops(struct rtmp_stream *stream)
+{
+	uint64_t front_seq = stream->packets_front_seq;
+
+	while (stream->gops.size) {
+		struct rtmp_gop *gop = get_gop(stream, 0);
+		struct rtmp_gop *next = num_gops(stream) > 1 ?
+			get_gop(stream, 1) : NULL;
+
+		pop_gop_frames(&gop->refs, front_seq);
+		pop_gop_frames(&gop->nonrefs, front_seq);
+
+		if (!next || next->start_seq > front_seq)
+			break;
+
+		circlebuf_free(&gop->refs);
+		circlebuf_free(&gop->nonrefs);
+		circlebuf_pop_front(&stream->gops, NULL, sizeof(*gop));
+	}
+}
+
 static inline void free_packets(struct rtmp_stream *stream)
 {
 	size_t num_packets;
@@ -48,6 +105,10 @@ static inline void free_packets(struct rtmp_stream *stream)
 		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
 		obs_encoder_packet_release(&packet);
 	}
+
+	free_gops(stream);
+	stream->packets_front_seq = 0;
+	stream->num_dropped_buffered = 0;
 	pthread_mutex_unlock(&stream->packets_mutex);
 }
 
@@ -103,6 +164,7 @@ static void rtmp_stream_destroy(void *data)
 	os_sem_destroy(stream->send_sem);
 	pthread_mutex_destroy(&stream->packets_mutex);
 	circlebuf_free(&stream->packets);
+	circlebuf_free(&stream->gops);
 #ifdef TEST_FRAMEDROPS
 	circlebuf_free(&stream->droptest_info);
 #endif
@@ -212,11 +274,21 @@ static inline bool get_next_packet(struct rtmp_stream *stream,
 	bool new_packet = false;
 
 	pthread_mutex_lock(&stream->packets_mutex);
-	if (stream->packets.size) {
+	while (stream->packets.size) {
 		circlebuf_pop_front(&stream->packets, packet,
 				sizeof(struct encoder_packet));
-		new_packet = true;
+		stream->packets_front_seq++;
+
+		/* frames dropped in place are left behind with no data */
+		if (packet->data) {
+			new_packet = true;
+			break;
+		}
+
+		stream->num_dropped_buffered--;
 	}
+
+	trim_gops(stream);
 	pthread_mutex_unlock(&stream->packets_mutex);
 
 	return new_packet;
@@ -359,10 +431,13 @@ static int send_packet(struct rtmp_stream *stream,
 	ret = RTMP_Write(&stream->rtmp, (char*)data, (int)size, (int)idx);
 	bfree(data);
 
-	if (is_header)
+	if (is_header) {
 		bfree(packet->data);
-	else
+	} else {
+		if (ret >= 0)
+			obs_output_packet_sent(stream->output, packet);
 		obs_encoder_packet_release(packet);
+	}
 
 	stream->total_bytes_sent += size;
 	return ret;
@@ -492,6 +567,14 @@ static void *send_thread(void *data)
 		info("User stopped the stream");
 	}
 
+	if (stream->dropped_frames) {
+		info("Dropped frames: %d non-reference, %d GOP tail, "
+		     "%d waiting for next priority frame",
+				stream->dropped_nonref_frames,
+				stream->dropped_gop_tail_frames,
+				stream->dropped_waiting_frames);
+	}
+
 	if (stream->new_socket_loop) {
 		os_event_signal(stream->send_thread_signaled_exit);
 		os_event_signal(stream->buffer_has_data_event);
@@ -897,6 +980,9 @@ static bool init_connect(struct rtmp_stream *stream)
 	os_atomic_set_bool(&stream->disconnected, false);
 	stream->total_bytes_sent = 0;
 	stream->dropped_frames   = 0;
+	stream->dropped_nonref_frames   = 0;
+	stream->dropped_gop_tail_frames = 0;
+	stream->dropped_waiting_frames  = 0;
 	stream->min_priority     = 0;
 	stream->got_first_video  = false;
 
@@ -980,45 +1066,155 @@ static inline bool add_packet(struct rtmp_stream *stream,
 
 static inline size_t num_buffered_packets(struct rtmp_stream *stream)
 {
-	return stream->packets.size / sizeof(struct encoder_packet);
+	return stream->packets.size / sizeof(struct encoder_packet) -
+		stream->num_dropped_buffered;
 }
 
-static void drop_frames(struct rtmp_stream *stream, const char *name,
-		int highest_priority, bool pframes)
+static inline uint64_t next_packet_seq(struct rtmp_stream *stream)
 {
-	UNUSED_PARAMETER(pframes);
+	return stream->packets_front_seq +
+		stream->packets.size / sizeof(struct encoder_packet);
+}
 
-	struct circlebuf new_buf            = {0};
-	int              num_frames_dropped = 0;
+static void index_video_packet(struct rtmp_stream *stream,
+		struct encoder_packet *packet)
+{
+	struct rtmp_gop_frame frame;
+	struct rtmp_gop *gop;
 
-#ifdef _DEBUG
-	int start_packets = (int)num_buffered_packets(stream);
-#else
-	UNUSED_PARAMETER(name);
-#endif
+	frame.seq = next_packet_seq(stream);
+	frame.dts_usec = packet->dts_usec;
 
-	circlebuf_reserve(&new_buf, sizeof(struct encoder_packet) * 8);
+	if (packet->keyframe || !stream->gops.size) {
+		struct rtmp_gop new_gop = {0};
+		new_gop.start_seq = frame.seq;
+		circlebuf_push_back(&stream->gops, &new_gop, sizeof(new_gop));
+	}
 
-	while (stream->packets.size) {
-		struct encoder_packet packet;
-		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
+	if (packet->keyframe)
+		return;
+
+	gop = get_gop(stream, num_gops(stream) - 1);
+
+	if (packet->drop_priority < OBS_NAL_PRIORITY_HIGH)
+		circlebuf_push_back(&gop->nonrefs, &frame, sizeof(frame));
+	else
+		circlebuf_push_back(&gop->refs, &frame, sizeof(frame));
+}
+
+static int drop_gop_frames(struct rtmp_stream *stream, struct circlebuf *frames)
+{
+	int num_dropped = 0;
 
-		/* do not drop audio data or video keyframes */
-		if (packet.type          == OBS_ENCODER_AUDIO ||
-		    packet.drop_priority >= highest_priority) {
-			circlebuf_push_back(&new_buf, &packet, sizeof(packet));
+	while (frames->size) {
+		struct rtmp_gop_frame frame;
+		struct encoder_packet *packet;
 
-		} else {
-			num_frames_dropped++;
-			obs_encoder_packet_release(&packet);
+		circlebuf_pop_front(frames, &frame, sizeof(frame));
+		packet = circlebuf_data(&stream->packets,
+				(size_t)(frame.seq - stream->packets_front_seq) *
+				sizeof(struct encoder_packet));
+
+		obs_encoder_packet_release(packet);
+		stream->num_dropped_buffered++;
+		num_dropped++;
+	}
+
+	return num_dropped;
+}
+
+static bool get_first_frame_dts(struct rtmp_stream *stream, int64_t *dts_usec)
+{
+	for (size_t i = 0; i < num_gops(stream); i++) {
+		struct rtmp_gop *gop = get_gop(stream, i);
+		struct rtmp_gop_frame *ref = circlebuf_data(&gop->refs, 0);
+		struct rtmp_gop_frame *nonref = circlebuf_data(&gop->nonrefs, 0);
+
+		if (ref && nonref) {
+			*dts_usec = ref->dts_usec < nonref->dts_usec ?
+				ref->dts_usec : nonref->dts_usec;
+			return true;
+		} else if (ref || nonref) {
+			*dts_usec = ref ? ref->dts_usec : nonref->dts_usec;
+			return true;
 		}
 	}
 
-	circlebuf_free(&stream->packets);
-	stream->packets = new_buf;
+	return false;
+}
+
+static inline int64_t buffer_duration(struct rtmp_stream *stream)
+{
+	int64_t first_dts_usec;
+
+	if (!get_first_frame_dts(stream, &first_dts_usec))
+		return 0;
+
+	return stream->last_dts_usec - first_dts_usec;
+}
+
+/* drops every buffered non-reference frame.  nothing depends on them, so
+ * the rest of each GOP remains decodable */
+static int drop_nonref_frames(struct rtmp_stream *stream)
+{
+	int num_dropped = 0;
+
+	for (size_t i = 0; i < num_gops(stream); i++) {
+		struct rtmp_gop *gop = get_gop(stream, i);
+		num_dropped += drop_gop_frames(stream, &gop->nonrefs);
+	}
+
+	stream->dropped_nonref_frames += num_dropped;
+	return num_dropped;
+}
+
+/* drops the tails of the oldest GOPs (everything after their keyframes)
+ * until the buffered duration is back under the threshold.  if the GOP that
+ * is still being received has to be cut as well, incoming frames are
+ * dropped until the next keyframe */
+static int drop_gop_tails(struct rtmp_stream *stream, int64_t drop_threshold)
+{
+	size_t count = num_gops(stream);
+	int num_dropped = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		struct rtmp_gop *gop = get_gop(stream, i);
+
+		if (!gop->refs.size && !gop->nonrefs.size)
+			continue;
+
+		num_dropped += drop_gop_frames(stream, &gop->nonrefs);
+		num_dropped += drop_gop_frames(stream, &gop->refs);
+
+		if (i == count - 1)
+			stream->min_priority = OBS_NAL_PRIORITY_HIGHEST;
+		else if (buffer_duration(stream) <= drop_threshold)
+			break;
+	}
+
+	stream->dropped_gop_tail_frames += num_dropped;
+	return num_dropped;
+}
+
+static void drop_frames(struct rtmp_stream *stream, const char *name,
+		int64_t drop_threshold, bool pframes)
+{
+	int num_frames_dropped;
+
+#ifdef _DEBUG
+	int start_packets = (int)num_buffered_packets(stream);
+#else
+	UNUSED_PARAMETER(name);
+#endif
+
+	if (pframes) {
+		num_frames_dropped = drop_gop_tails(stream, drop_threshold);
+	} else {
+		num_frames_dropped = drop_nonref_frames(stream);
+		if (stream->min_priority < OBS_NAL_PRIORITY_HIGH)
+			stream->min_priority = OBS_NAL_PRIORITY_HIGH;
+	}
 
-	if (stream->min_priority < highest_priority)
-		stream->min_priority = highest_priority;
 	if (!num_frames_dropped)
 		return;
 
@@ -1031,34 +1227,15 @@ static void drop_frames(struct rtmp_stream *stream, const char *name,
 #endif
 }
 
-static bool find_first_video_packet(struct rtmp_stream *stream,
-		struct encoder_packet *first)
-{
-	size_t count = stream->packets.size / sizeof(*first);
-
-	for (size_t i = 0; i < count; i++) {
-		struct encoder_packet *cur = circlebuf_data(&stream->packets,
-				i * sizeof(*first));
-		if (cur->type == OBS_ENCODER_VIDEO && !cur->keyframe) {
-			*first = *cur;
-			return true;
-		}
-	}
-
-	return false;
-}
-
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 {
-	struct encoder_packet first;
 	int64_t buffer_duration_usec;
 	size_t num_packets = num_buffered_packets(stream);
 	const char *name = pframes ? "p-frames" : "b-frames";
-	int priority = pframes ?
-		OBS_NAL_PRIORITY_HIGHEST : OBS_NAL_PRIORITY_HIGH;
 	int64_t drop_threshold = pframes ?
 		stream->pframe_drop_threshold_usec :
 		stream->drop_threshold_usec;
+	int64_t first_dts_usec;
 
 	if (num_packets < 5) {
 		if (!pframes)
@@ -1066,12 +1243,12 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 		return;
 	}
 
-	if (!find_first_video_packet(stream, &first))
+	if (!get_first_frame_dts(stream, &first_dts_usec))
 		return;
 
 	/* if the amount of time stored in the buffered packets waiting to be
 	 * sent is higher than threshold, drop frames */
-	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+	buffer_duration_usec = stream->last_dts_usec - first_dts_usec;
 
 	if (!pframes) {
 		stream->congestion = (float)buffer_duration_usec /
@@ -1080,7 +1257,7 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 
 	if (buffer_duration_usec > drop_threshold) {
 		debug("buffer_duration_usec: %" PRId64, buffer_duration_usec);
-		drop_frames(stream, name, priority, pframes);
+		drop_frames(stream, name, drop_threshold, pframes);
 	}
 }
 
@@ -1094,12 +1271,14 @@ static bool add_video_packet(struct rtmp_stream *stream,
 	 * desired priority */
 	if (packet->drop_priority < stream->min_priority) {
 		stream->dropped_frames++;
+		stream->dropped_waiting_frames++;
 		return false;
 	} else {
 		stream->min_priority = 0;
 	}
 
 	stream->last_dts_usec = packet->dts_usec;
+	index_video_packet(stream, packet);
 	return add_packet(stream, packet);
 }
 
@@ -1217,7 +1396,8 @@ struct obs_output_info rtmp_output_info = {
 	.flags                = OBS_OUTPUT_AV |
 	                        OBS_OUTPUT_ENCODED |
 	                        OBS_OUTPUT_SERVICE |
-	                        OBS_OUTPUT_MULTI_TRACK,
+	                        OBS_OUTPUT_MULTI_TRACK |
+	                        OBS_OUTPUT_ASYNC_SEND,
 	.encoded_video_codecs = "h264",
 	.encoded_audio_codecs = "aac",
 	.get_name             = rtmp_stream_getname,
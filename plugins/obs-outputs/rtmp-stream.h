@@ -45,6 +45,19 @@ struct droptest_info {
 };
 #endif
 
+/* buffered video frames of one GOP, indexed by drop class.  entries are
+ * absolute packet sequence numbers so they can be dropped in place */
+struct rtmp_gop_frame {
+	uint64_t         seq;
+	int64_t          dts_usec;
+};
+
+struct rtmp_gop {
+	uint64_t         start_seq;
+	struct circlebuf refs;
+	struct circlebuf nonrefs;
+};
+
 struct rtmp_stream {
 	obs_output_t     *output;
 
@@ -80,10 +93,17 @@ struct rtmp_stream {
 	int              min_priority;
 	float            congestion;
 
+	struct circlebuf gops;
+	uint64_t         packets_front_seq;
+	size_t           num_dropped_buffered;
+
 	int64_t          last_dts_usec;
 
 	uint64_t         total_bytes_sent;
 	int              dropped_frames;
+	int              dropped_nonref_frames;
+	int              dropped_gop_tail_frames;
+	int              dropped_waiting_frames;
 
 #ifdef TEST_FRAMEDROPS
 	struct circlebuf droptest_info;
@@ -42,7 +42,8 @@ static struct obs_source_info freetype2_source_info = {
 #ifdef _WIN32
 	                OBS_SOURCE_DEPRECATED |
 #endif
-	                OBS_SOURCE_CUSTOM_DRAW,
+	                OBS_SOURCE_CUSTOM_DRAW |
+	                OBS_SOURCE_STATIC_CONTENT,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create,
 	.destroy = ft2_source_destroy,
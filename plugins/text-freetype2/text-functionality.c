@@ -143,6 +143,8 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 skip_word_wrap:;
 	fill_vertex_buffer(srcdata);
 	obs_leave_graphics();
+
+	obs_source_content_changed(srcdata->src);
 }
 
 void fill_vertex_buffer(struct ft2_source *srcdata)
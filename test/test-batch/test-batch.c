@@ -0,0 +1,265 @@
+/*
+ * Counts the draw calls a scene of many small sprites takes with and without
+ * the sprite batch.
+ *
+ * Runs on the null renderer, so no GPU is needed: its API call count is the
+ * number of draws it was given.  The scene holds NUM_ITEMS sprite sources
+ * spread over NUM_TEXTURES textures, first as sources that only have a
+ * video_render callback and then as sources that also return their texture
+ * with get_sprite_texture.  Each sample is one render of the scene from a
+ * main render callback.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <obs.h>
+
+#define BENCH_CX      1280
+#define BENCH_CY      720
+#define SPRITE_SIZE   32
+#define NUM_ITEMS     200
+#define NUM_TEXTURES  4
+#define WARMUP_FRAMES 5
+#define BENCH_FRAMES  60
+
+static gs_texture_t *sprite_textures[NUM_TEXTURES];
+static long sprite_count = 0;
+
+/* --------------------------------------------------- */
+
+static uint32_t sprite_get_size(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return SPRITE_SIZE;
+}
+
+static const char *sprite_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Batch benchmark sprite";
+}
+
+static void *sprite_create(obs_data_t *settings, obs_source_t *source)
+{
+	long idx = os_atomic_inc_long(&sprite_count);
+
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return sprite_textures[idx % NUM_TEXTURES];
+}
+
+static void sprite_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static void sprite_render(void *data, gs_effect_t *effect)
+{
+	gs_texture_t *tex = data;
+
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
+			tex);
+	gs_draw_sprite(tex, 0, SPRITE_SIZE, SPRITE_SIZE);
+}
+
+static gs_texture_t *sprite_get_sprite_texture(void *data)
+{
+	return data;
+}
+
+static struct obs_source_info bench_sprite = {
+	.id           = "batch_bench_sprite",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name     = sprite_get_name,
+	.create       = sprite_create,
+	.destroy      = sprite_destroy,
+	.get_width    = sprite_get_size,
+	.get_height   = sprite_get_size,
+	.video_render = sprite_render
+};
+
+static struct obs_source_info bench_batched_sprite = {
+	.id                 = "batch_bench_batched_sprite",
+	.type               = OBS_SOURCE_TYPE_INPUT,
+	.output_flags       = OBS_SOURCE_VIDEO,
+	.get_name           = sprite_get_name,
+	.create             = sprite_create,
+	.destroy            = sprite_destroy,
+	.get_width          = sprite_get_size,
+	.get_height         = sprite_get_size,
+	.video_render       = sprite_render,
+	.get_sprite_texture = sprite_get_sprite_texture
+};
+
+/* --------------------------------------------------- */
+
+struct bench {
+	obs_scene_t     *scene;
+
+	long            frames;
+	uint64_t        total_calls;
+	uint64_t        min_calls;
+	uint64_t        max_calls;
+};
+
+static void bench_draw(void *param, uint32_t cx, uint32_t cy)
+{
+	struct bench *bench = param;
+	uint64_t start, calls;
+	long frame;
+
+	frame = os_atomic_load_long(&bench->frames);
+	if (frame >= WARMUP_FRAMES + BENCH_FRAMES)
+		return;
+
+	start = gs_get_api_calls();
+	obs_source_video_render(obs_scene_get_source(bench->scene));
+	calls = gs_get_api_calls() - start;
+
+	if (frame >= WARMUP_FRAMES) {
+		bench->total_calls += calls;
+		if (!bench->min_calls || calls < bench->min_calls)
+			bench->min_calls = calls;
+		if (calls > bench->max_calls)
+			bench->max_calls = calls;
+	}
+
+	os_atomic_inc_long(&bench->frames);
+
+	UNUSED_PARAMETER(cx);
+	UNUSED_PARAMETER(cy);
+}
+
+static bool run_bench(const char *sprite_id, struct bench *bench)
+{
+	memset(bench, 0, sizeof(*bench));
+
+	bench->scene = obs_scene_create("scene");
+	if (!bench->scene)
+		return false;
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		obs_source_t *sprite;
+		obs_sceneitem_t *item;
+		struct vec2 pos;
+
+		sprite = obs_source_create(sprite_id, "sprite", NULL, NULL);
+		if (!sprite) {
+			obs_scene_release(bench->scene);
+			return false;
+		}
+
+		item = obs_scene_add(bench->scene, sprite);
+		vec2_set(&pos,
+			(float)(i * SPRITE_SIZE % BENCH_CX),
+			(float)(i * SPRITE_SIZE / BENCH_CX * SPRITE_SIZE));
+		obs_sceneitem_set_pos(item, &pos);
+
+		obs_source_release(sprite);
+	}
+
+	obs_add_main_render_callback(bench_draw, bench);
+
+	while (os_atomic_load_long(&bench->frames) <
+			WARMUP_FRAMES + BENCH_FRAMES)
+		os_sleep_ms(10);
+
+	obs_remove_main_render_callback(bench_draw, bench);
+
+	obs_source_remove(obs_scene_get_source(bench->scene));
+	obs_scene_release(bench->scene);
+	return true;
+}
+
+static void print_bench(const char *name, const struct bench *bench)
+{
+	printf("%-9s %4d items, %d textures: %8.1f draw calls/frame "
+			"average, %llu min, %llu max\n",
+			name, NUM_ITEMS, NUM_TEXTURES,
+			(double)bench->total_calls / BENCH_FRAMES,
+			(unsigned long long)bench->min_calls,
+			(unsigned long long)bench->max_calls);
+}
+
+/* --------------------------------------------------- */
+
+static void create_textures(void)
+{
+	uint32_t pixels[SPRITE_SIZE * SPRITE_SIZE];
+	const uint8_t *data = (const uint8_t*)pixels;
+
+	obs_enter_graphics();
+	for (int i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t j = 0; j < SPRITE_SIZE * SPRITE_SIZE; j++)
+			pixels[j] = 0xFF000000 | (0x3F << (i * 8 % 24));
+
+		sprite_textures[i] = gs_texture_create(SPRITE_SIZE,
+				SPRITE_SIZE, GS_RGBA, 1, &data, 0);
+	}
+	obs_leave_graphics();
+}
+
+static void destroy_textures(void)
+{
+	obs_enter_graphics();
+	for (int i = 0; i < NUM_TEXTURES; i++)
+		gs_texture_destroy(sprite_textures[i]);
+	obs_leave_graphics();
+}
+
+int main(int argc, char *argv[])
+{
+	struct obs_video_info ovi = {0};
+	struct bench unbatched, batched;
+	int ret = 1;
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "Couldn't create OBS\n");
+		return 1;
+	}
+
+	ovi.adapter         = 0;
+	ovi.fps_num         = 60;
+	ovi.fps_den         = 1;
+	ovi.graphics_module = TEST_BATCH_GRAPHICS_MODULE;
+	ovi.output_format   = VIDEO_FORMAT_RGBA;
+	ovi.base_width      = BENCH_CX;
+	ovi.base_height     = BENCH_CY;
+	ovi.output_width    = BENCH_CX;
+	ovi.output_height   = BENCH_CY;
+
+	if (obs_reset_video(&ovi) != 0) {
+		fprintf(stderr, "Couldn't initialize video\n");
+		goto fail;
+	}
+
+	obs_register_source(&bench_sprite);
+	obs_register_source(&bench_batched_sprite);
+
+	create_textures();
+
+	if (!run_bench(bench_sprite.id, &unbatched) ||
+	    !run_bench(bench_batched_sprite.id, &batched)) {
+		fprintf(stderr, "Couldn't create benchmark sources\n");
+		destroy_textures();
+		goto fail;
+	}
+
+	print_bench("unbatched", &unbatched);
+	print_bench("batched", &batched);
+	destroy_textures();
+	ret = 0;
+
+fail:
+	obs_shutdown();
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return ret;
+}
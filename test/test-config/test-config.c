@@ -0,0 +1,358 @@
+/*
+ * Checks the item index of config files and measures lookups on a
+ * basic.ini sized file.
+ *
+ * The checks cover the paths where the index has to agree with a linear
+ * search of the sections: repeated sections (hand-edited files), removing
+ * items and setting them again, case-insensitive names, defaults, and a
+ * config that grows well past its first table.  Saved files are compared
+ * with the exact text the old code wrote.  Returns non-zero if anything
+ * is off.
+ *
+ * The benchmark then reads and writes random keys of a file with
+ * NUM_KEYS keys in the sections of a typical basic.ini.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/config-file.h>
+
+#define TEST_FILE   "test-config.ini"
+#define NUM_GROWN   1000
+#define NUM_GETS    1000000
+#define NUM_SETS    200000
+
+static int failures = 0;
+
+#define check(cond, format, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAILED: " format "\n", \
+					##__VA_ARGS__); \
+			failures++; \
+		} \
+	} while (false)
+
+static inline bool str_equal(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a == b;
+	return strcmp(a, b) == 0;
+}
+
+static void check_value(config_t *config, const char *section,
+		const char *name, const char *expected)
+{
+	const char *value = config_get_string(config, section, name);
+
+	check(str_equal(value, expected), "%s/%s is '%s' instead of '%s'",
+			section, name, value ? value : "(null)",
+			expected ? expected : "(null)");
+}
+
+static config_t *open_test_file(const char *text)
+{
+	config_t *config = NULL;
+
+	if (!os_quick_write_utf8_file(TEST_FILE, text, strlen(text), false)) {
+		check(false, "couldn't write " TEST_FILE);
+		return NULL;
+	}
+
+	if (config_open(&config, TEST_FILE, CONFIG_OPEN_EXISTING) !=
+			CONFIG_SUCCESS) {
+		check(false, "couldn't open " TEST_FILE);
+		return NULL;
+	}
+
+	return config;
+}
+
+static void check_saved(config_t *config, const char *expected)
+{
+	char *text;
+
+	check(config_save(config) == CONFIG_SUCCESS, "couldn't save");
+
+	text = os_quick_read_utf8_file(TEST_FILE);
+	check(str_equal(text, expected), "saved\n%s\ninstead of\n%s",
+			text ? text : "(null)", expected);
+	bfree(text);
+}
+
+/* --------------------------------------------------- */
+
+/* a repeated section only shadows the names the first one has, and
+ * config_set_* only ever changes the first one */
+static void test_duplicate_sections(void)
+{
+	static const char *text =
+		"[Video]\n"
+		"Base=1920x1080\n"
+		"FPS=30\n"
+		"\n"
+		"[Audio]\n"
+		"Rate=48000\n"
+		"\n"
+		"[video]\n"
+		"FPS=60\n"
+		"Extra=1\n";
+	static const char *saved =
+		"[Video]\n"
+		"Base=1920x1080\n"
+		"FPS=25\n"
+		"Extra=2\n"
+		"New=x\n"
+		"\n"
+		"[Audio]\n"
+		"Rate=48000\n"
+		"\n"
+		"[video]\n"
+		"FPS=60\n"
+		"Extra=1\n";
+	config_t *config = open_test_file(text);
+	if (!config)
+		return;
+
+	check_value(config, "Video", "FPS", "30");
+	check_value(config, "VIDEO", "fps", "30");
+	check_value(config, "Video", "Extra", "1");
+	check_value(config, "video", "Base", "1920x1080");
+
+	config_set_string(config, "Video", "FPS", "25");
+	config_set_string(config, "Video", "Extra", "2");
+	config_set_string(config, "video", "New", "x");
+
+	check_value(config, "Video", "FPS", "25");
+	check_value(config, "Video", "Extra", "2");
+	check_value(config, "Video", "New", "x");
+	check(config_num_sections(config) == 3, "%d sections instead of 3",
+			(int)config_num_sections(config));
+
+	check_saved(config, saved);
+
+	/* removing the first item uncovers the one of the repeated section,
+	 * and setting it again puts it back in the first section */
+	check(config_remove_value(config, "Video", "FPS"),
+			"couldn't remove Video/FPS");
+	check_value(config, "Video", "FPS", "60");
+	check_value(config, "Video", "Extra", "2");
+
+	config_set_string(config, "Video", "FPS", "24");
+	check_value(config, "Video", "FPS", "24");
+	check_value(config, "Video", "New", "x");
+
+	config_close(config);
+}
+
+static void test_remove_reinsert(void)
+{
+	static const char *text =
+		"[General]\n"
+		"A=1\n"
+		"B=2\n"
+		"C=3\n"
+		"D=4\n"
+		"\n"
+		"[Output]\n"
+		"Mode=Simple\n";
+	static const char *saved =
+		"[General]\n"
+		"C=3\n"
+		"D=4\n"
+		"B=5\n"
+		"\n"
+		"[Output]\n"
+		"Mode=Advanced\n";
+	config_t *config = open_test_file(text);
+	if (!config)
+		return;
+
+	/* the items after a removed one move down in their section */
+	check(config_remove_value(config, "General", "b"),
+			"couldn't remove General/B");
+	check(!config_remove_value(config, "General", "B"),
+			"removed General/B twice");
+	check_value(config, "General", "B", NULL);
+	check_value(config, "General", "C", "3");
+	check_value(config, "General", "D", "4");
+
+	config_set_string(config, "General", "B", "5");
+	check_value(config, "General", "B", "5");
+	check_value(config, "General", "D", "4");
+
+	check(config_remove_value(config, "GENERAL", "A"),
+			"couldn't remove General/A");
+	check_value(config, "General", "C", "3");
+	check_value(config, "General", "B", "5");
+	check_value(config, "Output", "Mode", "Simple");
+
+	/* a removed user value falls back to the default again */
+	config_set_default_string(config, "Output", "Mode", "Simple");
+	config_set_string(config, "Output", "Mode", "Advanced");
+	check(config_has_user_value(config, "Output", "Mode"),
+			"Output/Mode has no user value");
+	check_saved(config, saved);
+
+	check(config_remove_value(config, "Output", "Mode"),
+			"couldn't remove Output/Mode");
+	check(!config_has_user_value(config, "Output", "Mode"),
+			"Output/Mode still has a user value");
+	check_value(config, "Output", "Mode", "Simple");
+
+	config_close(config);
+}
+
+/* the table is rebuilt several times while it grows, and again after
+ * every removal */
+static void test_growth(void)
+{
+	struct dstr section = {0};
+	struct dstr name = {0};
+	config_t *config = config_create(TEST_FILE);
+	if (!config) {
+		check(false, "couldn't create a config");
+		return;
+	}
+
+	for (int i = 0; i < NUM_GROWN; i++) {
+		dstr_printf(&section, "Section%d", i % 7);
+		dstr_printf(&name, "Name%d", i);
+		config_set_int(config, section.array, name.array, i);
+	}
+
+	for (int i = 0; i < NUM_GROWN; i += 3) {
+		dstr_printf(&section, "section%d", i % 7);
+		dstr_printf(&name, "NAME%d", i);
+		check(config_remove_value(config, section.array, name.array),
+				"couldn't remove %s/%s", section.array,
+				name.array);
+	}
+
+	for (int i = 0; i < NUM_GROWN; i++) {
+		bool removed = i % 3 == 0;
+
+		dstr_printf(&section, "SECTION%d", i % 7);
+		dstr_printf(&name, "name%d", i);
+		check(config_has_user_value(config, section.array,
+					name.array) == !removed,
+				"%s/%s is %s", section.array, name.array,
+				removed ? "still there" : "missing");
+		if (!removed)
+			check(config_get_int(config, section.array,
+						name.array) == i,
+					"%s/%s is not %d", section.array,
+					name.array, i);
+	}
+
+	check(config_num_sections(config) == 7, "%d sections instead of 7",
+			(int)config_num_sections(config));
+
+	config_close(config);
+	dstr_free(&section);
+	dstr_free(&name);
+}
+
+/* --------------------------------------------------- */
+
+static const char *bench_sections[] = {
+	"General", "Video", "Audio", "Output", "SimpleOutput", "AdvOut",
+	"Hotkeys", "BasicWindow", "Panels", "Stream1", "Accessibility",
+	"Basic"
+};
+
+static const int bench_keys[] = {
+	20, 15, 12, 10, 25, 80, 60, 30, 10, 8, 12, 18
+};
+
+#define NUM_SECTIONS (sizeof(bench_sections) / sizeof(bench_sections[0]))
+
+static inline uint32_t next_random(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static void benchmark(void)
+{
+	struct dstr text = {0};
+	char name[64];
+	config_t *config;
+	uint32_t seed = 1;
+	uint64_t start, get_ns, set_ns;
+	long long found = 0;
+	int total = 0;
+
+	for (size_t s = 0; s < NUM_SECTIONS; s++) {
+		dstr_catf(&text, "[%s]\n", bench_sections[s]);
+		for (int k = 0; k < bench_keys[s]; k++, total++)
+			dstr_catf(&text, "Key%dName%s=value %d\n", k,
+					bench_sections[s], k);
+	}
+
+	config_open_string(&config, text.array);
+	config_set_default_int(config, "AdvOut", "DefaultOnly", 42);
+
+	/* a few of the names are missing, and the case differs from the
+	 * file, like the lookups of the frontend */
+	start = os_gettime_ns();
+	for (int i = 0; i < NUM_GETS; i++) {
+		uint32_t r = next_random(&seed);
+		size_t s = r % NUM_SECTIONS;
+		int k = (int)((r >> 8) % (bench_keys[s] + 2));
+
+		snprintf(name, sizeof(name), "key%dname%s", k,
+				bench_sections[s]);
+		if (config_get_string(config, bench_sections[s], name))
+			found++;
+		found += config_get_int(config, "advout", "DefaultOnly");
+	}
+	get_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < NUM_SETS; i++) {
+		uint32_t r = next_random(&seed);
+		size_t s = r % NUM_SECTIONS;
+		int k = (int)((r >> 8) % (bench_keys[s] + 4));
+
+		snprintf(name, sizeof(name), "Key%dName%s", k,
+				bench_sections[s]);
+		config_set_int(config, bench_sections[s], name, i);
+	}
+	set_ns = os_gettime_ns() - start;
+
+	printf("%d keys in %d sections:\n", total, (int)NUM_SECTIONS);
+	printf("  %dk config_get_*     %8.1f ms\n", NUM_GETS * 2 / 1000,
+			(double)get_ns / 1000000.0);
+	printf("  %dk config_set_int   %8.1f ms\n", NUM_SETS / 1000,
+			(double)set_ns / 1000000.0);
+
+	check(found > (long long)NUM_GETS * 42, "only %lld found", found);
+
+	config_close(config);
+	dstr_free(&text);
+}
+
+int main(int argc, char *argv[])
+{
+	test_duplicate_sections();
+	test_remove_reinsert();
+	test_growth();
+	os_unlink(TEST_FILE);
+
+	if (failures)
+		fprintf(stderr, "%d checks failed\n", failures);
+	else
+		printf("all checks passed\n");
+
+	benchmark();
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * Measures saving and loading a scene collection sized like a large one.
+ *
+ * Builds a synthetic collection of NUM_SOURCES sources, each with settings
+ * and filters, plus one object with NUM_KEYS keys, the shape that made the
+ * hash index worthwhile.  Then it times obs_data_get_json, loading the
+ * result with obs_data_create_from_json, and NUM_GETS lookups in the large
+ * object.  Every run checks that a save of the loaded collection gives the
+ * same text again, and returns non-zero if it does not.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <obs-data.h>
+
+#define NUM_SOURCES 10000
+#define NUM_FILTERS 2
+#define NUM_KEYS    10000
+#define NUM_GETS    100000
+#define NUM_RUNS    5
+
+/* --------------------------------------------------- */
+
+static obs_data_t *create_filter(int source, int filter)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	struct dstr name = {0};
+
+	dstr_printf(&name, "Filter %d of source %d", filter, source);
+	obs_data_set_double(settings, "opacity", (double)filter / 4.0);
+	obs_data_set_int(settings, "color", 0xFF000000 | source);
+
+	obs_data_set_string(data, "name", name.array);
+	obs_data_set_string(data, "id", "color_filter");
+	obs_data_set_bool(data, "enabled", filter % 2 == 0);
+	obs_data_set_obj(data, "settings", settings);
+
+	obs_data_release(settings);
+	dstr_free(&name);
+	return data;
+}
+
+static obs_data_t *create_source(int source)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	obs_data_array_t *filters = obs_data_array_create();
+	struct dstr name = {0};
+	struct dstr file = {0};
+
+	dstr_printf(&name, "Source %d", source);
+	dstr_printf(&file, "/home/user/media/image-%05d.png", source);
+
+	obs_data_set_string(settings, "file", file.array);
+	obs_data_set_bool(settings, "unload", false);
+	obs_data_set_int(settings, "width", 1920 - source % 640);
+	obs_data_set_int(settings, "height", 1080 - source % 360);
+
+	for (int i = 0; i < NUM_FILTERS; i++) {
+		obs_data_t *filter = create_filter(source, i);
+		obs_data_array_push_back(filters, filter);
+		obs_data_release(filter);
+	}
+
+	obs_data_set_string(data, "name", name.array);
+	obs_data_set_string(data, "id", "image_source");
+	obs_data_set_double(data, "volume", 1.0);
+	obs_data_set_bool(data, "muted", false);
+	obs_data_set_int(data, "sync", 0);
+	obs_data_set_int(data, "flags", 0);
+	obs_data_set_obj(data, "settings", settings);
+	obs_data_set_array(data, "filters", filters);
+
+	obs_data_array_release(filters);
+	obs_data_release(settings);
+	dstr_free(&file);
+	dstr_free(&name);
+	return data;
+}
+
+static obs_data_t *create_collection(void)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_t *keys = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+	struct dstr key = {0};
+
+	for (int i = 0; i < NUM_SOURCES; i++) {
+		obs_data_t *source = create_source(i);
+		obs_data_array_push_back(sources, source);
+		obs_data_release(source);
+	}
+
+	for (int i = 0; i < NUM_KEYS; i++) {
+		dstr_printf(&key, "hotkey-%d", i);
+		obs_data_set_int(keys, key.array, i);
+	}
+
+	obs_data_set_string(data, "name", "Synthetic");
+	obs_data_set_string(data, "current_scene", "Source 0");
+	obs_data_set_array(data, "sources", sources);
+	obs_data_set_obj(data, "keys", keys);
+
+	obs_data_array_release(sources);
+	obs_data_release(keys);
+	dstr_free(&key);
+	return data;
+}
+
+/* --------------------------------------------------- */
+
+struct timing {
+	uint64_t min_ns;
+	uint64_t total_ns;
+};
+
+static inline void add_time(struct timing *timing, uint64_t start)
+{
+	uint64_t elapsed = os_gettime_ns() - start;
+
+	timing->total_ns += elapsed;
+	if (!timing->min_ns || elapsed < timing->min_ns)
+		timing->min_ns = elapsed;
+}
+
+static void print_timing(const char *name, const struct timing *timing)
+{
+	printf("%-10s %9.2f ms average, %9.2f ms min\n", name,
+			(double)timing->total_ns / NUM_RUNS / 1000000.0,
+			(double)timing->min_ns / 1000000.0);
+}
+
+static long long get_keys(obs_data_t *data)
+{
+	obs_data_t *keys = obs_data_get_obj(data, "keys");
+	struct dstr key = {0};
+	long long sum = 0;
+
+	for (int i = 0; i < NUM_GETS; i++) {
+		dstr_printf(&key, "hotkey-%d", (i * 7919) % NUM_KEYS);
+		sum += obs_data_get_int(keys, key.array);
+	}
+
+	dstr_free(&key);
+	obs_data_release(keys);
+	return sum;
+}
+
+static long long expected_sum(void)
+{
+	long long sum = 0;
+
+	for (int i = 0; i < NUM_GETS; i++)
+		sum += (i * 7919) % NUM_KEYS;
+	return sum;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timing create = {0}, save = {0}, load = {0}, gets = {0};
+	int failures = 0;
+
+	for (int run = 0; run < NUM_RUNS; run++) {
+		obs_data_t *collection, *loaded;
+		char *json;
+		uint64_t start;
+		long long sum;
+
+		start = os_gettime_ns();
+		collection = create_collection();
+		add_time(&create, start);
+
+		start = os_gettime_ns();
+		json = bstrdup(obs_data_get_json(collection));
+		add_time(&save, start);
+
+		start = os_gettime_ns();
+		loaded = obs_data_create_from_json(json);
+		add_time(&load, start);
+
+		if (!loaded || strcmp(obs_data_get_json(loaded), json) != 0) {
+			fprintf(stderr, "run %d: the loaded collection does "
+					"not save to the same text\n", run);
+			failures++;
+		}
+
+		start = os_gettime_ns();
+		sum = get_keys(loaded);
+		add_time(&gets, start);
+
+		if (sum != expected_sum()) {
+			fprintf(stderr, "run %d: lookups returned %lld "
+					"instead of %lld\n", run, sum,
+					expected_sum());
+			failures++;
+		}
+
+		if (run == 0)
+			printf("%d sources, %d filters each, %d keys: "
+					"%zu bytes of JSON\n", NUM_SOURCES,
+					NUM_FILTERS, NUM_KEYS, strlen(json));
+
+		obs_data_release(loaded);
+		obs_data_release(collection);
+		bfree(json);
+	}
+
+	print_timing("create", &create);
+	print_timing("save", &save);
+	print_timing("load", &load);
+	print_timing("100k gets", &gets);
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,407 @@
+/*
+ * Compares the GPU time of a chain of per-pixel filters rendered one pass
+ * per filter against the same chain fused into a single pass.
+ *
+ * A 1920x1080 input gets NUM_FILTERS filters, first as regular filters and
+ * then as fusable ones.  Every frame the input is rendered once from a main
+ * render callback and read back, so each sample covers the whole chain
+ * including the wait for the GPU.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <obs.h>
+
+#define BENCH_CX      1920
+#define BENCH_CY      1080
+#define NUM_FILTERS   4
+#define WARMUP_FRAMES 30
+#define BENCH_FRAMES  300
+
+/* --------------------------------------------------- */
+
+static uint32_t input_get_width(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return BENCH_CX;
+}
+
+static uint32_t input_get_height(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return BENCH_CY;
+}
+
+static const char *input_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Fusion benchmark input";
+}
+
+static void *input_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void input_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static void input_render(void *data, gs_effect_t *effect)
+{
+	gs_effect_t *solid = obs_get_base_effect(OBS_EFFECT_SOLID);
+	gs_eparam_t *color = gs_effect_get_param_by_name(solid, "color");
+	struct vec4 value;
+
+	vec4_set(&value, 0.25f, 0.5f, 0.75f, 1.0f);
+	gs_effect_set_vec4(color, &value);
+
+	while (gs_effect_loop(solid, "Solid"))
+		gs_draw_sprite(NULL, 0, BENCH_CX, BENCH_CY);
+
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(effect);
+}
+
+static struct obs_source_info bench_input = {
+	.id           = "fusion_bench_input",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name     = input_get_name,
+	.create       = input_create,
+	.destroy      = input_destroy,
+	.video_render = input_render,
+	.get_width    = input_get_width,
+	.get_height   = input_get_height
+};
+
+/* --------------------------------------------------- */
+
+struct bench_filter {
+	obs_source_t *source;
+	gs_effect_t  *effect;
+	struct vec4  mul;
+};
+
+static const char *bench_filter_effect =
+"uniform float4x4 ViewProj;\n"
+"uniform texture2d image;\n"
+"uniform float4 mul;\n"
+"\n"
+"sampler_state def_sampler {\n"
+"	Filter   = Linear;\n"
+"	AddressU = Clamp;\n"
+"	AddressV = Clamp;\n"
+"};\n"
+"\n"
+"struct VertInOut {\n"
+"	float4 pos : POSITION;\n"
+"	float2 uv  : TEXCOORD0;\n"
+"};\n"
+"\n"
+"VertInOut VSDefault(VertInOut vert_in)\n"
+"{\n"
+"	VertInOut vert_out;\n"
+"	vert_out.pos = mul(float4(vert_in.pos.xyz, 1.0), ViewProj);\n"
+"	vert_out.uv  = vert_in.uv;\n"
+"	return vert_out;\n"
+"}\n"
+"\n"
+"float4 PSFilter(VertInOut vert_in) : TARGET\n"
+"{\n"
+"	float4 rgba = image.Sample(def_sampler, vert_in.uv);\n"
+"	return float4(pow(rgba.rgb * mul.rgb, float3(0.9, 0.9, 0.9)),\n"
+"			rgba.a);\n"
+"}\n"
+"\n"
+"technique Draw\n"
+"{\n"
+"	pass\n"
+"	{\n"
+"		vertex_shader = VSDefault(vert_in);\n"
+"		pixel_shader  = PSFilter(vert_in);\n"
+"	}\n"
+"}\n";
+
+/* same as PSFilter in bench_filter_effect */
+static const char *bench_fused_shader =
+"uniform float4 $mul;\n"
+"\n"
+"float4 $main(float4 rgba)\n"
+"{\n"
+"	return float4(pow(rgba.rgb * $mul.rgb, float3(0.9, 0.9, 0.9)),\n"
+"			rgba.a);\n"
+"}\n";
+
+static const char *filter_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Fusion benchmark filter";
+}
+
+static void filter_destroy(void *data)
+{
+	struct bench_filter *filter = data;
+
+	obs_enter_graphics();
+	gs_effect_destroy(filter->effect);
+	obs_leave_graphics();
+
+	bfree(filter);
+}
+
+static void *filter_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct bench_filter *filter = bzalloc(sizeof(struct bench_filter));
+	char *errors = NULL;
+
+	filter->source = source;
+	vec4_set(&filter->mul, 1.1f, 0.9f, 1.05f, 1.0f);
+
+	obs_enter_graphics();
+	filter->effect = gs_effect_create(bench_filter_effect,
+			"fusion_bench_filter", &errors);
+	obs_leave_graphics();
+
+	if (!filter->effect) {
+		blog(LOG_ERROR, "Failed to create benchmark filter effect:\n%s",
+				errors ? errors : "(unknown error)");
+		bfree(errors);
+		filter_destroy(filter);
+		return NULL;
+	}
+
+	UNUSED_PARAMETER(settings);
+	return filter;
+}
+
+static void filter_render(void *data, gs_effect_t *effect)
+{
+	struct bench_filter *filter = data;
+
+	if (!obs_source_process_filter_begin(filter->source, GS_RGBA,
+				OBS_ALLOW_DIRECT_RENDERING))
+		return;
+
+	gs_effect_set_vec4(gs_effect_get_param_by_name(filter->effect, "mul"),
+			&filter->mul);
+	obs_source_process_filter_end(filter->source, filter->effect, 0, 0);
+
+	UNUSED_PARAMETER(effect);
+}
+
+static const char *filter_get_fused_shader(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return bench_fused_shader;
+}
+
+static void filter_set_fused_params(void *data, gs_effect_t *effect,
+		const char *prefix)
+{
+	struct bench_filter *filter = data;
+
+	gs_effect_set_vec4(obs_fused_effect_get_param(effect, prefix, "mul"),
+			&filter->mul);
+}
+
+static struct obs_source_info bench_filter = {
+	.id           = "fusion_bench_filter",
+	.type         = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name     = filter_get_name,
+	.create       = filter_create,
+	.destroy      = filter_destroy,
+	.video_render = filter_render
+};
+
+static struct obs_source_info bench_fused_filter = {
+	.id               = "fusion_bench_fused_filter",
+	.type             = OBS_SOURCE_TYPE_FILTER,
+	.output_flags     = OBS_SOURCE_VIDEO | OBS_SOURCE_FUSABLE,
+	.get_name         = filter_get_name,
+	.create           = filter_create,
+	.destroy          = filter_destroy,
+	.video_render     = filter_render,
+	.get_fused_shader = filter_get_fused_shader,
+	.set_fused_params = filter_set_fused_params
+};
+
+/* --------------------------------------------------- */
+
+struct bench {
+	obs_source_t    *input;
+	gs_texrender_t  *texrender;
+	gs_stagesurf_t  *stagesurf;
+
+	long            frames;
+	uint64_t        total_ns;
+	uint64_t        min_ns;
+	uint64_t        max_ns;
+};
+
+static void bench_draw(void *param, uint32_t cx, uint32_t cy)
+{
+	struct bench *bench = param;
+	uint64_t start, elapsed;
+	uint8_t *data;
+	uint32_t linesize;
+	long frame;
+
+	frame = os_atomic_load_long(&bench->frames);
+	if (frame >= WARMUP_FRAMES + BENCH_FRAMES)
+		return;
+
+	start = os_gettime_ns();
+
+	gs_texrender_reset(bench->texrender);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(bench->texrender, BENCH_CX, BENCH_CY)) {
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)BENCH_CX, 0.0f, (float)BENCH_CY,
+				-100.0f, 100.0f);
+
+		obs_source_video_render(bench->input);
+
+		gs_texrender_end(bench->texrender);
+	}
+
+	gs_blend_state_pop();
+
+	/* mapping waits for the GPU to finish the whole chain */
+	gs_stage_texture(bench->stagesurf,
+			gs_texrender_get_texture(bench->texrender));
+	if (gs_stagesurface_map(bench->stagesurf, &data, &linesize))
+		gs_stagesurface_unmap(bench->stagesurf);
+
+	elapsed = os_gettime_ns() - start;
+
+	if (frame >= WARMUP_FRAMES) {
+		bench->total_ns += elapsed;
+		if (!bench->min_ns || elapsed < bench->min_ns)
+			bench->min_ns = elapsed;
+		if (elapsed > bench->max_ns)
+			bench->max_ns = elapsed;
+	}
+
+	os_atomic_inc_long(&bench->frames);
+
+	UNUSED_PARAMETER(cx);
+	UNUSED_PARAMETER(cy);
+}
+
+static bool run_bench(const char *filter_id, struct bench *bench)
+{
+	memset(bench, 0, sizeof(*bench));
+
+	bench->input = obs_source_create(bench_input.id, "input", NULL, NULL);
+	if (!bench->input)
+		return false;
+
+	for (int i = 0; i < NUM_FILTERS; i++) {
+		obs_source_t *filter = obs_source_create(filter_id, "filter",
+				NULL, NULL);
+		if (!filter) {
+			obs_source_release(bench->input);
+			return false;
+		}
+
+		obs_source_filter_add(bench->input, filter);
+		obs_source_release(filter);
+	}
+
+	obs_enter_graphics();
+	bench->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	bench->stagesurf = gs_stagesurface_create(BENCH_CX, BENCH_CY, GS_RGBA);
+	obs_leave_graphics();
+
+	obs_add_main_render_callback(bench_draw, bench);
+
+	while (os_atomic_load_long(&bench->frames) <
+			WARMUP_FRAMES + BENCH_FRAMES)
+		os_sleep_ms(10);
+
+	obs_remove_main_render_callback(bench_draw, bench);
+
+	obs_enter_graphics();
+	gs_stagesurface_destroy(bench->stagesurf);
+	gs_texrender_destroy(bench->texrender);
+	obs_leave_graphics();
+
+	obs_source_remove(bench->input);
+	obs_source_release(bench->input);
+	return true;
+}
+
+static void print_bench(const char *name, const struct bench *bench)
+{
+	printf("%-8s %4d filters: %8.3f ms/frame average, "
+			"%8.3f min, %8.3f max\n",
+			name, NUM_FILTERS,
+			(double)bench->total_ns / BENCH_FRAMES / 1000000.0,
+			(double)bench->min_ns / 1000000.0,
+			(double)bench->max_ns / 1000000.0);
+}
+
+/* --------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	struct obs_video_info ovi = {0};
+	struct bench unfused, fused;
+	int ret = 1;
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "Couldn't create OBS\n");
+		return 1;
+	}
+
+	ovi.adapter         = 0;
+	ovi.fps_num         = 60;
+	ovi.fps_den         = 1;
+	ovi.graphics_module = DL_OPENGL;
+	ovi.output_format   = VIDEO_FORMAT_RGBA;
+	ovi.base_width      = BENCH_CX;
+	ovi.base_height     = BENCH_CY;
+	ovi.output_width    = BENCH_CX;
+	ovi.output_height   = BENCH_CY;
+
+	if (obs_reset_video(&ovi) != 0) {
+		fprintf(stderr, "Couldn't initialize video\n");
+		goto fail;
+	}
+
+	obs_register_source(&bench_input);
+	obs_register_source(&bench_filter);
+	obs_register_source(&bench_fused_filter);
+
+	if (!run_bench(bench_filter.id, &unfused) ||
+	    !run_bench(bench_fused_filter.id, &fused)) {
+		fprintf(stderr, "Couldn't create benchmark sources\n");
+		goto fail;
+	}
+
+	print_bench("unfused", &unfused);
+	print_bench("fused", &fused);
+	ret = 0;
+
+fail:
+	obs_shutdown();
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return ret;
+}
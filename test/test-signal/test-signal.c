@@ -0,0 +1,188 @@
+/*
+ * Measures the cost of a signal emission to a few connected callbacks.
+ *
+ * Emits NUM_EMITS signals with the calldata built three ways: on the heap,
+ * in a fixed stack buffer and with calldata_init_stack.  Then the stack
+ * variant is repeated from NUM_THREADS threads at once, which only scales
+ * if emitting does not hold a lock while the callbacks run.  Every run
+ * also prints the number of allocations it made per emit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <callback/signal.h>
+
+#define NUM_EMITS     1000000
+#define NUM_CALLBACKS 3
+#define NUM_THREADS   4
+
+static const char *bench_signals[] = {
+	"void volume(ptr source, in out float volume, int flags)",
+	NULL
+};
+
+static volatile long calls = 0;
+static volatile long allocs = 0;
+
+/* bnum_allocs only counts outstanding blocks, so count the calls instead */
+static void *count_malloc(size_t size)
+{
+	os_atomic_inc_long(&allocs);
+	return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	os_atomic_inc_long(&allocs);
+	return realloc(ptr, size);
+}
+
+static struct base_allocator count_allocator = {
+	count_malloc,
+	count_realloc,
+	free
+};
+
+static void bench_callback(void *param, calldata_t *cd)
+{
+	double volume = calldata_float(cd, "volume");
+
+	if (volume >= 0.0)
+		os_atomic_inc_long(&calls);
+
+	UNUSED_PARAMETER(param);
+}
+
+/* --------------------------------------------------- */
+
+enum calldata_type {
+	CALLDATA_HEAP,
+	CALLDATA_FIXED,
+	CALLDATA_STACK
+};
+
+static const char *calldata_type_names[] = {
+	"heap",
+	"fixed",
+	"stack"
+};
+
+static inline void emit(signal_handler_t *handler, enum calldata_type type,
+		long i)
+{
+	uint8_t stack[128];
+	calldata_t cd;
+
+	if (type == CALLDATA_HEAP)
+		calldata_init(&cd);
+	else if (type == CALLDATA_FIXED)
+		calldata_init_fixed(&cd, stack, sizeof(stack));
+	else
+		calldata_init_stack(&cd, stack, sizeof(stack));
+
+	calldata_set_ptr(&cd, "source", handler);
+	calldata_set_float(&cd, "volume", (double)(i % 100) / 100.0);
+	calldata_set_int(&cd, "flags", i);
+	signal_handler_signal(handler, "volume", &cd);
+	calldata_free(&cd);
+}
+
+struct emitter {
+	signal_handler_t   *handler;
+	enum calldata_type type;
+	long               emits;
+	pthread_t          thread;
+};
+
+static void *emit_thread(void *data)
+{
+	struct emitter *emitter = data;
+
+	for (long i = 0; i < emitter->emits; i++)
+		emit(emitter->handler, emitter->type, i);
+
+	return NULL;
+}
+
+static bool run_bench(signal_handler_t *handler, enum calldata_type type,
+		int threads)
+{
+	struct emitter emitters[NUM_THREADS];
+	long emits = NUM_EMITS / threads;
+	long total = emits * threads;
+	long start_allocs;
+	uint64_t start, elapsed;
+
+	os_atomic_set_long(&calls, 0);
+	start_allocs = os_atomic_load_long(&allocs);
+	start = os_gettime_ns();
+
+	for (int i = 0; i < threads; i++) {
+		emitters[i].handler = handler;
+		emitters[i].type    = type;
+		emitters[i].emits   = emits;
+		pthread_create(&emitters[i].thread, NULL, emit_thread,
+				&emitters[i]);
+	}
+
+	for (int i = 0; i < threads; i++)
+		pthread_join(emitters[i].thread, NULL);
+
+	elapsed = os_gettime_ns() - start;
+
+	printf("%-6s %d thread%s: %8.1f ns/emit, %5.2f allocations/emit\n",
+			calldata_type_names[type], threads,
+			threads == 1 ? " " : "s",
+			(double)elapsed / (double)total,
+			(double)(os_atomic_load_long(&allocs) - start_allocs) /
+			(double)total);
+
+	if (os_atomic_load_long(&calls) != total * NUM_CALLBACKS) {
+		fprintf(stderr, "Expected %ld callback calls, got %ld\n",
+				total * NUM_CALLBACKS,
+				os_atomic_load_long(&calls));
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	signal_handler_t *handler;
+	bool success = true;
+
+	base_set_allocator(&count_allocator);
+	handler = signal_handler_create();
+
+	if (!handler || !signal_handler_add_array(handler, bench_signals)) {
+		fprintf(stderr, "Couldn't create the signal handler\n");
+		signal_handler_destroy(handler);
+		return 1;
+	}
+
+	for (int i = 0; i < NUM_CALLBACKS; i++)
+		signal_handler_connect(handler, "volume", bench_callback,
+				(void*)(intptr_t)i);
+
+	/* the first emits also cover any lazy setup */
+	for (long i = 0; i < 1000; i++)
+		emit(handler, CALLDATA_STACK, i);
+
+	success = run_bench(handler, CALLDATA_HEAP, 1) && success;
+	success = run_bench(handler, CALLDATA_FIXED, 1) && success;
+	success = run_bench(handler, CALLDATA_STACK, 1) && success;
+	success = run_bench(handler, CALLDATA_STACK, NUM_THREADS) && success;
+
+	signal_handler_destroy(handler);
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return success ? 0 : 1;
+}
@@ -0,0 +1,341 @@
+/*
+ * Checks where the ffmpeg muxer output splits files, and that no packet is
+ * lost, repeated or mistimed across the files.
+ *
+ * Feeds an interleaved sequence of video and audio packets through the
+ * same split logic the output uses (obs-ffmpeg-split.h) and compares the
+ * per-track packet counts and timestamps of each resulting file with what
+ * the limits should produce.  Returns non-zero if anything is off.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <obs.h>
+
+#include "obs-ffmpeg-split.h"
+
+#define FPS               30
+#define KEYINT            60
+#define SAMPLE_RATE       48000
+#define AUDIO_FRAME       1024
+#define NUM_AUDIO_TRACKS  2
+#define VIDEO_PACKET_SIZE 10000
+#define AUDIO_PACKET_SIZE 500
+#define DURATION_SEC      20
+#define MAX_SEGMENTS      16
+#define NUM_TRACKS        (NUM_AUDIO_TRACKS + 1)
+
+struct track {
+	long             packets;
+	int64_t          first_dts;
+	int64_t          last_dts;
+	int64_t          first_orig_dts;
+	int64_t          last_orig_dts;
+	bool             bad_dts;
+};
+
+struct segment {
+	struct track     tracks[NUM_TRACKS];
+	bool             starts_on_keyframe;
+	long             packets;
+};
+
+struct split_test {
+	struct ffmpeg_split split;
+	struct segment   segments[MAX_SEGMENTS];
+	int              num_segments;
+	long             total[NUM_TRACKS];
+	int64_t          last_input_dts[NUM_TRACKS];
+	int              failures;
+};
+
+#define check(test, cond, format, ...) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "FAILED: " format "\n", \
+					##__VA_ARGS__); \
+			(test)->failures++; \
+		} \
+	} while (false)
+
+/* --------------------------------------------------- */
+
+static inline int track_of(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO ? 0 :
+		(int)packet->track_idx + 1;
+}
+
+/* what ffmpeg_mux_data does with each packet, minus the muxer process */
+static void mux_packet(struct split_test *test, struct encoder_packet *packet)
+{
+	struct encoder_packet pkt = *packet;
+	struct segment *seg;
+	struct track *track;
+	int idx = track_of(&pkt);
+
+	if (ffmpeg_split_needed(&test->split, &pkt)) {
+		ffmpeg_split_next_segment(&test->split);
+		test->num_segments++;
+	}
+
+	if (test->num_segments > MAX_SEGMENTS) {
+		test->failures++;
+		return;
+	}
+
+	ffmpeg_split_offset_packet(&test->split, &pkt);
+
+	seg = &test->segments[test->num_segments - 1];
+	track = &seg->tracks[idx];
+
+	if (!seg->packets)
+		seg->starts_on_keyframe = pkt.type == OBS_ENCODER_VIDEO &&
+			pkt.keyframe;
+
+	if (!track->packets) {
+		track->first_dts = pkt.dts;
+		track->first_orig_dts = packet->dts;
+	} else if (pkt.dts <= track->last_dts) {
+		track->bad_dts = true;
+	}
+
+	if (pkt.dts != packet->dts - track->first_orig_dts ||
+	    pkt.pts - pkt.dts != packet->pts - packet->dts)
+		track->bad_dts = true;
+
+	track->last_dts = pkt.dts;
+	track->last_orig_dts = packet->dts;
+	track->packets++;
+	seg->packets++;
+}
+
+/* video and audio packets in the order the encoders would deliver them */
+static void feed_packets(struct split_test *test)
+{
+	const int64_t video_frames = (int64_t)DURATION_SEC * FPS;
+	const int64_t audio_frames =
+		(int64_t)DURATION_SEC * SAMPLE_RATE / AUDIO_FRAME;
+	int64_t v = 0, a = 0;
+
+	test->num_segments = 1;
+	ffmpeg_split_reset_segment(&test->split);
+
+	while (v < video_frames || a < audio_frames) {
+		int64_t v_usec = v * 1000000 / FPS;
+		int64_t a_usec = a * AUDIO_FRAME * 1000000 / SAMPLE_RATE;
+		struct encoder_packet packet = {0};
+
+		if (v < video_frames &&
+		    (a >= audio_frames || v_usec <= a_usec)) {
+			packet.type         = OBS_ENCODER_VIDEO;
+			packet.keyframe     = v % KEYINT == 0;
+			packet.dts          = v;
+			packet.pts          = v + 1;
+			packet.dts_usec     = v_usec;
+			packet.timebase_num = 1;
+			packet.timebase_den = FPS;
+			packet.size         = VIDEO_PACKET_SIZE;
+
+			mux_packet(test, &packet);
+			test->total[0]++;
+			test->last_input_dts[0] = packet.dts;
+			v++;
+			continue;
+		}
+
+		for (size_t i = 0; i < NUM_AUDIO_TRACKS; i++) {
+			packet.type         = OBS_ENCODER_AUDIO;
+			packet.keyframe     = true;
+			packet.track_idx    = i;
+			packet.dts          = a * AUDIO_FRAME;
+			packet.pts          = packet.dts;
+			packet.dts_usec     = a_usec;
+			packet.timebase_num = 1;
+			packet.timebase_den = SAMPLE_RATE;
+			packet.size         = AUDIO_PACKET_SIZE;
+
+			mux_packet(test, &packet);
+			test->total[i + 1]++;
+			test->last_input_dts[i + 1] = packet.dts;
+		}
+		a++;
+	}
+}
+
+/* every track continues in the next file exactly where it stopped in the
+ * previous one, and the files add up to what was fed in */
+static void check_tracks(struct split_test *test, const char *name)
+{
+	for (int t = 0; t < NUM_TRACKS; t++) {
+		int64_t step = t == 0 ? 1 : AUDIO_FRAME;
+		int64_t next_dts = 0;
+		long packets = 0;
+
+		for (int s = 0; s < test->num_segments; s++) {
+			struct track *track = &test->segments[s].tracks[t];
+
+			if (!track->packets)
+				continue;
+
+			check(test, !track->bad_dts,
+					"%s: file %d track %d has bad "
+					"timestamps", name, s + 1, t);
+			check(test, track->first_dts == 0,
+					"%s: file %d track %d starts at %lld",
+					name, s + 1, t,
+					(long long)track->first_dts);
+			check(test, track->first_orig_dts == next_dts,
+					"%s: file %d track %d starts at input "
+					"dts %lld instead of %lld", name, s + 1,
+					t, (long long)track->first_orig_dts,
+					(long long)next_dts);
+
+			next_dts = track->last_orig_dts + step;
+			packets += track->packets;
+		}
+
+		check(test, packets == test->total[t],
+				"%s: track %d has %ld packets in its files, "
+				"%ld were fed in", name, t, packets,
+				test->total[t]);
+		check(test, next_dts == test->last_input_dts[t] + step,
+				"%s: track %d ends at input dts %lld instead "
+				"of %lld", name, t, (long long)next_dts - step,
+				(long long)test->last_input_dts[t]);
+	}
+
+	for (int s = 1; s < test->num_segments; s++)
+		check(test, test->segments[s].starts_on_keyframe,
+				"%s: file %d does not start on a video "
+				"keyframe", name, s + 1);
+}
+
+static void print_segments(const struct split_test *test, const char *name)
+{
+	printf("%s: %d files\n", name, test->num_segments);
+
+	for (int s = 0; s < test->num_segments; s++) {
+		const struct segment *seg = &test->segments[s];
+
+		printf("  file %d:", s + 1);
+		for (int t = 0; t < NUM_TRACKS; t++)
+			printf(" track %d: %4ld packets, dts %lld-%lld;", t,
+					seg->tracks[t].packets,
+					(long long)seg->tracks[t].first_dts,
+					(long long)seg->tracks[t].last_dts);
+		printf("\n");
+	}
+}
+
+/* --------------------------------------------------- */
+
+/* a 5 second limit with a keyframe every 2 seconds splits at the first
+ * keyframe from 5 seconds on: 6, 12 and 18 seconds */
+static int test_max_time(void)
+{
+	static const long expected_video[] = {180, 180, 180, 60};
+	struct split_test *test = bzalloc(sizeof(*test));
+	int failures;
+
+	test->split.max_time = 5 * 1000000LL;
+	feed_packets(test);
+	print_segments(test, "max_time");
+	check_tracks(test, "max_time");
+
+	check(test, test->num_segments == 4,
+			"max_time: %d files instead of 4", test->num_segments);
+	for (int s = 0; s < test->num_segments && s < 4; s++)
+		check(test, test->segments[s].tracks[0].packets ==
+				expected_video[s],
+				"max_time: file %d has %ld video packets "
+				"instead of %ld", s + 1,
+				test->segments[s].tracks[0].packets,
+				expected_video[s]);
+
+	failures = test->failures;
+	bfree(test);
+	return failures;
+}
+
+/* a file is only split once it reached the size limit, and only on a
+ * keyframe, so every file but the last is at least max_size */
+static int test_max_size(void)
+{
+	struct split_test *test = bzalloc(sizeof(*test));
+	const int64_t max_size = 2 * 1000 * 1000;
+	int failures;
+
+	test->split.max_size = max_size;
+	feed_packets(test);
+	print_segments(test, "max_size");
+	check_tracks(test, "max_size");
+
+	check(test, test->num_segments > 1,
+			"max_size: the output was never split");
+	for (int s = 0; s < test->num_segments - 1; s++) {
+		const struct segment *seg = &test->segments[s];
+		int64_t size = 0;
+
+		for (int t = 0; t < NUM_TRACKS; t++)
+			size += seg->tracks[t].packets *
+				(t == 0 ? VIDEO_PACKET_SIZE : AUDIO_PACKET_SIZE);
+
+		check(test, size >= max_size,
+				"max_size: file %d was split at %lld bytes",
+				s + 1, (long long)size);
+	}
+
+	failures = test->failures;
+	bfree(test);
+	return failures;
+}
+
+/* the same order of calls as change_file, from the state
+ * ffmpeg_mux_start leaves behind */
+static int test_paths(void)
+{
+	static const char *expected[] = {
+		"/rec/out_2.mkv", "/rec/out_3.mkv", "/rec/out_4.mkv"
+	};
+	struct split_test test;
+	struct dstr path = {0};
+
+	memset(&test, 0, sizeof(test));
+	ffmpeg_split_reset_segment(&test.split);
+
+	for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+		ffmpeg_split_get_path(&test.split, "/rec/out.mkv", &path);
+		check(&test, strcmp(path.array, expected[i]) == 0,
+				"path: split %d got '%s' instead of '%s'",
+				(int)i + 1, path.array, expected[i]);
+		ffmpeg_split_next_segment(&test.split);
+	}
+
+	memset(&test.split, 0, sizeof(test.split));
+	ffmpeg_split_get_path(&test.split, "/rec.d/out", &path);
+	check(&test, strcmp(path.array, "/rec.d/out_2") == 0,
+			"path: got '%s' instead of '/rec.d/out_2'",
+			path.array);
+
+	dstr_free(&path);
+	return test.failures;
+}
+
+int main(int argc, char *argv[])
+{
+	int failures = test_max_time() + test_max_size() + test_paths();
+
+	if (failures)
+		fprintf(stderr, "%d checks failed\n", failures);
+	else
+		printf("all checks passed\n");
+
+	UNUSED_PARAMETER(argc);
+	UNUSED_PARAMETER(argv);
+	return failures ? 1 : 0;
+}